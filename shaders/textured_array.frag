@@ -0,0 +1,23 @@
+#version 460
+//textured_lit fragment stage for textures packed into an array, see texture_packer.h
+//each texture fills its own layer, so the repeat sampler tiles it like an image of its own
+layout (location = 0) in vec3 inColor;
+layout (location = 1) in vec2 texCoord;
+
+layout (location = 0) out vec4 outFragColor;
+
+//push constants block, data is the uv scale of the texture in its layer in xy (always 1) and the layer in z
+layout( push_constant ) uniform constants
+{
+	vec4 data;
+	mat4 render_matrix;
+} PushConstants;
+
+layout(set = 2, binding = 0) uniform sampler2DArray tex1;
+
+void main()
+{
+	//the sampler wraps, filtering and every mip level reach across to the opposite edge of the same texture
+	vec3 color = texture(tex1, vec3(texCoord, PushConstants.data.z)).xyz;
+	outFragColor = vec4(color, 1.0f);
+}
@@ -0,0 +1,1015 @@
+// asset_cooker: offline converter from source assets (.obj/.png) to the engine's cooked format.
+// usage: asset_cooker <file or folder>... [-o output_folder] [-lod ratio,ratio,...] [-mip-filter box|kaiser]
+//                      [-bc none|bc1|bc3|bc5|bc7|auto] [-ktx2] [-zstd level] [-bench-obj] [-bench-mips] [-bench-bc]
+//                      [-bench-decode] [-pack-arrays] [-bench-arrays]
+// -bc picks the texture block format, auto is BC5 for files named *normal* and BC7 for the rest
+// -ktx2 writes textures as .ktx2 instead of .tx, zstd supercompressed at -zstd level (0 stores the levels plain)
+// -bench-obj times the obj parser against tinyobj instead of cooking
+// -bench-mips times the cpu mip generator per filter and code path instead of cooking
+// -bench-bc times and scores every block encoder instead of cooking
+// -bench-decode times decoding every image of the inputs one after another against all at once on the thread pool,
+//               and the peak memory of decoding straight into staging against going through heap copies
+// -pack-arrays also packs the small diffuse textures of every cooked mesh into texture arrays next to it (.texa)
+// -bench-arrays packs 1000 synthetic small textures and counts texture binds of a scene using them, no inputs needed
+#include <iostream>
+#include <filesystem>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <cstdlib>
+#include <limits>
+#include <cstring>
+#include <random>
+#include <future>
+#include <memory>
+
+#include <vk_mesh.h>
+#include <vk_meshlet.h>
+#include <vk_mesh_simplify.h>
+#include <asset_loader.h>
+#include <obj_loader.h>
+#include <thread_pool.h>
+#include <texture_packer.h>
+#include <mip_generator.h>
+#include <bc_encoder.h>
+#include <ktx2_loader.h>
+#include <tiny_obj_loader.h>
+
+#include <image_decode.h>
+#include <memory_stats.h>
+#include <stb_image.h>
+
+namespace fs = std::filesystem;
+
+//fractions of LOD 0 triangles for the mesh LOD chain, set with -lod
+static std::vector<float> lodRatios(DEFAULT_LOD_RATIOS.begin(), DEFAULT_LOD_RATIOS.end());
+//set with -bench-obj, compare obj parsers instead of cooking
+static bool benchObj = false;
+//set with -bench-decode, time serial against parallel image decode over all inputs
+static bool benchDecode = false;
+//set with -pack-arrays, cook the small textures of each mesh into texture arrays
+static bool packArrays = false;
+//set with -bench-arrays, pack a synthetic texture set and count binds
+static bool benchArrays = false;
+//set with -bench-mips, time the mip generator instead of cooking
+static bool benchMips = false;
+//set with -bench-bc, time and score the block encoders instead of cooking
+static bool benchBc = false;
+//filter for the cooked mip chains, set with -mip-filter
+static MipFilter mipFilter = MipFilter::Kaiser;
+//block format of cooked textures set with -bc, autoBc picks per file
+static assets::TextureFormat textureFormat = assets::TextureFormat::BC7_SRGB;
+static bool autoBc = true;
+//set with -ktx2, write textures as KTX2 with levels supercompressed at zstdLevel (-zstd)
+static bool writeKtx2 = false;
+static int zstdLevel = 10;
+
+static float elapsed_ms(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+//build the LOD chain and check it: valid ranges, triangle targets, and the recorded error
+//really bounding the distance from the full detail surface to each level
+static bool cook_lods(const fs::path& input, Mesh& mesh)
+{
+	const float lodTime = vkutil::generate_lods(mesh, lodRatios.data(), lodRatios.size());
+	if (!vkutil::validate_lods(mesh)) {
+		std::cerr << "LODs of " << input << " failed validation" << std::endl;
+		return false;
+	}
+	//sample LOD 0 at its edge midpoints, generate_lods measured its vertices and triangle centroids
+	const MeshLod base = mesh.base_lod();
+	std::vector<glm::vec3> midpoints;
+	midpoints.reserve(base.indexCount);
+	for (uint32_t i = base.indexOffset; i < base.indexOffset + base.indexCount; i += 3) {
+		const glm::vec3 a = mesh._vertices[mesh._indices[i]].position;
+		const glm::vec3 b = mesh._vertices[mesh._indices[i + 1]].position;
+		const glm::vec3 c = mesh._vertices[mesh._indices[i + 2]].position;
+		midpoints.push_back((a + b) * 0.5f);
+		midpoints.push_back((b + c) * 0.5f);
+		midpoints.push_back((c + a) * 0.5f);
+	}
+
+	std::cout << "LODs " << input.filename() << ": " << mesh._lods.size() << " levels in " << lodTime << " ms, "
+		<< base.submeshCount << " submeshes over " << mesh._materials.size() << " materials" << std::endl;
+	std::cout << "  level  triangles     target      error   measured" << std::endl;
+	const uint32_t baseTriangles = base.indexCount / 3;
+	for (size_t l = 0; l < mesh._lods.size(); l++) {
+		const uint32_t triangles = mesh._lods[l].indexCount / 3;
+		const uint32_t target = l == 0 ? baseTriangles : static_cast<uint32_t>(baseTriangles * lodRatios[l - 1]);
+		const float measured = l == 0 ? 0.0f : vkutil::measure_lod_error(mesh, l, midpoints);
+		std::cout << "  " << std::setw(5) << l << std::setw(11) << triangles << std::setw(11) << target
+			<< std::setw(11) << mesh._lods[l].error << std::setw(11) << measured << std::endl;
+		//seams and borders can leave a level a little short of its target, far off it the ratios do not suit the mesh
+		if (triangles > target * (1.0f + LOD_TARGET_SLACK)) {
+			std::cerr << "LOD " << l << " of " << input << " keeps " << triangles << " triangles for a target of " << target
+				<< " (slack " << LOD_TARGET_SLACK * 100.0f << "%)" << std::endl;
+			return false;
+		}
+		//small slack for float rounding in the distance queries
+		if (measured > mesh._lods[l].error * 1.001f + 1e-6f) {
+			std::cerr << "LOD " << l << " of " << input << " deviates " << measured << " but records " << mesh._lods[l].error << std::endl;
+			return false;
+		}
+	}
+	if (mesh._lods.size() < lodRatios.size() + 1) {
+		std::cout << "  " << mesh._lods.size() - 1 << " of " << lodRatios.size() << " levels built" << std::endl;
+	}
+	return true;
+}
+
+//mesh bounds against a scalar pass, and world bounds against every transformed vertex
+static bool check_bounds(const fs::path& input, Mesh& mesh)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	mesh.update_bounds();
+	const float boundsTime = elapsed_ms(start);
+	const Bounds& bounds = mesh._bounds;
+	if (!vkutil::validate_bounds(bounds, &mesh._vertices[0].position, mesh._vertices.size(), sizeof(Vertex))) {
+		std::cerr << "Bounds of " << input << " failed validation" << std::endl;
+		return false;
+	}
+	//rotated, non uniformly scaled and moved, like a placed object
+	const glm::mat4 transform = glm::translate(glm::vec3(3.0f, -1.0f, 2.0f)) * glm::rotate(0.7f, glm::normalize(glm::vec3(1.0f, 2.0f, 3.0f)))
+		* glm::scale(glm::vec3(2.0f, 0.5f, 1.0f));
+	const Bounds world = vkutil::transform_bounds(bounds, transform);
+	const float tolerance = world.sphere.w * 1e-5f + 1e-5f;
+	for (const Vertex& v : mesh._vertices) {
+		const glm::vec3 p = glm::vec3(transform * glm::vec4(v.position, 1.0f));
+		if (glm::any(glm::lessThan(p, world.min - tolerance)) || glm::any(glm::greaterThan(p, world.max + tolerance))
+			|| glm::length(p - glm::vec3(world.sphere)) > world.sphere.w + tolerance) {
+			std::cerr << "World bounds of " << input << " miss a transformed vertex" << std::endl;
+			return false;
+		}
+	}
+	std::cout << "Bounds " << input.filename() << ": box (" << bounds.min.x << ", " << bounds.min.y << ", " << bounds.min.z
+		<< ") - (" << bounds.max.x << ", " << bounds.max.y << ", " << bounds.max.z << "), sphere radius " << bounds.sphere.w
+		<< " (half diagonal " << glm::length(bounds.max - bounds.min) * 0.5f << "), " << boundsTime << " ms" << std::endl;
+	return true;
+}
+
+static bool cook_texture_pack(const fs::path& input, const Mesh& mesh, const fs::path& output);
+
+static bool cook_mesh(const fs::path& input, const fs::path& output)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	Mesh mesh;
+	if (!mesh.load_from_obj(input.string().c_str())) {
+		return false;
+	}
+	const float parseTime = elapsed_ms(start);
+
+	//simplified levels go after LOD 0 in the same index buffer, cooked so the engine never simplifies at load
+	if (!cook_lods(input, mesh)) {
+		return false;
+	}
+	//bounds are recomputed at load, check them here since culling and LOD selection trust them
+	if (!check_bounds(input, mesh)) {
+		return false;
+	}
+
+	//check the compact vertex format against the fp32 vertices, the engine may upload either
+	Mesh quantized = mesh;
+	quantized.quantize_vertices();
+	QuantizationError error = quantized.measure_quantization_error();
+	std::cout << "Quantized " << input.filename() << ": " << mesh.vertex_buffer_size() << " -> "
+		<< quantized.vertex_buffer_size() << " bytes, max error position " << error.position
+		<< " (step " << quantized.position_step() << ") normal " << error.normal << " deg uv " << error.uv << std::endl;
+	if (!error.within_tolerance(quantized.position_step())) {
+		std::cerr << "Compact vertices of " << input << " are out of tolerance" << std::endl;
+		return false;
+	}
+
+	//meshlets are rebuilt at load time, cook them here to check coverage and bounds
+	const float meshletTime = vkutil::build_meshlets(mesh);
+	if (!vkutil::validate_meshlets(mesh)) {
+		std::cerr << "Meshlets of " << input << " failed validation" << std::endl;
+		return false;
+	}
+	const uint32_t baseTriangles = mesh.base_lod().indexCount / 3;
+	std::cout << "Meshlets " << input.filename() << ": " << mesh._meshlets.size() << " clusters for "
+		<< baseTriangles << " triangles, " << meshletTime << " ms ("
+		<< meshletTime * 1e6f / std::max<uint32_t>(baseTriangles, 1) << " ms per million triangles)" << std::endl;
+
+	assets::MeshInfo info = {};
+	info.vertexCount = mesh._vertices.size();
+	info.indexCount = mesh._indices.size();
+	info.vertexFormat = assets::VertexFormat::PNCV_F32;
+	info.vertexSize = sizeof(Vertex);
+	info.lodCount = static_cast<uint32_t>(mesh._lods.size());
+	info.lodSize = sizeof(MeshLod);
+	info.submeshCount = static_cast<uint32_t>(mesh._submeshes.size());
+	info.materialCount = static_cast<uint32_t>(mesh._materials.size());
+
+	std::vector<assets::MaterialInfo> materials(mesh._materials.size());
+	for (size_t m = 0; m < mesh._materials.size(); m++) {
+		const MeshMaterial& material = mesh._materials[m];
+		assets::MaterialInfo& record = materials[m];
+		memset(&record, 0, sizeof(record));
+		if (material.name.size() >= sizeof(record.name) || material.diffuseTexture.size() >= sizeof(record.diffuseTexture)) {
+			std::cerr << "Material " << material.name << " of " << input << " has a name or texture path that is too long" << std::endl;
+			return false;
+		}
+		memcpy(record.name, material.name.data(), material.name.size());
+		memcpy(record.diffuseTexture, material.diffuseTexture.data(), material.diffuseTexture.size());
+		record.diffuse[0] = material.diffuse.x;
+		record.diffuse[1] = material.diffuse.y;
+		record.diffuse[2] = material.diffuse.z;
+	}
+
+	std::vector<std::pair<const void*, size_t>> sections{
+		{ mesh._vertices.data(), mesh._vertices.size() * sizeof(Vertex) },
+		{ mesh._indices.data(), mesh._indices.size() * sizeof(uint32_t) },
+		{ mesh._lods.data(), mesh._lods.size() * sizeof(MeshLod) },
+		{ mesh._submeshes.data(), mesh._submeshes.size() * sizeof(Submesh) },
+		{ materials.data(), materials.size() * sizeof(assets::MaterialInfo) }
+	};
+	if (!assets::save_asset(output.string().c_str(), "MESH", &info, sizeof(info), sections)) {
+		return false;
+	}
+
+	//load it back the way the engine does, to compare against the obj parse
+	start = std::chrono::high_resolution_clock::now();
+	Mesh cooked;
+	if (!cooked.load_from_asset(output.string().c_str())) {
+		std::cerr << "Failed to read back " << output << std::endl;
+		return false;
+	}
+	const float loadTime = elapsed_ms(start);
+	if (cooked._submeshes.size() != mesh._submeshes.size() || cooked._materials.size() != mesh._materials.size()
+		|| !vkutil::validate_lods(cooked)) {
+		std::cerr << "Submeshes of " << output << " don't match the cooked mesh" << std::endl;
+		return false;
+	}
+	std::cout << "Cooked " << input.filename() << " -> " << output.filename()
+		<< ": " << fs::file_size(input) << " -> " << fs::file_size(output) << " bytes, load "
+		<< parseTime << " ms (obj) vs " << loadTime << " ms (cooked)" << std::endl;
+	if (packArrays) {
+		fs::path packOutput = output;
+		return cook_texture_pack(input, mesh, packOutput.replace_extension(".texa"));
+	}
+	return true;
+}
+
+static const char* texture_format_name(assets::TextureFormat format)
+{
+	switch (format) {
+	case assets::TextureFormat::BC1_SRGB: return "BC1";
+	case assets::TextureFormat::BC3_SRGB: return "BC3";
+	case assets::TextureFormat::BC5_UNORM: return "BC5";
+	case assets::TextureFormat::BC7_SRGB: return "BC7";
+	default: return "RGBA8";
+	}
+}
+
+static bool cook_texture(const fs::path& input, const fs::path& output)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	int texWidth, texHeight, texChannels;
+	stbi_uc* pixels = stbi_load(input.string().c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+	if (!pixels) {
+		std::cout << "Failed to load texture file " << input << std::endl;
+		return false;
+	}
+	const float decodeTime = elapsed_ms(start);
+
+	assets::TextureFormat format = textureFormat;
+	if (autoBc) {
+		std::string name = input.filename().string();
+		for (char& c : name) {
+			c = static_cast<char>(tolower(c));
+		}
+		format = name.find("normal") != std::string::npos ? assets::TextureFormat::BC5_UNORM : assets::TextureFormat::BC7_SRGB;
+	}
+
+	//ship the whole chain, so loading is a single copy with no blits
+	//normal maps are linear data, their mips are filtered without the srgb curve
+	start = std::chrono::high_resolution_clock::now();
+	MipChain chain;
+	vkutil::generate_mips(pixels, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight),
+		format != assets::TextureFormat::BC5_UNORM, mipFilter, ThreadPool::shared(), chain);
+	stbi_image_free(pixels);
+	const float mipTime = elapsed_ms(start);
+
+	assets::TextureInfo info = {};
+	info.format = format;
+	info.width = chain.width;
+	info.height = chain.height;
+	info.mipLevels = chain.level_count();
+
+	//compress every level into one buffer laid out like the chain
+	start = std::chrono::high_resolution_clock::now();
+	std::vector<uint8_t> blocks;
+	std::vector<size_t> blockOffsets;
+	if (vkutil::is_block_format(format)) {
+		for (uint32_t i = 0; i < chain.level_count(); i++) {
+			blockOffsets.push_back(blocks.size());
+			blocks.resize(blocks.size() + assets::texture_level_size(format, chain.level_width(i), chain.level_height(i)));
+		}
+		for (uint32_t i = 0; i < chain.level_count(); i++) {
+			vkutil::compress_image(chain.level_data(i), chain.level_width(i), chain.level_height(i), format,
+				ThreadPool::shared(), blocks.data() + blockOffsets[i]);
+		}
+	}
+	const float compressTime = elapsed_ms(start);
+
+	std::vector<std::pair<const void*, size_t>> sections;
+	size_t rawBytes = 0;
+	size_t cookedBytes = 0;
+	for (uint32_t i = 0; i < chain.level_count(); i++) {
+		const size_t size = assets::texture_level_size(format, chain.level_width(i), chain.level_height(i));
+		sections.push_back({ vkutil::is_block_format(format) ? blocks.data() + blockOffsets[i] : chain.level_data(i), size });
+		rawBytes += chain.level_size(i);
+		cookedBytes += size;
+	}
+	if (writeKtx2 && !assets::save_ktx2(output.string().c_str(), format, chain.width, chain.height, sections, zstdLevel)) {
+		return false;
+	}
+	if (!writeKtx2 && !assets::save_asset(output.string().c_str(), "TEXI", &info, sizeof(info), sections)) {
+		return false;
+	}
+	std::cout << "Mips " << input.filename() << ": " << info.mipLevels << " levels (" << vkutil::mip_filter_name(mipFilter)
+		<< ", " << vkutil::simd_path_name(vkutil::best_simd_path()) << ") in " << mipTime << " ms" << std::endl;
+	if (vkutil::is_block_format(format)) {
+		//score level 0 against the source on the channels the format keeps
+		const uint32_t channels = format == assets::TextureFormat::BC1_SRGB ? 0x7 : format == assets::TextureFormat::BC5_UNORM ? 0x3 : 0xF;
+		std::vector<uint8_t> decoded(chain.level_size(0));
+		vkutil::decompress_image(blocks.data(), chain.width, chain.height, format, decoded.data());
+		const double psnr = vkutil::compute_psnr(chain.level_data(0), decoded.data(), size_t(chain.width) * chain.height, channels);
+		std::cout << "Compressed " << input.filename() << " to " << texture_format_name(format) << " in " << compressTime
+			<< " ms, PSNR " << psnr << " dB, VRAM " << rawBytes << " -> " << cookedBytes << " bytes ("
+			<< double(rawBytes) / double(cookedBytes) << "x smaller)" << std::endl;
+	}
+
+	//time the cooked read path: map and decompress every level
+	//the byte for byte KTX2 round trip is checked by engine_tests (ktx2)
+	start = std::chrono::high_resolution_clock::now();
+	assets::MappedFile file;
+	if (!file.open(output.string().c_str())) {
+		std::cerr << "Failed to read back " << output << std::endl;
+		return false;
+	}
+	std::vector<char> level;
+	if (writeKtx2) {
+		assets::Ktx2View view;
+		if (!assets::open_ktx2(file, view)) {
+			std::cerr << "Failed to read back " << output << std::endl;
+			return false;
+		}
+		for (uint32_t i = 0; i < view.level_count(); i++) {
+			level.resize(static_cast<size_t>(view.levels[i].uncompressedByteLength));
+			assets::unpack_ktx2_level(view, i, level.data());
+		}
+	}
+	else {
+		assets::AssetView view;
+		if (!assets::open_asset(file, "TEXI", view)) {
+			std::cerr << "Failed to read back " << output << std::endl;
+			return false;
+		}
+		for (uint32_t i = 0; i < view.header->sectionCount; i++) {
+			level.resize(view.sections[i].rawSize);
+			assets::unpack_section(view, i, level.data());
+		}
+	}
+	const float loadTime = elapsed_ms(start);
+	std::cout << "Cooked " << input.filename() << " -> " << output.filename()
+		<< ": " << fs::file_size(input) << " -> " << fs::file_size(output) << " bytes, load "
+		<< decodeTime << " ms (png) vs " << loadTime << " ms (cooked)" << std::endl;
+	return true;
+}
+
+//parse with tinyobj the way Mesh::load_from_obj used to and with assets::parse_obj,
+//check they agree and print both timings
+static bool bench_obj(const fs::path& input)
+{
+	const double megabytes = fs::file_size(input) / (1024.0 * 1024.0);
+	auto start = std::chrono::high_resolution_clock::now();
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string warn, err;
+	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, input.string().c_str(), nullptr) || !err.empty()) {
+		std::cerr << err << std::endl;
+		return false;
+	}
+	std::vector<glm::vec3> referencePositions;
+	for (const tinyobj::shape_t& shape : shapes) {
+		for (const tinyobj::index_t& idx : shape.mesh.indices) {
+			referencePositions.push_back(glm::vec3(attrib.vertices[3 * idx.vertex_index + 0],
+				attrib.vertices[3 * idx.vertex_index + 1], attrib.vertices[3 * idx.vertex_index + 2]));
+		}
+	}
+	const float referenceTime = elapsed_ms(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	assets::ObjData obj;
+	ThreadPool& pool = ThreadPool::shared();
+	if (!assets::parse_obj(input.string().c_str(), obj, pool)) {
+		return false;
+	}
+	const float parseTime = elapsed_ms(start);
+
+	if (obj.corners.size() != referencePositions.size()) {
+		std::cerr << "Parsers disagree on " << input << ": " << obj.corners.size() << " vs "
+			<< referencePositions.size() << " face corners" << std::endl;
+		return false;
+	}
+	//both parsers round to the nearest float, allow one ulp in case tinyobj's double path rounds twice
+	float maxDifference = 0.0f;
+	for (size_t i = 0; i < referencePositions.size(); i++) {
+		const glm::vec3 difference = glm::abs(obj.positions[obj.corners[i].position] - referencePositions[i]);
+		const glm::vec3 magnitude = glm::abs(referencePositions[i]);
+		for (int axis = 0; axis < 3; axis++) {
+			maxDifference = std::max(maxDifference, difference[axis] / std::max(magnitude[axis], 1e-30f));
+		}
+	}
+	std::cout << "Parsed " << input.filename() << " (" << megabytes << " MB, " << obj.corners.size() / 3 << " triangles): tinyobj "
+		<< referenceTime << " ms (" << megabytes * 1000.0 / referenceTime << " MB/s), parse_obj " << parseTime << " ms ("
+		<< megabytes * 1000.0 / parseTime << " MB/s) on " << pool.thread_count() << " threads, max relative difference "
+		<< maxDifference << std::endl;
+	if (maxDifference > 2.0f * std::numeric_limits<float>::epsilon()) {
+		std::cerr << "Parsed positions of " << input << " differ from tinyobj" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+//time generate_mips for every filter and compiled in code path on one image, check the simd paths
+//against the scalar one and that filtering happens in linear light
+static bool bench_mips(const fs::path& input)
+{
+	int texWidth, texHeight, texChannels;
+	stbi_uc* pixels = stbi_load(input.string().c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+	if (!pixels) {
+		std::cout << "Failed to load texture file " << input << std::endl;
+		return false;
+	}
+	const std::vector<uint8_t> image(pixels, pixels + size_t(texWidth) * texHeight * 4);
+	stbi_image_free(pixels);
+	const uint32_t width = static_cast<uint32_t>(texWidth);
+	const uint32_t height = static_cast<uint32_t>(texHeight);
+
+	//a black and white checker averages to half the light, which is srgb 188 and not 128
+	const uint8_t checker[16] = { 0,0,0,255, 255,255,255,255, 255,255,255,255, 0,0,0,255 };
+	MipChain gamma;
+	vkutil::generate_mips(checker, 2, 2, true, MipFilter::Box, ThreadPool::shared(), gamma, SimdPath::Scalar);
+	if (gamma.level_data(1)[0] != 188 || gamma.level_data(1)[3] != 255) {
+		std::cerr << "Box filtered srgb checker gives " << int(gamma.level_data(1)[0]) << " instead of 188" << std::endl;
+		return false;
+	}
+
+	const double megabytes = image.size() / (1024.0 * 1024.0);
+	const SimdPath paths[] = { SimdPath::Scalar, SimdPath::SSE, SimdPath::AVX2, SimdPath::NEON };
+	const MipFilter filters[] = { MipFilter::Box, MipFilter::Kaiser };
+	std::cout << "Mips " << input.filename() << " (" << width << "x" << height << ", " << vkutil::mip_level_count(width, height)
+		<< " levels) on " << ThreadPool::shared().thread_count() << " threads" << std::endl;
+	for (MipFilter filter : filters) {
+		MipChain reference;
+		for (SimdPath path : paths) {
+			if (!vkutil::simd_path_supported(path)) {
+				continue;
+			}
+			//best of a few runs, the first one also pays for page faults
+			MipChain chain;
+			float best = std::numeric_limits<float>::max();
+			for (int run = 0; run < 3; run++) {
+				auto start = std::chrono::high_resolution_clock::now();
+				vkutil::generate_mips(image.data(), width, height, true, filter, ThreadPool::shared(), chain, path);
+				best = std::min(best, elapsed_ms(start));
+			}
+			//summation order matches the scalar loops, anything but tiny rounding differences is a bug
+			int maxDifference = 0;
+			if (path == SimdPath::Scalar) {
+				reference = chain;
+			}
+			else {
+				for (size_t i = 0; i < chain.pixels.size(); i++) {
+					maxDifference = std::max(maxDifference, std::abs(int(chain.pixels[i]) - int(reference.pixels[i])));
+				}
+			}
+			std::cout << "  " << std::setw(6) << vkutil::mip_filter_name(filter) << " " << std::setw(6) << vkutil::simd_path_name(path)
+				<< ": " << std::setw(9) << best << " ms, " << std::setw(8) << megabytes * 1000.0 / best << " MB/s, max difference to scalar "
+				<< maxDifference << std::endl;
+			if (maxDifference > 1) {
+				std::cerr << vkutil::simd_path_name(path) << " mips of " << input << " differ from the scalar path" << std::endl;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+//compress a crop of one image with every block encoder, print time and PSNR of each and check the quality
+//ordering, plus that flat blocks survive the round trip
+static bool bench_bc(const fs::path& input)
+{
+	int texWidth, texHeight, texChannels;
+	stbi_uc* pixels = stbi_load(input.string().c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+	if (!pixels) {
+		std::cout << "Failed to load texture file " << input << std::endl;
+		return false;
+	}
+	//the encoders run per block, a 2048 crop times the same as the whole image would per texel
+	const uint32_t width = std::min(static_cast<uint32_t>(texWidth), 2048u);
+	const uint32_t height = std::min(static_cast<uint32_t>(texHeight), 2048u);
+	std::vector<uint8_t> image(size_t(width) * height * 4);
+	for (uint32_t y = 0; y < height; y++) {
+		memcpy(image.data() + size_t(y) * width * 4, pixels + size_t(y) * texWidth * 4, size_t(width) * 4);
+	}
+	stbi_image_free(pixels);
+
+	//one flat block per format must come back exact, BC7 can be off by one where the p-bit is shared
+	const uint8_t flat[4] = { 37, 200, 91, 130 };
+	uint8_t flatBlock[64];
+	for (int i = 0; i < 16; i++) {
+		memcpy(flatBlock + i * 4, flat, 4);
+	}
+
+	const double megabytes = image.size() / (1024.0 * 1024.0);
+	const assets::TextureFormat formats[] = { assets::TextureFormat::BC1_SRGB, assets::TextureFormat::BC3_SRGB,
+		assets::TextureFormat::BC5_UNORM, assets::TextureFormat::BC7_SRGB };
+	std::cout << "Block compression " << input.filename() << " (" << width << "x" << height << " crop) on "
+		<< ThreadPool::shared().thread_count() << " threads" << std::endl;
+	std::vector<uint8_t> blocks;
+	std::vector<uint8_t> decoded(image.size());
+	double bc1Psnr = 0.0, bc7Psnr = 0.0;
+	for (assets::TextureFormat format : formats) {
+		blocks.resize(assets::texture_level_size(format, width, height));
+		auto start = std::chrono::high_resolution_clock::now();
+		vkutil::compress_image(image.data(), width, height, format, ThreadPool::shared(), blocks.data());
+		const float time = elapsed_ms(start);
+		if (!vkutil::decompress_image(blocks.data(), width, height, format, decoded.data())) {
+			std::cerr << texture_format_name(format) << " wrote blocks its decoder does not read" << std::endl;
+			return false;
+		}
+		//BC1 drops alpha and BC5 blue, compare the formats on what they keep and all of them on color
+		const uint32_t channels = format == assets::TextureFormat::BC1_SRGB ? 0x7 : format == assets::TextureFormat::BC5_UNORM ? 0x3 : 0xF;
+		const double psnr = vkutil::compute_psnr(image.data(), decoded.data(), size_t(width) * height, channels);
+		const double colorPsnr = vkutil::compute_psnr(image.data(), decoded.data(), size_t(width) * height,
+			format == assets::TextureFormat::BC5_UNORM ? 0x3 : 0x7);
+		if (format == assets::TextureFormat::BC1_SRGB) {
+			bc1Psnr = colorPsnr;
+		}
+		if (format == assets::TextureFormat::BC7_SRGB) {
+			bc7Psnr = colorPsnr;
+		}
+		std::cout << "  " << texture_format_name(format) << ": " << std::setw(9) << time << " ms, " << std::setw(8)
+			<< megabytes * 1000.0 / time << " MB/s, PSNR " << std::setw(6) << psnr << " dB (color " << std::setw(6) << colorPsnr
+			<< " dB), " << image.size() << " -> " << blocks.size() << " bytes" << std::endl;
+		if (psnr < 30.0) {
+			std::cerr << texture_format_name(format) << " PSNR of " << input << " is below 30 dB" << std::endl;
+			return false;
+		}
+
+		uint8_t flatBlocks[16];
+		uint8_t flatDecoded[64];
+		vkutil::compress_image(flatBlock, 4, 4, format, ThreadPool::shared(), flatBlocks);
+		vkutil::decompress_image(flatBlocks, 4, 4, format, flatDecoded);
+		const int tolerance = format == assets::TextureFormat::BC7_SRGB ? 1 : 0;
+		for (int i = 0; i < 16; i++) {
+			for (int c = 0; c < 4; c++) {
+				if (!(channels & (1u << c))) {
+					continue;
+				}
+				//BC1 and BC3 color is 565, flat colors only survive up to its precision
+				const int precision = (format == assets::TextureFormat::BC1_SRGB || format == assets::TextureFormat::BC3_SRGB) && c < 3
+					? (c == 1 ? 2 : 4) : tolerance;
+				if (std::abs(int(flatDecoded[i * 4 + c]) - int(flat[c])) > precision) {
+					std::cerr << texture_format_name(format) << " flat block channel " << c << " comes back as "
+						<< int(flatDecoded[i * 4 + c]) << " instead of " << int(flat[c]) << std::endl;
+					return false;
+				}
+			}
+		}
+	}
+	if (bc7Psnr < bc1Psnr) {
+		std::cerr << "BC7 color PSNR " << bc7Psnr << " is worse than BC1 " << bc1Psnr << std::endl;
+		return false;
+	}
+	return true;
+}
+
+//what the engine does per png before the upload: decode to RGBA8 straight into staging and build the chain behind
+//level 0, a heap buffer stands in for the mapped staging arena, 0 when decoding fails
+static uint64_t decode_image(const fs::path& file)
+{
+	int width, height, channels;
+	if (!stbi_info(file.string().c_str(), &width, &height, &channels)) {
+		return 0;
+	}
+	const size_t size = vkutil::mip_chain_size(uint32_t(width), uint32_t(height));
+	std::unique_ptr<uint8_t[]> staging(new uint8_t[size]);
+	if (!vkutil::decode_image_into(file.string().c_str(), uint32_t(width), uint32_t(height), staging.get())) {
+		return 0;
+	}
+	vkutil::generate_mips_in_place(staging.get(), uint32_t(width), uint32_t(height), true, MipFilter::Box, ThreadPool::shared());
+	//fnv-1a of the chain, so both passes can be checked against each other
+	uint64_t hash = 1469598103934665603ull;
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ staging[i]) * 1099511628211ull;
+	}
+	return hash;
+}
+
+//the same before decoding into staging: stb's heap buffer, a MipChain copy of it, and a copy of the chain into staging
+//copiedBytes adds what the two copies moved
+static uint64_t decode_image_heap(const fs::path& file, uint64_t& copiedBytes)
+{
+	int width, height, channels;
+	stbi_uc* pixels = stbi_load(file.string().c_str(), &width, &height, &channels, STBI_rgb_alpha);
+	if (!pixels) {
+		return 0;
+	}
+	MipChain chain;
+	vkutil::generate_mips(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), true,
+		MipFilter::Box, ThreadPool::shared(), chain);
+	stbi_image_free(pixels);
+	std::unique_ptr<uint8_t[]> staging(new uint8_t[chain.pixels.size()]);
+	memcpy(staging.get(), chain.pixels.data(), chain.pixels.size());
+	copiedBytes += chain.level_size(0) + chain.pixels.size();
+	uint64_t hash = 1469598103934665603ull;
+	for (size_t i = 0; i < chain.pixels.size(); i++) {
+		hash = (hash ^ staging[i]) * 1099511628211ull;
+	}
+	return hash;
+}
+
+//peak resident memory of loading the images one by one into staging, in place against through the heap
+//the in place pass goes first, the peak only ever grows so the heap pass can only raise it
+static bool bench_decode_memory(const std::vector<fs::path>& files)
+{
+	const double mb = 1.0 / (1024.0 * 1024.0);
+	const uint64_t baseline = vkutil::peak_rss_bytes();
+	std::vector<uint64_t> hashes(files.size());
+	auto start = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < files.size(); i++) {
+		hashes[i] = decode_image(files[i]);
+	}
+	const float inPlaceMs = elapsed_ms(start);
+	const uint64_t inPlacePeak = vkutil::peak_rss_bytes();
+	uint64_t copiedBytes = 0;
+	bool same = true;
+	start = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < files.size(); i++) {
+		same = same && decode_image_heap(files[i], copiedBytes) == hashes[i];
+	}
+	const float heapMs = elapsed_ms(start);
+	const uint64_t heapPeak = vkutil::peak_rss_bytes();
+	const vkutil::ImageDecodeStats decodeStats = vkutil::image_decode_stats();
+	std::cout << "Decode into staging: peak RSS +" << (inPlacePeak - baseline) * mb << " MB in place (" << inPlaceMs << " ms, "
+		<< decodeStats.inPlace << " in place, " << decodeStats.copied << " copied), +" << (heapPeak - baseline) * mb
+		<< " MB through the heap (" << heapMs << " ms, " << copiedBytes * mb << " MB memcpy)" << std::endl;
+	if (!same) {
+		std::cerr << "Decoding into staging produced different mip chains" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+//texture loading at startup: the images one after another on the calling thread, as load_image_from_file did,
+//against every image submitted to the thread pool at once, as the engine's TextureLoader does
+static bool bench_decode(const std::vector<fs::path>& files)
+{
+	if (files.empty()) {
+		std::cerr << "No images to decode" << std::endl;
+		return false;
+	}
+	//before the timing passes, every decode there raises the peak
+	if (!bench_decode_memory(files)) {
+		return false;
+	}
+	std::vector<uint64_t> serialHashes(files.size());
+	auto start = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < files.size(); i++) {
+		serialHashes[i] = decode_image(files[i]);
+	}
+	const float serialMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	start = std::chrono::high_resolution_clock::now();
+	std::vector<std::future<uint64_t>> futures;
+	for (const fs::path& file : files) {
+		futures.push_back(ThreadPool::shared().submit([file]() { return decode_image(file); }));
+	}
+	bool same = true;
+	int failed = 0;
+	for (size_t i = 0; i < files.size(); i++) {
+		const uint64_t hash = futures[i].get();
+		same = same && hash == serialHashes[i];
+		failed += hash == 0 ? 1 : 0;
+	}
+	const float parallelMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	std::cout << "Decode " << files.size() << " images (" << failed << " failed) on " << ThreadPool::shared().thread_count()
+		<< " threads: serial " << serialMs << " ms, parallel " << parallelMs << " ms, " << serialMs / parallelMs << "x" << std::endl;
+	if (!same) {
+		std::cerr << "Parallel decode produced different mip chains" << std::endl;
+		return false;
+	}
+	return failed == 0;
+}
+
+//the small diffuse textures of a mesh's materials into texture arrays, so materials sharing an array share a descriptor set
+static bool cook_texture_pack(const fs::path& input, const Mesh& mesh, const fs::path& output)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<PackSource> sources;
+	std::vector<stbi_uc*> pixels;
+	for (const MeshMaterial& material : mesh._materials) {
+		const std::string& file = material.diffuseTexture;
+		if (file.empty() || std::any_of(sources.begin(), sources.end(), [&file](const PackSource& s) { return s.name == file; })) {
+			continue;
+		}
+		int width, height, channels;
+		//only the header first, large textures are not packed
+		if (!stbi_info(file.c_str(), &width, &height, &channels)
+			|| uint32_t(width) > TEXTURE_ARRAY_MAX_SIZE || uint32_t(height) > TEXTURE_ARRAY_MAX_SIZE) {
+			continue;
+		}
+		stbi_uc* rgba = stbi_load(file.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+		if (!rgba) {
+			continue;
+		}
+		pixels.push_back(rgba);
+		sources.push_back({ file, uint32_t(width), uint32_t(height), rgba });
+	}
+	if (sources.empty()) {
+		std::cout << "No small textures to pack for " << input.filename() << std::endl;
+		return true;
+	}
+	//diffuse textures are color, auto picks BC7 for them
+	const assets::TextureFormat format = autoBc ? assets::TextureFormat::BC7_SRGB : textureFormat;
+	std::vector<PackedArray> arrays;
+	std::vector<PackPlacement> placements;
+	vkutil::pack_texture_arrays(sources, format != assets::TextureFormat::BC5_UNORM, mipFilter, ThreadPool::shared(), arrays, placements);
+	const bool saved = vkutil::save_texture_pack(output.string().c_str(), format, sources, arrays, placements, ThreadPool::shared());
+	for (stbi_uc* rgba : pixels) {
+		stbi_image_free(rgba);
+	}
+	if (!saved) {
+		std::cerr << "Failed to write " << output << std::endl;
+		return false;
+	}
+	const size_t packed = std::count_if(placements.begin(), placements.end(), [](const PackPlacement& p) { return p.array != ~0u; });
+	std::cout << "Packed " << packed << " of " << sources.size() << " textures of " << input.filename() << " into " << arrays.size() << " "
+		<< texture_format_name(format) << " arrays -> " << output.filename() << " in " << elapsed_ms(start) << " ms" << std::endl;
+	return true;
+}
+
+//1000 materials with small textures of mixed sizes drawn in submission order, like draw_objects does:
+//one texture per material rebinds the texture set at every material change, packed arrays only when the array changes
+//also checks that every power of two texture fills its layer and every other one is left unpacked
+static bool bench_arrays()
+{
+	const uint32_t textureCount = 1000;
+	//mostly power of two sides, the 48 and 100 ones stay unpacked
+	const uint32_t sizes[] = { 16, 32, 64, 128, 16, 32, 48, 100 };
+	std::mt19937 rng(7);
+	std::vector<std::vector<uint8_t>> images(textureCount);
+	std::vector<PackSource> sources(textureCount);
+	for (uint32_t i = 0; i < textureCount; i++) {
+		const uint32_t width = sizes[rng() % 8];
+		const uint32_t height = sizes[rng() % 8];
+		images[i].resize(size_t(width) * height * 4);
+		for (uint8_t& byte : images[i]) {
+			byte = static_cast<uint8_t>(rng());
+		}
+		sources[i] = { "synthetic" + std::to_string(i), width, height, images[i].data() };
+	}
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<PackedArray> arrays;
+	std::vector<PackPlacement> placements;
+	vkutil::pack_texture_arrays(sources, true, MipFilter::Box, ThreadPool::shared(), arrays, placements);
+	const float packTime = elapsed_ms(start);
+
+	bool ok = true;
+	uint32_t packedCount = 0;
+	uint64_t layerBytes = 0;
+	for (uint32_t i = 0; i < textureCount && ok; i++) {
+		const PackSource& source = sources[i];
+		const PackPlacement& placement = placements[i];
+		const bool powerOfTwo = (source.width & (source.width - 1)) == 0 && (source.height & (source.height - 1)) == 0;
+		if (placement.array == ~0u) {
+			ok = !powerOfTwo;
+		}
+		else {
+			const PackedArray& array = arrays[placement.array];
+			ok = powerOfTwo && array.width == source.width && array.height == source.height
+				&& memcmp(array.layers[placement.layer].level_data(0), source.rgba, images[i].size()) == 0
+				&& placement.uvScale[0] == 1.0f && placement.uvScale[1] == 1.0f;
+			packedCount++;
+		}
+		if (!ok) {
+			std::cerr << "Layer " << placement.layer << " of array " << placement.array << " does not hold " << source.name << std::endl;
+		}
+	}
+	for (const PackedArray& array : arrays) {
+		for (const MipChain& chain : array.layers) {
+			layerBytes += chain.level_size(0);
+		}
+	}
+
+	//draw order is submission order, the materials come in the order their textures were made
+	//textures left unpacked keep a set each and break the run of the array before them
+	uint32_t singleBinds = textureCount;
+	uint32_t arrayBinds = 0;
+	uint32_t lastArray = ~0u;
+	for (uint32_t i = 0; i < textureCount; i++) {
+		if (placements[i].array == ~0u || placements[i].array != lastArray) {
+			arrayBinds++;
+			lastArray = placements[i].array;
+		}
+	}
+	//the same draws sorted by array, what a material sort key would give
+	std::vector<uint32_t> sortedArrays;
+	for (const PackPlacement& placement : placements) {
+		if (placement.array != ~0u) {
+			sortedArrays.push_back(placement.array);
+		}
+	}
+	std::sort(sortedArrays.begin(), sortedArrays.end());
+	const uint32_t unpackedCount = textureCount - packedCount;
+	const uint32_t sortedBinds = static_cast<uint32_t>(std::unique(sortedArrays.begin(), sortedArrays.end()) - sortedArrays.begin()) + unpackedCount;
+
+	std::cout << "Packed " << packedCount << " of " << textureCount << " textures (the power of two ones) into " << arrays.size()
+		<< " arrays in " << packTime << " ms, " << layerBytes / 1024 << " KB of level 0" << std::endl;
+	std::cout << "Texture set binds per frame: " << singleBinds << " with a set per texture, " << arrayBinds
+		<< " with arrays in submission order, " << sortedBinds << " sorted by array; descriptor sets "
+		<< textureCount << " -> " << arrays.size() + unpackedCount << std::endl;
+	return ok;
+}
+
+static bool cook_file(const fs::path& input, const fs::path& outputFolder)
+{
+	std::string extension = input.extension().string();
+	for (char& c : extension) {
+		c = static_cast<char>(tolower(c));
+	}
+	fs::path folder = outputFolder.empty() ? input.parent_path() : outputFolder;
+	if (extension == ".obj" && benchObj) {
+		return bench_obj(input);
+	}
+	if (extension == ".obj") {
+		return cook_mesh(input, folder / input.filename().replace_extension(".mesh"));
+	}
+	if ((extension == ".png" || extension == ".jpg" || extension == ".tga") && benchMips) {
+		return bench_mips(input);
+	}
+	if ((extension == ".png" || extension == ".jpg" || extension == ".tga") && benchBc) {
+		return bench_bc(input);
+	}
+	if (extension == ".png" || extension == ".jpg" || extension == ".tga") {
+		return cook_texture(input, folder / input.filename().replace_extension(writeKtx2 ? ".ktx2" : ".tx"));
+	}
+	//not a source asset, nothing to do
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<fs::path> inputs;
+	fs::path outputFolder;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "-o" && i + 1 < argc) {
+			outputFolder = argv[++i];
+		}
+		else if (arg == "-bench-obj") {
+			benchObj = true;
+		}
+		else if (arg == "-bench-decode") {
+			benchDecode = true;
+		}
+		else if (arg == "-pack-arrays") {
+			packArrays = true;
+		}
+		else if (arg == "-bench-arrays") {
+			benchArrays = true;
+		}
+		else if (arg == "-bench-mips") {
+			benchMips = true;
+		}
+		else if (arg == "-ktx2") {
+			writeKtx2 = true;
+		}
+		else if (arg == "-zstd" && i + 1 < argc) {
+			zstdLevel = std::atoi(argv[++i]);
+			if (zstdLevel < 0 || zstdLevel > 22) {
+				std::cout << "Zstd level must be between 0 and 22, got " << argv[i] << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "-bench-bc") {
+			benchBc = true;
+		}
+		else if (arg == "-bc" && i + 1 < argc) {
+			const std::string format = argv[++i];
+			autoBc = format == "auto";
+			if (format == "none") {
+				textureFormat = assets::TextureFormat::RGBA8_SRGB;
+			}
+			else if (format == "bc1") {
+				textureFormat = assets::TextureFormat::BC1_SRGB;
+			}
+			else if (format == "bc3") {
+				textureFormat = assets::TextureFormat::BC3_SRGB;
+			}
+			else if (format == "bc5") {
+				textureFormat = assets::TextureFormat::BC5_UNORM;
+			}
+			else if (format == "bc7") {
+				textureFormat = assets::TextureFormat::BC7_SRGB;
+			}
+			else if (!autoBc) {
+				std::cout << "Block format must be none, bc1, bc3, bc5, bc7 or auto, got " << format << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "-mip-filter" && i + 1 < argc) {
+			const std::string filter = argv[++i];
+			if (filter != "box" && filter != "kaiser") {
+				std::cout << "Mip filter must be box or kaiser, got " << filter << std::endl;
+				return 1;
+			}
+			mipFilter = filter == "box" ? MipFilter::Box : MipFilter::Kaiser;
+		}
+		else if (arg == "-lod" && i + 1 < argc) {
+			//comma separated fractions of LOD 0, each smaller than the one before
+			lodRatios.clear();
+			std::stringstream ratios(argv[++i]);
+			std::string ratio;
+			while (std::getline(ratios, ratio, ',')) {
+				const float value = std::strtof(ratio.c_str(), nullptr);
+				if (value <= 0.0f || value >= 1.0f || (!lodRatios.empty() && value >= lodRatios.back())) {
+					std::cout << "LOD ratios must be decreasing fractions between 0 and 1, got " << argv[i] << std::endl;
+					return 1;
+				}
+				lodRatios.push_back(value);
+			}
+		}
+		else {
+			inputs.push_back(arg);
+		}
+	}
+	if (benchArrays && !bench_arrays()) {
+		return 1;
+	}
+	if (inputs.empty() && benchArrays) {
+		return 0;
+	}
+	if (inputs.empty()) {
+		std::cout << "usage: asset_cooker <file or folder>... [-o output_folder] [-lod ratio,ratio,...] [-mip-filter box|kaiser]"
+			" [-bc none|bc1|bc3|bc5|bc7|auto] [-ktx2] [-zstd level] [-bench-obj] [-bench-mips] [-bench-bc]"
+			" [-bench-decode] [-pack-arrays] [-bench-arrays]" << std::endl;
+		return 1;
+	}
+	if (benchDecode) {
+		std::vector<fs::path> images;
+		auto add_image = [&images](const fs::path& file) {
+			std::string extension = file.extension().string();
+			for (char& c : extension) {
+				c = static_cast<char>(tolower(c));
+			}
+			if (extension == ".png" || extension == ".jpg" || extension == ".tga") {
+				images.push_back(file);
+			}
+		};
+		for (const fs::path& input : inputs) {
+			if (fs::is_directory(input)) {
+				for (const auto& entry : fs::recursive_directory_iterator(input)) {
+					if (entry.is_regular_file()) {
+						add_image(entry.path());
+					}
+				}
+			}
+			else {
+				add_image(input);
+			}
+		}
+		return bench_decode(images) ? 0 : 1;
+	}
+	if (!outputFolder.empty()) {
+		fs::create_directories(outputFolder);
+	}
+
+	int failed = 0;
+	for (const fs::path& input : inputs) {
+		if (fs::is_directory(input)) {
+			for (const auto& entry : fs::recursive_directory_iterator(input)) {
+				if (entry.is_regular_file() && !cook_file(entry.path(), outputFolder)) {
+					std::cerr << "Failed to cook " << entry.path() << std::endl;
+					failed++;
+				}
+			}
+		}
+		else if (!cook_file(input, outputFolder)) {
+			std::cerr << "Failed to cook " << input << std::endl;
+			failed++;
+		}
+	}
+	return failed == 0 ? 0 : 1;
+}
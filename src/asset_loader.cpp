@@ -0,0 +1,206 @@
+#include "asset_loader.h"
+#include <iostream>
+#include <fstream>
+#include <cstring>
+
+#include <lz4.h>
+#include <lz4hc.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+assets::MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool assets::MappedFile::open(const char* path)
+{
+	close();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping) {
+		CloseHandle(file);
+		return false;
+	}
+	_data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!_data) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	_file = file;
+	_mapping = mapping;
+	_size = static_cast<size_t>(fileSize.QuadPart);
+#else
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+	void* ptr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	//the mapping keeps its own reference to the file
+	::close(fd);
+	if (ptr == MAP_FAILED) {
+		return false;
+	}
+	_data = (const char*)ptr;
+	_size = static_cast<size_t>(st.st_size);
+#endif
+	return true;
+}
+
+void assets::MappedFile::close()
+{
+	if (!_data) {
+		return;
+	}
+#ifdef _WIN32
+	UnmapViewOfFile(_data);
+	CloseHandle((HANDLE)_mapping);
+	CloseHandle((HANDLE)_file);
+	_mapping = nullptr;
+	_file = nullptr;
+#else
+	munmap((void*)_data, _size);
+#endif
+	_data = nullptr;
+	_size = 0;
+}
+
+bool assets::open_asset(const MappedFile& file, const char type[4], AssetView& outView)
+{
+	if (file.size() < sizeof(AssetHeader)) {
+		return false;
+	}
+	const AssetHeader* header = (const AssetHeader*)file.data();
+	if (memcmp(header->magic, "VKAS", 4) != 0 || memcmp(header->type, type, 4) != 0) {
+		std::cout << "Asset is not of type " << std::string(type, 4) << std::endl;
+		return false;
+	}
+	if (header->version != ASSET_VERSION) {
+		std::cout << "Asset version " << header->version << " does not match " << ASSET_VERSION
+			<< ", cook the asset again" << std::endl;
+		return false;
+	}
+	const size_t payloadStart = sizeof(AssetHeader) + header->sectionCount * sizeof(AssetSection) + header->metadataSize;
+	if (payloadStart > file.size()) {
+		return false;
+	}
+	outView.header = header;
+	outView.sections = (const AssetSection*)(file.data() + sizeof(AssetHeader));
+	outView.metadata = file.data() + sizeof(AssetHeader) + header->sectionCount * sizeof(AssetSection);
+	outView.payload = file.data() + payloadStart;
+	//every section must lie inside the mapping, compared against what is left so huge offsets cannot wrap
+	const uint64_t payloadSize = file.size() - payloadStart;
+	for (uint32_t i = 0; i < header->sectionCount; i++) {
+		const AssetSection& section = outView.sections[i];
+		if (section.offset > payloadSize || section.compressedSize > payloadSize - section.offset) {
+			std::cout << "Asset section " << i << " is truncated" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool assets::unpack_section(const AssetView& view, uint32_t section, void* dst)
+{
+	const AssetSection& s = view.sections[section];
+	if (s.rawSize == 0) {
+		return true;
+	}
+	int decompressed = LZ4_decompress_safe(view.payload + s.offset, (char*)dst,
+		static_cast<int>(s.compressedSize), static_cast<int>(s.rawSize));
+	return decompressed == static_cast<int>(s.rawSize);
+}
+
+bool assets::save_asset(const char* path, const char type[4], const void* metadata, uint32_t metadataSize,
+	const std::vector<std::pair<const void*, size_t>>& sections)
+{
+	AssetHeader header = {};
+	memcpy(header.magic, "VKAS", 4);
+	memcpy(header.type, type, 4);
+	header.version = ASSET_VERSION;
+	header.metadataSize = metadataSize;
+	header.sectionCount = static_cast<uint32_t>(sections.size());
+
+	std::vector<AssetSection> table(sections.size());
+	std::vector<char> payload;
+	for (size_t i = 0; i < sections.size(); i++) {
+		const char* src = (const char*)sections[i].first;
+		const int rawSize = static_cast<int>(sections[i].second);
+		if (sections[i].second > LZ4_MAX_INPUT_SIZE) {
+			std::cout << "Asset section " << i << " is too large for LZ4" << std::endl;
+			return false;
+		}
+		const size_t offset = payload.size();
+		payload.resize(offset + LZ4_compressBound(rawSize));
+		int compressedSize = LZ4_compress_HC(src, payload.data() + offset, rawSize,
+			LZ4_compressBound(rawSize), LZ4HC_CLEVEL_DEFAULT);
+		if (rawSize > 0 && compressedSize <= 0) {
+			return false;
+		}
+		payload.resize(offset + compressedSize);
+		table[i].offset = offset;
+		table[i].compressedSize = static_cast<uint64_t>(compressedSize);
+		table[i].rawSize = static_cast<uint64_t>(rawSize);
+	}
+
+	std::ofstream outfile(path, std::ios::binary | std::ios::out);
+	if (!outfile.is_open()) {
+		std::cout << "Failed to open " << path << " for writing" << std::endl;
+		return false;
+	}
+	outfile.write((const char*)&header, sizeof(AssetHeader));
+	outfile.write((const char*)table.data(), table.size() * sizeof(AssetSection));
+	outfile.write((const char*)metadata, metadataSize);
+	outfile.write(payload.data(), payload.size());
+	return outfile.good();
+}
+
+size_t assets::texture_level_size(TextureFormat format, uint32_t width, uint32_t height)
+{
+	const size_t blocks = size_t((width + 3) / 4) * ((height + 3) / 4);
+	switch (format) {
+	case TextureFormat::BC1_SRGB:
+		return blocks * 8;
+	case TextureFormat::BC3_SRGB:
+	case TextureFormat::BC5_UNORM:
+	case TextureFormat::BC7_SRGB:
+		return blocks * 16;
+	default:
+		return size_t(width) * height * 4;
+	}
+}
+
+std::string assets::cooked_path(const std::string& sourcePath, const char* cookedExtension)
+{
+	size_t dot = sourcePath.find_last_of('.');
+	size_t slash = sourcePath.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+		return sourcePath + cookedExtension;
+	}
+	return sourcePath.substr(0, dot) + cookedExtension;
+}
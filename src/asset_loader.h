@@ -0,0 +1,148 @@
+#pragma once
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//cooked asset container written by asset_cooker and read by the engine
+//layout: AssetHeader | AssetSection[sectionCount] | metadata | LZ4 compressed sections
+namespace assets {
+
+	constexpr uint32_t ASSET_VERSION = 3;
+
+	struct AssetHeader {
+		char magic[4];       //"VKAS"
+		char type[4];        //"MESH", "TEXI" or "TEXA"
+		uint32_t version;
+		uint32_t metadataSize;
+		uint32_t sectionCount;
+		uint32_t reserved;
+	};
+
+	//one independently compressed block of the payload
+	struct AssetSection {
+		uint64_t offset;         //from the start of the payload
+		uint64_t compressedSize;
+		uint64_t rawSize;
+	};
+
+	enum class VertexFormat : uint32_t {
+		PNCV_F32 = 0,  //position,normal,color,uv all fp32 (Vertex)
+	};
+
+	//fixed size material record of a "MESH" asset, strings are zero terminated
+	struct MaterialInfo {
+		char name[64];
+		char diffuseTexture[256];
+		float diffuse[3];
+	};
+
+	//metadata block of a "MESH" asset
+	//section 0 holds the vertices, section 1 the 32 bit indices of every LOD,
+	//section 2 the MeshLod ranges (empty when the mesh has no LODs),
+	//section 3 the Submesh ranges of every LOD, section 4 the MaterialInfo records
+	struct MeshInfo {
+		uint64_t vertexCount;
+		uint64_t indexCount;
+		VertexFormat vertexFormat;
+		uint32_t vertexSize;
+		uint32_t lodCount;
+		uint32_t lodSize;
+		uint32_t submeshCount;
+		uint32_t materialCount;
+	};
+
+	enum class TextureFormat : uint32_t {
+		RGBA8_SRGB = 0,
+		//4x4 blocks: BC1 8 bytes opaque color, BC3 16 bytes color + alpha,
+		//BC5 16 bytes two linear channels (normal maps), BC7 16 bytes high quality color + alpha
+		BC1_SRGB = 1,
+		BC3_SRGB = 2,
+		BC5_UNORM = 3,
+		BC7_SRGB = 4,
+	};
+
+	//metadata block of a "TEXI" asset
+	//one section per mip level, largest first, each exactly texture_level_size bytes
+	struct TextureInfo {
+		TextureFormat format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipLevels;
+	};
+
+	//one 2D texture array of a "TEXA" asset, its levels are sections firstSection.. firstSection + mipLevels - 1,
+	//each holding level i of every layer back to back
+	struct TextureArrayInfo {
+		TextureFormat format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t layerCount;
+		uint32_t mipLevels;
+		uint32_t firstSection;
+	};
+
+	//fixed size record of a texture packed into a layer, the texture covers [0, uvScale) of the layer
+	//the packer only packs textures that fill their layer, so uvScale is 1
+	struct TextureArrayEntry {
+		char name[256];
+		uint32_t array;
+		uint32_t layer;
+		float uvScale[2];
+	};
+
+	//metadata block of a "TEXA" asset, small textures packed into 2D texture arrays by size
+	//section 0 holds the TextureArrayInfo records, section 1 the TextureArrayEntry records, then the levels of every array
+	struct TexturePackInfo {
+		uint32_t arrayCount;
+		uint32_t entryCount;
+	};
+
+	//read only memory mapping of a whole file
+	class MappedFile {
+	public:
+		MappedFile() = default;
+		~MappedFile();
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool open(const char* path);
+		void close();
+
+		const char* data() const { return _data; }
+		size_t size() const { return _size; }
+	private:
+		const char* _data{ nullptr };
+		size_t _size{ 0 };
+#ifdef _WIN32
+		void* _file{ nullptr };
+		void* _mapping{ nullptr };
+#endif
+	};
+
+	//zero copy view of an asset inside a mapped file
+	struct AssetView {
+		const AssetHeader* header{ nullptr };
+		const AssetSection* sections{ nullptr };
+		const char* metadata{ nullptr };
+		const char* payload{ nullptr };
+	};
+
+	//validates the header against the mapped size, returns false on a foreign or truncated file
+	bool open_asset(const MappedFile& file, const char type[4], AssetView& outView);
+
+	//decompress one section into dst, which must hold at least section.rawSize bytes
+	bool unpack_section(const AssetView& view, uint32_t section, void* dst);
+
+	//compress every section with LZ4 HC and write the container to disk
+	bool save_asset(const char* path, const char type[4], const void* metadata, uint32_t metadataSize,
+		const std::vector<std::pair<const void*, size_t>>& sections);
+
+	//bytes of one width x height level, block formats round up to whole 4x4 blocks
+	size_t texture_level_size(TextureFormat format, uint32_t width, uint32_t height);
+
+	//cooked file that sits next to a source asset, "models/room.obj" -> "models/room.mesh"
+	std::string cooked_path(const std::string& sourcePath, const char* cookedExtension);
+}
+#endif // !ASSET_LOADER_H
@@ -0,0 +1,753 @@
+#include "bc_encoder.h"
+#include <thread_pool.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace {
+	//BC7 4 bit index interpolation weights, out of 64
+	constexpr int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+	constexpr int BC7_WEIGHTS_2BIT[4] = { 0, 21, 43, 64 };
+	//least squares passes after the principal axis guess
+	constexpr int REFINE_ITERATIONS = 2;
+
+	//the 16 texels of block (bx, by), repeating the last row and column past the image edges
+	void load_block(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t bx, uint32_t by, uint8_t block[64])
+	{
+		for (uint32_t y = 0; y < 4; y++) {
+			const uint32_t sy = std::min(by * 4 + y, height - 1);
+			for (uint32_t x = 0; x < 4; x++) {
+				const uint32_t sx = std::min(bx * 4 + x, width - 1);
+				memcpy(block + (y * 4 + x) * 4, rgba + (size_t(sy) * width + sx) * 4, 4);
+			}
+		}
+	}
+
+	//write the texels of a decoded block that fall inside the image
+	void store_block(const uint8_t block[64], uint32_t width, uint32_t height, uint32_t bx, uint32_t by, uint8_t* rgba)
+	{
+		for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++) {
+			for (uint32_t x = 0; x < 4 && bx * 4 + x < width; x++) {
+				memcpy(rgba + (size_t(by * 4 + y) * width + bx * 4 + x) * 4, block + (y * 4 + x) * 4, 4);
+			}
+		}
+	}
+
+	//mean and principal axis of the 16 points by power iteration, the axis is zero for a flat block
+	template<int N>
+	void fit_line(const float points[16][N], float mean[N], float axis[N])
+	{
+		for (int c = 0; c < N; c++) {
+			mean[c] = 0.0f;
+			for (int i = 0; i < 16; i++) {
+				mean[c] += points[i][c];
+			}
+			mean[c] /= 16.0f;
+		}
+		float covariance[N][N] = {};
+		for (int i = 0; i < 16; i++) {
+			for (int a = 0; a < N; a++) {
+				for (int b = 0; b < N; b++) {
+					covariance[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+				}
+			}
+		}
+		//start from the channel with the most variance, converges in a few steps for 3-4 dimensions
+		int widest = 0;
+		for (int c = 1; c < N; c++) {
+			if (covariance[c][c] > covariance[widest][widest]) {
+				widest = c;
+			}
+		}
+		for (int c = 0; c < N; c++) {
+			axis[c] = covariance[widest][c];
+		}
+		for (int iteration = 0; iteration < 8; iteration++) {
+			float next[N] = {};
+			float largest = 0.0f;
+			for (int a = 0; a < N; a++) {
+				for (int b = 0; b < N; b++) {
+					next[a] += covariance[a][b] * axis[b];
+				}
+				largest = std::max(largest, std::abs(next[a]));
+			}
+			if (largest < 1e-6f) {
+				for (int c = 0; c < N; c++) {
+					axis[c] = 0.0f;
+				}
+				return;
+			}
+			for (int c = 0; c < N; c++) {
+				axis[c] = next[c] / largest;
+			}
+		}
+		float length = 0.0f;
+		for (int c = 0; c < N; c++) {
+			length += axis[c] * axis[c];
+		}
+		length = std::sqrt(length);
+		for (int c = 0; c < N; c++) {
+			axis[c] /= length;
+		}
+	}
+
+	//endpoints at the extreme projections of the points on the principal axis
+	template<int N>
+	void initial_endpoints(const float points[16][N], float e0[N], float e1[N])
+	{
+		float mean[N], axis[N];
+		fit_line<N>(points, mean, axis);
+		float tMin = 0.0f, tMax = 0.0f;
+		for (int i = 0; i < 16; i++) {
+			float t = 0.0f;
+			for (int c = 0; c < N; c++) {
+				t += (points[i][c] - mean[c]) * axis[c];
+			}
+			tMin = std::min(tMin, t);
+			tMax = std::max(tMax, t);
+		}
+		for (int c = 0; c < N; c++) {
+			e0[c] = std::clamp(mean[c] + axis[c] * tMax, 0.0f, 255.0f);
+			e1[c] = std::clamp(mean[c] + axis[c] * tMin, 0.0f, 255.0f);
+		}
+	}
+
+	//solve for the endpoints that best fit the points given a weight of e0 per point, false when degenerate
+	template<int N>
+	bool least_squares_endpoints(const float points[16][N], const float weights[16], float e0[N], float e1[N])
+	{
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ax[N] = {}, bx[N] = {};
+		for (int i = 0; i < 16; i++) {
+			const float a = weights[i];
+			const float b = 1.0f - a;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (int c = 0; c < N; c++) {
+				ax[c] += a * points[i][c];
+				bx[c] += b * points[i][c];
+			}
+		}
+		const float determinant = aa * bb - ab * ab;
+		if (std::abs(determinant) < 1e-6f) {
+			return false;
+		}
+		for (int c = 0; c < N; c++) {
+			e0[c] = std::clamp((bb * ax[c] - ab * bx[c]) / determinant, 0.0f, 255.0f);
+			e1[c] = std::clamp((aa * bx[c] - ab * ax[c]) / determinant, 0.0f, 255.0f);
+		}
+		return true;
+	}
+
+	uint16_t pack_565(const float c[3])
+	{
+		const int r = std::clamp(int(c[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+		const int g = std::clamp(int(c[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+		const int b = std::clamp(int(c[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+		return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+	}
+
+	void unpack_565(uint16_t v, int out[3])
+	{
+		const int r = v >> 11, g = (v >> 5) & 63, b = v & 31;
+		out[0] = (r << 3) | (r >> 2);
+		out[1] = (g << 2) | (g >> 4);
+		out[2] = (b << 3) | (b >> 2);
+	}
+
+	//4 color mode when c0 > c1, otherwise 3 colors and black
+	void bc1_palette(uint16_t c0, uint16_t c1, int palette[4][3])
+	{
+		unpack_565(c0, palette[0]);
+		unpack_565(c1, palette[1]);
+		for (int c = 0; c < 3; c++) {
+			if (c0 > c1) {
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			else {
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+		}
+	}
+
+	void encode_bc1(const uint8_t block[64], uint8_t out[8])
+	{
+		float points[16][3];
+		for (int i = 0; i < 16; i++) {
+			for (int c = 0; c < 3; c++) {
+				points[i][c] = block[i * 4 + c];
+			}
+		}
+		float e0[3], e1[3];
+		initial_endpoints<3>(points, e0, e1);
+
+		//weight of color0 for each 4 color mode index
+		const float indexWeights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+		uint32_t bestError = std::numeric_limits<uint32_t>::max();
+		uint16_t best0 = 0, best1 = 0;
+		uint32_t bestIndices = 0;
+		for (int iteration = 0; iteration <= REFINE_ITERATIONS; iteration++) {
+			uint16_t c0 = pack_565(e0);
+			uint16_t c1 = pack_565(e1);
+			//c0 > c1 selects the 4 color mode, equal endpoints keep every index at 0 which works in both modes
+			if (c0 < c1) {
+				std::swap(c0, c1);
+			}
+			int palette[4][3];
+			bc1_palette(c0, c1, palette);
+			const int usable = c0 == c1 ? 1 : 4;
+			uint32_t indices = 0;
+			uint32_t error = 0;
+			float weights[16];
+			for (int i = 0; i < 16; i++) {
+				int bestIndex = 0;
+				int bestDistance = std::numeric_limits<int>::max();
+				for (int k = 0; k < usable; k++) {
+					int distance = 0;
+					for (int c = 0; c < 3; c++) {
+						const int d = block[i * 4 + c] - palette[k][c];
+						distance += d * d;
+					}
+					if (distance < bestDistance) {
+						bestDistance = distance;
+						bestIndex = k;
+					}
+				}
+				indices |= uint32_t(bestIndex) << (2 * i);
+				error += bestDistance;
+				weights[i] = indexWeights[bestIndex];
+			}
+			if (error < bestError) {
+				bestError = error;
+				best0 = c0;
+				best1 = c1;
+				bestIndices = indices;
+			}
+			if (error == 0 || c0 == c1 || !least_squares_endpoints<3>(points, weights, e0, e1)) {
+				break;
+			}
+		}
+		memcpy(out, &best0, 2);
+		memcpy(out + 2, &best1, 2);
+		memcpy(out + 4, &bestIndices, 4);
+	}
+
+	void decode_bc1(const uint8_t in[8], uint8_t block[64])
+	{
+		uint16_t c0, c1;
+		uint32_t indices;
+		memcpy(&c0, in, 2);
+		memcpy(&c1, in + 2, 2);
+		memcpy(&indices, in + 4, 4);
+		int palette[4][3];
+		bc1_palette(c0, c1, palette);
+		for (int i = 0; i < 16; i++) {
+			const int index = (indices >> (2 * i)) & 3;
+			for (int c = 0; c < 3; c++) {
+				block[i * 4 + c] = static_cast<uint8_t>(palette[index][c]);
+			}
+			block[i * 4 + 3] = (c0 <= c1 && index == 3) ? 0 : 255;
+		}
+	}
+
+	//8 value mode when v0 > v1, otherwise 6 values plus 0 and 255
+	void bc4_palette(int v0, int v1, int palette[8])
+	{
+		palette[0] = v0;
+		palette[1] = v1;
+		if (v0 > v1) {
+			for (int k = 2; k < 8; k++) {
+				palette[k] = ((8 - k) * v0 + (k - 1) * v1 + 3) / 7;
+			}
+		}
+		else {
+			for (int k = 2; k < 6; k++) {
+				palette[k] = ((6 - k) * v0 + (k - 1) * v1 + 2) / 5;
+			}
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	//one channel (stride 4 from values), endpoints at the block min/max in the 8 value mode
+	void encode_bc4(const uint8_t* values, uint8_t out[8])
+	{
+		int lo = 255, hi = 0;
+		for (int i = 0; i < 16; i++) {
+			lo = std::min(lo, int(values[i * 4]));
+			hi = std::max(hi, int(values[i * 4]));
+		}
+		out[0] = static_cast<uint8_t>(hi);
+		out[1] = static_cast<uint8_t>(lo);
+		uint64_t indices = 0;
+		if (hi > lo) {
+			int palette[8];
+			bc4_palette(hi, lo, palette);
+			for (int i = 0; i < 16; i++) {
+				int bestIndex = 0;
+				int bestDistance = std::numeric_limits<int>::max();
+				for (int k = 0; k < 8; k++) {
+					const int distance = std::abs(values[i * 4] - palette[k]);
+					if (distance < bestDistance) {
+						bestDistance = distance;
+						bestIndex = k;
+					}
+				}
+				indices |= uint64_t(bestIndex) << (3 * i);
+			}
+		}
+		for (int b = 0; b < 6; b++) {
+			out[2 + b] = static_cast<uint8_t>(indices >> (8 * b));
+		}
+	}
+
+	void decode_bc4(const uint8_t in[8], uint8_t* values)
+	{
+		int palette[8];
+		bc4_palette(in[0], in[1], palette);
+		uint64_t indices = 0;
+		for (int b = 0; b < 6; b++) {
+			indices |= uint64_t(in[2 + b]) << (8 * b);
+		}
+		for (int i = 0; i < 16; i++) {
+			values[i * 4] = static_cast<uint8_t>(palette[(indices >> (3 * i)) & 7]);
+		}
+	}
+
+	//7 bit endpoint channels plus one p-bit shared by the endpoint, the p-bit picked for the smaller error
+	void quantize_bc7_endpoint(const float e[4], int q[4], int& p)
+	{
+		float bestError = std::numeric_limits<float>::max();
+		for (int bit = 0; bit < 2; bit++) {
+			int candidate[4];
+			float error = 0.0f;
+			for (int c = 0; c < 4; c++) {
+				candidate[c] = std::clamp(int(std::floor((e[c] - bit) * 0.5f + 0.5f)), 0, 127);
+				const float d = float(candidate[c] * 2 + bit) - e[c];
+				error += d * d;
+			}
+			if (error < bestError) {
+				bestError = error;
+				p = bit;
+				memcpy(q, candidate, sizeof(candidate));
+			}
+		}
+	}
+
+	void bc7_palette(const int q0[4], int p0, const int q1[4], int p1, int palette[16][4])
+	{
+		for (int c = 0; c < 4; c++) {
+			const int v0 = q0[c] * 2 + p0;
+			const int v1 = q1[c] * 2 + p1;
+			for (int k = 0; k < 16; k++) {
+				palette[k][c] = ((64 - BC7_WEIGHTS[k]) * v0 + BC7_WEIGHTS[k] * v1 + 32) >> 6;
+			}
+		}
+	}
+
+	//LSB first bit stream over a 16 byte block
+	struct BlockBits {
+		uint8_t* data;
+		int position{ 0 };
+
+		void write(uint32_t value, int count)
+		{
+			for (int i = 0; i < count; i++, position++) {
+				data[position >> 3] |= static_cast<uint8_t>(((value >> i) & 1) << (position & 7));
+			}
+		}
+	};
+
+	struct BlockReader {
+		const uint8_t* data;
+		int position{ 0 };
+
+		uint32_t read(int count)
+		{
+			uint32_t value = 0;
+			for (int i = 0; i < count; i++, position++) {
+				value |= uint32_t((data[position >> 3] >> (position & 7)) & 1) << i;
+			}
+			return value;
+		}
+	};
+
+	//mode 6: one rgba line, 7777.1 endpoints with a p-bit each and 4 bit indices, returns the squared error
+	uint32_t encode_bc7_mode6(const uint8_t block[64], uint8_t out[16])
+	{
+		float points[16][4];
+		for (int i = 0; i < 16; i++) {
+			for (int c = 0; c < 4; c++) {
+				points[i][c] = block[i * 4 + c];
+			}
+		}
+		float e0[4], e1[4];
+		initial_endpoints<4>(points, e0, e1);
+
+		uint32_t bestError = std::numeric_limits<uint32_t>::max();
+		int bestQ0[4] = {}, bestQ1[4] = {}, bestP0 = 0, bestP1 = 0;
+		int bestIndices[16] = {};
+		for (int iteration = 0; iteration <= REFINE_ITERATIONS; iteration++) {
+			int q0[4], q1[4], p0, p1;
+			quantize_bc7_endpoint(e0, q0, p0);
+			quantize_bc7_endpoint(e1, q1, p1);
+			int palette[16][4];
+			bc7_palette(q0, p0, q1, p1, palette);
+			uint32_t error = 0;
+			int indices[16];
+			float weights[16];
+			for (int i = 0; i < 16; i++) {
+				int bestIndex = 0;
+				int bestDistance = std::numeric_limits<int>::max();
+				for (int k = 0; k < 16; k++) {
+					int distance = 0;
+					for (int c = 0; c < 4; c++) {
+						const int d = block[i * 4 + c] - palette[k][c];
+						distance += d * d;
+					}
+					if (distance < bestDistance) {
+						bestDistance = distance;
+						bestIndex = k;
+					}
+				}
+				indices[i] = bestIndex;
+				error += bestDistance;
+				weights[i] = 1.0f - BC7_WEIGHTS[bestIndex] / 64.0f;
+			}
+			if (error < bestError) {
+				bestError = error;
+				memcpy(bestQ0, q0, sizeof(q0));
+				memcpy(bestQ1, q1, sizeof(q1));
+				bestP0 = p0;
+				bestP1 = p1;
+				memcpy(bestIndices, indices, sizeof(indices));
+			}
+			if (error == 0 || !least_squares_endpoints<4>(points, weights, e0, e1)) {
+				break;
+			}
+		}
+		//the first index is stored with 3 bits, so its top bit has to be 0: swap the endpoints otherwise
+		if (bestIndices[0] >= 8) {
+			std::swap(bestQ0, bestQ1);
+			std::swap(bestP0, bestP1);
+			for (int& index : bestIndices) {
+				index = 15 - index;
+			}
+		}
+		memset(out, 0, 16);
+		BlockBits bits{ out };
+		//mode 6: six 0 bits and a 1
+		bits.write(1u << 6, 7);
+		for (int c = 0; c < 4; c++) {
+			bits.write(bestQ0[c], 7);
+			bits.write(bestQ1[c], 7);
+		}
+		bits.write(bestP0, 1);
+		bits.write(bestP1, 1);
+		bits.write(bestIndices[0], 3);
+		for (int i = 1; i < 16; i++) {
+			bits.write(bestIndices[i], 4);
+		}
+		return bestError;
+	}
+
+	//7 bit rgb endpoint channel of mode 5, expanded by repeating the top bit
+	int quantize_bc7_color(float value, int& expanded)
+	{
+		const int q = std::clamp(int(value * 127.0f / 255.0f + 0.5f), 0, 127);
+		expanded = (q << 1) | (q >> 6);
+		return q;
+	}
+
+	//mode 5: rgb and alpha each get their own endpoints and 2 bit indices, for blocks where alpha
+	//does not follow color, returns the squared error
+	uint32_t encode_bc7_mode5(const uint8_t block[64], uint8_t out[16])
+	{
+		float points[16][3];
+		for (int i = 0; i < 16; i++) {
+			for (int c = 0; c < 3; c++) {
+				points[i][c] = block[i * 4 + c];
+			}
+		}
+		float e0[3], e1[3];
+		initial_endpoints<3>(points, e0, e1);
+
+		uint32_t bestColorError = std::numeric_limits<uint32_t>::max();
+		int bestQ0[3] = {}, bestQ1[3] = {};
+		int bestColor[16] = {};
+		for (int iteration = 0; iteration <= REFINE_ITERATIONS; iteration++) {
+			int q0[3], q1[3], v0[3], v1[3];
+			for (int c = 0; c < 3; c++) {
+				q0[c] = quantize_bc7_color(e0[c], v0[c]);
+				q1[c] = quantize_bc7_color(e1[c], v1[c]);
+			}
+			int palette[4][3];
+			for (int k = 0; k < 4; k++) {
+				for (int c = 0; c < 3; c++) {
+					palette[k][c] = ((64 - BC7_WEIGHTS_2BIT[k]) * v0[c] + BC7_WEIGHTS_2BIT[k] * v1[c] + 32) >> 6;
+				}
+			}
+			uint32_t error = 0;
+			int indices[16];
+			float weights[16];
+			for (int i = 0; i < 16; i++) {
+				int bestIndex = 0;
+				int bestDistance = std::numeric_limits<int>::max();
+				for (int k = 0; k < 4; k++) {
+					int distance = 0;
+					for (int c = 0; c < 3; c++) {
+						const int d = block[i * 4 + c] - palette[k][c];
+						distance += d * d;
+					}
+					if (distance < bestDistance) {
+						bestDistance = distance;
+						bestIndex = k;
+					}
+				}
+				indices[i] = bestIndex;
+				error += bestDistance;
+				weights[i] = 1.0f - BC7_WEIGHTS_2BIT[bestIndex] / 64.0f;
+			}
+			if (error < bestColorError) {
+				bestColorError = error;
+				memcpy(bestQ0, q0, sizeof(q0));
+				memcpy(bestQ1, q1, sizeof(q1));
+				memcpy(bestColor, indices, sizeof(indices));
+			}
+			if (error == 0 || !least_squares_endpoints<3>(points, weights, e0, e1)) {
+				break;
+			}
+		}
+
+		//alpha endpoints are stored with 8 bits, the block min/max is exact at both ends
+		int a0 = 255, a1 = 0;
+		for (int i = 0; i < 16; i++) {
+			a0 = std::min(a0, int(block[i * 4 + 3]));
+			a1 = std::max(a1, int(block[i * 4 + 3]));
+		}
+		uint32_t alphaError = 0;
+		int alpha[16];
+		for (int i = 0; i < 16; i++) {
+			int bestIndex = 0;
+			int bestDistance = std::numeric_limits<int>::max();
+			for (int k = 0; k < 4; k++) {
+				const int d = block[i * 4 + 3] - (((64 - BC7_WEIGHTS_2BIT[k]) * a0 + BC7_WEIGHTS_2BIT[k] * a1 + 32) >> 6);
+				if (d * d < bestDistance) {
+					bestDistance = d * d;
+					bestIndex = k;
+				}
+			}
+			alpha[i] = bestIndex;
+			alphaError += bestDistance;
+		}
+
+		//both anchors are stored with 1 bit
+		if (bestColor[0] >= 2) {
+			std::swap(bestQ0, bestQ1);
+			for (int& index : bestColor) {
+				index = 3 - index;
+			}
+		}
+		if (alpha[0] >= 2) {
+			std::swap(a0, a1);
+			for (int& index : alpha) {
+				index = 3 - index;
+			}
+		}
+		memset(out, 0, 16);
+		BlockBits bits{ out };
+		//mode 5: five 0 bits and a 1, then no channel rotation
+		bits.write(1u << 5, 6);
+		bits.write(0, 2);
+		for (int c = 0; c < 3; c++) {
+			bits.write(bestQ0[c], 7);
+			bits.write(bestQ1[c], 7);
+		}
+		bits.write(a0, 8);
+		bits.write(a1, 8);
+		for (int i = 0; i < 16; i++) {
+			bits.write(bestColor[i], i == 0 ? 1 : 2);
+		}
+		for (int i = 0; i < 16; i++) {
+			bits.write(alpha[i], i == 0 ? 1 : 2);
+		}
+		return bestColorError + alphaError;
+	}
+
+	//opaque blocks almost always go to mode 6, varying alpha often to mode 5
+	void encode_bc7(const uint8_t block[64], uint8_t out[16])
+	{
+		uint8_t mode5[16];
+		const uint32_t error6 = encode_bc7_mode6(block, out);
+		if (error6 > 0 && encode_bc7_mode5(block, mode5) < error6) {
+			memcpy(out, mode5, 16);
+		}
+	}
+
+	bool decode_bc7(const uint8_t in[16], uint8_t block[64])
+	{
+		BlockReader bits{ in };
+		int mode = 0;
+		while (mode < 8 && bits.read(1) == 0) {
+			mode++;
+		}
+		if (mode == 6) {
+			int q0[4], q1[4];
+			for (int c = 0; c < 4; c++) {
+				q0[c] = static_cast<int>(bits.read(7));
+				q1[c] = static_cast<int>(bits.read(7));
+			}
+			const int p0 = static_cast<int>(bits.read(1));
+			const int p1 = static_cast<int>(bits.read(1));
+			int palette[16][4];
+			bc7_palette(q0, p0, q1, p1, palette);
+			for (int i = 0; i < 16; i++) {
+				const int index = static_cast<int>(bits.read(i == 0 ? 3 : 4));
+				for (int c = 0; c < 4; c++) {
+					block[i * 4 + c] = static_cast<uint8_t>(palette[index][c]);
+				}
+			}
+			return true;
+		}
+		if (mode == 5) {
+			const int rotation = static_cast<int>(bits.read(2));
+			int v0[4], v1[4];
+			for (int c = 0; c < 3; c++) {
+				const int q0 = static_cast<int>(bits.read(7));
+				const int q1 = static_cast<int>(bits.read(7));
+				v0[c] = (q0 << 1) | (q0 >> 6);
+				v1[c] = (q1 << 1) | (q1 >> 6);
+			}
+			v0[3] = static_cast<int>(bits.read(8));
+			v1[3] = static_cast<int>(bits.read(8));
+			int color[16];
+			for (int i = 0; i < 16; i++) {
+				color[i] = static_cast<int>(bits.read(i == 0 ? 1 : 2));
+			}
+			for (int i = 0; i < 16; i++) {
+				const int alpha = static_cast<int>(bits.read(i == 0 ? 1 : 2));
+				for (int c = 0; c < 4; c++) {
+					const int w = BC7_WEIGHTS_2BIT[c < 3 ? color[i] : alpha];
+					block[i * 4 + c] = static_cast<uint8_t>(((64 - w) * v0[c] + w * v1[c] + 32) >> 6);
+				}
+				//rotation swaps alpha with one of the color channels
+				if (rotation > 0) {
+					std::swap(block[i * 4 + 3], block[i * 4 + rotation - 1]);
+				}
+			}
+			return true;
+		}
+		//other modes are never written by encode_bc7
+		for (int i = 0; i < 16; i++) {
+			block[i * 4 + 0] = 255;
+			block[i * 4 + 1] = 0;
+			block[i * 4 + 2] = 255;
+			block[i * 4 + 3] = 255;
+		}
+		return false;
+	}
+
+	uint32_t block_bytes(assets::TextureFormat format)
+	{
+		return format == assets::TextureFormat::BC1_SRGB ? 8 : 16;
+	}
+}
+
+bool vkutil::is_block_format(assets::TextureFormat format)
+{
+	return format == assets::TextureFormat::BC1_SRGB || format == assets::TextureFormat::BC3_SRGB
+		|| format == assets::TextureFormat::BC5_UNORM || format == assets::TextureFormat::BC7_SRGB;
+}
+
+void vkutil::compress_image(const uint8_t* rgba, uint32_t width, uint32_t height, assets::TextureFormat format,
+	ThreadPool& pool, uint8_t* out)
+{
+	const uint32_t blocksX = (width + 3) / 4;
+	const uint32_t blocksY = (height + 3) / 4;
+	const uint32_t blockSize = block_bytes(format);
+	pool.parallel_for(blocksY, 4, [&](size_t begin, size_t end) {
+		uint8_t block[64];
+		for (size_t by = begin; by < end; by++) {
+			for (uint32_t bx = 0; bx < blocksX; bx++) {
+				load_block(rgba, width, height, bx, static_cast<uint32_t>(by), block);
+				uint8_t* dst = out + (by * blocksX + bx) * blockSize;
+				switch (format) {
+				case assets::TextureFormat::BC1_SRGB:
+					encode_bc1(block, dst);
+					break;
+				case assets::TextureFormat::BC3_SRGB:
+					encode_bc4(block + 3, dst);
+					encode_bc1(block, dst + 8);
+					break;
+				case assets::TextureFormat::BC5_UNORM:
+					encode_bc4(block + 0, dst);
+					encode_bc4(block + 1, dst + 8);
+					break;
+				default:
+					encode_bc7(block, dst);
+					break;
+				}
+			}
+		}
+	});
+}
+
+bool vkutil::decompress_image(const uint8_t* blocks, uint32_t width, uint32_t height, assets::TextureFormat format, uint8_t* outRgba)
+{
+	const uint32_t blocksX = (width + 3) / 4;
+	const uint32_t blocksY = (height + 3) / 4;
+	const uint32_t blockSize = block_bytes(format);
+	bool valid = true;
+	uint8_t block[64];
+	for (uint32_t by = 0; by < blocksY; by++) {
+		for (uint32_t bx = 0; bx < blocksX; bx++) {
+			const uint8_t* src = blocks + (size_t(by) * blocksX + bx) * blockSize;
+			switch (format) {
+			case assets::TextureFormat::BC1_SRGB:
+				decode_bc1(src, block);
+				break;
+			case assets::TextureFormat::BC3_SRGB:
+				decode_bc1(src + 8, block);
+				decode_bc4(src, block + 3);
+				break;
+			case assets::TextureFormat::BC5_UNORM:
+				decode_bc4(src, block + 0);
+				decode_bc4(src + 8, block + 1);
+				for (int i = 0; i < 16; i++) {
+					block[i * 4 + 2] = 0;
+					block[i * 4 + 3] = 255;
+				}
+				break;
+			default:
+				valid = decode_bc7(src, block) && valid;
+				break;
+			}
+			store_block(block, width, height, bx, by, outRgba);
+		}
+	}
+	return valid;
+}
+
+double vkutil::compute_psnr(const uint8_t* a, const uint8_t* b, size_t texelCount, uint32_t channelMask)
+{
+	double squaredError = 0.0;
+	size_t samples = 0;
+	for (int c = 0; c < 4; c++) {
+		if (!(channelMask & (1u << c))) {
+			continue;
+		}
+		for (size_t i = 0; i < texelCount; i++) {
+			const double d = double(a[i * 4 + c]) - double(b[i * 4 + c]);
+			squaredError += d * d;
+		}
+		samples += texelCount;
+	}
+	if (samples == 0 || squaredError == 0.0) {
+		return std::numeric_limits<double>::infinity();
+	}
+	return 10.0 * std::log10(255.0 * 255.0 / (squaredError / double(samples)));
+}
@@ -0,0 +1,31 @@
+#pragma once
+#ifndef BC_ENCODER_H
+#define BC_ENCODER_H
+#include <cstdint>
+#include <cstddef>
+#include <asset_loader.h>
+
+class ThreadPool;
+
+namespace vkutil {
+	//true for the 4x4 block formats of assets::TextureFormat
+	bool is_block_format(assets::TextureFormat format);
+
+	//compress a width x height RGBA8 image into format, block rows are split over the pool
+	//out must hold assets::texture_level_size(format, width, height) bytes, edge blocks repeat the last texels
+	//BC1: opaque, principal axis endpoints refined by least squares, always the 4 color mode
+	//BC3: BC1 color plus a BC4 alpha block; BC5: BC4 blocks of red and green
+	//BC7: per block the better of mode 6 (one rgba line, 4 bit indices) and mode 5 (separate rgb and alpha
+	//lines, 2 bit indices), the partitioned modes are not searched
+	void compress_image(const uint8_t* rgba, uint32_t width, uint32_t height, assets::TextureFormat format,
+		ThreadPool& pool, uint8_t* out);
+
+	//decode blocks written by compress_image back to RGBA8, for quality checks and devices without BC support
+	//BC5 decodes to red/green with blue 0 and alpha 255; returns false on BC7 blocks of a mode other than 5 or 6
+	bool decompress_image(const uint8_t* blocks, uint32_t width, uint32_t height, assets::TextureFormat format, uint8_t* outRgba);
+
+	//peak signal to noise ratio in dB between two RGBA8 images over the channels set in channelMask
+	//(bit 0 red .. bit 3 alpha), infinity when they are identical
+	double compute_psnr(const uint8_t* a, const uint8_t* b, size_t texelCount, uint32_t channelMask);
+}
+#endif // !BC_ENCODER_H
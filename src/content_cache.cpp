@@ -0,0 +1,190 @@
+#include "content_cache.h"
+#include <asset_loader.h>
+#include <iostream>
+#include <cstring>
+
+namespace {
+	constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+	constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+	constexpr uint64_t PRIME3 = 0x165667B19E3779F9ull;
+	constexpr uint64_t PRIME4 = 0x85EBCA77C2B2AE63ull;
+	constexpr uint64_t PRIME5 = 0x27D4EB2F165667C5ull;
+
+	inline uint64_t rotl(uint64_t x, int r)
+	{
+		return (x << r) | (x >> (64 - r));
+	}
+
+	//unaligned little endian reads, the platforms the engine targets are all little endian
+	inline uint64_t read64(const uint8_t* p)
+	{
+		uint64_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	inline uint32_t read32(const uint8_t* p)
+	{
+		uint32_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	inline uint64_t round(uint64_t acc, uint64_t input)
+	{
+		acc += input * PRIME2;
+		acc = rotl(acc, 31);
+		return acc * PRIME1;
+	}
+
+	inline uint64_t merge_round(uint64_t acc, uint64_t val)
+	{
+		acc ^= round(0, val);
+		return acc * PRIME1 + PRIME4;
+	}
+}
+
+uint64_t content_hash(const void* data, size_t size, uint64_t seed)
+{
+	const uint8_t* p = static_cast<const uint8_t*>(data);
+	const uint8_t* end = p + size;
+	uint64_t h;
+	if (size >= 32) {
+		//four independent lanes over 32 byte stripes
+		uint64_t v1 = seed + PRIME1 + PRIME2;
+		uint64_t v2 = seed + PRIME2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - PRIME1;
+		const uint8_t* limit = end - 32;
+		do {
+			v1 = round(v1, read64(p));
+			v2 = round(v2, read64(p + 8));
+			v3 = round(v3, read64(p + 16));
+			v4 = round(v4, read64(p + 24));
+			p += 32;
+		} while (p <= limit);
+		h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+		h = merge_round(h, v1);
+		h = merge_round(h, v2);
+		h = merge_round(h, v3);
+		h = merge_round(h, v4);
+	}
+	else {
+		h = seed + PRIME5;
+	}
+	h += static_cast<uint64_t>(size);
+
+	//the tail, 8, 4 and then 1 bytes at a time
+	while (p + 8 <= end) {
+		h ^= round(0, read64(p));
+		h = rotl(h, 27) * PRIME1 + PRIME4;
+		p += 8;
+	}
+	if (p + 4 <= end) {
+		h ^= uint64_t(read32(p)) * PRIME1;
+		h = rotl(h, 23) * PRIME2 + PRIME3;
+		p += 4;
+	}
+	while (p < end) {
+		h ^= (*p) * PRIME5;
+		h = rotl(h, 11) * PRIME1;
+		p++;
+	}
+
+	h ^= h >> 33;
+	h *= PRIME2;
+	h ^= h >> 29;
+	h *= PRIME3;
+	h ^= h >> 32;
+	return h;
+}
+
+bool file_content_key(const char* path, ContentKey& outKey)
+{
+	assets::MappedFile file;
+	if (!file.open(path)) {
+		return false;
+	}
+	outKey.hash = content_hash(file.data(), file.size());
+	outKey.size = file.size();
+	return true;
+}
+
+const std::string* ContentCache::find(const ContentKey& key, const std::string& path) const
+{
+	auto it = _owners.find(key);
+	if (it == _owners.end()) {
+		return nullptr;
+	}
+	if (it->second.path != path) {
+		assets::MappedFile owner;
+		assets::MappedFile file;
+		if (!owner.open(it->second.path.c_str()) || !file.open(path.c_str()) || owner.size() != file.size()
+			|| memcmp(owner.data(), file.data(), file.size()) != 0) {
+			return nullptr;
+		}
+	}
+	return &it->second.name;
+}
+
+void ContentCache::alias(const std::string& name, const std::string& owner, uint64_t size)
+{
+	if (name != owner) {
+		_aliases[name] = owner;
+	}
+	_stats.hits++;
+	_stats.bytesSaved += size;
+}
+
+void ContentCache::insert(const ContentKey& key, const std::string& name, const std::string& path)
+{
+	_owners[key] = Owner{ name, path };
+	_aliases.erase(name);
+	_stats.misses++;
+}
+
+void ContentCache::remove(const std::string& name)
+{
+	if (_aliases.erase(name) != 0) {
+		return;
+	}
+	for (auto it = _owners.begin(); it != _owners.end(); it++) {
+		if (it->second.name != name) {
+			continue;
+		}
+		//the first alias becomes the owner, the others follow it
+		std::string heir;
+		for (auto alias = _aliases.begin(); alias != _aliases.end();) {
+			if (alias->second != name) {
+				alias++;
+			}
+			else if (heir.empty()) {
+				heir = alias->first;
+				alias = _aliases.erase(alias);
+			}
+			else {
+				alias->second = heir;
+				alias++;
+			}
+		}
+		if (heir.empty()) {
+			_owners.erase(it);
+		}
+		else {
+			it->second.name = heir;
+		}
+		return;
+	}
+}
+
+const std::string& ContentCache::resolve(const std::string& name) const
+{
+	auto it = _aliases.find(name);
+	return it == _aliases.end() ? name : it->second;
+}
+
+void ContentCache::print_stats(const char* name) const
+{
+	std::cout << name << ": " << _owners.size() << " unique, " << _stats.hits << " hits, " << _stats.misses << " misses, "
+		<< _stats.bytesSaved / 1024 << " KB not loaded twice" << std::endl;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#ifndef CONTENT_CACHE_H
+#define CONTENT_CACHE_H
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+
+//identity of a resource by what it contains rather than what it is called
+struct ContentKey {
+	uint64_t hash{ 0 };
+	uint64_t size{ 0 };
+
+	bool operator==(const ContentKey& other) const { return hash == other.hash && size == other.size; }
+};
+
+struct ContentKeyHash {
+	size_t operator()(const ContentKey& key) const { return static_cast<size_t>(key.hash); }
+};
+
+struct ContentCacheStats {
+	//names aliased to an owner, and contents loaded because no owner had them
+	uint64_t hits{ 0 };
+	uint64_t misses{ 0 };
+	//content bytes that were not loaded and uploaded a second time
+	uint64_t bytesSaved{ 0 };
+};
+
+//64 bit xxHash (XXH64) of size bytes, several GB/s against FNV-1a's byte at a time
+uint64_t content_hash(const void* data, size_t size, uint64_t seed = 0);
+
+//key of a whole file's bytes, false when it cannot be opened
+bool file_content_key(const char* path, ContentKey& outKey);
+
+//content addressed layer under the engine's string keyed resources: the first name a content is loaded under
+//owns the gpu resource, later names with the same bytes become aliases of it instead of a second copy
+//find() before loading, then alias() once the owner's resource is found or insert() once the load succeeded,
+//resolve() wherever a name has to reach the owner
+class ContentCache {
+public:
+	//owner of the content of path, keyed by key, nullptr on a miss; the owner's file is compared byte for byte
+	//with path, so a key collision is a miss, and nothing is recorded until alias() or insert()
+	const std::string* find(const ContentKey& key, const std::string& path) const;
+	//name stands for owner's resource from now on, counted as a hit saving size bytes
+	void alias(const std::string& name, const std::string& owner, uint64_t size);
+	//name owns the content of path, taking over the key from an owner with colliding bytes
+	void insert(const ContentKey& key, const std::string& name, const std::string& path);
+	//the resource of name is gone: an alias is dropped, an owner hands its content to one of its aliases or leaves the cache
+	void remove(const std::string& name);
+
+	//owner of name, name itself when it is no alias
+	const std::string& resolve(const std::string& name) const;
+	//alias -> owner
+	const std::unordered_map<std::string, std::string>& aliases() const { return _aliases; }
+
+	const ContentCacheStats& stats() const { return _stats; }
+	void print_stats(const char* name) const;
+
+private:
+	struct Owner {
+		std::string name;
+		//file the content was loaded from, compared with the files of later finds
+		std::string path;
+	};
+	std::unordered_map<ContentKey, Owner, ContentKeyHash> _owners;
+	std::unordered_map<std::string, std::string> _aliases;
+	ContentCacheStats _stats;
+};
+#endif // !CONTENT_CACHE_H
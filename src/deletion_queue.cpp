@@ -0,0 +1,75 @@
+#include "deletion_queue.h"
+
+void DeletionQueue::init(uint32_t frameSlots, DestroyFunction destroy, void* context)
+{
+	_destroy = destroy;
+	_context = context;
+	_frames.resize(frameSlots);
+}
+
+DeletionRecord DeletionQueue::record(void (*callback)(void* context), void* context)
+{
+	DeletionRecord record;
+	record.callback = callback;
+	record.owner = context;
+	record.type = DeletionType::Callback;
+	return record;
+}
+
+void DeletionQueue::begin_frame(uint32_t slot)
+{
+	destroy_all(_frames[slot]);
+}
+
+void DeletionQueue::end_frame(uint32_t slot)
+{
+	std::lock_guard<std::mutex> lock(_retireMutex);
+	if (_frames[slot].empty()) {
+		_frames[slot].swap(_retired);
+	}
+	else {
+		//begin_frame was skipped for the slot, the older records wait along
+		_frames[slot].insert(_frames[slot].end(), _retired.begin(), _retired.end());
+		_retired.clear();
+	}
+}
+
+void DeletionQueue::flush()
+{
+	for (std::vector<DeletionRecord>& frame : _frames) {
+		destroy_all(frame);
+	}
+	{
+		std::lock_guard<std::mutex> lock(_retireMutex);
+		destroy_all(_retired);
+	}
+	//later objects can depend on earlier ones, a view on its image, a set on its pool
+	for (auto it = _records.rbegin(); it != _records.rend(); it++) {
+		_destroy(*it, _context);
+	}
+	_records.clear();
+}
+
+size_t DeletionQueue::retired_count()
+{
+	std::lock_guard<std::mutex> lock(_retireMutex);
+	size_t count = _retired.size();
+	for (const std::vector<DeletionRecord>& frame : _frames) {
+		count += frame.size();
+	}
+	return count;
+}
+
+void DeletionQueue::retire_record(const DeletionRecord& record)
+{
+	std::lock_guard<std::mutex> lock(_retireMutex);
+	_retired.push_back(record);
+}
+
+void DeletionQueue::destroy_all(std::vector<DeletionRecord>& records)
+{
+	for (const DeletionRecord& record : records) {
+		_destroy(record, _context);
+	}
+	records.clear();
+}
@@ -0,0 +1,113 @@
+#pragma once
+#ifndef DELETION_QUEUE_H
+#define DELETION_QUEUE_H
+#include <vk_types.h>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+//what a DeletionRecord destroys
+enum class DeletionType : uint8_t {
+	Buffer,
+	Image,
+	ImageView,
+	Sampler,
+	Framebuffer,
+	RenderPass,
+	Pipeline,
+	PipelineLayout,
+	DescriptorSetLayout,
+	DescriptorPool,
+	DescriptorSet,
+	CommandPool,
+	Fence,
+	Semaphore,
+	Swapchain,
+	//anything else, like the cleanup of a subsystem: callback(owner)
+	Callback,
+};
+
+//one object to destroy, the handle bits and what destroying it needs besides the device
+//the handles are the 64 bit pointer kind, the engine only builds for 64 bit targets
+struct DeletionRecord {
+	union {
+		uint64_t handle;
+		void (*callback)(void* context);
+	};
+	//allocation of buffers and images, pool of descriptor sets, context of callbacks
+	void* owner;
+	DeletionType type;
+};
+
+//deferred destruction without a heap allocation per object: records go into vectors that keep their capacity
+//push() is for objects living until shutdown, flush() destroys them in the reverse order they were pushed
+//retire() is for objects dropped at runtime while frames in flight may still use them, from any thread:
+//end_frame(slot) after a frame's submit hands everything retired so far to that slot, and begin_frame(slot)
+//destroys it once the slot's fence signalled, the fence covering every submission before it on the queue
+class DeletionQueue {
+public:
+	//destroy runs for every record, the engine's calls into Vulkan, so the queue itself runs without a device
+	using DestroyFunction = void (*)(const DeletionRecord& record, void* context);
+
+	void init(uint32_t frameSlots, DestroyFunction destroy, void* context);
+
+	template<typename... Args>
+	void push(Args... args) { _records.push_back(record(args...)); }
+	template<typename... Args>
+	void retire(Args... args) { retire_record(record(args...)); }
+
+	void begin_frame(uint32_t slot);
+	void end_frame(uint32_t slot);
+	//retired objects first, then the pushed ones, with the device idle
+	void flush();
+
+	//records waiting for a fence, retired and not handed to a frame included
+	size_t retired_count();
+
+	static DeletionRecord record(VkBuffer buffer, VmaAllocation allocation) { return make(buffer, allocation, DeletionType::Buffer); }
+	static DeletionRecord record(VkImage image, VmaAllocation allocation) { return make(image, allocation, DeletionType::Image); }
+	static DeletionRecord record(VkImageView view) { return make(view, nullptr, DeletionType::ImageView); }
+	static DeletionRecord record(VkSampler sampler) { return make(sampler, nullptr, DeletionType::Sampler); }
+	static DeletionRecord record(VkFramebuffer framebuffer) { return make(framebuffer, nullptr, DeletionType::Framebuffer); }
+	static DeletionRecord record(VkRenderPass renderPass) { return make(renderPass, nullptr, DeletionType::RenderPass); }
+	static DeletionRecord record(VkPipeline pipeline) { return make(pipeline, nullptr, DeletionType::Pipeline); }
+	static DeletionRecord record(VkPipelineLayout layout) { return make(layout, nullptr, DeletionType::PipelineLayout); }
+	static DeletionRecord record(VkDescriptorSetLayout layout) { return make(layout, nullptr, DeletionType::DescriptorSetLayout); }
+	static DeletionRecord record(VkDescriptorPool pool) { return make(pool, nullptr, DeletionType::DescriptorPool); }
+	//freed back to pool, which needs VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT
+	static DeletionRecord record(VkDescriptorSet set, VkDescriptorPool pool) { return make(set, pool, DeletionType::DescriptorSet); }
+	static DeletionRecord record(VkCommandPool pool) { return make(pool, nullptr, DeletionType::CommandPool); }
+	static DeletionRecord record(VkFence fence) { return make(fence, nullptr, DeletionType::Fence); }
+	static DeletionRecord record(VkSemaphore semaphore) { return make(semaphore, nullptr, DeletionType::Semaphore); }
+	static DeletionRecord record(VkSwapchainKHR swapchain) { return make(swapchain, nullptr, DeletionType::Swapchain); }
+	//a lambda without captures converts to callback
+	static DeletionRecord record(void (*callback)(void* context), void* context);
+
+	//the object a record holds, for the destroy function
+	template<typename T>
+	static T handle(const DeletionRecord& record) { return reinterpret_cast<T>(record.handle); }
+
+private:
+	template<typename T>
+	static DeletionRecord make(T handle, void* owner, DeletionType type)
+	{
+		DeletionRecord record;
+		record.handle = reinterpret_cast<uint64_t>(handle);
+		record.owner = owner;
+		record.type = type;
+		return record;
+	}
+
+	void retire_record(const DeletionRecord& record);
+	void destroy_all(std::vector<DeletionRecord>& records);
+
+	DestroyFunction _destroy{ nullptr };
+	void* _context{ nullptr };
+	std::vector<DeletionRecord> _records;
+	//per frame slot, what its last end_frame collected
+	std::vector<std::vector<DeletionRecord>> _frames;
+	//retired since the last end_frame, swapped with a slot's emptied list so neither gives up its capacity
+	std::mutex _retireMutex;
+	std::vector<DeletionRecord> _retired;
+};
+#endif // !DELETION_QUEUE_H
@@ -0,0 +1,72 @@
+#include "frame_allocator.h"
+#include <algorithm>
+
+static uintptr_t align_up(uintptr_t value, size_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+FrameAllocator::FrameAllocator(size_t capacity)
+{
+	reserve(capacity);
+}
+
+FrameAllocator::~FrameAllocator()
+{
+	release_overflows();
+}
+
+void FrameAllocator::reserve(size_t capacity)
+{
+	release_overflows();
+	_used = 0;
+	_stats.usedBytes = 0;
+	if (capacity > _stats.capacity) {
+		_block.reset(new char[capacity]);
+		_stats.capacity = capacity;
+	}
+}
+
+void* FrameAllocator::allocate(size_t size, size_t alignment)
+{
+	alignment = std::max<size_t>(alignment, 1);
+	const uintptr_t base = reinterpret_cast<uintptr_t>(_block.get());
+	const size_t offset = align_up(base + _used, alignment) - base;
+	if (_block && offset + size <= _stats.capacity) {
+		_stats.usedBytes += offset + size - _used;
+		_stats.highWater = std::max(_stats.highWater, _stats.usedBytes);
+		_used = offset + size;
+		return _block.get() + offset;
+	}
+	//past the block: a heap chunk with room to align, linked in front of the allocation
+	char* chunk = new char[sizeof(Overflow) + alignment + size];
+	Overflow* overflow = reinterpret_cast<Overflow*>(chunk);
+	overflow->next = _overflows;
+	_overflows = overflow;
+	_stats.overflows++;
+	_stats.usedBytes += alignment + size;
+	_stats.highWater = std::max(_stats.highWater, _stats.usedBytes);
+	return reinterpret_cast<void*>(align_up(reinterpret_cast<uintptr_t>(chunk + sizeof(Overflow)), alignment));
+}
+
+void FrameAllocator::reset()
+{
+	if (_overflows) {
+		//the frame needed more than the block, the next ones likely do too
+		release_overflows();
+		_stats.capacity = std::max(_stats.capacity * 2, _stats.usedBytes);
+		_block.reset(new char[_stats.capacity]);
+		_stats.grows++;
+	}
+	_used = 0;
+	_stats.usedBytes = 0;
+}
+
+void FrameAllocator::release_overflows()
+{
+	while (_overflows) {
+		Overflow* next = _overflows->next;
+		delete[] reinterpret_cast<char*>(_overflows);
+		_overflows = next;
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+#ifndef FRAME_ALLOCATOR_H
+#define FRAME_ALLOCATOR_H
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//occupancy of a FrameAllocator
+struct FrameAllocatorStats {
+	size_t capacity{ 0 };
+	//bytes handed out since the last reset, alignment padding and overflow included
+	size_t usedBytes{ 0 };
+	size_t highWater{ 0 };
+	//allocations that did not fit the block and went to the heap, and how often the block grew because of them
+	uint64_t overflows{ 0 };
+	uint32_t grows{ 0 };
+};
+
+//linear arena for cpu data that lives one frame, like the scratch vectors of sorting and culling:
+//allocate() bumps a pointer through one block and reset() drops everything at once, nothing is freed one by one
+//a frame that runs past the block still gets its memory from the heap, and the block grows to fit at the next reset,
+//so only the first frames of a bigger scene allocate
+class FrameAllocator {
+public:
+	explicit FrameAllocator(size_t capacity = 0);
+	~FrameAllocator();
+	FrameAllocator(const FrameAllocator&) = delete;
+	FrameAllocator& operator=(const FrameAllocator&) = delete;
+
+	//drops everything and makes the block at least capacity bytes
+	void reserve(size_t capacity);
+	//size bytes aligned to alignment, valid until the next reset(), never null
+	void* allocate(size_t size, size_t alignment);
+	void reset();
+
+	const FrameAllocatorStats& stats() const { return _stats; }
+
+private:
+	//heap chunks of allocations past the block, freed with the next reset
+	struct Overflow {
+		Overflow* next;
+	};
+
+	void release_overflows();
+
+	std::unique_ptr<char[]> _block;
+	size_t _used{ 0 };
+	Overflow* _overflows{ nullptr };
+	FrameAllocatorStats _stats;
+};
+
+//std allocator on a FrameAllocator, deallocate does nothing and the memory goes with the arena's reset
+template<typename T>
+class FrameStlAllocator {
+public:
+	using value_type = T;
+
+	FrameStlAllocator(FrameAllocator& arena) noexcept : _arena(&arena) {}
+	template<typename U>
+	FrameStlAllocator(const FrameStlAllocator<U>& other) noexcept : _arena(&other.arena()) {}
+
+	T* allocate(size_t count) { return static_cast<T*>(_arena->allocate(count * sizeof(T), alignof(T))); }
+	void deallocate(T*, size_t) noexcept {}
+
+	FrameAllocator& arena() const { return *_arena; }
+
+private:
+	FrameAllocator* _arena;
+};
+
+template<typename T, typename U>
+bool operator==(const FrameStlAllocator<T>& a, const FrameStlAllocator<U>& b) { return &a.arena() == &b.arena(); }
+template<typename T, typename U>
+bool operator!=(const FrameStlAllocator<T>& a, const FrameStlAllocator<U>& b) { return !(a == b); }
+
+//vector for one frame, reserve what it will hold since growing leaves the old storage in the arena until reset
+template<typename T>
+using FrameVector = std::vector<T, FrameStlAllocator<T>>;
+#endif // !FRAME_ALLOCATOR_H
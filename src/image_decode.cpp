@@ -0,0 +1,89 @@
+#include "image_decode.h"
+#include <atomic>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+	//caller memory the next stb_image allocation of exactly size bytes gets instead of the heap,
+	//set for the duration of one decode on the decoding thread
+	struct DecodeTarget {
+		uint8_t* dst{ nullptr };
+		size_t size{ 0 };
+		bool handedOut{ false };
+	};
+	thread_local DecodeTarget decodeTarget;
+
+	std::atomic<uint64_t> inPlaceDecodes{ 0 };
+	std::atomic<uint64_t> copiedDecodes{ 0 };
+
+	//the result of an RGBA8 decode is its only allocation of width * height * 4 bytes, intermediates
+	//(zlib output, 16 bit or paletted data) differ in size, and one that happens to match is freed before the result
+	void* decode_malloc(size_t size)
+	{
+		if (decodeTarget.dst && !decodeTarget.handedOut && size == decodeTarget.size) {
+			decodeTarget.handedOut = true;
+			return decodeTarget.dst;
+		}
+		return malloc(size);
+	}
+
+	void decode_free(void* p)
+	{
+		if (p && p == decodeTarget.dst) {
+			decodeTarget.handedOut = false;
+			return;
+		}
+		free(p);
+	}
+
+	void* decode_realloc(void* p, size_t size)
+	{
+		if (p && p == decodeTarget.dst) {
+			//never grown in place, the target has a fixed size
+			void* moved = malloc(size);
+			if (moved) {
+				memcpy(moved, p, std::min(size, decodeTarget.size));
+				decodeTarget.handedOut = false;
+			}
+			return moved;
+		}
+		return realloc(p, size);
+	}
+}
+
+#define STBI_MALLOC(size) decode_malloc(size)
+#define STBI_REALLOC(p, size) decode_realloc(p, size)
+#define STBI_FREE(p) decode_free(p)
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+bool vkutil::decode_image_into(const char* file, uint32_t width, uint32_t height, uint8_t* dst)
+{
+	const size_t size = size_t(width) * height * 4;
+	decodeTarget = { dst, size, false };
+	int texWidth, texHeight, texChannels;
+	stbi_uc* pixels = stbi_load(file, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+	decodeTarget = {};
+	if (!pixels) {
+		return false;
+	}
+	const bool sized = uint32_t(texWidth) == width && uint32_t(texHeight) == height;
+	if (pixels == dst) {
+		inPlaceDecodes++;
+	}
+	else {
+		//the decoder took another route to its result, one copy like before
+		if (sized) {
+			memcpy(dst, pixels, size);
+		}
+		stbi_image_free(pixels);
+		copiedDecodes++;
+	}
+	return sized;
+}
+
+vkutil::ImageDecodeStats vkutil::image_decode_stats()
+{
+	return { inPlaceDecodes.load(), copiedDecodes.load() };
+}
@@ -0,0 +1,21 @@
+#pragma once
+#ifndef IMAGE_DECODE_H
+#define IMAGE_DECODE_H
+#include <cstdint>
+#include <cstddef>
+
+//owner of the stb_image implementation, both targets decode through the allocation hook here
+namespace vkutil {
+	//decode a png/jpg as RGBA8 straight into dst, which holds width * height * 4 bytes as stbi_info reported them
+	//stb_image allocates its result through a hook that hands out dst, so the pixels never go through the heap
+	//thread safe, false when the file no longer decodes to that size
+	bool decode_image_into(const char* file, uint32_t width, uint32_t height, uint8_t* dst);
+
+	//decodes that landed in the caller's memory and ones that took a heap buffer and a copy, over the process
+	struct ImageDecodeStats {
+		uint64_t inPlace;
+		uint64_t copied;
+	};
+	ImageDecodeStats image_decode_stats();
+}
+#endif // !IMAGE_DECODE_H
@@ -0,0 +1,293 @@
+#include "ktx2_loader.h"
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <array>
+
+#include <zstd.h>
+
+namespace {
+	constexpr uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	static_assert(sizeof(assets::Ktx2Header) == 80, "KTX2 header must match the file layout");
+	static_assert(sizeof(assets::Ktx2Level) == 24, "KTX2 level index entry must match the file layout");
+
+	//khronos data format descriptor values used by the basic descriptor block
+	constexpr uint32_t KHR_DF_MODEL_RGBSDA = 1;
+	constexpr uint32_t KHR_DF_MODEL_BC1A = 128;
+	constexpr uint32_t KHR_DF_MODEL_BC3 = 130;
+	constexpr uint32_t KHR_DF_MODEL_BC5 = 132;
+	constexpr uint32_t KHR_DF_MODEL_BC7 = 134;
+	constexpr uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+	constexpr uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+	constexpr uint32_t KHR_DF_TRANSFER_SRGB = 2;
+	constexpr uint32_t KHR_DF_CHANNEL_ALPHA = 15;
+	constexpr uint32_t KHR_DF_SAMPLE_LINEAR = 0x10;
+
+	struct DfdSample {
+		uint32_t channel;
+		uint32_t bitOffset;
+		uint32_t bitLength;
+	};
+
+	//one basic descriptor block with its total size in front, bytesPlane0 is 0 for supercompressed data
+	std::vector<uint32_t> basic_dfd(assets::TextureFormat format, bool supercompressed)
+	{
+		uint32_t model = KHR_DF_MODEL_RGBSDA;
+		uint32_t blockBytes = 4;
+		//at most one sample per RGBA channel
+		std::array<DfdSample, 4> samples{};
+		uint32_t sampleCount = 1;
+		switch (format) {
+		case assets::TextureFormat::BC1_SRGB:
+			model = KHR_DF_MODEL_BC1A;
+			blockBytes = 8;
+			samples[0] = { 0, 0, 64 };
+			break;
+		case assets::TextureFormat::BC3_SRGB:
+			model = KHR_DF_MODEL_BC3;
+			blockBytes = 16;
+			samples[0] = { KHR_DF_CHANNEL_ALPHA, 0, 64 };
+			samples[1] = { 0, 64, 64 };
+			sampleCount = 2;
+			break;
+		case assets::TextureFormat::BC5_UNORM:
+			model = KHR_DF_MODEL_BC5;
+			blockBytes = 16;
+			samples[0] = { 0, 0, 64 };
+			samples[1] = { 1, 64, 64 };
+			sampleCount = 2;
+			break;
+		case assets::TextureFormat::BC7_SRGB:
+			model = KHR_DF_MODEL_BC7;
+			blockBytes = 16;
+			samples[0] = { 0, 0, 128 };
+			break;
+		default:
+			samples = { { { 0, 0, 8 }, { 1, 8, 8 }, { 2, 16, 8 }, { KHR_DF_CHANNEL_ALPHA, 24, 8 } } };
+			sampleCount = 4;
+			break;
+		}
+		const bool block = model != KHR_DF_MODEL_RGBSDA;
+		const bool srgb = format != assets::TextureFormat::BC5_UNORM;
+		const uint32_t blockSize = 24 + 16 * sampleCount;
+
+		std::vector<uint32_t> words;
+		words.push_back(4 + blockSize);
+		//vendor khronos, descriptor type basic
+		words.push_back(0);
+		words.push_back(2 | (blockSize << 16));
+		words.push_back(model | (KHR_DF_PRIMARIES_BT709 << 8) | ((srgb ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR) << 16));
+		//texel block dimensions minus one
+		words.push_back(block ? (3 | (3 << 8)) : 0);
+		words.push_back(supercompressed ? 0 : blockBytes);
+		words.push_back(0);
+		for (uint32_t s = 0; s < sampleCount; s++) {
+			const DfdSample& sample = samples[s];
+			//alpha never goes through the transfer function
+			const uint32_t qualifiers = sample.channel == KHR_DF_CHANNEL_ALPHA && srgb ? KHR_DF_SAMPLE_LINEAR : 0;
+			words.push_back(sample.bitOffset | ((sample.bitLength - 1) << 16) | ((sample.channel | qualifiers) << 24));
+			words.push_back(0);
+			words.push_back(0);
+			words.push_back(block ? 0xFFFFFFFFu : (1u << sample.bitLength) - 1);
+		}
+		return words;
+	}
+
+	//level data alignment of uncompressed files, lcm of the texel block size and 4
+	uint64_t level_alignment(assets::TextureFormat format)
+	{
+		switch (format) {
+		case assets::TextureFormat::BC1_SRGB:
+			return 8;
+		case assets::TextureFormat::RGBA8_SRGB:
+			return 4;
+		default:
+			return 16;
+		}
+	}
+
+	bool in_file(uint64_t offset, uint64_t length, size_t fileSize)
+	{
+		return offset <= fileSize && length <= fileSize - offset;
+	}
+}
+
+VkFormat assets::texture_vk_format(TextureFormat format)
+{
+	switch (format) {
+	case TextureFormat::BC1_SRGB:
+		return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+	case TextureFormat::BC3_SRGB:
+		return VK_FORMAT_BC3_SRGB_BLOCK;
+	case TextureFormat::BC5_UNORM:
+		return VK_FORMAT_BC5_UNORM_BLOCK;
+	case TextureFormat::BC7_SRGB:
+		return VK_FORMAT_BC7_SRGB_BLOCK;
+	default:
+		return VK_FORMAT_R8G8B8A8_SRGB;
+	}
+}
+
+bool assets::texture_format_from_vk(uint32_t vkFormat, TextureFormat& outFormat)
+{
+	switch (vkFormat) {
+	case VK_FORMAT_R8G8B8A8_SRGB:
+		outFormat = TextureFormat::RGBA8_SRGB;
+		return true;
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		outFormat = TextureFormat::BC1_SRGB;
+		return true;
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+		outFormat = TextureFormat::BC3_SRGB;
+		return true;
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+		outFormat = TextureFormat::BC5_UNORM;
+		return true;
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		outFormat = TextureFormat::BC7_SRGB;
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool assets::open_ktx2(const MappedFile& file, Ktx2View& outView)
+{
+	if (file.size() < sizeof(Ktx2Header)) {
+		return false;
+	}
+	const Ktx2Header* header = (const Ktx2Header*)file.data();
+	if (memcmp(header->identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+		std::cout << "File is not a KTX2 texture" << std::endl;
+		return false;
+	}
+	TextureFormat format;
+	if (!texture_format_from_vk(header->vkFormat, format)) {
+		std::cout << "KTX2 format " << header->vkFormat << " is not supported" << std::endl;
+		return false;
+	}
+	if (header->pixelWidth == 0 || header->pixelHeight == 0 || header->pixelDepth != 0 || header->layerCount > 1
+		|| header->faceCount != 1) {
+		std::cout << "Only single layer 2D KTX2 textures are supported" << std::endl;
+		return false;
+	}
+	if (header->supercompressionScheme != Ktx2Supercompression::None && header->supercompressionScheme != Ktx2Supercompression::Zstd) {
+		std::cout << "KTX2 supercompression scheme " << uint32_t(header->supercompressionScheme) << " is not supported" << std::endl;
+		return false;
+	}
+	const uint32_t levelCount = header->levelCount == 0 ? 1 : header->levelCount;
+	const uint32_t largest = header->pixelWidth > header->pixelHeight ? header->pixelWidth : header->pixelHeight;
+	if (levelCount > 32 || (largest >> (levelCount - 1)) == 0) {
+		std::cout << "KTX2 texture has more levels than its size allows" << std::endl;
+		return false;
+	}
+	const uint64_t indexEnd = sizeof(Ktx2Header) + uint64_t(levelCount) * sizeof(Ktx2Level);
+	if (!in_file(0, indexEnd, file.size()) || !in_file(header->dfdByteOffset, header->dfdByteLength, file.size())
+		|| !in_file(header->kvdByteOffset, header->kvdByteLength, file.size())
+		|| !in_file(header->sgdByteOffset, header->sgdByteLength, file.size())) {
+		std::cout << "KTX2 index is truncated" << std::endl;
+		return false;
+	}
+
+	Ktx2View view;
+	view.header = header;
+	view.levels = (const Ktx2Level*)(file.data() + sizeof(Ktx2Header));
+	view.file = file.data();
+	view.format = format;
+	//every level must lie after the index inside the mapping and unpack to exactly one level
+	for (uint32_t i = 0; i < levelCount; i++) {
+		const Ktx2Level& level = view.levels[i];
+		if (level.byteOffset < indexEnd || !in_file(level.byteOffset, level.byteLength, file.size())) {
+			std::cout << "KTX2 level " << i << " is truncated" << std::endl;
+			return false;
+		}
+		if (level.uncompressedByteLength != texture_level_size(format, view.level_width(i), view.level_height(i))
+			|| (header->supercompressionScheme == Ktx2Supercompression::None && level.byteLength != level.uncompressedByteLength)) {
+			std::cout << "KTX2 level " << i << " has the wrong size" << std::endl;
+			return false;
+		}
+	}
+	outView = view;
+	return true;
+}
+
+bool assets::unpack_ktx2_level(const Ktx2View& view, uint32_t level, void* dst)
+{
+	const Ktx2Span span = view.level_span(level);
+	const size_t rawSize = static_cast<size_t>(view.levels[level].uncompressedByteLength);
+	if (view.header->supercompressionScheme == Ktx2Supercompression::None) {
+		memcpy(dst, span.data, span.size);
+		return true;
+	}
+	const size_t decompressed = ZSTD_decompress(dst, rawSize, span.data, span.size);
+	return !ZSTD_isError(decompressed) && decompressed == rawSize;
+}
+
+bool assets::save_ktx2(const char* path, TextureFormat format, uint32_t width, uint32_t height,
+	const std::vector<std::pair<const void*, size_t>>& levels, int zstdLevel)
+{
+	const bool supercompressed = zstdLevel > 0;
+	Ktx2Header header = {};
+	memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+	header.vkFormat = texture_vk_format(format);
+	header.typeSize = 1;
+	header.pixelWidth = width;
+	header.pixelHeight = height;
+	header.faceCount = 1;
+	header.levelCount = static_cast<uint32_t>(levels.size());
+	header.supercompressionScheme = supercompressed ? Ktx2Supercompression::Zstd : Ktx2Supercompression::None;
+
+	const std::vector<uint32_t> dfd = basic_dfd(format, supercompressed);
+	//one KTXwriter entry: length, "key\0value\0", padded to 4 bytes
+	const char writer[] = "KTXwriter\0asset_cooker";
+	const uint32_t writerLength = sizeof(writer);
+	std::vector<char> kvd(sizeof(uint32_t) + ((writerLength + 3) & ~3u), 0);
+	memcpy(kvd.data(), &writerLength, sizeof(uint32_t));
+	memcpy(kvd.data() + sizeof(uint32_t), writer, writerLength);
+
+	header.dfdByteOffset = static_cast<uint32_t>(sizeof(Ktx2Header) + levels.size() * sizeof(Ktx2Level));
+	header.dfdByteLength = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+	header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+	header.kvdByteLength = static_cast<uint32_t>(kvd.size());
+
+	//levels are stored smallest first, so a streamer can read the small ones without seeking past the big ones
+	std::vector<Ktx2Level> index(levels.size());
+	std::vector<char> data;
+	const uint64_t dataStart = header.kvdByteOffset + header.kvdByteLength;
+	const uint64_t alignment = supercompressed ? 1 : level_alignment(format);
+	for (size_t i = levels.size(); i-- > 0;) {
+		const size_t rawSize = levels[i].second;
+		size_t offset = data.size();
+		offset += static_cast<size_t>((alignment - (dataStart + offset) % alignment) % alignment);
+		if (supercompressed) {
+			data.resize(offset + ZSTD_compressBound(rawSize));
+			const size_t compressedSize = ZSTD_compress(data.data() + offset, ZSTD_compressBound(rawSize),
+				levels[i].first, rawSize, zstdLevel);
+			if (ZSTD_isError(compressedSize)) {
+				std::cout << "Zstd failed on KTX2 level " << i << ": " << ZSTD_getErrorName(compressedSize) << std::endl;
+				return false;
+			}
+			data.resize(offset + compressedSize);
+		}
+		else {
+			data.resize(offset + rawSize);
+			memcpy(data.data() + offset, levels[i].first, rawSize);
+		}
+		index[i].byteOffset = dataStart + offset;
+		index[i].byteLength = data.size() - offset;
+		index[i].uncompressedByteLength = rawSize;
+	}
+
+	std::ofstream outfile(path, std::ios::binary | std::ios::out);
+	if (!outfile.is_open()) {
+		std::cout << "Failed to open " << path << " for writing" << std::endl;
+		return false;
+	}
+	outfile.write((const char*)&header, sizeof(Ktx2Header));
+	outfile.write((const char*)index.data(), index.size() * sizeof(Ktx2Level));
+	outfile.write((const char*)dfd.data(), dfd.size() * sizeof(uint32_t));
+	outfile.write(kvd.data(), kvd.size());
+	outfile.write(data.data(), data.size());
+	return outfile.good();
+}
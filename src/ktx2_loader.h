@@ -0,0 +1,82 @@
+#pragma once
+#ifndef KTX2_LOADER_H
+#define KTX2_LOADER_H
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <asset_loader.h>
+
+//Khronos KTX2 texture container, read straight from a memory mapping
+//layout: Ktx2Header | Ktx2Level[levelCount] | data format descriptor | key/value data | levels smallest first
+namespace assets {
+
+	enum class Ktx2Supercompression : uint32_t {
+		None = 0,
+		//every level is its own zstd frame
+		Zstd = 2,
+	};
+
+	//identifier plus header and index, 80 bytes at the start of the file
+	struct Ktx2Header {
+		uint8_t identifier[12];
+		uint32_t vkFormat;
+		uint32_t typeSize;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t layerCount;
+		uint32_t faceCount;
+		//0 asks the loader to build the chain, the file then still holds one level
+		uint32_t levelCount;
+		Ktx2Supercompression supercompressionScheme;
+		uint32_t dfdByteOffset;
+		uint32_t dfdByteLength;
+		uint32_t kvdByteOffset;
+		uint32_t kvdByteLength;
+		uint64_t sgdByteOffset;
+		uint64_t sgdByteLength;
+	};
+
+	//level index entry, offsets are from the start of the file
+	struct Ktx2Level {
+		uint64_t byteOffset;
+		uint64_t byteLength;
+		uint64_t uncompressedByteLength;
+	};
+
+	//bytes of one level inside the mapping, still zstd compressed when the file is supercompressed
+	struct Ktx2Span {
+		const char* data;
+		size_t size;
+	};
+
+	//zero copy view of a KTX2 file inside a mapped file
+	struct Ktx2View {
+		const Ktx2Header* header{ nullptr };
+		const Ktx2Level* levels{ nullptr };
+		const char* file{ nullptr };
+		TextureFormat format{ TextureFormat::RGBA8_SRGB };
+
+		uint32_t level_count() const { return header->levelCount == 0 ? 1 : header->levelCount; }
+		uint32_t level_width(uint32_t level) const { return header->pixelWidth >> level ? header->pixelWidth >> level : 1; }
+		uint32_t level_height(uint32_t level) const { return header->pixelHeight >> level ? header->pixelHeight >> level : 1; }
+		Ktx2Span level_span(uint32_t level) const { return { file + levels[level].byteOffset, static_cast<size_t>(levels[level].byteLength) }; }
+	};
+
+	//Vulkan format of a cooked texture format and back, false for formats the engine cannot load
+	VkFormat texture_vk_format(TextureFormat format);
+	bool texture_format_from_vk(uint32_t vkFormat, TextureFormat& outFormat);
+
+	//validates the header, the level index and every range against the mapped size,
+	//only single layer, single face 2D textures in a TextureFormat are accepted
+	bool open_ktx2(const MappedFile& file, Ktx2View& outView);
+
+	//copy or decompress one level into dst, which must hold levels[level].uncompressedByteLength bytes
+	bool unpack_ktx2_level(const Ktx2View& view, uint32_t level, void* dst);
+
+	//write a 2D texture, levels largest first and each texture_level_size bytes, zstdLevel 0 stores them uncompressed
+	bool save_ktx2(const char* path, TextureFormat format, uint32_t width, uint32_t height,
+		const std::vector<std::pair<const void*, size_t>>& levels, int zstdLevel);
+}
+#endif // !KTX2_LOADER_H
@@ -0,0 +1,128 @@
+#include "memory_stats.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#include <cstdio>
+#endif
+#ifdef COUNT_HEAP_ALLOCATIONS
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> heapAllocations{ 0 };
+
+//malloc underneath so the matching deletes can free, over-aligned new keeps the library's and is not counted
+static void* counted_new(std::size_t size) noexcept
+{
+	heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	return std::malloc(size > 0 ? size : 1);
+}
+
+void* operator new(std::size_t size)
+{
+	void* memory = counted_new(size);
+	if (!memory) {
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	return counted_new(size);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return counted_new(size);
+}
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+void operator delete[](void* memory) noexcept
+{
+	std::free(memory);
+}
+void operator delete(void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+void operator delete[](void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+	std::free(memory);
+}
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+	std::free(memory);
+}
+#endif
+
+uint64_t vkutil::current_rss_bytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return 0;
+	}
+	return counters.WorkingSetSize;
+#else
+	//second field of statm is the resident page count
+	FILE* statm = fopen("/proc/self/statm", "r");
+	if (!statm) {
+		return 0;
+	}
+	unsigned long long pages = 0, resident = 0;
+	const int read = fscanf(statm, "%llu %llu", &pages, &resident);
+	fclose(statm);
+	return read == 2 ? resident * uint64_t(sysconf(_SC_PAGESIZE)) : 0;
+#endif
+}
+
+uint64_t vkutil::peak_rss_bytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return 0;
+	}
+	return counters.PeakWorkingSetSize;
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return 0;
+	}
+	//kilobytes on linux
+	return uint64_t(usage.ru_maxrss) * 1024;
+#endif
+}
+
+uint64_t vkutil::heap_allocation_count()
+{
+#ifdef COUNT_HEAP_ALLOCATIONS
+	return heapAllocations.load(std::memory_order_relaxed);
+#else
+	return 0;
+#endif
+}
+
+bool vkutil::heap_allocations_counted()
+{
+#ifdef COUNT_HEAP_ALLOCATIONS
+	return true;
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,17 @@
+#pragma once
+#ifndef MEMORY_STATS_H
+#define MEMORY_STATS_H
+#include <cstdint>
+
+//resident memory of the process, what the load paths are measured by
+namespace vkutil {
+	//bytes resident now, 0 when the platform cannot tell
+	uint64_t current_rss_bytes();
+	//largest resident set since the process started, it never goes down
+	uint64_t peak_rss_bytes();
+	//operator new calls since the process started, on every thread, for the zero allocation frame checks
+	//only counted in builds with COUNT_HEAP_ALLOCATIONS, which replaces the global operator new, 0 otherwise
+	uint64_t heap_allocation_count();
+	bool heap_allocations_counted();
+}
+#endif // !MEMORY_STATS_H
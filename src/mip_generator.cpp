@@ -0,0 +1,486 @@
+#include "mip_generator.h"
+#include <thread_pool.h>
+#include <cmath>
+#include <cstring>
+#include <array>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_SSE 1
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define MIP_AVX2 1
+#include "mip_generator_avx2.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#define MIP_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+	//kaiser window over +-3 destination texels, the usual choice for mip filtering
+	constexpr float KAISER_RADIUS = 3.0f;
+	constexpr float KAISER_ALPHA = 4.0f;
+	//destination rows filtered together, their narrowed source rows have to fit in cache
+	constexpr size_t MIP_BLOCK_ROWS = 16;
+
+	//weights of one separable pass: every destination texel reads taps source texels from start
+	struct Kernel {
+		uint32_t taps{ 0 };
+		std::vector<uint32_t> start;
+		std::vector<float> weights;
+	};
+
+	float srgb_to_linear(float c)
+	{
+		return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+	}
+
+	const float* srgb_to_linear_table()
+	{
+		static const std::array<float, 256> table = []() {
+			std::array<float, 256> values;
+			for (int i = 0; i < 256; i++) {
+				values[i] = srgb_to_linear(i / 255.0f);
+			}
+			return values;
+		}();
+		return table.data();
+	}
+
+	//linear value quantized to 16 bits -> nearest srgb byte, exact up to the quantization
+	//built from the linear midpoints between neighbouring srgb codes
+	const uint8_t* linear_to_srgb_table()
+	{
+		static const std::vector<uint8_t> table = []() {
+			std::vector<uint8_t> values(65536);
+			int code = 0;
+			float threshold = srgb_to_linear(0.5f / 255.0f);
+			for (int i = 0; i < 65536; i++) {
+				const float v = i / 65535.0f;
+				while (code < 255 && v >= threshold) {
+					code++;
+					threshold = srgb_to_linear((code + 0.5f) / 255.0f);
+				}
+				values[i] = static_cast<uint8_t>(code);
+			}
+			return values;
+		}();
+		return table.data();
+	}
+
+	//modified bessel function of the first kind, order 0
+	float bessel_i0(float x)
+	{
+		float sum = 1.0f;
+		float term = 1.0f;
+		const float halfSquared = x * x * 0.25f;
+		for (int k = 1; k < 32 && term > sum * 1e-8f; k++) {
+			term *= halfSquared / float(k * k);
+			sum += term;
+		}
+		return sum;
+	}
+
+	float kaiser_sinc(float t)
+	{
+		if (std::abs(t) >= KAISER_RADIUS) {
+			return 0.0f;
+		}
+		const float x = t / KAISER_RADIUS;
+		const float window = bessel_i0(KAISER_ALPHA * std::sqrt(1.0f - x * x)) / bessel_i0(KAISER_ALPHA);
+		const float pt = 3.14159265f * t;
+		return (std::abs(t) < 1e-6f ? 1.0f : std::sin(pt) / pt) * window;
+	}
+
+	//edge texels are clamped, so taps falling outside the image add their weight to the border texel
+	Kernel build_kernel(uint32_t srcSize, uint32_t dstSize, MipFilter filter)
+	{
+		const float scale = float(srcSize) / float(dstSize);
+		const float support = filter == MipFilter::Box ? scale * 0.5f : KAISER_RADIUS * scale;
+		std::vector<uint32_t> first(dstSize);
+		std::vector<std::vector<float>> spans(dstSize);
+		Kernel kernel;
+		for (uint32_t x = 0; x < dstSize; x++) {
+			const float center = (x + 0.5f) * scale;
+			const int begin = static_cast<int>(std::floor(center - support));
+			const int end = static_cast<int>(std::ceil(center + support));
+			const int lo = std::clamp(begin, 0, int(srcSize) - 1);
+			const int hi = std::clamp(end, 0, int(srcSize) - 1);
+			std::vector<float> span(hi - lo + 1, 0.0f);
+			for (int i = begin; i <= end; i++) {
+				float weight;
+				if (filter == MipFilter::Box) {
+					//the part of texel i inside the footprint
+					weight = std::max(0.0f, std::min(i + 1.0f, center + support) - std::max(float(i), center - support));
+				}
+				else {
+					weight = kaiser_sinc((i + 0.5f - center) / scale);
+				}
+				span[std::clamp(i, 0, int(srcSize) - 1) - lo] += weight;
+			}
+			//drop zero weights at both ends to keep the tap count down
+			size_t spanBegin = 0, spanEnd = span.size();
+			while (spanEnd - spanBegin > 1 && span[spanBegin] == 0.0f) {
+				spanBegin++;
+			}
+			while (spanEnd - spanBegin > 1 && span[spanEnd - 1] == 0.0f) {
+				spanEnd--;
+			}
+			float sum = 0.0f;
+			for (size_t i = spanBegin; i < spanEnd; i++) {
+				sum += span[i];
+			}
+			spans[x].assign(span.begin() + spanBegin, span.begin() + spanEnd);
+			for (float& weight : spans[x]) {
+				weight /= sum;
+			}
+			first[x] = static_cast<uint32_t>(lo + spanBegin);
+			kernel.taps = std::max(kernel.taps, static_cast<uint32_t>(spans[x].size()));
+		}
+		//same tap count everywhere so the loops have no per texel bounds, short spans are padded with zeros
+		kernel.start.resize(dstSize);
+		kernel.weights.assign(size_t(dstSize) * kernel.taps, 0.0f);
+		for (uint32_t x = 0; x < dstSize; x++) {
+			kernel.start[x] = std::min(first[x], srcSize - kernel.taps);
+			std::copy(spans[x].begin(), spans[x].end(), kernel.weights.begin() + size_t(x) * kernel.taps + (first[x] - kernel.start[x]));
+		}
+		return kernel;
+	}
+
+	//horizontal pass: one RGBA texel per output, summed over the kernel taps
+	void filter_row_scalar(const float* src, float* dst, const Kernel& kernel)
+	{
+		for (size_t x = 0; x < kernel.start.size(); x++) {
+			const float* weights = kernel.weights.data() + x * kernel.taps;
+			const float* texel = src + size_t(kernel.start[x]) * 4;
+			float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (uint32_t t = 0; t < kernel.taps; t++) {
+				for (int c = 0; c < 4; c++) {
+					sum[c] += weights[t] * texel[t * 4 + c];
+				}
+			}
+			memcpy(dst + x * 4, sum, sizeof(sum));
+		}
+	}
+
+	//vertical pass: dst = sum of weights[t] * rows[t], over whole rows of floats
+	void blend_rows_scalar(const float* const* rows, const float* weights, uint32_t taps, float* dst, size_t count)
+	{
+		for (size_t i = 0; i < count; i++) {
+			float sum = 0.0f;
+			for (uint32_t t = 0; t < taps; t++) {
+				sum += weights[t] * rows[t][i];
+			}
+			dst[i] = sum;
+		}
+	}
+
+#ifdef MIP_SSE
+	//an RGBA texel is exactly one register
+	void filter_row_sse(const float* src, float* dst, const Kernel& kernel)
+	{
+		for (size_t x = 0; x < kernel.start.size(); x++) {
+			const float* weights = kernel.weights.data() + x * kernel.taps;
+			const float* texel = src + size_t(kernel.start[x]) * 4;
+			__m128 sum = _mm_setzero_ps();
+			for (uint32_t t = 0; t < kernel.taps; t++) {
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(texel + t * 4)));
+			}
+			_mm_storeu_ps(dst + x * 4, sum);
+		}
+	}
+
+	void blend_rows_sse(const float* const* rows, const float* weights, uint32_t taps, float* dst, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4) {
+			__m128 sum = _mm_setzero_ps();
+			for (uint32_t t = 0; t < taps; t++) {
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(rows[t] + i)));
+			}
+			_mm_storeu_ps(dst + i, sum);
+		}
+		for (; i < count; i++) {
+			float sum = 0.0f;
+			for (uint32_t t = 0; t < taps; t++) {
+				sum += weights[t] * rows[t][i];
+			}
+			dst[i] = sum;
+		}
+	}
+#endif
+
+#ifdef MIP_AVX2
+	void filter_row_avx2(const float* src, float* dst, const Kernel& kernel)
+	{
+		vkutil::avx2::filter_row(src, dst, kernel.start.data(), kernel.weights.data(), kernel.taps, kernel.start.size());
+	}
+
+	//AVX2 in the cpu and in the os saved register state, and the kernels built with it
+	bool avx2_available()
+	{
+		static const bool available = []() {
+			if (!vkutil::avx2::kernels_compiled()) {
+				return false;
+			}
+#ifdef _MSC_VER
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] < 7) {
+				return false;
+			}
+			__cpuid(info, 1);
+			const bool osxsave = (info[2] & (1 << 27)) != 0;
+			const bool avx = (info[2] & (1 << 28)) != 0;
+			if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+				return false;
+			}
+			__cpuidex(info, 7, 0);
+			return (info[1] & (1 << 5)) != 0;
+#else
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx2") != 0;
+#endif
+		}();
+		return available;
+	}
+#endif
+
+#ifdef MIP_NEON
+	void filter_row_neon(const float* src, float* dst, const Kernel& kernel)
+	{
+		for (size_t x = 0; x < kernel.start.size(); x++) {
+			const float* weights = kernel.weights.data() + x * kernel.taps;
+			const float* texel = src + size_t(kernel.start[x]) * 4;
+			float32x4_t sum = vdupq_n_f32(0.0f);
+			for (uint32_t t = 0; t < kernel.taps; t++) {
+				sum = vaddq_f32(sum, vmulq_n_f32(vld1q_f32(texel + t * 4), weights[t]));
+			}
+			vst1q_f32(dst + x * 4, sum);
+		}
+	}
+
+	void blend_rows_neon(const float* const* rows, const float* weights, uint32_t taps, float* dst, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4) {
+			float32x4_t sum = vdupq_n_f32(0.0f);
+			for (uint32_t t = 0; t < taps; t++) {
+				sum = vaddq_f32(sum, vmulq_n_f32(vld1q_f32(rows[t] + i), weights[t]));
+			}
+			vst1q_f32(dst + i, sum);
+		}
+		for (; i < count; i++) {
+			float sum = 0.0f;
+			for (uint32_t t = 0; t < taps; t++) {
+				sum += weights[t] * rows[t][i];
+			}
+			dst[i] = sum;
+		}
+	}
+#endif
+
+	using FilterRowFn = void(*)(const float* src, float* dst, const Kernel& kernel);
+	using BlendRowsFn = void(*)(const float* const* rows, const float* weights, uint32_t taps, float* dst, size_t count);
+
+	void select_path(SimdPath path, FilterRowFn& filterRow, BlendRowsFn& blendRows)
+	{
+		filterRow = filter_row_scalar;
+		blendRows = blend_rows_scalar;
+		switch (path) {
+#ifdef MIP_SSE
+		case SimdPath::SSE:
+			filterRow = filter_row_sse;
+			blendRows = blend_rows_sse;
+			break;
+#endif
+#ifdef MIP_AVX2
+		case SimdPath::AVX2:
+			filterRow = filter_row_avx2;
+			blendRows = vkutil::avx2::blend_rows;
+			break;
+#endif
+#ifdef MIP_NEON
+		case SimdPath::NEON:
+			filterRow = filter_row_neon;
+			blendRows = blend_rows_neon;
+			break;
+#endif
+		default:
+			break;
+		}
+	}
+
+	//fp32 texels back to bytes, out of range kaiser overshoot is clamped
+	void store_row(const float* src, uint8_t* dst, size_t texels, bool srgb)
+	{
+		const uint8_t* toSrgb = linear_to_srgb_table();
+		for (size_t i = 0; i < texels * 4; i++) {
+			const float v = std::min(std::max(src[i], 0.0f), 1.0f);
+			dst[i] = (srgb && (i & 3) != 3) ? toSrgb[static_cast<uint32_t>(v * 65535.0f + 0.5f)]
+				: static_cast<uint8_t>(v * 255.0f + 0.5f);
+		}
+	}
+}
+
+uint32_t vkutil::mip_level_count(uint32_t width, uint32_t height)
+{
+	uint32_t levels = 1;
+	for (uint32_t size = std::max(width, height); size > 1; size >>= 1) {
+		levels++;
+	}
+	return levels;
+}
+
+size_t vkutil::mip_chain_size(uint32_t width, uint32_t height)
+{
+	size_t size = 0;
+	for (uint32_t i = 0; i < mip_level_count(width, height); i++) {
+		size += size_t(std::max(1u, width >> i)) * std::max(1u, height >> i) * 4;
+	}
+	return size;
+}
+
+SimdPath vkutil::best_simd_path()
+{
+#ifdef MIP_AVX2
+	if (avx2_available()) {
+		return SimdPath::AVX2;
+	}
+#endif
+#if defined(MIP_SSE)
+	return SimdPath::SSE;
+#elif defined(MIP_NEON)
+	return SimdPath::NEON;
+#else
+	return SimdPath::Scalar;
+#endif
+}
+
+bool vkutil::simd_path_supported(SimdPath path)
+{
+	switch (path) {
+	case SimdPath::Scalar:
+		return true;
+#ifdef MIP_SSE
+	case SimdPath::SSE:
+		return true;
+#endif
+#ifdef MIP_AVX2
+	case SimdPath::AVX2:
+		return avx2_available();
+#endif
+#ifdef MIP_NEON
+	case SimdPath::NEON:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+const char* vkutil::simd_path_name(SimdPath path)
+{
+	switch (path) {
+	case SimdPath::SSE: return "SSE";
+	case SimdPath::AVX2: return "AVX2";
+	case SimdPath::NEON: return "NEON";
+	default: return "scalar";
+	}
+}
+
+const char* vkutil::mip_filter_name(MipFilter filter)
+{
+	return filter == MipFilter::Kaiser ? "kaiser" : "box";
+}
+
+void vkutil::generate_mips(const uint8_t* rgba, uint32_t width, uint32_t height, bool srgb, MipFilter filter,
+	ThreadPool& pool, MipChain& outChain, SimdPath path)
+{
+	outChain.width = width;
+	outChain.height = height;
+	const uint32_t levelCount = mip_level_count(width, height);
+	outChain.levelOffsets.resize(levelCount);
+	size_t totalSize = 0;
+	for (uint32_t i = 0; i < levelCount; i++) {
+		outChain.levelOffsets[i] = totalSize;
+		totalSize += outChain.level_size(i);
+	}
+	outChain.pixels.resize(totalSize);
+	memcpy(outChain.pixels.data(), rgba, outChain.level_size(0));
+	generate_mips_in_place(outChain.pixels.data(), width, height, srgb, filter, pool, path);
+}
+
+void vkutil::generate_mips_in_place(uint8_t* levels, uint32_t width, uint32_t height, bool srgb, MipFilter filter,
+	ThreadPool& pool, SimdPath path)
+{
+	FilterRowFn filterRow;
+	BlendRowsFn blendRows;
+	select_path(simd_path_supported(path) ? path : SimdPath::Scalar, filterRow, blendRows);
+
+	const uint32_t levelCount = mip_level_count(width, height);
+	if (levelCount == 1) {
+		return;
+	}
+	const uint8_t* rgba = levels;
+	uint8_t* levelBytes = levels;
+
+	const float* toLinear = srgb_to_linear_table();
+	//level 0 stays in bytes and is converted a row at a time, every later level is kept in linear fp32
+	std::vector<float> level;
+	std::vector<float> next;
+	uint32_t srcWidth = width;
+	uint32_t srcHeight = height;
+	for (uint32_t l = 1; l < levelCount; l++) {
+		const uint32_t dstWidth = std::max(1u, width >> l);
+		const uint32_t dstHeight = std::max(1u, height >> l);
+		const Kernel kernelX = build_kernel(srcWidth, dstWidth, filter);
+		const Kernel kernelY = build_kernel(srcHeight, dstHeight, filter);
+		next.resize(size_t(dstWidth) * dstHeight * 4);
+		levelBytes += size_t(srcWidth) * srcHeight * 4;
+
+		//destination rows go in blocks, each narrowing only the source rows it reads into a small buffer,
+		//so the row pass result stays in cache instead of making a round trip through memory
+		pool.parallel_for(dstHeight, MIP_BLOCK_ROWS, [&](size_t begin, size_t end) {
+			std::vector<float> sourceRow(l == 1 ? size_t(srcWidth) * 4 : 0);
+			std::vector<float> block;
+			std::vector<const float*> rows(kernelY.taps);
+			for (size_t blockBegin = begin; blockBegin < end; blockBegin += MIP_BLOCK_ROWS) {
+				const size_t blockEnd = std::min(end, blockBegin + MIP_BLOCK_ROWS);
+				//start only grows with the row, so the block reads one contiguous run of source rows
+				const size_t firstRow = kernelY.start[blockBegin];
+				const size_t lastRow = size_t(kernelY.start[blockEnd - 1]) + kernelY.taps;
+				block.resize((lastRow - firstRow) * dstWidth * 4);
+				for (size_t r = firstRow; r < lastRow; r++) {
+					const float* src = sourceRow.data();
+					if (l == 1) {
+						const uint8_t* bytes = rgba + r * srcWidth * 4;
+						for (size_t i = 0; i < size_t(srcWidth) * 4; i++) {
+							sourceRow[i] = (srgb && (i & 3) != 3) ? toLinear[bytes[i]] : bytes[i] / 255.0f;
+						}
+					}
+					else {
+						src = level.data() + r * srcWidth * 4;
+					}
+					filterRow(src, block.data() + (r - firstRow) * dstWidth * 4, kernelX);
+				}
+				for (size_t y = blockBegin; y < blockEnd; y++) {
+					for (uint32_t t = 0; t < kernelY.taps; t++) {
+						rows[t] = block.data() + (kernelY.start[y] + t - firstRow) * dstWidth * 4;
+					}
+					float* dstRow = next.data() + y * dstWidth * 4;
+					blendRows(rows.data(), kernelY.weights.data() + y * kernelY.taps, kernelY.taps, dstRow, size_t(dstWidth) * 4);
+					store_row(dstRow, levelBytes + y * dstWidth * 4, dstWidth, srgb);
+				}
+			}
+		});
+
+		level.swap(next);
+		srcWidth = dstWidth;
+		srcHeight = dstHeight;
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+#ifndef MIP_GENERATOR_H
+#define MIP_GENERATOR_H
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+
+class ThreadPool;
+
+//downsampling filter of the cpu mip generator
+enum class MipFilter : uint32_t {
+	//average of the covered texels, cheap and soft
+	Box = 0,
+	//kaiser windowed sinc over 3 destination texels, keeps detail but can ring a little
+	Kaiser = 1,
+};
+
+//instruction set the filter loops run with, only paths compiled into the binary can be picked
+//AVX2 lives in mip_generator_avx2.cpp and is only picked when the cpu reports it at runtime
+enum class SimdPath : uint32_t {
+	Scalar = 0,
+	SSE = 1,
+	AVX2 = 2,
+	NEON = 3,
+};
+
+//RGBA8 image and every level of its mip chain, back to back largest first,
+//laid out the way the staging buffer and the cooked asset sections want them
+struct MipChain {
+	uint32_t width{ 0 };
+	uint32_t height{ 0 };
+	std::vector<uint8_t> pixels;
+	//byte offset of every level in pixels
+	std::vector<size_t> levelOffsets;
+
+	uint32_t level_count() const { return static_cast<uint32_t>(levelOffsets.size()); }
+	uint32_t level_width(uint32_t level) const { return std::max(1u, width >> level); }
+	uint32_t level_height(uint32_t level) const { return std::max(1u, height >> level); }
+	size_t level_size(uint32_t level) const { return size_t(level_width(level)) * level_height(level) * 4; }
+	const uint8_t* level_data(uint32_t level) const { return pixels.data() + levelOffsets[level]; }
+};
+
+namespace vkutil {
+	//full chain length down to 1x1
+	uint32_t mip_level_count(uint32_t width, uint32_t height);
+
+	//widest path compiled in, what generate_mips uses by default
+	SimdPath best_simd_path();
+	bool simd_path_supported(SimdPath path);
+	const char* simd_path_name(SimdPath path);
+	const char* mip_filter_name(MipFilter filter);
+
+	//bytes of the whole chain of a width x height RGBA8 image, levels back to back like MipChain::pixels
+	size_t mip_chain_size(uint32_t width, uint32_t height);
+
+	//build the whole chain of a width x height RGBA8 image, level 0 is copied as is
+	//each level is filtered from the one above in fp32, separable (rows then columns), split by rows over the pool
+	//srgb filters rgb in linear light and converts back, alpha is always linear
+	void generate_mips(const uint8_t* rgba, uint32_t width, uint32_t height, bool srgb, MipFilter filter,
+		ThreadPool& pool, MipChain& outChain, SimdPath path = best_simd_path());
+	//same chain written in place: levels holds mip_chain_size bytes with level 0 already at its start,
+	//so an image decoded straight into staging memory gets its levels without a copy of level 0
+	void generate_mips_in_place(uint8_t* levels, uint32_t width, uint32_t height, bool srgb, MipFilter filter,
+		ThreadPool& pool, SimdPath path = best_simd_path());
+}
+#endif // !MIP_GENERATOR_H
@@ -0,0 +1,71 @@
+#include "mip_generator_avx2.h"
+
+//src/CMakeLists.txt builds this file alone with /arch:AVX2 or -mavx2, without them the kernels compile to nothing
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+bool vkutil::avx2::kernels_compiled()
+{
+	return true;
+}
+
+//two output texels per register, each half reading its own taps
+void vkutil::avx2::filter_row(const float* src, float* dst, const uint32_t* start, const float* weights, uint32_t taps, size_t count)
+{
+	size_t x = 0;
+	for (; x + 2 <= count; x += 2) {
+		const float* weights0 = weights + x * taps;
+		const float* weights1 = weights0 + taps;
+		const float* texel0 = src + size_t(start[x]) * 4;
+		const float* texel1 = src + size_t(start[x + 1]) * 4;
+		__m256 sum = _mm256_setzero_ps();
+		for (uint32_t t = 0; t < taps; t++) {
+			const __m256 texels = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(texel0 + t * 4)), _mm_loadu_ps(texel1 + t * 4), 1);
+			const __m256 weight = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(weights0[t])), _mm_set1_ps(weights1[t]), 1);
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(weight, texels));
+		}
+		_mm256_storeu_ps(dst + x * 4, sum);
+	}
+	for (; x < count; x++) {
+		const float* texelWeights = weights + x * taps;
+		const float* texel = src + size_t(start[x]) * 4;
+		__m128 sum = _mm_setzero_ps();
+		for (uint32_t t = 0; t < taps; t++) {
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(texelWeights[t]), _mm_loadu_ps(texel + t * 4)));
+		}
+		_mm_storeu_ps(dst + x * 4, sum);
+	}
+}
+
+void vkutil::avx2::blend_rows(const float* const* rows, const float* weights, uint32_t taps, float* dst, size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 sum = _mm256_setzero_ps();
+		for (uint32_t t = 0; t < taps; t++) {
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[t]), _mm256_loadu_ps(rows[t] + i)));
+		}
+		_mm256_storeu_ps(dst + i, sum);
+	}
+	for (; i < count; i++) {
+		float sum = 0.0f;
+		for (uint32_t t = 0; t < taps; t++) {
+			sum += weights[t] * rows[t][i];
+		}
+		dst[i] = sum;
+	}
+}
+#else
+bool vkutil::avx2::kernels_compiled()
+{
+	return false;
+}
+
+void vkutil::avx2::filter_row(const float*, float*, const uint32_t*, const float*, uint32_t, size_t)
+{
+}
+
+void vkutil::avx2::blend_rows(const float* const*, const float*, uint32_t, float*, size_t)
+{
+}
+#endif
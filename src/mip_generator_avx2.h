@@ -0,0 +1,19 @@
+#pragma once
+#ifndef MIP_GENERATOR_AVX2_H
+#define MIP_GENERATOR_AVX2_H
+#include <cstddef>
+#include <cstdint>
+
+//AVX2 filter loops of mip_generator.cpp, kept in their own translation unit so only it is built with AVX2 code generation
+//mip_generator.cpp calls them only after checking the cpu at runtime
+namespace vkutil {
+	namespace avx2 {
+		//false when this file was built without AVX2 code generation or for a cpu family without it
+		bool kernels_compiled();
+
+		//count destination texels, each one taps weights dotted with taps texels of src from start[x]
+		void filter_row(const float* src, float* dst, const uint32_t* start, const float* weights, uint32_t taps, size_t count);
+		void blend_rows(const float* const* rows, const float* weights, uint32_t taps, float* dst, size_t count);
+	}
+}
+#endif // !MIP_GENERATOR_AVX2_H
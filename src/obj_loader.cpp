@@ -0,0 +1,441 @@
+#include "obj_loader.h"
+#include <asset_loader.h>
+#include <thread_pool.h>
+#include <tiny_obj_loader.h>
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <unordered_map>
+#include <map>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+namespace {
+	//powers of ten that are exact in a double, anything beyond falls back to std::pow
+	const double exactPowers[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	//per chunk results, indices are global except the slots listed in relative
+	struct ObjChunk {
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec2> texcoords;
+		std::vector<assets::ObjIndex> corners;
+		//corner * 3 + attribute of negative indices, stored relative to the chunk start
+		std::vector<uint32_t> relative;
+		//usemtl lines as (first local triangle, name), triangles before the first one
+		//continue the material of the previous chunk
+		std::vector<std::pair<uint32_t, std::string>> materialRuns;
+		std::vector<std::string> libraries;
+		//first malformed line, nullptr when the chunk parsed cleanly
+		const char* error{ nullptr };
+	};
+
+	inline bool is_space(char c)
+	{
+		return c == ' ' || c == '\t';
+	}
+
+	inline const char* skip_spaces(const char* p, const char* end)
+	{
+		while (p < end && is_space(*p)) {
+			p++;
+		}
+		return p;
+	}
+
+	inline const char* skip_line(const char* p, const char* end)
+	{
+		const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+		return newline ? newline + 1 : end;
+	}
+
+	inline const char* parse_int(const char* p, const char* end, int32_t& outValue)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative = *p == '-';
+			p++;
+		}
+		const char* digits = p;
+		int64_t value = 0;
+		while (p < end && *p >= '0' && *p <= '9' && value < INT32_MAX) {
+			value = value * 10 + (*p - '0');
+			p++;
+		}
+		if (p == digits || value >= INT32_MAX) {
+			return nullptr;
+		}
+		outValue = static_cast<int32_t>(negative ? -value : value);
+		return p;
+	}
+
+	//obj indices are 1 based, negative ones count back from the last element declared so far
+	//and may point into an earlier chunk, those stay chunk relative until the merge
+	inline bool resolve_index(int32_t value, size_t localCount, int32_t& outIndex, bool& outRelative)
+	{
+		outRelative = value < 0;
+		outIndex = value > 0 ? value - 1 : static_cast<int32_t>(localCount) + value;
+		return value != 0;
+	}
+
+	//rest of the line without the trailing whitespace, names may contain spaces
+	inline std::string line_argument(const char* p, const char* end)
+	{
+		p = skip_spaces(p, end);
+		if (p >= end) {
+			return std::string();
+		}
+		const char* lineEnd = static_cast<const char*>(memchr(p, '\n', size_t(end - p)));
+		lineEnd = lineEnd ? lineEnd : end;
+		while (lineEnd > p && (is_space(lineEnd[-1]) || lineEnd[-1] == '\r')) {
+			lineEnd--;
+		}
+		return std::string(p, lineEnd);
+	}
+
+	inline bool starts_with_keyword(const char* line, const char* end, const char* keyword, size_t length)
+	{
+		return size_t(end - line) > length && memcmp(line, keyword, length) == 0 && is_space(line[length]);
+	}
+
+	void parse_chunk(const char* p, const char* end, ObjChunk& chunk)
+	{
+		//corners of the current polygon, with a bit per attribute that is chunk relative
+		std::vector<assets::ObjIndex> polygon;
+		std::vector<uint8_t> polygonRelative;
+		while (p < end) {
+			const char* line = skip_spaces(p, end);
+			if (end - line < 2 || (line[0] != 'v' && line[0] != 'f')) {
+				if (starts_with_keyword(line, end, "usemtl", 6)) {
+					chunk.materialRuns.emplace_back(static_cast<uint32_t>(chunk.corners.size() / 3), line_argument(line + 6, end));
+				}
+				else if (starts_with_keyword(line, end, "mtllib", 6)) {
+					chunk.libraries.push_back(line_argument(line + 6, end));
+				}
+				p = skip_line(line, end);
+				continue;
+			}
+
+			if (line[0] == 'v') {
+				int components = 3;
+				float* target = nullptr;
+				if (is_space(line[1])) {
+					chunk.positions.emplace_back();
+					target = &chunk.positions.back().x;
+				}
+				else if (line[1] == 'n' && end - line > 2 && is_space(line[2])) {
+					chunk.normals.emplace_back();
+					target = &chunk.normals.back().x;
+				}
+				else if (line[1] == 't' && end - line > 2 && is_space(line[2])) {
+					chunk.texcoords.emplace_back();
+					target = &chunk.texcoords.back().x;
+					components = 2;
+				}
+				else {
+					//vp and friends
+					p = skip_line(line, end);
+					continue;
+				}
+				p = line + (is_space(line[1]) ? 1 : 2);
+				for (int i = 0; i < components; i++) {
+					p = assets::parse_float(skip_spaces(p, end), end, target[i]);
+					if (!p) {
+						chunk.error = line;
+						return;
+					}
+				}
+				//extra values (w, vertex colors) are ignored
+				p = skip_line(p, end);
+				continue;
+			}
+			if (!is_space(line[1])) {
+				p = skip_line(line, end);
+				continue;
+			}
+
+			//face: "v", "v/vt", "v//vn" or "v/vt/vn" per corner
+			polygon.clear();
+			polygonRelative.clear();
+			p = line + 1;
+			for (;;) {
+				p = skip_spaces(p, end);
+				if (p >= end || *p == '\n' || *p == '\r' || *p == '#') {
+					break;
+				}
+				assets::ObjIndex corner = { -1, -1, -1 };
+				uint8_t relative = 0;
+				bool isRelative;
+				int32_t value;
+				if (!(p = parse_int(p, end, value)) || !resolve_index(value, chunk.positions.size(), corner.position, isRelative)) {
+					chunk.error = line;
+					return;
+				}
+				relative |= isRelative ? 1 : 0;
+				if (p < end && *p == '/') {
+					p++;
+					if (p < end && *p != '/') {
+						if (!(p = parse_int(p, end, value)) || !resolve_index(value, chunk.texcoords.size(), corner.texcoord, isRelative)) {
+							chunk.error = line;
+							return;
+						}
+						relative |= isRelative ? 2 : 0;
+					}
+					if (p < end && *p == '/') {
+						p++;
+						if (!(p = parse_int(p, end, value)) || !resolve_index(value, chunk.normals.size(), corner.normal, isRelative)) {
+							chunk.error = line;
+							return;
+						}
+						relative |= isRelative ? 4 : 0;
+					}
+				}
+				polygon.push_back(corner);
+				polygonRelative.push_back(relative);
+			}
+			if (polygon.size() < 3) {
+				chunk.error = line;
+				return;
+			}
+			//fan triangulation, the same as tinyobj does for convex polygons
+			auto emit = [&](size_t i) {
+				for (uint32_t attribute = 0; attribute < 3; attribute++) {
+					if (polygonRelative[i] & (1 << attribute)) {
+						chunk.relative.push_back(static_cast<uint32_t>(chunk.corners.size()) * 3 + attribute);
+					}
+				}
+				chunk.corners.push_back(polygon[i]);
+			};
+			for (size_t i = 2; i < polygon.size(); i++) {
+				emit(0);
+				emit(i - 1);
+				emit(i);
+			}
+			p = skip_line(p, end);
+		}
+	}
+}
+
+const char* assets::parse_float(const char* p, const char* end, float& outValue)
+{
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+	//up to 19 significant digits fit in the mantissa, later ones only shift the exponent
+	uint64_t mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	bool any = false;
+	while (p < end && *p >= '0' && *p <= '9') {
+		if (digits < 19) {
+			mantissa = mantissa * 10 + (*p - '0');
+			digits += mantissa != 0 ? 1 : 0;
+		}
+		else {
+			exponent++;
+		}
+		any = true;
+		p++;
+	}
+	if (p < end && *p == '.') {
+		p++;
+		while (p < end && *p >= '0' && *p <= '9') {
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				digits += mantissa != 0 ? 1 : 0;
+				exponent--;
+			}
+			any = true;
+			p++;
+		}
+	}
+	if (!any) {
+		return nullptr;
+	}
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		int32_t power;
+		const char* afterExponent = parse_int(p + 1, end, power);
+		if (afterExponent) {
+			exponent += power;
+			p = afterExponent;
+		}
+	}
+
+	double value = static_cast<double>(mantissa);
+	if (exponent < 0) {
+		value = -exponent <= 22 ? value / exactPowers[-exponent] : value * std::pow(10.0, exponent);
+	}
+	else if (exponent > 0) {
+		value = exponent <= 22 ? value * exactPowers[exponent] : value * std::pow(10.0, exponent);
+	}
+	outValue = static_cast<float>(negative ? -value : value);
+	return p;
+}
+
+bool assets::parse_obj(const char* path, ObjData& outData, ThreadPool& pool)
+{
+	MappedFile file;
+	if (!file.open(path)) {
+		std::cerr << "Failed to open obj file " << path << std::endl;
+		return false;
+	}
+	const char* begin = file.data();
+	const char* end = begin + file.size();
+
+	//a few chunks per worker so a chunk full of faces doesn't hold up the rest, but not tiny ones
+	const size_t minChunkSize = 1 << 20;
+	const size_t chunkCount = std::max<size_t>(1, std::min(file.size() / minChunkSize, pool.thread_count() * 4));
+	std::vector<const char*> bounds(chunkCount + 1, end);
+	bounds[0] = begin;
+	for (size_t i = 1; i < chunkCount; i++) {
+		//move every split forward to the start of the next line
+		const char* split = std::max(bounds[i - 1], begin + file.size() / chunkCount * i);
+		bounds[i] = split == begin ? begin : skip_line(split - 1, end);
+	}
+
+	std::vector<ObjChunk> chunks(chunkCount);
+	pool.parallel_for(chunkCount, 1, [&](size_t first, size_t last) {
+		for (size_t i = first; i < last; i++) {
+			parse_chunk(bounds[i], bounds[i + 1], chunks[i]);
+		}
+	});
+
+	//chunk start offsets into the merged arrays
+	struct ChunkBase {
+		size_t position, normal, texcoord, corner;
+	};
+	std::vector<ChunkBase> bases(chunkCount + 1, ChunkBase{});
+	for (size_t i = 0; i < chunkCount; i++) {
+		if (chunks[i].error) {
+			const char* lineEnd = static_cast<const char*>(memchr(chunks[i].error, '\n', end - chunks[i].error));
+			std::cerr << "Malformed line in " << path << ": "
+				<< std::string(chunks[i].error, lineEnd ? lineEnd : end) << std::endl;
+			return false;
+		}
+		bases[i + 1].position = bases[i].position + chunks[i].positions.size();
+		bases[i + 1].normal = bases[i].normal + chunks[i].normals.size();
+		bases[i + 1].texcoord = bases[i].texcoord + chunks[i].texcoords.size();
+		bases[i + 1].corner = bases[i].corner + chunks[i].corners.size();
+	}
+	const ChunkBase& total = bases[chunkCount];
+	if (total.corner > size_t(INT32_MAX) || total.position > size_t(INT32_MAX)) {
+		std::cerr << "Obj file " << path << " is too large" << std::endl;
+		return false;
+	}
+
+	//materials from every mtllib, in file order, then ids for the usemtl names
+	outData.materials.clear();
+	std::unordered_map<std::string, int32_t> materialIds;
+	const std::filesystem::path folder = std::filesystem::path(path).parent_path();
+	for (const ObjChunk& chunk : chunks) {
+		for (const std::string& library : chunk.libraries) {
+			std::ifstream stream(folder / library);
+			if (!stream.is_open()) {
+				std::cout << "Material library " << library << " of " << path << " not found" << std::endl;
+				continue;
+			}
+			std::map<std::string, int> materialMap;
+			std::vector<tinyobj::material_t> materials;
+			std::string warn, err;
+			tinyobj::LoadMtl(&materialMap, &materials, &stream, &warn, &err);
+			for (const tinyobj::material_t& material : materials) {
+				if (materialIds.count(material.name)) {
+					continue;
+				}
+				ObjMaterial entry;
+				entry.name = material.name;
+				entry.diffuse = glm::vec3(material.diffuse[0], material.diffuse[1], material.diffuse[2]);
+				if (!material.diffuse_texname.empty()) {
+					entry.diffuseTexture = (folder / material.diffuse_texname).generic_string();
+				}
+				materialIds[entry.name] = static_cast<int32_t>(outData.materials.size());
+				outData.materials.push_back(entry);
+			}
+		}
+	}
+	//material of the first triangle of every chunk, carried over from the chunks before it
+	std::vector<std::vector<int32_t>> runIds(chunkCount);
+	std::vector<int32_t> inherited(chunkCount, -1);
+	for (size_t i = 0; i < chunkCount; i++) {
+		for (const auto& run : chunks[i].materialRuns) {
+			auto found = materialIds.find(run.second);
+			if (found == materialIds.end()) {
+				ObjMaterial entry;
+				entry.name = run.second;
+				found = materialIds.emplace(run.second, static_cast<int32_t>(outData.materials.size())).first;
+				outData.materials.push_back(entry);
+			}
+			runIds[i].push_back(found->second);
+		}
+		if (i + 1 < chunkCount) {
+			inherited[i + 1] = runIds[i].empty() ? inherited[i] : runIds[i].back();
+		}
+	}
+
+	//size everything once, then every chunk copies into its own slice
+	outData.triangleMaterials.resize(total.corner / 3);
+	outData.positions.resize(total.position);
+	outData.normals.resize(total.normal);
+	outData.texcoords.resize(total.texcoord);
+	outData.corners.resize(total.corner);
+	std::vector<uint8_t> outOfRange(chunkCount, 0);
+	pool.parallel_for(chunkCount, 1, [&](size_t first, size_t last) {
+		for (size_t i = first; i < last; i++) {
+			ObjChunk& chunk = chunks[i];
+			const ChunkBase& base = bases[i];
+			std::copy(chunk.positions.begin(), chunk.positions.end(), outData.positions.begin() + base.position);
+			std::copy(chunk.normals.begin(), chunk.normals.end(), outData.normals.begin() + base.normal);
+			std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), outData.texcoords.begin() + base.texcoord);
+
+			ObjIndex* corners = &outData.corners[base.corner];
+			std::copy(chunk.corners.begin(), chunk.corners.end(), corners);
+			const int32_t attributeBase[3] = {
+				static_cast<int32_t>(base.position), static_cast<int32_t>(base.texcoord), static_cast<int32_t>(base.normal)
+			};
+			for (uint32_t slot : chunk.relative) {
+				int32_t& index = (&corners[slot / 3].position)[slot % 3];
+				index += attributeBase[slot % 3];
+				//-1 marks a missing attribute, an index pointing before the first element must not turn into one
+				if (index < 0) {
+					outOfRange[i] = 1;
+				}
+			}
+
+			int32_t* triangleMaterials = &outData.triangleMaterials[base.corner / 3];
+			const uint32_t triangleCount = static_cast<uint32_t>(chunk.corners.size() / 3);
+			int32_t material = inherited[i];
+			uint32_t triangle = 0;
+			for (size_t run = 0; run <= chunk.materialRuns.size(); run++) {
+				const uint32_t runStart = run < chunk.materialRuns.size() ? chunk.materialRuns[run].first : triangleCount;
+				std::fill(triangleMaterials + triangle, triangleMaterials + runStart, material);
+				triangle = runStart;
+				material = run < chunk.materialRuns.size() ? runIds[i][run] : material;
+			}
+
+			const int32_t positionCount = static_cast<int32_t>(total.position);
+			const int32_t texcoordCount = static_cast<int32_t>(total.texcoord);
+			const int32_t normalCount = static_cast<int32_t>(total.normal);
+			for (size_t c = 0; c < chunk.corners.size(); c++) {
+				const ObjIndex& corner = corners[c];
+				if (corner.position < 0 || corner.position >= positionCount || corner.texcoord >= texcoordCount
+					|| corner.normal >= normalCount || corner.texcoord < -1 || corner.normal < -1) {
+					outOfRange[i] = 1;
+					break;
+				}
+			}
+			//free the chunk as soon as it is merged, peak memory is the merged arrays plus one copy
+			chunk = ObjChunk{};
+		}
+	});
+	if (std::find(outOfRange.begin(), outOfRange.end(), 1) != outOfRange.end()) {
+		std::cerr << "Obj file " << path << " has a face index out of range" << std::endl;
+		return false;
+	}
+	return true;
+}
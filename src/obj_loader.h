@@ -0,0 +1,48 @@
+#pragma once
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+class ThreadPool;
+
+namespace assets {
+	//one face corner, 0 based indices into the ObjData arrays, -1 when the corner has no such attribute
+	struct ObjIndex {
+		int32_t position;
+		int32_t texcoord;
+		int32_t normal;
+	};
+
+	//.mtl entry, names used by usemtl but missing from every library get a white untextured one
+	struct ObjMaterial {
+		std::string name;
+		glm::vec3 diffuse{ 1.0f };
+		//map_Kd joined with the obj folder, empty when untextured
+		std::string diffuseTexture;
+	};
+
+	//raw attribute arrays of an obj file, polygons are fan triangulated into corners (3 per triangle)
+	struct ObjData {
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec2> texcoords;
+		std::vector<ObjIndex> corners;
+		//index into materials per triangle, -1 before the first usemtl
+		std::vector<int32_t> triangleMaterials;
+		std::vector<ObjMaterial> materials;
+	};
+
+	//memory map the file, parse line aligned chunks on the pool and merge them into outData
+	//v/vt/vn/f, usemtl and mtllib are read, everything else (groups, smoothing) is skipped
+	//prints the first error and returns false on a missing or malformed file
+	bool parse_obj(const char* path, ObjData& outData, ThreadPool& pool);
+
+	//parse a float the way from_chars does (no locale, no allocation), returns the end of the number
+	//or nullptr when there is no number at p
+	const char* parse_float(const char* p, const char* end, float& outValue);
+}
+#endif // !OBJ_LOADER_H
@@ -0,0 +1,144 @@
+#include "range_allocator.h"
+#include <iostream>
+#include <algorithm>
+
+void RangeAllocator::reset(uint64_t capacity)
+{
+	_capacity = capacity;
+	_usedBytes = 0;
+	_allocationCount = 0;
+	_freeByOffset.clear();
+	_freeBySize.clear();
+	if (capacity > 0) {
+		insert_free(0, capacity);
+	}
+}
+
+bool RangeAllocator::allocate(uint64_t size, uint64_t alignment, RangeAllocation& outAllocation)
+{
+	if (size == 0) {
+		//empty meshes still get a valid range to hand back to free
+		outAllocation = RangeAllocation{ 0, 0 };
+		return true;
+	}
+	alignment = std::max<uint64_t>(alignment, 1);
+	//smallest ranges first, alignment padding can push the first candidates out
+	for (auto it = _freeBySize.lower_bound(size); it != _freeBySize.end(); ++it) {
+		const uint64_t rangeOffset = it->second;
+		const uint64_t rangeSize = it->first;
+		const uint64_t offset = (rangeOffset + alignment - 1) / alignment * alignment;
+		const uint64_t padding = offset - rangeOffset;
+		if (padding + size > rangeSize) {
+			continue;
+		}
+		erase_free(_freeByOffset.find(rangeOffset));
+		//the padding in front stays free and is merged back once a neighbour is freed
+		if (padding > 0) {
+			insert_free(rangeOffset, padding);
+		}
+		if (padding + size < rangeSize) {
+			insert_free(offset + size, rangeSize - padding - size);
+		}
+		_usedBytes += size;
+		_allocationCount++;
+		outAllocation = RangeAllocation{ offset, size };
+		return true;
+	}
+	return false;
+}
+
+void RangeAllocator::free(const RangeAllocation& allocation)
+{
+	if (allocation.size == 0) {
+		return;
+	}
+	uint64_t offset = allocation.offset;
+	uint64_t size = allocation.size;
+	_usedBytes -= size;
+	_allocationCount--;
+
+	//merge with the free ranges right after and right before
+	auto next = _freeByOffset.lower_bound(offset);
+	if (next != _freeByOffset.end() && next->first == offset + size) {
+		size += next->second;
+		next = std::next(next);
+		erase_free(std::prev(next));
+	}
+	if (next != _freeByOffset.begin()) {
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset) {
+			offset = previous->first;
+			size += previous->second;
+			erase_free(previous);
+		}
+	}
+	insert_free(offset, size);
+}
+
+RangeAllocatorStats RangeAllocator::stats() const
+{
+	RangeAllocatorStats stats;
+	stats.capacity = _capacity;
+	stats.usedBytes = _usedBytes;
+	stats.allocationCount = _allocationCount;
+	stats.freeRangeCount = static_cast<uint32_t>(_freeByOffset.size());
+	for (const auto& range : _freeByOffset) {
+		stats.freeBytes += range.second;
+	}
+	stats.largestFreeRange = _freeBySize.empty() ? 0 : _freeBySize.rbegin()->first;
+	return stats;
+}
+
+bool RangeAllocator::validate() const
+{
+	if (_freeByOffset.size() != _freeBySize.size()) {
+		std::cout << "Range allocator free lists differ in length" << std::endl;
+		return false;
+	}
+	uint64_t freeBytes = 0;
+	uint64_t previousEnd = 0;
+	bool first = true;
+	for (const auto& range : _freeByOffset) {
+		if (range.second == 0 || range.first + range.second > _capacity) {
+			std::cout << "Free range at " << range.first << " is empty or outside the capacity" << std::endl;
+			return false;
+		}
+		if (!first && range.first <= previousEnd) {
+			std::cout << "Free range at " << range.first << " overlaps or touches the one before" << std::endl;
+			return false;
+		}
+		//every range by offset has its twin by size
+		auto sized = _freeBySize.equal_range(range.second);
+		if (std::find_if(sized.first, sized.second, [&](const auto& entry) { return entry.second == range.first; }) == sized.second) {
+			std::cout << "Free range at " << range.first << " is missing from the size list" << std::endl;
+			return false;
+		}
+		freeBytes += range.second;
+		previousEnd = range.first + range.second;
+		first = false;
+	}
+	//alignment padding goes back to the free list, so every byte is either used or free
+	if (_usedBytes + freeBytes != _capacity) {
+		std::cout << "Range allocator used and free bytes do not add up to its capacity" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void RangeAllocator::insert_free(uint64_t offset, uint64_t size)
+{
+	_freeByOffset.emplace(offset, size);
+	_freeBySize.emplace(size, offset);
+}
+
+void RangeAllocator::erase_free(std::map<uint64_t, uint64_t>::iterator range)
+{
+	auto sized = _freeBySize.equal_range(range->second);
+	for (auto it = sized.first; it != sized.second; ++it) {
+		if (it->second == range->first) {
+			_freeBySize.erase(it);
+			break;
+		}
+	}
+	_freeByOffset.erase(range);
+}
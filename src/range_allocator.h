@@ -0,0 +1,58 @@
+#pragma once
+#ifndef RANGE_ALLOCATOR_H
+#define RANGE_ALLOCATOR_H
+#include <cstdint>
+#include <map>
+
+//offset and size of a suballocation inside a RangeAllocator
+struct RangeAllocation {
+	uint64_t offset{ 0 };
+	uint64_t size{ 0 };
+};
+
+//occupancy of a RangeAllocator
+struct RangeAllocatorStats {
+	uint64_t capacity{ 0 };
+	uint64_t usedBytes{ 0 };
+	uint64_t freeBytes{ 0 };
+	uint64_t largestFreeRange{ 0 };
+	uint32_t allocationCount{ 0 };
+	uint32_t freeRangeCount{ 0 };
+	//0 when all free space is one range, close to 1 when it is scattered into small ones
+	float fragmentation() const { return freeBytes > 0 ? 1.0f - float(double(largestFreeRange) / double(freeBytes)) : 0.0f; }
+};
+
+//hands out ranges of a fixed size address space (a big buffer), knows nothing about the memory itself
+//best fit over free ranges kept by size, neighbouring free ranges are merged on free
+class RangeAllocator {
+public:
+	explicit RangeAllocator(uint64_t capacity = 0) { reset(capacity); }
+
+	//forget every allocation, the whole capacity becomes one free range
+	void reset(uint64_t capacity);
+
+	//offset is a multiple of alignment (any value, vertex strides are not powers of two)
+	//returns false and leaves outAllocation alone when no free range fits
+	bool allocate(uint64_t size, uint64_t alignment, RangeAllocation& outAllocation);
+	//give back a range returned by allocate
+	void free(const RangeAllocation& allocation);
+
+	RangeAllocatorStats stats() const;
+	//free ranges by offset, for debugging and validation
+	const std::map<uint64_t, uint64_t>& free_ranges() const { return _freeByOffset; }
+	//both free lists agree, ranges are merged and inside the capacity, prints the first problem
+	bool validate() const;
+
+private:
+	void insert_free(uint64_t offset, uint64_t size);
+	void erase_free(std::map<uint64_t, uint64_t>::iterator range);
+
+	uint64_t _capacity{ 0 };
+	uint64_t _usedBytes{ 0 };
+	uint32_t _allocationCount{ 0 };
+	//offset -> size, to find neighbours when freeing
+	std::map<uint64_t, uint64_t> _freeByOffset;
+	//size -> offset, to find the best fit
+	std::multimap<uint64_t, uint64_t> _freeBySize;
+};
+#endif // !RANGE_ALLOCATOR_H
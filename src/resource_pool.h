@@ -0,0 +1,111 @@
+#pragma once
+#ifndef RESOURCE_POOL_H
+#define RESOURCE_POOL_H
+#include <cassert>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+//32 bit reference to an element of a ResourcePool<T>, the slot index in the low bits and the slot's generation above
+//removing an element bumps the generation of its slot, so its handles stop resolving instead of reaching what reuses the slot
+//generations start at 1 and skip 0 when they wrap, the zero value is never handed out and is the null handle
+template<typename T>
+struct Handle {
+	static constexpr uint32_t INDEX_BITS = 20;
+	static constexpr uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+	static constexpr uint32_t GENERATION_MASK = (1u << (32 - INDEX_BITS)) - 1;
+
+	uint32_t value{ 0 };
+
+	uint32_t index() const { return value & INDEX_MASK; }
+	uint32_t generation() const { return value >> INDEX_BITS; }
+	bool is_null() const { return value == 0; }
+
+	bool operator==(Handle other) const { return value == other.value; }
+	bool operator!=(Handle other) const { return value != other.value; }
+};
+
+//elements of one type in a dense array addressed by Handle<T>, a lookup is an index and a generation compare
+//removed slots go on a free list that add() takes from first, so the array only grows to the most elements alive at once
+//a slot is reused GENERATION_MASK times before its oldest handles could resolve again
+//pointers from get() move when add() grows the array, keep handles and resolve them where they are used
+template<typename T>
+class ResourcePool {
+public:
+	Handle<T> add(T value)
+	{
+		uint32_t index;
+		if (!_freeSlots.empty()) {
+			index = _freeSlots.back();
+			_freeSlots.pop_back();
+			_items[index] = std::move(value);
+		}
+		else {
+			if (_items.size() > Handle<T>::INDEX_MASK) {
+				throw std::runtime_error("Resource pool is out of handle indices");
+			}
+			index = static_cast<uint32_t>(_items.size());
+			_items.push_back(std::move(value));
+			_generations.push_back(1);
+		}
+		_count++;
+		return make_handle(index, _generations[index]);
+	}
+
+	//drops the element and what it owns, false when handle was null or stale already
+	bool remove(Handle<T> handle)
+	{
+		if (!contains(handle)) {
+			return false;
+		}
+		const uint32_t index = handle.index();
+		_items[index] = T{};
+		uint32_t& generation = _generations[index];
+		generation = generation == Handle<T>::GENERATION_MASK ? 1 : generation + 1;
+		_freeSlots.push_back(index);
+		_count--;
+		return true;
+	}
+
+	bool contains(Handle<T> handle) const
+	{
+		return !handle.is_null() && handle.index() < _generations.size() && _generations[handle.index()] == handle.generation();
+	}
+
+	//null for the null handle and stale ones
+	T* get(Handle<T> handle) { return contains(handle) ? &_items[handle.index()] : nullptr; }
+	const T* get(Handle<T> handle) const { return contains(handle) ? &_items[handle.index()] : nullptr; }
+
+	//for handles known to be live: unchecked in release builds, debug builds assert on null and stale ones
+	T& operator[](Handle<T> handle)
+	{
+		assert(contains(handle) && "null or stale resource handle");
+		return _items[handle.index()];
+	}
+	const T& operator[](Handle<T> handle) const
+	{
+		assert(contains(handle) && "null or stale resource handle");
+		return _items[handle.index()];
+	}
+
+	//live elements
+	size_t size() const { return _count; }
+	//slots, free ones included
+	size_t slot_count() const { return _items.size(); }
+
+private:
+	static Handle<T> make_handle(uint32_t index, uint32_t generation)
+	{
+		Handle<T> handle;
+		handle.value = generation << Handle<T>::INDEX_BITS | index;
+		return handle;
+	}
+
+	std::vector<T> _items;
+	//per slot, the generation its live handles carry
+	std::vector<uint32_t> _generations;
+	std::vector<uint32_t> _freeSlots;
+	size_t _count{ 0 };
+};
+#endif // !RESOURCE_POOL_H
@@ -0,0 +1,86 @@
+#include "ring_allocator.h"
+#include <algorithm>
+
+uint64_t RingAllocatorLimits::alignment(RingUsage usage) const
+{
+	switch (usage) {
+	case RingUsage::Uniform: return minUniformBufferOffsetAlignment;
+	case RingUsage::Storage: return minStorageBufferOffsetAlignment;
+	default: return optimalBufferCopyOffsetAlignment;
+	}
+}
+
+void RingAllocator::reset(uint64_t capacity, uint32_t frameSlots, const RingAllocatorLimits& limits)
+{
+	_limits = limits;
+	_head = 0;
+	_tail = 0;
+	_frameStart = 0;
+	_frameEnds.assign(frameSlots, 0);
+	_stats = RingAllocatorStats{};
+	_stats.capacity = capacity;
+}
+
+void RingAllocator::begin_frame(uint32_t slot)
+{
+	_tail = std::max(_tail, _frameEnds[slot]);
+	_stats.usedBytes = _head - _tail;
+}
+
+void RingAllocator::end_frame(uint32_t slot)
+{
+	_frameEnds[slot] = _head;
+	_frameStart = _head;
+}
+
+bool RingAllocator::allocate(uint64_t size, RingUsage usage, uint64_t& outOffset)
+{
+	return allocate(size, _limits.alignment(usage), outOffset);
+}
+
+bool RingAllocator::allocate(uint64_t size, uint64_t alignment, uint64_t& outOffset)
+{
+	const uint64_t capacity = _stats.capacity;
+	if (size > capacity || capacity == 0) {
+		_stats.failures++;
+		return false;
+	}
+	alignment = std::max<uint64_t>(alignment, 1);
+	const uint64_t offset = _head % capacity;
+	uint64_t aligned = (offset + alignment - 1) / alignment * alignment;
+	uint64_t start = _head + (aligned - offset);
+	bool wrapped = false;
+	if (aligned + size > capacity) {
+		//the rest of the buffer is skipped, the allocation starts over at offset 0
+		start = _head + (capacity - offset);
+		aligned = 0;
+		wrapped = true;
+	}
+	if (start + size - _tail > capacity) {
+		_stats.failures++;
+		return false;
+	}
+	_head = start + size;
+	_stats.wraps += wrapped ? 1 : 0;
+	_stats.usedBytes = _head - _tail;
+	_stats.highWater = std::max(_stats.highWater, _stats.usedBytes);
+	outOffset = aligned;
+	return true;
+}
+
+uint32_t RingAllocator::pending_ranges(RangeAllocation outRanges[2]) const
+{
+	const uint64_t capacity = _stats.capacity;
+	if (_head == _frameStart) {
+		return 0;
+	}
+	const uint64_t begin = _frameStart % capacity;
+	const uint64_t size = _head - _frameStart;
+	if (begin + size <= capacity) {
+		outRanges[0] = RangeAllocation{ begin, size };
+		return 1;
+	}
+	outRanges[0] = RangeAllocation{ begin, capacity - begin };
+	outRanges[1] = RangeAllocation{ 0, size - (capacity - begin) };
+	return 2;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#ifndef RING_ALLOCATOR_H
+#define RING_ALLOCATOR_H
+#include <cstdint>
+#include <vector>
+#include <range_allocator.h>
+
+//what a suballocation is bound as, picks the device alignment it needs
+enum class RingUsage : uint8_t {
+	Uniform,
+	Storage,
+	Staging,
+};
+
+//the device limits ring offsets have to honour, copied from VkPhysicalDeviceLimits by the engine
+//a struct of its own so the allocator runs without a device, the cooker's checks fill it by hand
+struct RingAllocatorLimits {
+	uint64_t minUniformBufferOffsetAlignment{ 256 };
+	uint64_t minStorageBufferOffsetAlignment{ 256 };
+	uint64_t optimalBufferCopyOffsetAlignment{ 1 };
+
+	uint64_t alignment(RingUsage usage) const;
+};
+
+//occupancy of a RingAllocator
+struct RingAllocatorStats {
+	uint64_t capacity{ 0 };
+	//bytes between the oldest frame in flight and the head, alignment and wrap padding included
+	uint64_t usedBytes{ 0 };
+	uint64_t highWater{ 0 };
+	uint64_t wraps{ 0 };
+	uint64_t failures{ 0 };
+};
+
+//bump allocator over a fixed size address space (one persistently mapped buffer) shared by the frames in flight:
+//every frame allocates behind the previous one, wrapping to the start when an allocation does not fit before the end,
+//and end_frame()/begin_frame() of a frame slot hand back everything that slot allocated once its fence signalled
+//frames have to retire in the order they were recorded, like a swapchain ring does
+class RingAllocator {
+public:
+	void reset(uint64_t capacity, uint32_t frameSlots, const RingAllocatorLimits& limits);
+
+	//the fence of slot signalled, what it allocated the last time around is free again
+	void begin_frame(uint32_t slot);
+	//the allocations since the last end_frame belong to slot
+	void end_frame(uint32_t slot);
+
+	//offset is aligned for usage, false when the frames in flight leave no room
+	bool allocate(uint64_t size, RingUsage usage, uint64_t& outOffset);
+	bool allocate(uint64_t size, uint64_t alignment, uint64_t& outOffset);
+
+	//ranges written since the last end_frame, two when the frame wrapped, for flushing non coherent memory
+	uint32_t pending_ranges(RangeAllocation outRanges[2]) const;
+
+	const RingAllocatorStats& stats() const { return _stats; }
+	const RingAllocatorLimits& limits() const { return _limits; }
+
+private:
+	RingAllocatorLimits _limits;
+	//positions only grow, the offset in the buffer is the position modulo the capacity
+	uint64_t _head{ 0 };
+	uint64_t _tail{ 0 };
+	uint64_t _frameStart{ 0 };
+	//head when each slot last ended its frame
+	std::vector<uint64_t> _frameEnds;
+	RingAllocatorStats _stats;
+};
+#endif // !RING_ALLOCATOR_H
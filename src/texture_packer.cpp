@@ -0,0 +1,107 @@
+#include "texture_packer.h"
+#include <bc_encoder.h>
+#include <thread_pool.h>
+#include <map>
+#include <cstring>
+
+namespace {
+	bool is_power_of_two(uint32_t v)
+	{
+		return v != 0 && (v & (v - 1)) == 0;
+	}
+}
+
+void vkutil::pack_texture_arrays(const std::vector<PackSource>& sources, bool srgb, MipFilter filter, ThreadPool& pool,
+	std::vector<PackedArray>& outArrays, std::vector<PackPlacement>& outPlacements)
+{
+	outArrays.clear();
+	outPlacements.assign(sources.size(), PackPlacement{});
+	//size class -> array being filled
+	std::map<std::pair<uint32_t, uint32_t>, uint32_t> filling;
+	for (size_t i = 0; i < sources.size(); i++) {
+		const PackSource& source = sources[i];
+		if (!is_power_of_two(source.width) || !is_power_of_two(source.height)
+			|| source.width > TEXTURE_ARRAY_MAX_SIZE || source.height > TEXTURE_ARRAY_MAX_SIZE) {
+			continue;
+		}
+		const std::pair<uint32_t, uint32_t> sizeClass = { source.width, source.height };
+		auto it = filling.find(sizeClass);
+		if (it == filling.end() || outArrays[it->second].layers.size() >= TEXTURE_ARRAY_MAX_LAYERS) {
+			PackedArray array;
+			array.width = sizeClass.first;
+			array.height = sizeClass.second;
+			outArrays.push_back(std::move(array));
+			it = filling.insert_or_assign(sizeClass, static_cast<uint32_t>(outArrays.size() - 1)).first;
+		}
+		PackedArray& array = outArrays[it->second];
+		PackPlacement& placement = outPlacements[i];
+		placement.array = it->second;
+		placement.layer = static_cast<uint32_t>(array.layers.size());
+		array.layers.emplace_back();
+		generate_mips(source.rgba, array.width, array.height, srgb, filter, pool, array.layers.back());
+	}
+}
+
+bool vkutil::save_texture_pack(const char* path, assets::TextureFormat format, const std::vector<PackSource>& sources,
+	const std::vector<PackedArray>& arrays, const std::vector<PackPlacement>& placements, ThreadPool& pool)
+{
+	assets::TexturePackInfo info = {};
+	info.arrayCount = static_cast<uint32_t>(arrays.size());
+	std::vector<assets::TextureArrayInfo> arrayInfos;
+	std::vector<assets::TextureArrayEntry> entries;
+	for (size_t i = 0; i < sources.size(); i++) {
+		if (placements[i].array == ~0u) {
+			continue;
+		}
+		assets::TextureArrayEntry entry = {};
+		if (sources[i].name.size() >= sizeof(entry.name)) {
+			return false;
+		}
+		memcpy(entry.name, sources[i].name.data(), sources[i].name.size());
+		entry.array = placements[i].array;
+		entry.layer = placements[i].layer;
+		entry.uvScale[0] = placements[i].uvScale[0];
+		entry.uvScale[1] = placements[i].uvScale[1];
+		entries.push_back(entry);
+	}
+	info.entryCount = static_cast<uint32_t>(entries.size());
+
+	//level i of every layer back to back, the way one copy region per level reads them
+	std::vector<std::vector<uint8_t>> levels;
+	uint32_t section = 2;
+	for (const PackedArray& array : arrays) {
+		const MipChain& first = array.layers.front();
+		assets::TextureArrayInfo arrayInfo = {};
+		arrayInfo.format = format;
+		arrayInfo.width = array.width;
+		arrayInfo.height = array.height;
+		arrayInfo.layerCount = static_cast<uint32_t>(array.layers.size());
+		arrayInfo.mipLevels = first.level_count();
+		arrayInfo.firstSection = section;
+		arrayInfos.push_back(arrayInfo);
+		for (uint32_t level = 0; level < arrayInfo.mipLevels; level++) {
+			const size_t layerSize = assets::texture_level_size(format, first.level_width(level), first.level_height(level));
+			std::vector<uint8_t> data(layerSize * array.layers.size());
+			for (size_t l = 0; l < array.layers.size(); l++) {
+				const MipChain& chain = array.layers[l];
+				if (is_block_format(format)) {
+					compress_image(chain.level_data(level), chain.level_width(level), chain.level_height(level), format,
+						pool, data.data() + l * layerSize);
+				}
+				else {
+					memcpy(data.data() + l * layerSize, chain.level_data(level), layerSize);
+				}
+			}
+			levels.push_back(std::move(data));
+			section++;
+		}
+	}
+
+	std::vector<std::pair<const void*, size_t>> sections;
+	sections.push_back({ arrayInfos.data(), arrayInfos.size() * sizeof(assets::TextureArrayInfo) });
+	sections.push_back({ entries.data(), entries.size() * sizeof(assets::TextureArrayEntry) });
+	for (const std::vector<uint8_t>& level : levels) {
+		sections.push_back({ level.data(), level.size() });
+	}
+	return assets::save_asset(path, "TEXA", &info, sizeof(info), sections);
+}
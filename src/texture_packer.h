@@ -0,0 +1,51 @@
+#pragma once
+#ifndef TEXTURE_PACKER_H
+#define TEXTURE_PACKER_H
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <asset_loader.h>
+#include <mip_generator.h>
+
+class ThreadPool;
+
+//power of two textures up to this size on both sides are packed, other ones keep an image of their own
+constexpr uint32_t TEXTURE_ARRAY_MAX_SIZE = 256;
+//the smallest maxImageArrayLayers Vulkan allows, fuller size classes get a second array
+constexpr uint32_t TEXTURE_ARRAY_MAX_LAYERS = 256;
+
+//an RGBA8 image to pack, the pixels stay owned by the caller
+struct PackSource {
+	std::string name;
+	uint32_t width{ 0 };
+	uint32_t height{ 0 };
+	const uint8_t* rgba{ nullptr };
+};
+
+//where a source went, array is ~0u when it was not packed
+//uvScale is always 1, a packed texture fills its layer
+struct PackPlacement {
+	uint32_t array{ ~0u };
+	uint32_t layer{ 0 };
+	float uvScale[2]{ 1.0f, 1.0f };
+};
+
+//one texture array, every layer a full mip chain of width x height
+struct PackedArray {
+	uint32_t width{ 0 };
+	uint32_t height{ 0 };
+	std::vector<MipChain> layers;
+};
+
+namespace vkutil {
+	//sort the small power of two sources into arrays by size, one texture filling each layer, so the repeat sampler
+	//wraps tiling uvs and linear and mip filtering across the texture's own opposite edge like on an image of its own
+	//a texture padded into a larger layer would seam there, those are left unpacked
+	void pack_texture_arrays(const std::vector<PackSource>& sources, bool srgb, MipFilter filter, ThreadPool& pool,
+		std::vector<PackedArray>& outArrays, std::vector<PackPlacement>& outPlacements);
+
+	//write the arrays as a "TEXA" asset in format, block formats are compressed layer by layer
+	bool save_texture_pack(const char* path, assets::TextureFormat format, const std::vector<PackSource>& sources,
+		const std::vector<PackedArray>& arrays, const std::vector<PackPlacement>& placements, ThreadPool& pool);
+}
+#endif // !TEXTURE_PACKER_H
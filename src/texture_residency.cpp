@@ -0,0 +1,192 @@
+#include "texture_residency.h"
+#include <algorithm>
+#include <limits>
+
+uint32_t TextureResidency::add_texture(uint32_t width, uint32_t height, const std::vector<uint64_t>& levelBytes)
+{
+	TextureState texture;
+	texture.levelBytes = levelBytes;
+	const uint32_t levelCount = static_cast<uint32_t>(levelBytes.size());
+	while (texture.tailMip + 1 < levelCount
+		&& std::max(width >> texture.tailMip, height >> texture.tailMip) > TEXTURE_TAIL_SIZE) {
+		texture.tailMip++;
+	}
+	texture.residentMip = texture.tailMip;
+	texture.pendingMip = texture.tailMip;
+	texture.desiredMip = texture.tailMip;
+	_textures.push_back(texture);
+	return static_cast<uint32_t>(_textures.size() - 1);
+}
+
+void TextureResidency::request(uint32_t texture, uint32_t mip)
+{
+	TextureState& state = _textures[texture];
+	//the first request of a frame replaces the last frame's, later ones can only ask for more
+	if (state.usedFrame != _frame) {
+		state.usedFrame = _frame;
+		state.desiredMip = mip;
+	}
+	else {
+		state.desiredMip = std::min(state.desiredMip, mip);
+	}
+}
+
+void TextureResidency::complete(uint32_t texture, uint32_t residentMip)
+{
+	_textures[texture].residentMip = residentMip;
+	_textures[texture].pendingMip = residentMip;
+}
+
+uint64_t TextureResidency::bytes_from(uint32_t texture, uint32_t mip) const
+{
+	uint64_t bytes = 0;
+	const std::vector<uint64_t>& levels = _textures[texture].levelBytes;
+	for (size_t i = mip; i < levels.size(); i++) {
+		bytes += levels[i];
+	}
+	return bytes;
+}
+
+uint64_t TextureResidency::committed_bytes(const TextureState& texture) const
+{
+	const uint32_t id = static_cast<uint32_t>(&texture - _textures.data());
+	return bytes_from(id, std::min(texture.residentMip, texture.pendingMip));
+}
+
+void TextureResidency::plan(uint64_t budgetBytes, uint32_t maxStreamIns, std::vector<ResidencyRequest>& outStreamIns,
+	std::vector<ResidencyRequest>& outEvictions, FrameAllocator& scratch)
+{
+	outStreamIns.clear();
+	outEvictions.clear();
+	//a texture moves at most once per plan, sized here the lists only grow in the frame after add_texture
+	outStreamIns.reserve(_textures.size());
+	outEvictions.reserve(_textures.size());
+	//textures drawn this frame want their footprint, the rest only their tail
+	auto wanted = [this](const TextureState& texture) {
+		return texture.usedFrame == _frame ? std::min(texture.desiredMip, texture.tailMip) : texture.tailMip;
+	};
+	auto idle = [](const TextureState& texture) { return texture.pendingMip == texture.residentMip; };
+
+	//committed holds evictions in flight at their old size, settled at their new one
+	uint64_t committed = 0;
+	uint64_t settled = 0;
+	FrameVector<uint32_t> streamIns(scratch);
+	streamIns.reserve(_textures.size());
+	for (uint32_t i = 0; i < _textures.size(); i++) {
+		const TextureState& texture = _textures[i];
+		committed += committed_bytes(texture);
+		settled += bytes_from(i, texture.pendingMip);
+		if (idle(texture) && wanted(texture) < texture.residentMip) {
+			streamIns.push_back(i);
+		}
+	}
+	//the blurriest textures first
+	std::sort(streamIns.begin(), streamIns.end(), [&](uint32_t a, uint32_t b) {
+		return _textures[a].residentMip - wanted(_textures[a]) > _textures[b].residentMip - wanted(_textures[b]);
+	});
+	//only make room for the stream ins that can start this frame, evicting for the whole backlog empties the pool
+	uint64_t wantedBytes = 0;
+	for (size_t i = 0; i < streamIns.size() && i < maxStreamIns; i++) {
+		wantedBytes += bytes_from(streamIns[i], wanted(_textures[streamIns[i]])) - bytes_from(streamIns[i], _textures[streamIns[i]].residentMip);
+	}
+
+	//over budget, or the wanted levels do not fit: drop levels nobody needs, least recently used first
+	//evicted bytes are only given back once the move lands, so stream ins wait for them,
+	//but evictions already in flight count as done or every frame of latency would evict again
+	if (settled + wantedBytes > budgetBytes) {
+		const uint64_t needed = settled + wantedBytes - budgetBytes;
+		FrameVector<uint32_t> evictable(scratch);
+		evictable.reserve(_textures.size());
+		for (uint32_t i = 0; i < _textures.size(); i++) {
+			if (idle(_textures[i]) && _textures[i].residentMip < wanted(_textures[i])) {
+				evictable.push_back(i);
+			}
+		}
+		std::sort(evictable.begin(), evictable.end(), [&](uint32_t a, uint32_t b) {
+			return _textures[a].usedFrame < _textures[b].usedFrame;
+		});
+		uint64_t freed = 0;
+		for (size_t e = 0; e < evictable.size() && freed < needed; e++) {
+			TextureState& texture = _textures[evictable[e]];
+			const uint32_t target = wanted(texture);
+			freed += bytes_from(evictable[e], texture.residentMip) - bytes_from(evictable[e], target);
+			texture.pendingMip = target;
+			outEvictions.push_back({ evictable[e], target });
+			_stats.evictions++;
+		}
+		//the budget itself shrank below what is in use: textures in use give up their finest level too
+		if (settled > budgetBytes + freed) {
+			FrameVector<uint32_t> inUse(scratch);
+			inUse.reserve(_textures.size());
+			for (uint32_t i = 0; i < _textures.size(); i++) {
+				if (idle(_textures[i]) && _textures[i].residentMip < _textures[i].tailMip) {
+					inUse.push_back(i);
+				}
+			}
+			std::sort(inUse.begin(), inUse.end(), [&](uint32_t a, uint32_t b) {
+				return _textures[a].usedFrame < _textures[b].usedFrame
+					|| (_textures[a].usedFrame == _textures[b].usedFrame && _textures[a].residentMip < _textures[b].residentMip);
+			});
+			for (size_t e = 0; e < inUse.size() && settled > budgetBytes + freed; e++) {
+				TextureState& texture = _textures[inUse[e]];
+				freed += texture.levelBytes[texture.residentMip];
+				texture.pendingMip = texture.residentMip + 1;
+				outEvictions.push_back({ inUse[e], texture.pendingMip });
+				_stats.evictions++;
+			}
+		}
+	}
+
+	//stream in what fits, part of the way when all of it does not
+	for (uint32_t id : streamIns) {
+		if (outStreamIns.size() >= maxStreamIns) {
+			break;
+		}
+		TextureState& texture = _textures[id];
+		const uint64_t residentBytes = bytes_from(id, texture.residentMip);
+		uint32_t target = wanted(texture);
+		while (target < texture.residentMip && committed + bytes_from(id, target) - residentBytes > budgetBytes) {
+			target++;
+		}
+		if (target >= texture.residentMip) {
+			continue;
+		}
+		committed += bytes_from(id, target) - residentBytes;
+		texture.pendingMip = target;
+		outStreamIns.push_back({ id, target });
+		_stats.streamIns++;
+	}
+
+	_stats.residentBytes = 0;
+	_stats.committedBytes = committed;
+	_stats.budgetBytes = budgetBytes;
+	_stats.texturesBelowDesired = 0;
+	_stats.inFlight = 0;
+	for (uint32_t i = 0; i < _textures.size(); i++) {
+		const TextureState& texture = _textures[i];
+		_stats.residentBytes += bytes_from(i, texture.residentMip);
+		_stats.texturesBelowDesired += texture.usedFrame == _frame && texture.residentMip > wanted(texture) ? 1 : 0;
+		_stats.inFlight += idle(texture) ? 0 : 1;
+	}
+	_frame++;
+}
+
+float vkutil::sphere_screen_pixels(const glm::vec4& sphere, const glm::vec3& eye, float pixelsPerUnit)
+{
+	const float distance = glm::length(glm::vec3(sphere) - eye) - sphere.w;
+	//inside the sphere the object can fill the screen
+	if (distance <= 0.0f) {
+		return std::numeric_limits<float>::max();
+	}
+	return 2.0f * sphere.w * pixelsPerUnit / distance;
+}
+
+uint32_t vkutil::footprint_mip(uint32_t width, uint32_t height, uint32_t levelCount, float screenPixels)
+{
+	const uint32_t size = std::max(width, height);
+	uint32_t mip = 0;
+	while (mip + 1 < levelCount && float(size >> (mip + 1)) >= screenPixels) {
+		mip++;
+	}
+	return mip;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#ifndef TEXTURE_RESIDENCY_H
+#define TEXTURE_RESIDENCY_H
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+#include <frame_allocator.h>
+
+//levels at or below this size stay resident from registration to shutdown, so there is always something to sample
+constexpr uint32_t TEXTURE_TAIL_SIZE = 64;
+
+//one texture's move to a new first resident level: finer than now streams levels in, coarser evicts them
+struct ResidencyRequest {
+	uint32_t texture;
+	uint32_t targetMip;
+};
+
+struct ResidencyStats {
+	//levels on the gpu now
+	uint64_t residentBytes{ 0 };
+	//what residency will be once every move in flight lands, evictions count at their old size until then
+	uint64_t committedBytes{ 0 };
+	uint64_t budgetBytes{ 0 };
+	//textures used last frame whose resident levels are coarser than their footprint wants
+	uint32_t texturesBelowDesired{ 0 };
+	uint32_t inFlight{ 0 };
+	uint64_t streamIns{ 0 };
+	uint64_t evictions{ 0 };
+};
+
+//cpu side mip residency policy of the texture streamer, no Vulkan in here so it can run against a simulated
+//budget: textures start with their tail resident, request() records how fine each one is needed every frame,
+//plan() turns that into stream ins under the budget and evicts least recently used levels when it is exceeded
+//each texture has at most one move in flight, the caller reports it with complete()
+class TextureResidency {
+public:
+	//levelBytes[i] is the size of level i, largest first, returns the texture id
+	uint32_t add_texture(uint32_t width, uint32_t height, const std::vector<uint64_t>& levelBytes);
+
+	//the texture is drawn this frame and needs levels down to mip
+	void request(uint32_t texture, uint32_t mip);
+
+	//moves to start this frame, then starts the next frame
+	//at most maxStreamIns stream ins are started, evictions come first in least recently used order
+	//the candidate lists it sorts live in scratch, which the caller resets every frame, and the output lists keep
+	//room for every texture, so planning only touches the heap after textures were added
+	void plan(uint64_t budgetBytes, uint32_t maxStreamIns, std::vector<ResidencyRequest>& outStreamIns,
+		std::vector<ResidencyRequest>& outEvictions, FrameAllocator& scratch);
+
+	//a move from plan() landed (or failed, with the old level still resident)
+	void complete(uint32_t texture, uint32_t residentMip);
+
+	uint32_t resident_mip(uint32_t texture) const { return _textures[texture].residentMip; }
+	uint32_t tail_mip(uint32_t texture) const { return _textures[texture].tailMip; }
+	uint32_t level_count(uint32_t texture) const { return static_cast<uint32_t>(_textures[texture].levelBytes.size()); }
+	//bytes of levels [mip, levelCount)
+	uint64_t bytes_from(uint32_t texture, uint32_t mip) const;
+	size_t texture_count() const { return _textures.size(); }
+	const ResidencyStats& stats() const { return _stats; }
+
+private:
+	struct TextureState {
+		std::vector<uint64_t> levelBytes;
+		uint32_t tailMip{ 0 };
+		uint32_t residentMip{ 0 };
+		//target of the move in flight, residentMip when idle
+		uint32_t pendingMip{ 0 };
+		//finest level requested in usedFrame
+		uint32_t desiredMip{ 0 };
+		uint64_t usedFrame{ 0 };
+	};
+
+	uint64_t committed_bytes(const TextureState& texture) const;
+
+	std::vector<TextureState> _textures;
+	uint64_t _frame{ 1 };
+	ResidencyStats _stats;
+};
+
+namespace vkutil {
+	//screen pixels covered by the diameter of a bounding sphere (xyz center, w radius) seen from eye,
+	//pixelsPerUnit is the size of one world unit at distance 1
+	float sphere_screen_pixels(const glm::vec4& sphere, const glm::vec3& eye, float pixelsPerUnit);
+
+	//level a texture spread over screenPixels needs: the coarsest one whose larger side still has
+	//a texel for every covered pixel
+	uint32_t footprint_mip(uint32_t width, uint32_t height, uint32_t levelCount, float screenPixels);
+}
+#endif // !TEXTURE_RESIDENCY_H
@@ -0,0 +1,118 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+	if (threadCount == 0) {
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+	_workers.reserve(threadCount);
+	for (uint32_t i = 0; i < threadCount; i++) {
+		_workers.emplace_back([this]() { worker_loop(); });
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_wake.notify_all();
+	for (std::thread& worker : _workers) {
+		worker.join();
+	}
+}
+
+ThreadPool& ThreadPool::shared()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+void ThreadPool::enqueue(std::function<void()>&& job)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_jobs.push_back(std::move(job));
+	}
+	_wake.notify_one();
+}
+
+void ThreadPool::worker_loop()
+{
+	for (;;) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_wake.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+			//finish queued work before shutting down, nobody else would run it
+			if (_jobs.empty()) {
+				return;
+			}
+			job = std::move(_jobs.front());
+			_jobs.pop_front();
+		}
+		job();
+	}
+}
+
+void ThreadPool::parallel_for(size_t count, size_t minRange, const std::function<void(size_t begin, size_t end)>& body)
+{
+	if (count == 0) {
+		return;
+	}
+	//a few ranges per thread so uneven ranges still balance
+	const size_t rangeSize = std::max(std::max<size_t>(minRange, 1), (count + _workers.size() * 4 - 1) / (_workers.size() * 4));
+	const size_t rangeCount = (count + rangeSize - 1) / rangeSize;
+	if (rangeCount == 1) {
+		body(0, count);
+		return;
+	}
+
+	//helpers can start after the caller returned, so the shared state outlives this call
+	//and body is only touched while a range is still unclaimed
+	struct State {
+		std::atomic<size_t> next{ 0 };
+		size_t finished{ 0 };
+		std::exception_ptr error;
+		std::mutex mutex;
+		std::condition_variable done;
+	};
+	auto state = std::make_shared<State>();
+	const std::function<void(size_t, size_t)>* bodyPtr = &body;
+	auto run = [state, bodyPtr, count, rangeSize, rangeCount]() {
+		for (;;) {
+			const size_t range = state->next.fetch_add(1);
+			if (range >= rangeCount) {
+				return;
+			}
+			std::exception_ptr error;
+			try {
+				(*bodyPtr)(range * rangeSize, std::min(count, (range + 1) * rangeSize));
+			}
+			catch (...) {
+				error = std::current_exception();
+			}
+			std::lock_guard<std::mutex> lock(state->mutex);
+			if (error && !state->error) {
+				state->error = error;
+			}
+			if (++state->finished == rangeCount) {
+				state->done.notify_all();
+			}
+		}
+	};
+
+	const size_t helpers = std::min(_workers.size(), rangeCount - 1);
+	for (size_t i = 0; i < helpers; i++) {
+		enqueue(run);
+	}
+	run();
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->done.wait(lock, [&]() { return state->finished == rangeCount; });
+	if (state->error) {
+		std::rethrow_exception(state->error);
+	}
+}
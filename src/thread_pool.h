@@ -0,0 +1,57 @@
+#pragma once
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <atomic>
+
+//fixed set of worker threads shared by the loaders, so parallel jobs don't each spawn their own threads
+class ThreadPool {
+public:
+	//0 uses one worker per hardware thread
+	explicit ThreadPool(uint32_t threadCount = 0);
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	//process wide pool, created on first use
+	static ThreadPool& shared();
+
+	size_t thread_count() const { return _workers.size(); }
+
+	//queue a job, the future holds its result or rethrows its exception
+	template<typename F>
+	auto submit(F&& job) -> std::future<decltype(job())>;
+
+	//split [0, count) into ranges of at least minRange and run body(begin, end) on them,
+	//the calling thread works too and returns once every range is done
+	void parallel_for(size_t count, size_t minRange, const std::function<void(size_t begin, size_t end)>& body);
+
+private:
+	void enqueue(std::function<void()>&& job);
+	void worker_loop();
+
+	std::vector<std::thread> _workers;
+	std::deque<std::function<void()>> _jobs;
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	bool _stopping{ false };
+};
+
+template<typename F>
+auto ThreadPool::submit(F&& job) -> std::future<decltype(job())>
+{
+	using Result = decltype(job());
+	//std::function needs a copyable callable, packaged_task is move only
+	auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+	std::future<Result> result = task->get_future();
+	enqueue([task]() { (*task)(); });
+	return result;
+}
+#endif // !THREAD_POOL_H
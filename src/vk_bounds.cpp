@@ -0,0 +1,210 @@
+#include "vk_bounds.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VK_BOUNDS_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+	inline const glm::vec3& position_at(const glm::vec3* positions, size_t stride, size_t i)
+	{
+		return *reinterpret_cast<const glm::vec3*>(reinterpret_cast<const char*>(positions) + i * stride);
+	}
+
+#ifdef VK_BOUNDS_SSE
+	//xyz in the low lanes, reads 4 floats so the caller keeps the last position of an array away from here
+	inline __m128 load_position(const glm::vec3* positions, size_t stride, size_t i)
+	{
+		return _mm_loadu_ps(&position_at(positions, stride, i).x);
+	}
+
+	inline __m128 set_position(const glm::vec3& p)
+	{
+		return _mm_setr_ps(p.x, p.y, p.z, 0.0f);
+	}
+#endif
+
+	void compute_box(const glm::vec3* positions, size_t count, size_t stride, glm::vec3& outMin, glm::vec3& outMax)
+	{
+#ifdef VK_BOUNDS_SSE
+		//two accumulators each to hide the min/max latency
+		__m128 last = set_position(position_at(positions, stride, count - 1));
+		__m128 min0 = last, max0 = last, min1 = last, max1 = last;
+		size_t i = 0;
+		for (; i + 2 < count; i += 2) {
+			const __m128 a = load_position(positions, stride, i);
+			const __m128 b = load_position(positions, stride, i + 1);
+			min0 = _mm_min_ps(min0, a);
+			max0 = _mm_max_ps(max0, a);
+			min1 = _mm_min_ps(min1, b);
+			max1 = _mm_max_ps(max1, b);
+		}
+		for (; i + 1 < count; i++) {
+			const __m128 a = load_position(positions, stride, i);
+			min0 = _mm_min_ps(min0, a);
+			max0 = _mm_max_ps(max0, a);
+		}
+		alignas(16) float minValues[4], maxValues[4];
+		_mm_store_ps(minValues, _mm_min_ps(min0, min1));
+		_mm_store_ps(maxValues, _mm_max_ps(max0, max1));
+		outMin = glm::vec3(minValues[0], minValues[1], minValues[2]);
+		outMax = glm::vec3(maxValues[0], maxValues[1], maxValues[2]);
+#else
+		outMin = outMax = position_at(positions, stride, 0);
+		for (size_t i = 1; i < count; i++) {
+			outMin = glm::min(outMin, position_at(positions, stride, i));
+			outMax = glm::max(outMax, position_at(positions, stride, i));
+		}
+#endif
+	}
+
+	//largest squared distance from center to any position
+	float max_distance_squared(const glm::vec3* positions, size_t count, size_t stride, const glm::vec3& center)
+	{
+#ifdef VK_BOUNDS_SSE
+		const __m128 c = set_position(center);
+		__m128 best = _mm_setzero_ps();
+		size_t i = 0;
+		//transpose 4 positions to x/y/z lanes so the dot products stay vertical
+		for (; i + 4 < count; i += 4) {
+			__m128 p0 = _mm_sub_ps(load_position(positions, stride, i + 0), c);
+			__m128 p1 = _mm_sub_ps(load_position(positions, stride, i + 1), c);
+			__m128 p2 = _mm_sub_ps(load_position(positions, stride, i + 2), c);
+			__m128 p3 = _mm_sub_ps(load_position(positions, stride, i + 3), c);
+			_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+			const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p0, p0), _mm_mul_ps(p1, p1)), _mm_mul_ps(p2, p2));
+			best = _mm_max_ps(best, d);
+		}
+		alignas(16) float lanes[4];
+		_mm_store_ps(lanes, best);
+		float result = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+#else
+		float result = 0.0f;
+		size_t i = 0;
+#endif
+		for (; i < count; i++) {
+			const glm::vec3 d = position_at(positions, stride, i) - center;
+			result = std::max(result, glm::dot(d, d));
+		}
+		return result;
+	}
+
+	//ritter's sphere from the most distant pair of axis extremes, grown to fit the rest
+	glm::vec4 ritter_sphere(const glm::vec3* positions, size_t count, size_t stride)
+	{
+		size_t minIndex[3] = { 0, 0, 0 };
+		size_t maxIndex[3] = { 0, 0, 0 };
+		glm::vec3 minPos = position_at(positions, stride, 0);
+		glm::vec3 maxPos = minPos;
+		for (size_t i = 1; i < count; i++) {
+			const glm::vec3& p = position_at(positions, stride, i);
+			for (int axis = 0; axis < 3; axis++) {
+				if (p[axis] < minPos[axis]) {
+					minPos[axis] = p[axis];
+					minIndex[axis] = i;
+				}
+				if (p[axis] > maxPos[axis]) {
+					maxPos[axis] = p[axis];
+					maxIndex[axis] = i;
+				}
+			}
+		}
+		glm::vec3 a = position_at(positions, stride, minIndex[0]);
+		glm::vec3 b = position_at(positions, stride, maxIndex[0]);
+		for (int axis = 1; axis < 3; axis++) {
+			const glm::vec3& minP = position_at(positions, stride, minIndex[axis]);
+			const glm::vec3& maxP = position_at(positions, stride, maxIndex[axis]);
+			if (glm::dot(maxP - minP, maxP - minP) > glm::dot(b - a, b - a)) {
+				a = minP;
+				b = maxP;
+			}
+		}
+		glm::vec3 center = (a + b) * 0.5f;
+		float radius = glm::length(b - a) * 0.5f;
+		for (size_t i = 0; i < count; i++) {
+			const glm::vec3& p = position_at(positions, stride, i);
+			//almost every point is already inside, only take the square root for the rest
+			const float distanceSquared = glm::dot(p - center, p - center);
+			if (distanceSquared > radius * radius) {
+				const float distance = std::sqrt(distanceSquared);
+				const float newRadius = (radius + distance) * 0.5f;
+				center += (p - center) * ((newRadius - radius) / distance);
+				radius = newRadius;
+			}
+		}
+		return glm::vec4(center, radius);
+	}
+}
+
+Bounds vkutil::compute_bounds(const glm::vec3* positions, size_t count, size_t stride)
+{
+	Bounds bounds;
+	if (count == 0) {
+		return bounds;
+	}
+	compute_box(positions, count, stride, bounds.min, bounds.max);
+
+	//the box centered sphere wins on boxy meshes, ritter's on round ones
+	const glm::vec3 boxCenter = (bounds.min + bounds.max) * 0.5f;
+	const float boxRadius = std::sqrt(max_distance_squared(positions, count, stride, boxCenter));
+	const glm::vec4 ritter = ritter_sphere(positions, count, stride);
+	//ritter's growth step can leave a point a rounding error outside, measure the final radius instead
+	const float ritterRadius = std::sqrt(max_distance_squared(positions, count, stride, glm::vec3(ritter)));
+	bounds.sphere = ritterRadius < boxRadius ? glm::vec4(glm::vec3(ritter), ritterRadius) : glm::vec4(boxCenter, boxRadius);
+	return bounds;
+}
+
+Bounds vkutil::transform_bounds(const Bounds& bounds, const glm::mat4& transform)
+{
+	//arvo's method: the new half extents are the old ones through the absolute matrix
+	const glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+	const glm::vec3 extent = (bounds.max - bounds.min) * 0.5f;
+	const glm::mat3 linear(transform);
+	const glm::mat3 absolute(glm::abs(linear[0]), glm::abs(linear[1]), glm::abs(linear[2]));
+	const glm::vec3 newCenter = glm::vec3(transform * glm::vec4(center, 1.0f));
+	const glm::vec3 newExtent = absolute * extent;
+
+	//the sphere scales by the longest axis
+	const float scale = std::sqrt(std::max(std::max(glm::dot(linear[0], linear[0]), glm::dot(linear[1], linear[1])),
+		glm::dot(linear[2], linear[2])));
+
+	Bounds result;
+	result.min = newCenter - newExtent;
+	result.max = newCenter + newExtent;
+	result.sphere = glm::vec4(glm::vec3(transform * glm::vec4(glm::vec3(bounds.sphere), 1.0f)), bounds.sphere.w * scale);
+	return result;
+}
+
+bool vkutil::validate_bounds(const Bounds& bounds, const glm::vec3* positions, size_t count, size_t stride)
+{
+	if (count == 0) {
+		return true;
+	}
+	glm::vec3 minPos = position_at(positions, stride, 0);
+	glm::vec3 maxPos = minPos;
+	for (size_t i = 1; i < count; i++) {
+		minPos = glm::min(minPos, position_at(positions, stride, i));
+		maxPos = glm::max(maxPos, position_at(positions, stride, i));
+	}
+	if (minPos != bounds.min || maxPos != bounds.max) {
+		std::cout << "Bounding box differs from the scalar min/max" << std::endl;
+		return false;
+	}
+	const glm::vec3 center(bounds.sphere);
+	const float tolerance = bounds.sphere.w * 1e-5f + 1e-6f;
+	for (size_t i = 0; i < count; i++) {
+		if (glm::length(position_at(positions, stride, i) - center) > bounds.sphere.w + tolerance) {
+			std::cout << "Bounding sphere misses position " << i << std::endl;
+			return false;
+		}
+	}
+	//never looser than the sphere around the box corners
+	if (bounds.sphere.w > glm::length(maxPos - minPos) * 0.5f + tolerance) {
+		std::cout << "Bounding sphere is looser than the box centered sphere" << std::endl;
+		return false;
+	}
+	return true;
+}
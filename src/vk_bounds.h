@@ -0,0 +1,26 @@
+#pragma once
+#ifndef VK_BOUNDS_H
+#define VK_BOUNDS_H
+#include <glm/glm.hpp>
+
+//axis aligned box and bounding sphere of a mesh or object
+struct Bounds {
+	glm::vec3 min{ 0.0f };
+	glm::vec3 max{ 0.0f };
+	//xyz center and w radius, the smaller of the box centered and ritter's sphere
+	glm::vec4 sphere{ 0.0f };
+};
+
+namespace vkutil {
+	//bounds of count positions spaced stride bytes apart, so Vertex arrays can be passed directly
+	//min/max and the sphere radius run 4 wide with SSE when the target has it
+	Bounds compute_bounds(const glm::vec3* positions, size_t count, size_t stride = sizeof(glm::vec3));
+
+	//bounds of the transformed box and sphere, still conservative under rotation and non uniform scale
+	Bounds transform_bounds(const Bounds& bounds, const glm::mat4& transform);
+
+	//check against a plain scalar pass: box is exactly the min/max and the sphere holds every position
+	//prints the first failure and returns false
+	bool validate_bounds(const Bounds& bounds, const glm::vec3* positions, size_t count, size_t stride = sizeof(glm::vec3));
+}
+#endif // !VK_BOUNDS_H
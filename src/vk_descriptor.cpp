@@ -1,5 +1,7 @@
 #include <vk_descriptor.h>
+#include <vk_initializers.h>
 #include <algorithm>
+#include <stdexcept>
 
 namespace vkutil {
 
@@ -186,6 +188,123 @@ namespace vkutil {
 		}
 	}
 
+	void SamplerCache::init(VkDevice newDevice, float maxAnisotropy)
+	{
+		device = newDevice;
+		anisotropy = maxAnisotropy;
+	}
+
+	void SamplerCache::cleanup()
+	{
+		for (auto pair : samplerCache)
+		{
+			vkDestroySampler(device, pair.second, nullptr);
+		}
+		samplerCache.clear();
+	}
+
+	VkSampler SamplerCache::get_sampler(const VkSamplerCreateInfo& info)
+	{
+		requestCount++;
+		//fields the sampler ignores are cleared, so they cannot split equal samplers
+		SamplerInfo key;
+		key.info = info;
+		key.info.pNext = nullptr;
+		if (!key.info.anisotropyEnable)
+		{
+			key.info.maxAnisotropy = 0.0f;
+		}
+		if (!key.info.compareEnable)
+		{
+			key.info.compareOp = VK_COMPARE_OP_NEVER;
+		}
+		const bool border = key.info.addressModeU == VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER
+			|| key.info.addressModeV == VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER
+			|| key.info.addressModeW == VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+		if (!border)
+		{
+			key.info.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+		}
+
+		auto it = samplerCache.find(key);
+		if (it != samplerCache.end())
+		{
+			return (*it).second;
+		}
+		VkSampler sampler;
+		if (vkCreateSampler(device, &key.info, nullptr, &sampler) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create sampler!");
+		}
+		samplerCache[key] = sampler;
+		return sampler;
+	}
+
+	VkSampler SamplerCache::get_sampler(SamplerPreset preset)
+	{
+		return get_sampler(preset_info(preset));
+	}
+
+	VkSamplerCreateInfo SamplerCache::preset_info(SamplerPreset preset) const
+	{
+		const bool nearest = preset == SamplerPreset::NearestRepeat;
+		const VkSamplerAddressMode addressMode = preset == SamplerPreset::LinearClamp
+			? VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE : VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		VkSamplerCreateInfo info = vkinit::sampler_create_info(nearest ? VK_FILTER_NEAREST : VK_FILTER_LINEAR, addressMode);
+		info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		info.unnormalizedCoordinates = VK_FALSE;
+		info.compareEnable = VK_FALSE;
+		info.mipLodBias = 0.0f;
+		//textures of different sizes share the sampler, the image view limits the levels
+		info.minLod = 0.0f;
+		info.maxLod = VK_LOD_CLAMP_NONE;
+		if (preset == SamplerPreset::AnisotropicRepeat && anisotropy > 1.0f)
+		{
+			info.anisotropyEnable = VK_TRUE;
+			info.maxAnisotropy = anisotropy;
+		}
+		return info;
+	}
+
+	bool SamplerCache::SamplerInfo::operator==(const SamplerInfo& other) const
+	{
+		return info.flags == other.info.flags
+			&& info.magFilter == other.info.magFilter
+			&& info.minFilter == other.info.minFilter
+			&& info.mipmapMode == other.info.mipmapMode
+			&& info.addressModeU == other.info.addressModeU
+			&& info.addressModeV == other.info.addressModeV
+			&& info.addressModeW == other.info.addressModeW
+			&& info.mipLodBias == other.info.mipLodBias
+			&& info.anisotropyEnable == other.info.anisotropyEnable
+			&& info.maxAnisotropy == other.info.maxAnisotropy
+			&& info.compareEnable == other.info.compareEnable
+			&& info.compareOp == other.info.compareOp
+			&& info.minLod == other.info.minLod
+			&& info.maxLod == other.info.maxLod
+			&& info.borderColor == other.info.borderColor
+			&& info.unnormalizedCoordinates == other.info.unnormalizedCoordinates;
+	}
+
+	size_t SamplerCache::SamplerInfo::hash() const
+	{
+		using std::size_t;
+		using std::hash;
+
+		//the enums fit in a few bits each, pack them into one word
+		size_t packed = size_t(info.magFilter) | size_t(info.minFilter) << 2 | size_t(info.mipmapMode) << 4
+			| size_t(info.addressModeU) << 6 | size_t(info.addressModeV) << 9 | size_t(info.addressModeW) << 12
+			| size_t(info.anisotropyEnable) << 15 | size_t(info.compareEnable) << 16 | size_t(info.compareOp) << 17
+			| size_t(info.borderColor) << 20 | size_t(info.unnormalizedCoordinates) << 23 | size_t(info.flags) << 24;
+		size_t result = hash<size_t>()(packed);
+		//mix in the float fields
+		for (float f : { info.mipLodBias, info.maxAnisotropy, info.minLod, info.maxLod })
+		{
+			result = result * 31 + hash<float>()(f);
+		}
+		return result;
+	}
+
 	vkutil::DescriptorBuilder DescriptorBuilder::begin(DescriptorLayoutCache* layoutCache, DescriptorAllocator* allocator)
 	{
 		DescriptorBuilder builder;
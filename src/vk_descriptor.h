@@ -87,6 +87,60 @@ namespace vkutil {
 	};
 
 
+	//samplers materials pick by name instead of filling a VkSamplerCreateInfo each
+	enum class SamplerPreset : uint8_t {
+		//point filtered texels, linear between mips
+		NearestRepeat,
+		//trilinear
+		LinearRepeat,
+		LinearClamp,
+		//trilinear with the cache's anisotropy, plain trilinear when the device has none enabled
+		AnisotropicRepeat,
+	};
+
+	//one VkSampler per distinct create info, shared by every material asking for it
+	//drivers cap the number of live samplers, so materials never create their own
+	class SamplerCache {
+	public:
+		//maxAnisotropy 0 when the samplerAnisotropy feature is not enabled
+		void init(VkDevice newDevice, float maxAnisotropy);
+		void cleanup();
+
+		//info->pNext has to be null, chained structs are not part of the key
+		VkSampler get_sampler(const VkSamplerCreateInfo& info);
+		VkSampler get_sampler(SamplerPreset preset);
+
+		VkSamplerCreateInfo preset_info(SamplerPreset preset) const;
+
+		//get_sampler calls and samplers created for them
+		uint32_t requests() const { return requestCount; }
+		uint32_t unique() const { return static_cast<uint32_t>(samplerCache.size()); }
+
+		struct SamplerInfo {
+			VkSamplerCreateInfo info;
+
+			bool operator==(const SamplerInfo& other) const;
+
+			size_t hash() const;
+		};
+
+	private:
+
+		struct SamplerHash
+		{
+			std::size_t operator()(const SamplerInfo& k) const
+			{
+				return k.hash();
+			}
+		};
+
+		std::unordered_map<SamplerInfo, VkSampler, SamplerHash> samplerCache;
+		uint32_t requestCount{ 0 };
+		float anisotropy{ 0.0f };
+		VkDevice device;
+	};
+
+
 	class DescriptorBuilder {
 	public:
 
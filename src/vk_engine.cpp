@@ -1,6 +1,7 @@
 ﻿#include "vk_engine.h"
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 #include <SDL.h>
 #include <SDL_vulkan.h>
 
@@ -13,6 +14,12 @@
 /// </summary>
 #include <VkBootstrap.h>
 #include <vk_texture.h>
+#include <asset_loader.h>
+#include <vk_meshlet.h>
+#include <vk_mesh_simplify.h>
+#include <ktx2_loader.h>
+#include <image_decode.h>
+#include <memory_stats.h>
 //we want to immediately abort when there is an error. 
 //In normal engines this would give an error message to the user, 
 //or perform a dump of state.
@@ -28,6 +35,10 @@ using namespace std;
 		}                                                           \
 	} while (0)
 
+//frames allowed to touch the heap after startup, while the first loads land and the streamer settles
+//COUNT_HEAP_ALLOCATIONS builds report every later frame that allocates
+static constexpr uint32_t HEAP_WARMUP_FRAMES = 300;
+
 static glm::mat4 pushFunction(int frameNumber) {
 	// make a model view matrix for rendering the object
 	//camera position
@@ -45,8 +56,68 @@ static glm::mat4 pushFunction(int frameNumber) {
 	return mesh_matrix;
 }
 
+//the deletion queue's calls into Vulkan
+static void destroy_object(const DeletionRecord& record, void* context)
+{
+	VulkanEngine* engine = static_cast<VulkanEngine*>(context);
+	VkDevice device = engine->_device;
+	switch (record.type) {
+	case DeletionType::Buffer:
+		vmaDestroyBuffer(engine->_allocator, DeletionQueue::handle<VkBuffer>(record), static_cast<VmaAllocation>(record.owner));
+		break;
+	case DeletionType::Image:
+		vmaDestroyImage(engine->_allocator, DeletionQueue::handle<VkImage>(record), static_cast<VmaAllocation>(record.owner));
+		break;
+	case DeletionType::ImageView:
+		vkDestroyImageView(device, DeletionQueue::handle<VkImageView>(record), nullptr);
+		break;
+	case DeletionType::Sampler:
+		vkDestroySampler(device, DeletionQueue::handle<VkSampler>(record), nullptr);
+		break;
+	case DeletionType::Framebuffer:
+		vkDestroyFramebuffer(device, DeletionQueue::handle<VkFramebuffer>(record), nullptr);
+		break;
+	case DeletionType::RenderPass:
+		vkDestroyRenderPass(device, DeletionQueue::handle<VkRenderPass>(record), nullptr);
+		break;
+	case DeletionType::Pipeline:
+		vkDestroyPipeline(device, DeletionQueue::handle<VkPipeline>(record), nullptr);
+		break;
+	case DeletionType::PipelineLayout:
+		vkDestroyPipelineLayout(device, DeletionQueue::handle<VkPipelineLayout>(record), nullptr);
+		break;
+	case DeletionType::DescriptorSetLayout:
+		vkDestroyDescriptorSetLayout(device, DeletionQueue::handle<VkDescriptorSetLayout>(record), nullptr);
+		break;
+	case DeletionType::DescriptorPool:
+		vkDestroyDescriptorPool(device, DeletionQueue::handle<VkDescriptorPool>(record), nullptr);
+		break;
+	case DeletionType::DescriptorSet: {
+		VkDescriptorSet set = DeletionQueue::handle<VkDescriptorSet>(record);
+		vkFreeDescriptorSets(device, static_cast<VkDescriptorPool>(record.owner), 1, &set);
+		break;
+	}
+	case DeletionType::CommandPool:
+		vkDestroyCommandPool(device, DeletionQueue::handle<VkCommandPool>(record), nullptr);
+		break;
+	case DeletionType::Fence:
+		vkDestroyFence(device, DeletionQueue::handle<VkFence>(record), nullptr);
+		break;
+	case DeletionType::Semaphore:
+		vkDestroySemaphore(device, DeletionQueue::handle<VkSemaphore>(record), nullptr);
+		break;
+	case DeletionType::Swapchain:
+		vkDestroySwapchainKHR(device, DeletionQueue::handle<VkSwapchainKHR>(record), nullptr);
+		break;
+	case DeletionType::Callback:
+		record.callback(record.owner);
+		break;
+	}
+}
+
 void VulkanEngine::init()
 {
+	auto startTime = std::chrono::high_resolution_clock::now();
 	// We initialize SDL and create a window with it. 
 	SDL_Init(SDL_INIT_VIDEO);
 
@@ -60,6 +131,7 @@ void VulkanEngine::init()
 		_windowExtent.height,
 		window_flags
 	);
+	_mainDeletionQueue.init(FRAME_OVERLAP, destroy_object, this);
 	//load core vulkan structure;
 	init_vulkan();
 
@@ -73,14 +145,30 @@ void VulkanEngine::init()
 	init_framebuffers();
 
 	init_sync_structures();
+
+	_uploadBatcher.init(this, UPLOAD_ARENA_BYTES, UPLOAD_FLUSH_BYTES, UPLOAD_FLUSH_COPIES);
+	_mainDeletionQueue.push([](void* batcher) { static_cast<UploadBatcher*>(batcher)->cleanup(); }, &_uploadBatcher);
+	//samplerAnisotropy is not enabled on the device, the anisotropic preset is plain trilinear
+	_samplerCache.init(_device, 0.0f);
+	_mainDeletionQueue.push([](void* cache) { static_cast<vkutil::SamplerCache*>(cache)->cleanup(); }, &_samplerCache);
 	
 	init_descriptors();
 
+	_textureStreamer.init(this);
+	_textureLoader.init(this);
+	//before the pool goes, after the textures swapped into the material sets
+	_mainDeletionQueue.push([](void* context) {
+		VulkanEngine* engine = static_cast<VulkanEngine*>(context);
+		engine->_textureLoader.cleanup();
+		engine->_textureStreamer.cleanup();
+		}, this);
+
 	init_pipelines();
 
 	//load texture
 	load_mipmap_texture();
 	//load mesh 
+	init_geometry_pool();
 	load_meshes();
 
 	init_scene();
@@ -89,6 +177,25 @@ void VulkanEngine::init()
 	init_imgui();
 	//everything went fine
 	_isInitialized = true;
+	//the last uploads go out now instead of with the first frame, the first frame waits for nothing
+	_uploadBatcher.flush();
+	//with textures.asyncDecode on, pngs are still decoding here and land in the first frames
+	auto endTime = std::chrono::high_resolution_clock::now();
+	std::cout << "Engine initialized in " << std::chrono::duration<float, std::milli>(endTime - startTime).count() << " ms, "
+		<< _textureLoader.pending() << " textures still decoding" << std::endl;
+	//every upload was a submit and a vkQueueWaitIdle of its own before they were batched
+	_textureCache.print_stats("Texture cache");
+	_meshCache.print_stats("Mesh cache");
+	std::cout << "Sampler cache: " << _samplerCache.unique() << " samplers for " << _samplerCache.requests() << " requests" << std::endl;
+	//pngs decode straight into staging and meshes drop their cpu arrays after upload, this is what that keeps down
+	const vkutil::ImageDecodeStats decodeStats = vkutil::image_decode_stats();
+	std::cout << "Load memory: peak RSS " << vkutil::peak_rss_bytes() / (1024 * 1024) << " MB, now "
+		<< vkutil::current_rss_bytes() / (1024 * 1024) << " MB, " << decodeStats.inPlace << " images decoded into staging, "
+		<< decodeStats.copied << " copied" << std::endl;
+	const UploadStats& uploadStats = _uploadBatcher.stats();
+	std::cout << "Startup uploads: " << uploadStats.uploads << " uploads (" << uploadStats.copies << " copies, "
+		<< uploadStats.bytes / (1024.0 * 1024.0) << " MB) in " << uploadStats.submits << " submits, "
+		<< uploadStats.stalls << " waits for staging space" << std::endl;
 }
 
 void VulkanEngine::cleanup()
@@ -97,6 +204,16 @@ void VulkanEngine::cleanup()
 	if (_isInitialized) {
 		// make sure the gpu has stopped doing its things
 		vkDeviceWaitIdle(_device);
+		//a batch still recording copies into images destroyed below, retired ones included
+		_uploadBatcher.wait_idle();
+		//meshes still loaded retire what they own, the flush destroys it ahead of the pool buffers
+		std::vector<std::string> meshNames;
+		for (const auto& mesh : _objectsSet._meshNames) {
+			meshNames.push_back(mesh.first);
+		}
+		for (const std::string& name : meshNames) {
+			unload_mesh(name);
+		}
 		//flush deletion queue and use vkDestroy**
 		_mainDeletionQueue.flush();
 		//Must destroy vma allocator in front of destroy physical device,device and vulkan instance
@@ -131,11 +248,22 @@ void VulkanEngine::cleanup()
 */
 void VulkanEngine::draw()
 {	
+	const uint64_t heapAllocations = vkutil::heap_allocation_count();
 	//call imgui::render()
 	ImGui::Render();
 	//wait until the GPU has finished rendering the last frame. Timeout of 1 second
 	VK_CHECK(vkWaitForFences(_device, 1, &get_current_frame()._renderFence, true, 1000000000));
 	VK_CHECK(vkResetFences(_device, 1, &get_current_frame()._renderFence));
+	//transient cpu data of the frame goes into its arena, started over here
+	get_current_frame()._frameAllocator.reset();
+	//the frame this slot last rendered is done, what was retired before its submit can go
+	_mainDeletionQueue.begin_frame(_frameNumber % FRAME_OVERLAP);
+	//and so is what it pushed into the frame ring
+	_frameRing.begin_frame(_frameNumber % FRAME_OVERLAP);
+	_textureLoader.update();
+	_textureStreamer.update();
+	//the uploads recorded this frame go ahead of the frame's own submit on the same queue
+	_uploadBatcher.flush();
 
 	//request image from the swapchain, one second timeout
 	uint32_t swapchainImageIndex;
@@ -147,6 +275,13 @@ void VulkanEngine::draw()
 		&swapchainImageIndex));
 	//now that we are sure that the commands finished executing,
 	record_cmdbuffers(get_current_frame()._mainCommandBuffer, swapchainImageIndex);
+	//what the frame pushed into the ring becomes visible to the gpu with the submit, flushed in one go
+	RangeAllocation ringRanges[2];
+	const uint32_t ringRangeCount = _frameRing.pending_ranges(ringRanges);
+	for (uint32_t i = 0; i < ringRangeCount; i++) {
+		vmaFlushAllocation(_allocator, _frameRingBuffer._allocation, ringRanges[i].offset, ringRanges[i].size);
+	}
+	_frameRing.end_frame(_frameNumber % FRAME_OVERLAP);
 
 	//prepare the submission to the queue.
 	//we want to wait on the _presentSemaphore, as that semaphore is signaled when the swapchain is ready
@@ -172,6 +307,8 @@ void VulkanEngine::draw()
 	//submit command buffer to the queue and execute it.
 	// _renderFence will now block until the graphic commands finish execution
 	VK_CHECK(vkQueueSubmit(_graphicsQueue, 1, &submit, get_current_frame()._renderFence));
+	//objects retired up to here wait for this submit's fence
+	_mainDeletionQueue.end_frame(_frameNumber % FRAME_OVERLAP);
 	// this will put the image we just rendered into the visible window.
 	// we want to wait on the _renderSemaphore for that,
 	// as it's necessary that drawing commands have finished before the image is displayed to the user
@@ -189,6 +326,13 @@ void VulkanEngine::draw()
 
 	VK_CHECK(vkQueuePresentKHR(_graphicsQueue, &presentInfo));
 
+	//once loads and streaming settle a frame should not touch the heap
+	_frameHeapAllocations = vkutil::heap_allocation_count() - heapAllocations;
+#ifdef COUNT_HEAP_ALLOCATIONS
+	if (_frameNumber >= HEAP_WARMUP_FRAMES && _frameHeapAllocations > 0) {
+		std::cout << "Frame " << _frameNumber << " made " << _frameHeapAllocations << " heap allocations after warm-up" << std::endl;
+	}
+#endif
 	//increase the number of frames drawn
 	_frameNumber++;
 }
@@ -226,6 +370,22 @@ void VulkanEngine::run()
 
 		//imgui commands
 		ImGui::ShowDemoWindow();
+		const ResidencyStats& streaming = _textureStreamer.stats();
+		ImGui::Begin("Texture streaming");
+		ImGui::Text("resident %.1f MB, committed %.1f MB, budget %.1f MB", streaming.residentBytes / 1048576.0,
+			streaming.committedBytes / 1048576.0, streaming.budgetBytes / 1048576.0);
+		ImGui::Text("below desired %u, in flight %u", streaming.texturesBelowDesired, streaming.inFlight);
+		ImGui::Text("stream ins %llu, evictions %llu", (unsigned long long)streaming.streamIns, (unsigned long long)streaming.evictions);
+		ImGui::Text("texture set binds %u, %zu textures in arrays", _textureSetBinds, _arrayTextures.size());
+		const RingAllocatorStats& ring = _frameRing.stats();
+		ImGui::Text("frame ring %.1f KB used, high water %.1f KB of %.1f KB, %llu wraps", ring.usedBytes / 1024.0,
+			ring.highWater / 1024.0, ring.capacity / 1024.0, (unsigned long long)ring.wraps);
+		const FrameAllocatorStats& arena = get_current_frame()._frameAllocator.stats();
+		ImGui::Text("frame arena high water %.1f KB of %.1f KB, %u grows", arena.highWater / 1024.0, arena.capacity / 1024.0, arena.grows);
+		if (vkutil::heap_allocations_counted()) {
+			ImGui::Text("heap allocations last frame %llu", (unsigned long long)_frameHeapAllocations);
+		}
+		ImGui::End();
 
 		//your draw function
 		draw();
@@ -288,10 +448,7 @@ void VulkanEngine::init_vulkan() {
 	//initialize the memory allocator based on GPU(physical device),device and Vulkan instance
 	VmaAllocatorCreateInfo allocatorInfo = vkinit::vmaAllocator_create_info(_chosenGPU, _device, _instance);
 	VK_CHECK(vmaCreateAllocator(&allocatorInfo, &_allocator));
-	_mainDeletionQueue.push_function([=]() {
-		vmaDestroyAllocator(_allocator);
-		std::cout << "_allocator" << std::endl;
-		});
+	_mainDeletionQueue.push([](void* allocator) { vmaDestroyAllocator(static_cast<VmaAllocator>(allocator)); }, _allocator);
 }
 
 void VulkanEngine::init_imgui()
@@ -354,10 +511,8 @@ void VulkanEngine::init_imgui()
 	ImGui_ImplVulkan_DestroyFontUploadObjects();
 
 	//add the destroy the imgui created structures
-	_mainDeletionQueue.push_function([=]() {
-		vkDestroyDescriptorPool(_device, imguiPool, nullptr);
-		ImGui_ImplVulkan_Shutdown();
-		});
+	_mainDeletionQueue.push(imguiPool);
+	_mainDeletionQueue.push([](void*) { ImGui_ImplVulkan_Shutdown(); }, nullptr);
 }
 
 void VulkanEngine::init_swapchain() {
@@ -387,10 +542,7 @@ void VulkanEngine::init_swapchain() {
 	_swapchainImageFormat = vkbSwapchain.image_format;
 
 	//create _swapchain and then must push destroy swapchain funtion into deletion queue
-	_mainDeletionQueue.push_function([=]() {
-		vkDestroySwapchainKHR(_device, _swapchain, nullptr);
-		std::cout << "_swapchain" << std::endl;
-		});
+	_mainDeletionQueue.push(_swapchain);
 
 	//depth image size will match the window
 	VkExtent3D depthImageExtent = {
@@ -416,11 +568,9 @@ void VulkanEngine::init_swapchain() {
 
 	//allocate and create the image
 	VK_CHECK(vmaCreateImage(_allocator, &dimg_info, &dimg_allocinfo, &_depthImage._image, &_depthImage._allocation, nullptr));
+	_depthImage._format = _depthFormat;
 	//add to deletion queues
-	_mainDeletionQueue.push_function([=]() {
-		vmaDestroyImage(_allocator, _depthImage._image, _depthImage._allocation);
-		std::cout << "_depth image" << std::endl;
-		});
+	_mainDeletionQueue.push(_depthImage._image, _depthImage._allocation);
 	//build an image-view for the depth image to use for rendering
 	VkImageViewCreateInfo dview_info = vkinit::imageview_create_info(_depthImage._image,
 		_depthFormat,
@@ -430,10 +580,7 @@ void VulkanEngine::init_swapchain() {
 	VK_CHECK(vkCreateImageView(_device, &dview_info, nullptr, &_depthImageView));
 
 	//add to deletion queues
-	_mainDeletionQueue.push_function([=]() {
-		vkDestroyImageView(_device, _depthImageView, nullptr);
-		std::cout << "_depth image view" << std::endl;
-		});
+	_mainDeletionQueue.push(_depthImageView);
 
 }
 
@@ -441,10 +588,7 @@ void VulkanEngine::init_commands() {
 	//create upload context command pool
 	VkCommandPoolCreateInfo uploadContextPoolInfo = vkinit::command_pool_create_info(_graphicsQueueFamily);
 	VK_CHECK(vkCreateCommandPool(_device, &uploadContextPoolInfo, nullptr, &_uploadContext._commandPool));
-	_mainDeletionQueue.push_function([=]() {
-		vkDestroyCommandPool(_device, _uploadContext._commandPool, nullptr);
-		std::cout << "_upload context command pool" << std::endl;
-		});
+	_mainDeletionQueue.push(_uploadContext._commandPool);
 	//allocate the default command buffer that we will use for the instant commands
 	VkCommandBufferAllocateInfo cmdAllocInfo = vkinit::command_buffer_allocate_info(_uploadContext._commandPool, 1);
 	//VkCommandBuffer cmd;
@@ -461,11 +605,9 @@ void VulkanEngine::init_commands() {
 		VkCommandBufferAllocateInfo cmdAllocInfo = vkinit::command_buffer_allocate_info(_frames[i]._commandPool, 1);
 
 		VK_CHECK(vkAllocateCommandBuffers(_device, &cmdAllocInfo, &_frames[i]._mainCommandBuffer));
+		_frames[i]._frameAllocator.reserve(FRAME_ALLOCATOR_BYTES);
 
-		_mainDeletionQueue.push_function([=]() {
-			vkDestroyCommandPool(_device, _frames[i]._commandPool, nullptr);
-			std::cout << "frame["<<i<<"] command pool" << std::endl;
-			});
+		_mainDeletionQueue.push(_frames[i]._commandPool);
 	}
 }
 
@@ -582,10 +724,7 @@ void VulkanEngine::init_default_renderpass() {
 
 	VK_CHECK(vkCreateRenderPass(_device, &render_pass_info, nullptr, &_renderPass));
 	//After create object must push destroy function into deletion queue
-	_mainDeletionQueue.push_function([=]() {
-		vkDestroyRenderPass(_device, _renderPass, nullptr);
-		std::cout << "render pass" << std::endl;
-		});
+	_mainDeletionQueue.push(_renderPass);
 
 }
 
@@ -618,12 +757,8 @@ void VulkanEngine::init_framebuffers() {
 		VK_CHECK(vkCreateFramebuffer(_device, &fb_info, nullptr, &_framebuffers[i]));
 		//After create object must push destroy function into deletion queue
 		//swapchain image view also should destroy when destroy framebuffers
-		_mainDeletionQueue.push_function([=]() {
-			vkDestroyFramebuffer(_device, _framebuffers[i], nullptr);
-			vkDestroyImageView(_device, _swapchainImageViews[i], nullptr);
-			std::cout << "frame buffers" << std::endl;
-			std::cout << "swapchain image views" << std::endl;
-			});
+		_mainDeletionQueue.push(_swapchainImageViews[i]);
+		_mainDeletionQueue.push(_framebuffers[i]);
 	}
 }
 
@@ -631,10 +766,7 @@ void VulkanEngine::init_sync_structures() {
 	//create vertex mesh upload fence
 	VkFenceCreateInfo uploadFenceCreateInfo = vkinit::fence_create_info();
 	VK_CHECK(vkCreateFence(_device, &uploadFenceCreateInfo, nullptr, &_uploadContext._uploadFence));
-	_mainDeletionQueue.push_function([=]() {
-		vkDestroyFence(_device, _uploadContext._uploadFence, nullptr);
-		std::cout << " _uploadContext._uploadFence" << std::endl;
-		});
+	_mainDeletionQueue.push(_uploadContext._uploadFence);
 	//create synchronization structures
 	//we want to create the fence with the Create Signaled flag, 
 	//so we can wait on it before using it on a GPU command (for the first frame)
@@ -644,22 +776,13 @@ void VulkanEngine::init_sync_structures() {
 	{
 		VK_CHECK(vkCreateFence(_device, &fenceCreateInfo, nullptr, &_frames[i]._renderFence));
 		//After create object must push destroy function into deletion queue
-		_mainDeletionQueue.push_function([=]() {
-			vkDestroyFence(_device, _frames[i]._renderFence, nullptr);
-			std::cout << "_frames["<<i<<"]._renderFence" << std::endl;
-			});
+		_mainDeletionQueue.push(_frames[i]._renderFence);
 		VK_CHECK(vkCreateSemaphore(_device, &semaphoreCreateInfo, nullptr, &_frames[i]._presentSemaphore));
 		//After create object must push destroy function into deletion queue
-		_mainDeletionQueue.push_function([=]() {
-			vkDestroySemaphore(_device, _frames[i]._presentSemaphore, nullptr);
-			std::cout << "_frames[" << i << "]._presentSemaphore" << std::endl;
-			});
+		_mainDeletionQueue.push(_frames[i]._presentSemaphore);
 		VK_CHECK(vkCreateSemaphore(_device, &semaphoreCreateInfo, nullptr, &_frames[i]._renderSemaphore));
 		//After create object must push destroy function into deletion queue
-		_mainDeletionQueue.push_function([=]() {
-			vkDestroySemaphore(_device, _frames[i]._renderSemaphore, nullptr);
-			std::cout << "_frames[" << i << "]._renderSemaphore" << std::endl;
-			});
+		_mainDeletionQueue.push(_frames[i]._renderSemaphore);
 	}
 }
 
@@ -686,7 +809,7 @@ void VulkanEngine::record_cmdbuffers(VkCommandBuffer& cmd, uint32_t imageIndex)
 	//clear depth at 1
 	VkClearValue depthClear;
 	depthClear.depthStencil.depth = 1.f;
-	std::vector<VkClearValue> _clearValue{
+	VkClearValue clearValues[2] = {
 		clearValue,depthClear
 	};
 
@@ -704,8 +827,8 @@ void VulkanEngine::record_cmdbuffers(VkCommandBuffer& cmd, uint32_t imageIndex)
 	rpInfo.framebuffer = _framebuffers[imageIndex];
 
 	//connect clear values
-	rpInfo.clearValueCount = _clearValue.size();
-	rpInfo.pClearValues = _clearValue.data();
+	rpInfo.clearValueCount = 2;
+	rpInfo.pClearValues = clearValues;
 
 	vkCmdBeginRenderPass(cmd, &rpInfo, VK_SUBPASS_CONTENTS_INLINE);
 
@@ -781,8 +904,9 @@ void VulkanEngine::init_descriptors() {
 	// set0 binding point 0
 	// it's a uniform buffer binding
 	// we use it from the vertex shader
+	//the camera and the two below live in the frame ring, where the frame put them is the dynamic offset
 	VkDescriptorSetLayoutBinding camBufferBinding = vkinit::descriptorset_layout_binding(
-		VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0
+		VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 0
 	);
 	// set0 binding point 1
 	// it's a dynamic uniform buffer binding
@@ -797,7 +921,7 @@ void VulkanEngine::init_descriptors() {
 	// it's a storage buffer binding
 	// we use it from the vertex shader
 	VkDescriptorSetLayoutBinding objectBufferBinding = vkinit::descriptorset_layout_binding(
-		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
 		VK_SHADER_STAGE_VERTEX_BIT,
 		0
 	);
@@ -821,10 +945,7 @@ void VulkanEngine::init_descriptors() {
 	);
 	VK_CHECK(vkCreateDescriptorSetLayout(_device, &globalSetinfo, nullptr, &_globalSetLayout));
 	// add descriptor set layout to deletion queues
-	_mainDeletionQueue.push_function([&]() {
-		vkDestroyDescriptorSetLayout(_device, _globalSetLayout, nullptr);
-		std::cout << "_globalSetLayout" << std::endl;
-		});
+	_mainDeletionQueue.push(_globalSetLayout);
 	
 	//create objects descriptor set layout
 	std::vector<VkDescriptorSetLayoutBinding> objectLayoutBindSet{
@@ -834,10 +955,7 @@ void VulkanEngine::init_descriptors() {
 		objectLayoutBindSet.size(), objectLayoutBindSet.data()
 	);
 	VK_CHECK(vkCreateDescriptorSetLayout(_device, &objectSetInfo, nullptr, &_objectSetLayout));
-	_mainDeletionQueue.push_function([&]() {
-		vkDestroyDescriptorSetLayout(_device, _objectSetLayout, nullptr);
-		std::cout << "_objectSetLayout" << std::endl;
-		});
+	_mainDeletionQueue.push(_objectSetLayout);
 	
 
 	//create texture descriptor set layout
@@ -849,10 +967,7 @@ void VulkanEngine::init_descriptors() {
 	);
 	//_singleTextureSetLayout = _descriptorLayoutCache.create_descriptor_layout(&textureSetInfo);
 	VK_CHECK(vkCreateDescriptorSetLayout(_device, &textureSetInfo, nullptr, &_singleTextureSetLayout));
-	_mainDeletionQueue.push_function([&]() {
-		vkDestroyDescriptorSetLayout(_device, _singleTextureSetLayout, nullptr);
-		std::cout << "_singleTextureSetLayout" << std::endl;
-		});
+	_mainDeletionQueue.push(_singleTextureSetLayout);
 	
 	//create a descriptor pool that will hold 10 uniform buffers
 	std::vector<VkDescriptorPoolSize> sizes =
@@ -860,56 +975,50 @@ void VulkanEngine::init_descriptors() {
 		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10 },
 		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 10 },
 		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 10},
-		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,10}
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 10},
+		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,10 + MAX_MATERIAL_SETS + MAX_STREAMING_SETS + MAX_TEXTURE_ARRAYS}
 	};
 	VkDescriptorPoolCreateInfo pool_info = vkinit::descriptor_pool_create_info(
 		sizes.data(), (uint32_t)sizes.size()
 	);
+	pool_info.maxSets += MAX_MATERIAL_SETS + MAX_STREAMING_SETS + MAX_TEXTURE_ARRAYS;
+	//the streamer frees the texture sets it replaced
+	pool_info.flags |= VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
 	vkCreateDescriptorPool(_device, &pool_info, nullptr, &_descriptorPool);
 	// add descriptor set layout to deletion queues
-	_mainDeletionQueue.push_function([&]() {
-		vkDestroyDescriptorPool(_device, _descriptorPool, nullptr);
-		std::cout << "_descriptorPool" << std::endl;
-		});
+	_mainDeletionQueue.push(_descriptorPool);
 	
-	//create scene dynamic buffer
-	//get buffer size based on frame numbers and aligement size
-	const size_t sceneParamBufferSize = FRAME_OVERLAP * pad_uniform_buffer_size(sizeof(GPUSceneData));
-	_sceneObject._sceneParameterBuffer = create_buffer(
+	//one persistently mapped buffer for the transient data of every frame in flight, suballocated by the frame ring
+	//a dynamic descriptor reads its whole range from the offset, the tail past the ring keeps the largest range
+	//inside the buffer wherever an allocation lands
+	const VkDeviceSize frameRingTail = sizeof(GPUObjectData) * MAX_OBJECTS;
+	_frameRingBuffer = create_buffer(
 		false,
-		sceneParamBufferSize,
-		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-		VMA_MEMORY_USAGE_CPU_TO_GPU
+		FRAME_RING_BYTES + frameRingTail,
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VMA_MEMORY_USAGE_CPU_TO_GPU,
+		VMA_ALLOCATION_CREATE_MAPPED_BIT
 	);
+	RingAllocatorLimits ringLimits;
+	ringLimits.minUniformBufferOffsetAlignment = _gpuProperties.limits.minUniformBufferOffsetAlignment;
+	ringLimits.minStorageBufferOffsetAlignment = _gpuProperties.limits.minStorageBufferOffsetAlignment;
+	ringLimits.optimalBufferCopyOffsetAlignment = _gpuProperties.limits.optimalBufferCopyOffsetAlignment;
+	_frameRing.reset(FRAME_RING_BYTES, FRAME_OVERLAP, ringLimits);
 	for (size_t i = 0; i < FRAME_OVERLAP; i++) {
-		//create storage object data buffer
-		const size_t MAX_OBJECTS_NUM = 10000;
-		_frames[i].objectBuffer = create_buffer(
-			false,
-			sizeof(GPUObjectData) * MAX_OBJECTS_NUM,
-			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-			VMA_MEMORY_USAGE_CPU_TO_GPU
-		);
-		//create camera buffer(uniform buffer)
-		_frames[i].cameraBuffer = create_buffer(
-			false,
-			sizeof(GPUCameraData),
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VMA_MEMORY_USAGE_CPU_TO_GPU
-		);
 		//information about the buffer we want to point at in the descriptor
 		//descriptor connect to source(uniform buffer)
 		//descriptor buffer info is a point of buffer
 		//descriptor include info of source(buffer,image,imageview)
+		//every set points at the start of the ring, the offsets come with the bind
 		VkDescriptorBufferInfo cameraBuffer = vkinit::descriptor_buffer_info(
-			_frames[i].cameraBuffer._buffer, 0, sizeof(GPUCameraData)
+			_frameRingBuffer._buffer, 0, sizeof(GPUCameraData)
 		);
 		VkDescriptorBufferInfo sceneBuffer = vkinit::descriptor_buffer_info(
-			_sceneObject._sceneParameterBuffer._buffer, 0, sizeof(GPUSceneData)
+			_frameRingBuffer._buffer, 0, sizeof(GPUSceneData)
 		);
 		// storage buffer(object buffer) descriptor info
 		VkDescriptorBufferInfo objectBuffer = vkinit::descriptor_buffer_info(
-			_frames[i].objectBuffer._buffer, 0, sizeof(GPUObjectData) * MAX_OBJECTS_NUM
+			_frameRingBuffer._buffer, 0, frameRingTail
 		);
 
 		/*_frames[i]._globalDescrptorAllocator.init(_device);
@@ -938,7 +1047,7 @@ void VulkanEngine::init_descriptors() {
 		vkAllocateDescriptorSets(_device, &objectAllocInfo, &_frames[i].objectDescriptor);
 		
 		VkWriteDescriptorSet cameraWrite = vkinit::write_descriptor_buffer(
-			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
 			_frames[i].globalDescriptor,
 			&cameraBuffer,
 			0
@@ -950,7 +1059,7 @@ void VulkanEngine::init_descriptors() {
 			1
 		);
 		VkWriteDescriptorSet objectWrite = vkinit::write_descriptor_buffer(
-			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
 			_frames[i].objectDescriptor,
 			&objectBuffer,
 			0
@@ -980,6 +1089,24 @@ void VulkanEngine::init_pipelines() {
 	else {
 		std::cout << "textured fragemnet shader successfully loaded" << std::endl;
 	}
+	VkShaderModule compactVertexShader;
+	if (!load_shader_module((SHADER_SOURCE_PATH + "tri_mesh_compact.vert.spv").c_str(), &compactVertexShader))
+	{
+		std::cout << "Error when building the compact vertex shader module" << std::endl;
+	}
+	else {
+		std::cout << "compact vertex shader successfully loaded" << std::endl;
+	}
+	//without it the textures packed into arrays load one by one
+	VkShaderModule textureArrayShader = VK_NULL_HANDLE;
+	if (!load_shader_module((SHADER_SOURCE_PATH + "textured_array.frag.spv").c_str(), &textureArrayShader))
+	{
+		std::cout << "Error when building the texture array shader" << std::endl;
+		textureArrayShader = VK_NULL_HANDLE;
+	}
+	else {
+		std::cout << "texture array fragment shader successfully loaded" << std::endl;
+	}
 
 	//build the pipeline layout that controls the inputs / outputs of the shader
 	//we are not using descriptor sets or other systems yet, so no need to use anything other than empty default
@@ -993,8 +1120,8 @@ void VulkanEngine::init_pipelines() {
 	push_constant.offset = 0;
 	//this push constant range takes up the size of a MeshPushConstants struct
 	push_constant.size = sizeof(MeshPushConstants);
-	//this push constant range is accessible only in the vertex shader
-	push_constant.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	//the vertex shaders read the matrix, the texture array fragment shader reads data
+	push_constant.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
 
 	mesh_pipeline_layout_info.pPushConstantRanges = &push_constant;
 	mesh_pipeline_layout_info.pushConstantRangeCount = 1;
@@ -1009,9 +1136,7 @@ void VulkanEngine::init_pipelines() {
 
 	VK_CHECK(vkCreatePipelineLayout(_device, &mesh_pipeline_layout_info, nullptr, &_meshPipelineLayout));
 	//remember to destroy the pipeline layout
-	_mainDeletionQueue.push_function([=]() {
-		vkDestroyPipelineLayout(_device, _meshPipelineLayout, nullptr);
-		});
+	_mainDeletionQueue.push(_meshPipelineLayout);
 
 	//build the stage-create-info for both vertex and fragment stages. This lets the pipeline know the shader modules per stage
 	PipelineBuilder pipelineBuilder;
@@ -1066,9 +1191,7 @@ void VulkanEngine::init_pipelines() {
 	VkPipelineLayout texturePipelineLayout;
 	VK_CHECK(vkCreatePipelineLayout(_device, &texture_pipeline_layout_info, nullptr, &texturePipelineLayout));
 	//remember to destroy the pipeline layout
-	_mainDeletionQueue.push_function([=]() {
-		vkDestroyPipelineLayout(_device, texturePipelineLayout, nullptr);
-		});
+	_mainDeletionQueue.push(texturePipelineLayout);
 	pipelineBuilder._pipelineLayout = texturePipelineLayout;
 	pipelineBuilder._shaderStages.clear();
 	pipelineBuilder._shaderStages.push_back(
@@ -1078,94 +1201,294 @@ void VulkanEngine::init_pipelines() {
 		vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, texturedMeshShader)
 	);
 	VkPipeline texPipeline = pipelineBuilder.build_pipeline(_device, _renderPass);
-	_mainDeletionQueue.push_function([=]() {
-		vkDestroyPipeline(_device, texPipeline, nullptr);
-		});
+	_mainDeletionQueue.push(texPipeline);
 	_objectsSet.create_material(texPipeline,texturePipelineLayout, "texturedmesh");
 
+	//same textured pipeline reading CompactVertex
+	VertexInputDescription compactDescription = CompactVertex::get_vertex_description();
+	pipelineBuilder._vertexInputInfo.vertexBindingDescriptionCount = compactDescription.bindings.size();
+	pipelineBuilder._vertexInputInfo.pVertexBindingDescriptions = compactDescription.bindings.data();
+	pipelineBuilder._vertexInputInfo.vertexAttributeDescriptionCount = compactDescription.attributes.size();
+	pipelineBuilder._vertexInputInfo.pVertexAttributeDescriptions = compactDescription.attributes.data();
+	pipelineBuilder._shaderStages[0] =
+		vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, compactVertexShader);
+	VkPipeline compactTexPipeline = pipelineBuilder.build_pipeline(_device, _renderPass);
+	_mainDeletionQueue.push(compactTexPipeline);
+	_objectsSet.create_material(compactTexPipeline, texturePipelineLayout, "texturedmesh_compact");
+
+	//same textured pipelines sampling a layer of a texture array, with the same layout so the sets stay bound
+	if (textureArrayShader != VK_NULL_HANDLE) {
+		pipelineBuilder._shaderStages[1] =
+			vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, textureArrayShader);
+		VkPipeline compactArrayPipeline = pipelineBuilder.build_pipeline(_device, _renderPass);
+		pipelineBuilder._vertexInputInfo.vertexBindingDescriptionCount = vertexDescrption.bindings.size();
+		pipelineBuilder._vertexInputInfo.pVertexBindingDescriptions = vertexDescrption.bindings.data();
+		pipelineBuilder._vertexInputInfo.vertexAttributeDescriptionCount = vertexDescrption.attributes.size();
+		pipelineBuilder._vertexInputInfo.pVertexAttributeDescriptions = vertexDescrption.attributes.data();
+		pipelineBuilder._shaderStages[0] =
+			vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, triangleVertexShader);
+		VkPipeline arrayPipeline = pipelineBuilder.build_pipeline(_device, _renderPass);
+		_mainDeletionQueue.push(arrayPipeline);
+		_mainDeletionQueue.push(compactArrayPipeline);
+		_objectsSet.create_material(arrayPipeline, texturePipelineLayout, "texturedmesh_array");
+		_objectsSet.create_material(compactArrayPipeline, texturePipelineLayout, "texturedmesh_array_compact");
+		vkDestroyShaderModule(_device, textureArrayShader, nullptr);
+	}
+
 
 	//destroy shadermodule
 	//destroy all shader modules, outside of the queue
 	vkDestroyShaderModule(_device, triangleVertexShader, nullptr);
 	vkDestroyShaderModule(_device, texturedMeshShader, nullptr);
+	vkDestroyShaderModule(_device, compactVertexShader, nullptr);
 
 }
 
 void VulkanEngine::load_meshes() {
+	//const std::string meshFile = ASSERT_SOURCE_PATH + "lost_empire.obj";
+	const std::string meshFile = "D:/VulKan/Vulkanstart/models/viking_room.obj";
+	load_mesh(meshFile, "empire");
+}
 
-	Mesh _lostEmpire;
-	
-	//_lostEmpire.load_from_obj((ASSERT_SOURCE_PATH + "lost_empire.obj").c_str());
-	_lostEmpire.load_from_obj("D:/VulKan/Vulkanstart/models/viking_room.obj");
-	//upload lost empire object
-	upload_mesh(_lostEmpire);
+bool VulkanEngine::load_mesh(const std::string& meshFile, const std::string& name) {
+	//keyed by the file that is loaded, the cooked one when there is one
+	const std::string cookedFile = assets::cooked_path(meshFile, ".mesh");
+	ContentKey key;
+	std::string keyedFile;
+	for (const std::string& candidate : { cookedFile, meshFile }) {
+		if (file_content_key(candidate.c_str(), key)) {
+			keyedFile = candidate;
+			break;
+		}
+	}
+	const bool keyed = !keyedFile.empty();
+	if (keyed) {
+		const std::string* loaded = _meshCache.find(key, keyedFile);
+		const MeshHandle owner = loaded ? _objectsSet.get_mesh(*loaded) : MeshHandle{};
+		if (_objectsSet._meshes.contains(owner)) {
+			//the name reaches the owner's mesh, its buffers go back with the last name
+			if (_objectsSet.get_mesh(name) != owner) {
+				retire_replaced_mesh(name);
+			}
+			_objectsSet.alias_mesh(name, owner);
+			_meshCache.alias(name, *loaded, key.size);
+			return true;
+		}
+	}
 
-	_objectsSet._meshes["empire"] = _lostEmpire;
+	Mesh mesh;
+	auto startTime = std::chrono::high_resolution_clock::now();
+	//prefer the mesh cooked by asset_cooker, fall back to parsing the obj text
+	if (!mesh.load_from_asset(cookedFile.c_str())) {
+		if (!mesh.load_from_obj(meshFile.c_str())) {
+			std::cerr << "Failed to load mesh " << meshFile << std::endl;
+			return false;
+		}
+		//cooked meshes carry their LOD chain, the obj path has to build it here
+		float lodTime = vkutil::generate_lods(mesh, DEFAULT_LOD_RATIOS.data(), DEFAULT_LOD_RATIOS.size());
+		std::cout << "LODs: " << mesh._lods.size() << " levels in " << lodTime << " ms" << std::endl;
+	}
+	auto endTime = std::chrono::high_resolution_clock::now();
+	std::cout << "load_meshes: " << std::chrono::duration<float, std::milli>(endTime - startTime).count() << " ms" << std::endl;
+	if (_compactVertices) {
+		mesh.quantize_vertices();
+		QuantizationError error = mesh.measure_quantization_error();
+		std::cout << "Compact vertices: " << mesh._vertices.size() * sizeof(Vertex) << " -> "
+			<< mesh.vertex_buffer_size() << " bytes, max error position " << error.position
+			<< " normal " << error.normal << " deg uv " << error.uv << std::endl;
+		if (!error.within_tolerance(mesh.position_step())) {
+			std::cout << "Compact vertices of " << name << " are out of tolerance, uploading fp32 vertices" << std::endl;
+			mesh.drop_quantized_vertices();
+		}
+	}
+	const Bounds& bounds = mesh._bounds;
+	std::cout << "Bounds: min (" << bounds.min.x << ", " << bounds.min.y << ", " << bounds.min.z << ") max ("
+		<< bounds.max.x << ", " << bounds.max.y << ", " << bounds.max.z << ") radius " << bounds.sphere.w << std::endl;
+	//clusters for meshlet culling, uploaded next to the vertex buffer
+	float meshletTime = vkutil::build_meshlets(mesh);
+	std::cout << "Meshlets: " << mesh._meshlets.size() << " clusters for " << mesh.base_lod().indexCount / 3
+		<< " triangles in " << meshletTime << " ms" << std::endl;
+	upload_mesh(mesh);
+	_geometryPool.print_stats("Geometry pool");
+	//everything the gpu needs went into staging, the cpu copies would stay resident for the life of the engine
+	mesh.release_cpu_geometry();
+
+	retire_replaced_mesh(name);
+	_objectsSet.add_mesh(name, std::move(mesh));
+	if (keyed) {
+		_meshCache.insert(key, name, keyedFile);
+	}
+	//small textures of its materials, when the mesh was cooked with -pack-arrays
+	load_texture_arrays(assets::cooked_path(meshFile, ".texa"));
+	return true;
+}
+
+void VulkanEngine::init_geometry_pool() {
+	//destroyed by the main deletion queue like every other buffer
+	AllocatedBuffer vertexBuffer = create_buffer(false, GEOMETRY_POOL_VERTEX_BYTES,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+	AllocatedBuffer indexBuffer = create_buffer(false, GEOMETRY_POOL_INDEX_BYTES,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+	_geometryPool.init(vertexBuffer, GEOMETRY_POOL_VERTEX_BYTES, indexBuffer, GEOMETRY_POOL_INDEX_BYTES);
 }
 
 void VulkanEngine::upload_mesh(Mesh& mesh) {
-	//upload mesh vertex data to device(gpu) local memory
-	const size_t bufferSize = mesh._vertices.size() * sizeof(Vertex);
-	//create straging buffer storage vertex that load from disk
-	//straging buffer need destroy immediately
-	AllocatedBuffer stagingBuffer = create_buffer(
-		true,
-		bufferSize,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VMA_MEMORY_USAGE_CPU_ONLY);
-	//copy vertex data to straging buffer
-	void* data;
-	vmaMapMemory(_allocator, stagingBuffer._allocation, &data);
-	memcpy(data, mesh._vertices.data(), bufferSize);
-	vmaUnmapMemory(_allocator, stagingBuffer._allocation);
-
-	//create device local memory buffer(vertex buffer)
-	mesh._vertexBuffer = create_buffer(
-		false,
-		bufferSize,
-		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-		VMA_MEMORY_USAGE_GPU_ONLY
-	);
-	//submit copy command buffer->copy straging buffer data to gpu local buffer
-	immediate_submit([=](VkCommandBuffer cmd) {
-		VkBufferCopy bufferCopy;
-		bufferCopy.srcOffset = 0;
-		bufferCopy.dstOffset = 0;
-		bufferCopy.size = bufferSize;
-		vkCmdCopyBuffer(cmd, stagingBuffer._buffer, mesh._vertexBuffer._buffer, 1, &bufferCopy);
-		});
+	//upload mesh vertex and index data to device(gpu) local memory
+	const size_t vertexBufferSize = mesh.vertex_buffer_size();
+	const size_t indexBufferSize = mesh.choose_index_type();
+	const size_t meshletBufferSize = mesh._meshlets.size() * sizeof(Meshlet);
+	const size_t meshletVertexBufferSize = mesh._meshletVertices.size() * sizeof(uint32_t);
+	const size_t meshletTriangleBufferSize = mesh._meshletTriangles.size();
+	const size_t meshletDataSize = meshletBufferSize + meshletVertexBufferSize + meshletTriangleBufferSize;
+	//vertices, indices and meshlet arrays share one range of the upload staging arena, back to back
+	UploadStaging staging = _uploadBatcher.stage(vertexBufferSize + indexBufferSize + meshletDataSize);
+	//copy vertex and index data to straging buffer
+	char* data = staging.data;
+	memcpy(data, mesh.vertex_data(), vertexBufferSize);
+	if (mesh._indexType == VK_INDEX_TYPE_UINT16) {
+		//narrow indices to 16 bit while writing them
+		uint16_t* indexData = (uint16_t*)(data + vertexBufferSize);
+		for (size_t i = 0; i < mesh._indices.size(); i++) {
+			indexData[i] = static_cast<uint16_t>(mesh._indices[i]);
+		}
+	}
+	else {
+		memcpy(data + vertexBufferSize, mesh._indices.data(), indexBufferSize);
+	}
+	char* meshletData = data + vertexBufferSize + indexBufferSize;
+	memcpy(meshletData, mesh._meshlets.data(), meshletBufferSize);
+	memcpy(meshletData + meshletBufferSize, mesh._meshletVertices.data(), meshletVertexBufferSize);
+	memcpy(meshletData + meshletBufferSize + meshletVertexBufferSize, mesh._meshletTriangles.data(), meshletTriangleBufferSize);
+
+	//suballocate the mesh from the shared geometry buffers, draws then address it with firstIndex/vertexOffset
+	const uint32_t vertexStride = mesh._vertexFormat == MeshVertexFormat::Compact ? sizeof(CompactVertex) : sizeof(Vertex);
+	const uint32_t indexSize = mesh._indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	VkDeviceSize vertexDstOffset = 0;
+	VkDeviceSize indexDstOffset = 0;
+	mesh._pooled = _geometryPool.allocate(vertexBufferSize, vertexStride, indexBufferSize, indexSize, mesh._geometry);
+	if (mesh._pooled) {
+		mesh._vertexBuffer = _geometryPool._vertexBuffer;
+		mesh._indexBuffer = _geometryPool._indexBuffer;
+		vertexDstOffset = mesh._geometry.vertices.offset;
+		indexDstOffset = mesh._geometry.indices.offset;
+		mesh._vertexOffset = static_cast<int32_t>(vertexDstOffset / vertexStride);
+		mesh._firstIndex = static_cast<uint32_t>(indexDstOffset / indexSize);
+	}
+	else {
+		//the pool is full, the mesh gets buffers of its own
+		std::cout << "Geometry pool is full, " << vertexBufferSize + indexBufferSize << " bytes get their own buffers" << std::endl;
+		//create device local memory buffer(vertex buffer)
+		mesh._vertexBuffer = create_buffer(
+			true,
+			vertexBufferSize,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VMA_MEMORY_USAGE_GPU_ONLY
+		);
+		//create device local memory buffer(index buffer)
+		mesh._indexBuffer = create_buffer(
+			true,
+			indexBufferSize,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+			VMA_MEMORY_USAGE_GPU_ONLY
+		);
+		mesh._vertexOffset = 0;
+		mesh._firstIndex = 0;
+	}
+	//create device local storage buffers for the meshlets, read by culling shaders
+	//buffers of the mesh's own are retired with it by retire_mesh_geometry, not kept until shutdown
+	if (meshletDataSize > 0) {
+		mesh._meshletBuffer = create_buffer(true, meshletBufferSize,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+		mesh._meshletVertexBuffer = create_buffer(true, meshletVertexBufferSize,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+		mesh._meshletTriangleBuffer = create_buffer(true, meshletTriangleBufferSize,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+	}
+	//record the copies into the upload batch, it is submitted with the other uploads and its staging reclaimed after
+	UploadBufferCopy copies[5];
+	uint32_t copyCount = 0;
+	copies[copyCount++] = { staging.offset, mesh._vertexBuffer._buffer, vertexDstOffset, vertexBufferSize };
+	copies[copyCount++] = { staging.offset + vertexBufferSize, mesh._indexBuffer._buffer, indexDstOffset, indexBufferSize };
+	if (meshletDataSize > 0) {
+		VkDeviceSize meshletOffset = staging.offset + vertexBufferSize + indexBufferSize;
+		copies[copyCount++] = { meshletOffset, mesh._meshletBuffer._buffer, 0, meshletBufferSize };
+		meshletOffset += meshletBufferSize;
+		copies[copyCount++] = { meshletOffset, mesh._meshletVertexBuffer._buffer, 0, meshletVertexBufferSize };
+		meshletOffset += meshletVertexBufferSize;
+		copies[copyCount++] = { meshletOffset, mesh._meshletTriangleBuffer._buffer, 0, meshletTriangleBufferSize };
+	}
+	_uploadBatcher.copy_buffers(staging.buffer, copies, copyCount);
+}
 
-	//remember:must destroy straging buffer
-	vmaDestroyBuffer(_allocator, stagingBuffer._buffer, stagingBuffer._allocation);
+bool VulkanEngine::unload_mesh(const std::string& name) {
+	const MeshHandle handle = _objectsSet.get_mesh(name);
+	if (!_objectsSet._meshes.contains(handle)) {
+		return false;
+	}
+	//aliases draw from the same ranges and buffers, the last name retires them
+	if (_objectsSet.mesh_name_count(handle) == 1) {
+		retire_mesh_geometry(_objectsSet._meshes[handle]);
+	}
+	_objectsSet.remove_mesh(name);
+	_meshCache.remove(name);
+	return true;
+}
+
+void VulkanEngine::retire_replaced_mesh(const std::string& name) {
+	//a mesh only reached through name goes when name is given to another one
+	const MeshHandle previous = _objectsSet.get_mesh(name);
+	if (_objectsSet._meshes.contains(previous) && _objectsSet.mesh_name_count(previous) == 1) {
+		retire_mesh_geometry(_objectsSet._meshes[previous]);
+	}
+}
+
+void VulkanEngine::retire_mesh_geometry(Mesh& mesh) {
+	//frames in flight may still draw the mesh: its pool ranges go back and its own buffers are destroyed
+	//once their fences signalled, until then the next upload_mesh cannot overwrite them
+	if (mesh._pooled) {
+		//the callback needs both ranges, unloading is rare enough for a heap context
+		struct PooledGeometry {
+			GeometryPool* pool;
+			GeometryAllocation geometry;
+		};
+		_mainDeletionQueue.retire([](void* context) {
+			PooledGeometry* pooled = static_cast<PooledGeometry*>(context);
+			pooled->pool->free(pooled->geometry);
+			delete pooled;
+		}, static_cast<void*>(new PooledGeometry{ &_geometryPool, mesh._geometry }));
+		mesh._pooled = false;
+	}
+	else {
+		for (AllocatedBuffer* buffer : { &mesh._vertexBuffer, &mesh._indexBuffer }) {
+			if (buffer->_buffer != VK_NULL_HANDLE) {
+				_mainDeletionQueue.retire(buffer->_buffer, buffer->_allocation);
+			}
+		}
+	}
+	for (AllocatedBuffer* buffer : { &mesh._meshletBuffer, &mesh._meshletVertexBuffer, &mesh._meshletTriangleBuffer }) {
+		if (buffer->_buffer != VK_NULL_HANDLE) {
+			_mainDeletionQueue.retire(buffer->_buffer, buffer->_allocation);
+		}
+	}
+	mesh._vertexBuffer = {};
+	mesh._indexBuffer = {};
+	mesh._meshletBuffer = {};
+	mesh._meshletVertexBuffer = {};
+	mesh._meshletTriangleBuffer = {};
 }
 
 void VulkanEngine::init_scene() {
 	
 	RenderObject map;
 	map.mesh = _objectsSet.get_mesh("empire");
-	map.material = _objectsSet.get_material("texturedmesh");
-	map.transformMatrix = glm::translate(glm::vec3(1.0f));
-
-	_objectsSet._renderables.push_back(map);
+	const Mesh& mapMesh = _objectsSet._meshes[map.mesh];
+	//compact meshes need the pipeline with the matching vertex input
+	map.material = _objectsSet.get_material(
+		mapMesh._vertexFormat == MeshVertexFormat::Compact ? "texturedmesh_compact" : "texturedmesh");
 	
-	//create a sampler for the texture
-	VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_NEAREST);
-	samplerInfo.maxAnisotropy = _gpuProperties.limits.maxSamplerAnisotropy;
-	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-	samplerInfo.unnormalizedCoordinates = VK_FALSE;//使用归一化[0-1)坐标
-	samplerInfo.compareEnable = VK_FALSE;
-	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-	samplerInfo.mipLodBias = 0.0f;
-	samplerInfo.maxLod = static_cast<float>(mipLevels);
-	samplerInfo.minLod = 0.0f;
-	VkSampler blockySampler;
-	VK_CHECK(vkCreateSampler(_device, &samplerInfo, nullptr, &blockySampler));
-	_mainDeletionQueue.push_function([=]() {
-		vkDestroySampler(_device, blockySampler, nullptr);
-		std::cout << "blockySampler" << std::endl;
-		});
-	Material* texturedMat = _objectsSet.get_material("texturedmesh");
+	//point filtered sampler for the texture, shared through the sampler cache
+	VkSampler blockySampler = _samplerCache.get_sampler(vkutil::SamplerPreset::NearestRepeat);
+	Material* texturedMat = &_objectsSet._materials[map.material];
 
 	//allocate the descriptor set for single-texture to use on the material
 	VkDescriptorSetAllocateInfo allocInfo = {};
@@ -1192,6 +1515,52 @@ void VulkanEngine::init_scene() {
 	VkWriteDescriptorSet texture1 = vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, texturedMat->textureSet, &imageBufferInfo, 0);
 
 	vkUpdateDescriptorSets(_device, 1, &texture1, 0, nullptr);
+	bind_texture("empire_diffuse", map.material, blockySampler);
+
+	//one material per .mtl entry, sharing the pipeline of the base material
+	map.submeshMaterials = _objectsSet.create_mesh_materials("empire", mapMesh, texturedMat->pipeline, texturedMat->pipelineLayout);
+	//adding them can move the pool's array
+	texturedMat = &_objectsSet._materials[map.material];
+	//null when the texture array shader is missing
+	Material* arrayMat = _objectsSet._materials.get(_objectsSet.get_material(
+		mapMesh._vertexFormat == MeshVertexFormat::Compact ? "texturedmesh_array_compact" : "texturedmesh_array"));
+	for (size_t m = 0; m < mapMesh._materials.size(); m++) {
+		const MeshMaterial& meshMaterial = mapMesh._materials[m];
+		MaterialHandle submeshHandle = _objectsSet._submeshMaterials[map.submeshMaterials + m];
+		Material* submeshMat = &_objectsSet._materials[submeshHandle];
+		//textures packed into an array share its set, the material only picks the layer
+		auto packed = _arrayTextures.find(meshMaterial.diffuseTexture);
+		if (arrayMat && packed != _arrayTextures.end()) {
+			submeshMat->pipeline = arrayMat->pipeline;
+			submeshMat->textureSet = packed->second.set;
+			submeshMat->textureArrayRect = packed->second.rect;
+			continue;
+		}
+		//bound like the base material, so replacing the texture moves them to the base material's new set
+		if (m >= MAX_MATERIAL_SETS) {
+			submeshMat->textureSet = texturedMat->textureSet;
+			bind_texture("empire_diffuse", submeshHandle, blockySampler);
+			continue;
+		}
+		//untextured materials, and textures that fail to load, keep the base texture
+		std::string textureName = "empire_diffuse";
+		const std::string& diffuse = meshMaterial.diffuseTexture;
+		if (!diffuse.empty() && (_loadedTextures.count(diffuse) || load_mipmap_texture(diffuse, diffuse))) {
+			textureName = diffuse;
+		}
+		vkAllocateDescriptorSets(_device, &allocInfo, &submeshMat->textureSet);
+		VkDescriptorImageInfo materialImageInfo = imageBufferInfo;
+		materialImageInfo.imageView = _loadedTextures[textureName].imageView;
+		//every material asks for its preset, equal ones come back as the same sampler
+		materialImageInfo.sampler = _samplerCache.get_sampler(vkutil::SamplerPreset::NearestRepeat);
+		VkWriteDescriptorSet materialTexture = vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, submeshMat->textureSet, &materialImageInfo, 0);
+		vkUpdateDescriptorSets(_device, 1, &materialTexture, 0, nullptr);
+		bind_texture(textureName, submeshHandle, materialImageInfo.sampler);
+	}
+
+	_objectsSet.add_renderable(map, glm::translate(glm::vec3(1.0f)));
+	//the scene is complete, objects sharing a pipeline and texture set (a packed array among them) draw back to back
+	_objectsSet.sort_renderables();
 }
 
 void VulkanEngine::draw_objects(VkCommandBuffer cmd, RenderObject* first, int count) {
@@ -1205,106 +1574,138 @@ void VulkanEngine::draw_objects(VkCommandBuffer cmd, RenderObject* first, int co
 	//camera view
 	glm::vec3 camPos = { 0.f,-6.0f,-10.0f };
 	//glm::mat4 view = glm::translate(glm::mat4(1.f), camPos);
-	glm::mat4 view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::vec3 eye = { 2.0f, 2.0f, 2.0f };
+	glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 	//camera projection
 	//glm::mat4 projection = glm::perspective(glm::radians(70.f), 1700.f / 900.f, 0.1f, 200.0f);
 	glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)_windowExtent.width / (float)_windowExtent.height, 0.1f, 10.0f);
 	projection[1][1] *= -1;
+	//screen pixels covered by one world unit at distance 1, for LOD selection
+	const float pixelsPerUnit = _windowExtent.height / (2.0f * std::tan(glm::radians(45.0f) * 0.5f));
 	//fill a GPU camera data struct
 	GPUCameraData camData;
 	camData.proj = projection;
 	camData.view = view;
 	camData.viewproj = projection * view;
 
-	//and copy it to the buffer
-	void* data;
-	vmaMapMemory(_allocator, get_current_frame().cameraBuffer._allocation, &data);
-	memcpy(data, &camData, sizeof(GPUCameraData));
-	vmaUnmapMemory(_allocator, get_current_frame().cameraBuffer._allocation);
+	//the object descriptor range holds MAX_OBJECTS matrices
+	count = std::min(count, static_cast<int>(MAX_OBJECTS));
 	float framed = (_frameNumber / 120.f);
 
 	_sceneObject._sceneParameters.ambientColor = { sin(framed),0,cos(framed),1 };
 
-	char* sceneData;
-	vmaMapMemory(_allocator, _sceneObject._sceneParameterBuffer._allocation, (void**)&sceneData);
-
-	int frameIndex = _frameNumber % FRAME_OVERLAP;
-
-	sceneData += pad_uniform_buffer_size(sizeof(GPUSceneData)) * frameIndex;
-
+	//and copy them into the frame ring, draw() flushes the frame's range before the submit
+	//set 0 takes the camera and scene offsets in binding order, set 1 the object offset
+	uint32_t globalOffsets[2];
+	uint32_t objectOffset;
+	GPUCameraData* cameraData = (GPUCameraData*)push_frame_data(sizeof(GPUCameraData), RingUsage::Uniform, globalOffsets[0]);
+	GPUSceneData* sceneData = (GPUSceneData*)push_frame_data(sizeof(GPUSceneData), RingUsage::Uniform, globalOffsets[1]);
+	GPUObjectData* objectSSBO = (GPUObjectData*)push_frame_data(sizeof(GPUObjectData) * count, RingUsage::Storage, objectOffset);
+	if (!cameraData || !sceneData || !objectSSBO) {
+		std::cerr << "Frame ring is full, skipping the frame's objects" << std::endl;
+		return;
+	}
+	memcpy(cameraData, &camData, sizeof(GPUCameraData));
 	memcpy(sceneData, &_sceneObject._sceneParameters, sizeof(GPUSceneData));
 
-	vmaUnmapMemory(_allocator, _sceneObject._sceneParameterBuffer._allocation);
-
-	//copy object transformMatrix to object buffer model matrix
-	void* objectData;
-	vmaMapMemory(_allocator, get_current_frame().objectBuffer._allocation, &objectData);
-	GPUObjectData* objectSSBO = (GPUObjectData*)objectData;
+	//first points into _objectsSet._renderables, the spin moves every object and set_transform carries its bounds along
+	const uint32_t firstIndex = static_cast<uint32_t>(first - _objectsSet._renderables.data());
 	for (int i = 0; i < count; i++) {
-		RenderObject& object = first[i];
-		//objectSSBO[i].modelMatrix = object.transformMatrix;
-		objectSSBO[i].modelMatrix = model;
+		_objectsSet.set_transform(firstIndex + i, model);
 	}
-	vmaUnmapMemory(_allocator, get_current_frame().objectBuffer._allocation);
 
-	Mesh* lastMesh = nullptr;
-	Material* lastMaterial = nullptr;
+	VkBuffer lastVertexBuffer = VK_NULL_HANDLE;
+	VkBuffer lastIndexBuffer = VK_NULL_HANDLE;
+	VkIndexType lastIndexType = VK_INDEX_TYPE_UINT32;
+	const Material* lastMaterial = nullptr;
+	VkDescriptorSet lastTextureSet = VK_NULL_HANDLE;
+	_textureSetBinds = 0;
 	for (int i = 0; i < count; i++)
 	{
 		//get a render object from objects set render table;
 		RenderObject& object = first[i];
-		//objectSSBO[i].modelMatrix = object.transformMatrix;
-
-		//only bind the pipeline if it doesn't match with the already bound one
-		//if material(pipeline and pipeline yaout) is same,must not bind pipeline again!
-		if (object.material != lastMaterial) {
-
-			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipeline);
-			lastMaterial = object.material;
-			//offset for our scene buffer based on frame index
-			uint32_t uniform_offset = pad_uniform_buffer_size(sizeof(GPUSceneData)) * frameIndex;
-			//bind the descriptor set when changing pipeline
-			//bind the global descriptor set in pipeline layout 0 index
-			vkCmdBindDescriptorSets(cmd,VK_PIPELINE_BIND_POINT_GRAPHICS,
-				object.material->pipelineLayout,0,1,
-				&get_current_frame().globalDescriptor,1,&uniform_offset);
-			//bind the object descriptor set in pipeline layout 1 index
-			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
-				object.material->pipelineLayout, 1, 1,
-				&get_current_frame().objectDescriptor, 0, nullptr);
-			//bind the texture descriptor set in pipeline layout 2 index
-			if (object.material->textureSet != VK_NULL_HANDLE) {
-				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
-					object.material->pipelineLayout, 2, 1, &object.material->textureSet, 0, nullptr);
-			};
-			//_descriptorLayoutCache.
+		//removing a mesh or material takes its objects out of the set, the handles here are live
+		const Mesh* mesh = &_objectsSet._meshes[object.mesh];
+		const glm::mat4& objectModel = object.transformMatrix;
+		//compact meshes fold their position dequantization into the model matrix
+		objectSSBO[i].modelMatrix = objectModel * mesh->_positionDequantize;
+		//pooled meshes share one vertex and index buffer, so these only bind once per frame
+		//(plus once per index type change), meshes outside the pool rebind
+		if (mesh->_vertexBuffer._buffer != lastVertexBuffer) {
+			VkDeviceSize offset = 0;
+			vkCmdBindVertexBuffers(cmd, 0, 1, &mesh->_vertexBuffer._buffer, &offset);
+			lastVertexBuffer = mesh->_vertexBuffer._buffer;
+		}
+		if (mesh->_indexBuffer._buffer != lastIndexBuffer || mesh->_indexType != lastIndexType) {
+			//its index type was chosen when uploading, the mesh ranges are aligned to it
+			vkCmdBindIndexBuffer(cmd, mesh->_indexBuffer._buffer, 0, mesh->_indexType);
+			lastIndexBuffer = mesh->_indexBuffer._buffer;
+			lastIndexType = mesh->_indexType;
 		}
 
-
-		//glm::mat4 model = object.transformMatrix;
 		//final render matrix, that we are calculating on the cpu
-		glm::mat4 mesh_matrix = projection * view * model;
+		glm::mat4 mesh_matrix = projection * view * objectModel * mesh->_positionDequantize;
 
 		MeshPushConstants constants ;
 		constants.render_matrix = mesh_matrix;
 
-		//upload the mesh to the GPU via push constants
-		if (object.material)
-		{
-			vkCmdPushConstants(cmd, object.material->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(MeshPushConstants), &constants);
-		}
-		//only bind the mesh if it's a different one from last bind
-		if (object.mesh != lastMesh) {
-			//bind the mesh vertex buffer with offset 0
-			VkDeviceSize offset = 0;
-			vkCmdBindVertexBuffers(cmd, 0, 1, &object.mesh->_vertexBuffer._buffer, &offset);
-			lastMesh = object.mesh;
-		}
-		//we can now draw
-		if (object.mesh)
-		{
+		//coarsest level whose error stays under a pixel at this distance
+		const float distance = glm::length(eye - glm::vec3(objectModel[3]));
+		MeshLod lod = mesh->select_lod(distance, pixelsPerUnit, 1.0f);
+		//streamed textures want levels for the pixels the whole object covers
+		const float texturePixels = vkutil::sphere_screen_pixels(
+			_objectsSet._renderableBounds[firstIndex + i].sphere, eye, pixelsPerUnit);
+		//one draw per material range of the level, meshes without submeshes draw the level at once
+		const Submesh whole = { lod.indexOffset, lod.indexCount, 0 };
+		const Submesh* submeshes = lod.submeshCount > 0 ? mesh->lod_submeshes(lod) : &whole;
+		const uint32_t submeshCount = lod.submeshCount > 0 ? lod.submeshCount : 1;
+		for (uint32_t s = 0; s < submeshCount; s++) {
+			const Submesh& submesh = submeshes[s];
+			if (submesh.indexCount == 0) {
+				continue;
+			}
+			const MaterialHandle materialHandle = object.submeshMaterials != NO_SUBMESH_MATERIALS && lod.submeshCount > 0
+				? _objectsSet._submeshMaterials[object.submeshMaterials + submesh.materialId] : object.material;
+			const Material* material = &_objectsSet._materials[materialHandle];
+			_textureStreamer.request(materialHandle, texturePixels);
+
+			//only bind the pipeline if it doesn't match with the already bound one
+			//if material(pipeline and pipeline yaout) is same,must not bind pipeline again!
+			if (material != lastMaterial) {
+				if (!lastMaterial || material->pipeline != lastMaterial->pipeline) {
+					vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipeline);
+					//bind the descriptor set when changing pipeline
+					//bind the global descriptor set in pipeline layout 0 index, at this frame's place in the ring
+					vkCmdBindDescriptorSets(cmd,VK_PIPELINE_BIND_POINT_GRAPHICS,
+						material->pipelineLayout,0,1,
+						&get_current_frame().globalDescriptor,2,globalOffsets);
+					//bind the object descriptor set in pipeline layout 1 index
+					vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+						material->pipelineLayout, 1, 1,
+						&get_current_frame().objectDescriptor, 1, &objectOffset);
+				}
+				//materials sharing a pipeline only differ in their texture, materials of one texture array not even in that
+				//bind the texture descriptor set in pipeline layout 2 index
+				if (lastMaterial && material->pipelineLayout != lastMaterial->pipelineLayout) {
+					lastTextureSet = VK_NULL_HANDLE;
+				}
+				if (material->textureSet != VK_NULL_HANDLE && material->textureSet != lastTextureSet) {
+					vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+						material->pipelineLayout, 2, 1, &material->textureSet, 0, nullptr);
+					lastTextureSet = material->textureSet;
+					_textureSetBinds++;
+				};
+				lastMaterial = material;
+				//_descriptorLayoutCache.
+			}
+
+			//upload the mesh to the GPU via push constants, the texture array layer goes along
+			constants.data = material->textureArrayRect;
+			vkCmdPushConstants(cmd, material->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+				sizeof(MeshPushConstants), &constants);
 			//NOTE: i mean vertex shader gl_instance input
-			vkCmdDraw(cmd, object.mesh->_vertices.size(), 1, 0, i);
+			vkCmdDrawIndexed(cmd, submesh.indexCount, 1, mesh->_firstIndex + submesh.indexOffset,
+				mesh->_vertexOffset, i);
 		}
 	}
 }
@@ -1313,7 +1714,8 @@ FrameData& VulkanEngine::get_current_frame() {
 	return _frames[_frameNumber % FRAME_OVERLAP];
 }
 
-AllocatedBuffer VulkanEngine::create_buffer(bool immediate_destroy,size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage)
+AllocatedBuffer VulkanEngine::create_buffer(bool immediate_destroy,size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage,
+	VmaAllocationCreateFlags allocFlags)
 {
 	//allocate vertex buffer
 	VkBufferCreateInfo bufferInfo = {};
@@ -1326,35 +1728,35 @@ AllocatedBuffer VulkanEngine::create_buffer(bool immediate_destroy,size_t allocS
 
 	VmaAllocationCreateInfo vmaallocInfo = {};
 	vmaallocInfo.usage = memoryUsage;
+	vmaallocInfo.flags = allocFlags;
 
 	AllocatedBuffer newBuffer;
 
 	//allocate the buffer
+	VmaAllocationInfo allocationInfo = {};
 	VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &vmaallocInfo,
 		&newBuffer._buffer,
 		&newBuffer._allocation,
-		nullptr));
+		&allocationInfo));
+	//vma unmaps it when the buffer is destroyed
+	newBuffer._mapped = allocationInfo.pMappedData;
 	//whether destroy buffer or not immediately
 	//immediately destroy -> not push desctroy function to main deletion queue
 	//not immediately destory->push desctroy function to main deletion queue
 	if (!immediate_destroy) {
-		_mainDeletionQueue.push_function([=]() {
-			vmaDestroyBuffer(_allocator, newBuffer._buffer, newBuffer._allocation);
-			std::cout << "newBuffer" << std::endl;
-			});
+		_mainDeletionQueue.push(newBuffer._buffer, newBuffer._allocation);
 	}
 	return newBuffer;
 }
 
-size_t VulkanEngine::pad_uniform_buffer_size(size_t originalSize)
+void* VulkanEngine::push_frame_data(size_t size, RingUsage usage, uint32_t& outOffset)
 {
-	// Calculate required alignment based on minimum device offset alignment
-	size_t minUboAlignment = _gpuProperties.limits.minUniformBufferOffsetAlignment;
-	size_t alignedSize = originalSize;
-	if (minUboAlignment > 0) {
-		alignedSize = (alignedSize + minUboAlignment - 1) & ~(minUboAlignment - 1);
+	uint64_t offset;
+	if (!_frameRing.allocate(size, usage, offset)) {
+		return nullptr;
 	}
-	return alignedSize;
+	outOffset = static_cast<uint32_t>(offset);
+	return (char*)_frameRingBuffer._mapped + offset;
 }
 
 void VulkanEngine::immediate_submit(std::function<void(VkCommandBuffer cmd)>&& function) {
@@ -1389,32 +1791,246 @@ void VulkanEngine::load_texture() {
 	//create image view because of cant access image directly
 	VkImageViewCreateInfo imageinfo = vkinit::imageview_create_info(lostEmpire.image._image,VK_FORMAT_R8G8B8A8_SRGB, 1,VK_IMAGE_ASPECT_COLOR_BIT);
 	vkCreateImageView(_device, &imageinfo, nullptr, &lostEmpire.imageView);
-	_mainDeletionQueue.push_function([=]() {
-		vkDestroyImageView(_device, lostEmpire.imageView, nullptr);
-		std::cout << "lostEmpire.imageView" << std::endl;
-		});
+	_mainDeletionQueue.push(lostEmpire.imageView);
 	//add texture to textures set
 	_loadedTextures["empire_diffuse"] = lostEmpire;
 }
 
 void VulkanEngine::load_mipmap_texture() {
-	Texture lostEmpire;
 	//const char* file_name = (ASSERT_SOURCE_PATH + "lost_empire-RGBA.png").c_str();
 	const char* file_name = "D:/VulKan/Vulkanstart/textures/viking_room.png";
+	load_mipmap_texture(file_name, "empire_diffuse");
+}
 
-	if (!vkutil::load_image_from_file((VulkanEngine*)(this),file_name, lostEmpire.image,mipLevels)) {
-		std::cerr << "Failed to load image from file!" << std::endl;
-		return;
+bool VulkanEngine::load_mipmap_texture(const std::string& file, const std::string& name) {
+	//keyed by the file that is loaded, cooked before source as load_texture_file picks them
+	ContentKey key;
+	std::string keyedFile;
+	for (const std::string& candidate : { assets::cooked_path(file, ".ktx2"), assets::cooked_path(file, ".tx"), file }) {
+		if (file_content_key(candidate.c_str(), key)) {
+			keyedFile = candidate;
+			break;
+		}
+	}
+	const bool keyed = !keyedFile.empty();
+	if (keyed) {
+		const std::string* loaded = _textureCache.find(key, keyedFile);
+		auto owner = loaded ? _loadedTextures.find(*loaded) : _loadedTextures.end();
+		if (owner != _loadedTextures.end()) {
+			//materials bound to the alias are bound to the owner, replacing the owner updates both
+			_loadedTextures[name] = owner->second;
+			_textureCache.alias(name, *loaded, key.size);
+			return true;
+		}
+	}
+	if (!load_texture_file(file, name)) {
+		return false;
+	}
+	if (keyed) {
+		_textureCache.insert(key, name, keyedFile);
+	}
+	return true;
+}
+
+bool VulkanEngine::load_texture_file(const std::string& file, const std::string& name) {
+	Texture lostEmpire;
+	const char* file_name = file.c_str();
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	//cooked textures with mips stream, only their tail is loaded here
+	if (_textureStreamer.add_texture(file, name)) {
+		return true;
 	}
+	//prefer the textures cooked by asset_cooker (KTX2, then the engine's own container), fall back to decoding the png
+	if (!vkutil::load_image_from_ktx2(this, assets::cooked_path(file_name, ".ktx2").c_str(), lostEmpire.image, mipLevels)
+		&& !vkutil::load_image_from_asset(this, assets::cooked_path(file_name, ".tx").c_str(), lostEmpire.image, mipLevels)) {
+		//pngs decode on the pool unless textures.asyncDecode is off
+		if (_textureLoader.async() && _textureLoader.load(file, name) != INVALID_TEXTURE_LOAD) {
+			return true;
+		}
+		if (!vkutil::load_image_from_file((VulkanEngine*)(this), file_name, lostEmpire.image, mipLevels)) {
+			std::cerr << "Failed to load image from file!" << std::endl;
+			return false;
+		}
+	}
+	auto endTime = std::chrono::high_resolution_clock::now();
+	std::cout << "load_mipmap_texture " << file << ": " << std::chrono::duration<float, std::milli>(endTime - startTime).count() << " ms" << std::endl;
 	//create image view because of cant access image directly
-	VkImageViewCreateInfo imageinfo = vkinit::imageview_create_info(lostEmpire.image._image, VK_FORMAT_R8G8B8A8_SRGB, mipLevels, VK_IMAGE_ASPECT_COLOR_BIT);
+	VkImageViewCreateInfo imageinfo = vkinit::imageview_create_info(lostEmpire.image._image, lostEmpire.image._format, mipLevels, VK_IMAGE_ASPECT_COLOR_BIT);
 	vkCreateImageView(_device, &imageinfo, nullptr, &lostEmpire.imageView);
-	_mainDeletionQueue.push_function([=]() {
-		vkDestroyImageView(_device, lostEmpire.imageView, nullptr);
-		std::cout << "lostEmpire.imageView" << std::endl;
-		});
+	_mainDeletionQueue.push(lostEmpire.imageView);
 	//add texture to textures set
-	_loadedTextures["empire_diffuse"] = lostEmpire;
+	_loadedTextures[name] = lostEmpire;
+	return true;
+}
+
+void VulkanEngine::load_texture_arrays(const std::string& file) {
+	assets::MappedFile mapped;
+	assets::AssetView view;
+	if (!mapped.open(file.c_str())) {
+		return;
+	}
+	assets::TexturePackInfo info;
+	if (!assets::open_asset(mapped, "TEXA", view) || view.header->metadataSize < sizeof(info)) {
+		std::cerr << "Corrupt texture pack " << file << std::endl;
+		return;
+	}
+	memcpy(&info, view.metadata, sizeof(info));
+	std::vector<assets::TextureArrayInfo> arrays(info.arrayCount);
+	std::vector<assets::TextureArrayEntry> entries(info.entryCount);
+	if (view.header->sectionCount < 2
+		|| view.sections[0].rawSize != arrays.size() * sizeof(assets::TextureArrayInfo)
+		|| view.sections[1].rawSize != entries.size() * sizeof(assets::TextureArrayEntry)
+		|| !assets::unpack_section(view, 0, arrays.data()) || !assets::unpack_section(view, 1, entries.data())) {
+		std::cerr << "Corrupt texture pack " << file << std::endl;
+		return;
+	}
+
+	VkSampler sampler = _samplerCache.get_sampler(vkutil::SamplerPreset::NearestRepeat);
+	std::vector<VkDescriptorSet> sets(arrays.size(), VK_NULL_HANDLE);
+	for (size_t a = 0; a < arrays.size(); a++) {
+		const assets::TextureArrayInfo& array = arrays[a];
+		//the descriptor pool holds sets for MAX_TEXTURE_ARRAYS, the textures past them load one by one
+		if (_textureArrayCount >= MAX_TEXTURE_ARRAYS) {
+			break;
+		}
+		const VkFormat format = assets::texture_vk_format(array.format);
+		VkFormatProperties formatProperties{};
+		vkGetPhysicalDeviceFormatProperties(_chosenGPU, format, &formatProperties);
+		if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)
+			|| array.layerCount == 0 || array.layerCount > _gpuProperties.limits.maxImageArrayLayers
+			|| array.mipLevels == 0 || array.firstSection + array.mipLevels > view.header->sectionCount) {
+			continue;
+		}
+		VkDeviceSize size = 0;
+		bool valid = true;
+		for (uint32_t level = 0; level < array.mipLevels; level++) {
+			const uint64_t levelSize = uint64_t(assets::texture_level_size(array.format,
+				std::max(1u, array.width >> level), std::max(1u, array.height >> level))) * array.layerCount;
+			valid = valid && view.sections[array.firstSection + level].rawSize == levelSize;
+			size += levelSize;
+		}
+		if (!valid) {
+			std::cerr << "Corrupt texture array " << a << " in " << file << std::endl;
+			continue;
+		}
+		UploadStaging staging = _uploadBatcher.stage(size);
+		VkDeviceSize offset = 0;
+		for (uint32_t level = 0; level < array.mipLevels && valid; level++) {
+			valid = assets::unpack_section(view, array.firstSection + level, staging.data + offset);
+			offset += view.sections[array.firstSection + level].rawSize;
+		}
+		if (!valid) {
+			std::cerr << "Corrupt texture array " << a << " in " << file << std::endl;
+			continue;
+		}
+		Texture texture;
+		texture.image = vkutil::upload_mip_chain(this, staging.buffer, staging.offset, { array.width, array.height, 1 },
+			array.mipLevels, format, array.format, false, array.layerCount);
+		VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(texture.image._image, format, array.mipLevels, VK_IMAGE_ASPECT_COLOR_BIT);
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		viewInfo.subresourceRange.layerCount = array.layerCount;
+		VK_CHECK(vkCreateImageView(_device, &viewInfo, nullptr, &texture.imageView));
+		VkImageView imageView = texture.imageView;
+		_mainDeletionQueue.push(imageView);
+
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = _descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &_singleTextureSetLayout;
+		VK_CHECK(vkAllocateDescriptorSets(_device, &allocInfo, &sets[a]));
+		_textureArrayCount++;
+		VkDescriptorImageInfo imageInfo;
+		imageInfo.sampler = sampler;
+		imageInfo.imageView = texture.imageView;
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		VkWriteDescriptorSet write = vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, sets[a], &imageInfo, 0);
+		vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+	}
+
+	size_t packed = 0;
+	for (const assets::TextureArrayEntry& entry : entries) {
+		if (entry.array < sets.size() && sets[entry.array] != VK_NULL_HANDLE) {
+			const std::string name(entry.name, strnlen(entry.name, sizeof(entry.name)));
+			_arrayTextures[name] = { sets[entry.array], glm::vec4(entry.uvScale[0], entry.uvScale[1], float(entry.layer), 0.0f) };
+			packed++;
+		}
+	}
+	std::cout << "Texture pack " << file << ": " << packed << " of " << entries.size() << " textures in "
+		<< arrays.size() << " arrays" << std::endl;
 }
 
+void VulkanEngine::bind_texture(const std::string& name, MaterialHandle material, VkSampler sampler) {
+	const std::string& owner = _textureCache.resolve(name);
+	_textureBindings[owner].push_back({ material, sampler });
+	_textureStreamer.bind_material(owner, material);
+}
 
+bool VulkanEngine::replace_texture(const std::string& name, const Texture& texture, bool destroyOld) {
+	//sets in use by frames in flight cannot be rewritten, every material gets a new one
+	std::vector<TextureBinding>& bindings = _textureBindings[name];
+	//removed materials need no new set
+	bindings.erase(std::remove_if(bindings.begin(), bindings.end(),
+		[&](const TextureBinding& binding) { return !_objectsSet._materials.contains(binding.material); }), bindings.end());
+	//materials sharing a set (those past MAX_MATERIAL_SETS share the base material's) keep sharing the new one
+	std::vector<size_t> setIndices(bindings.size());
+	std::unordered_map<VkDescriptorSet, size_t> sharedSets;
+	size_t setCount = 0;
+	for (size_t i = 0; i < bindings.size(); i++) {
+		const VkDescriptorSet oldSet = _objectsSet._materials[bindings[i].material].textureSet;
+		if (oldSet == VK_NULL_HANDLE) {
+			setIndices[i] = setCount++;
+			continue;
+		}
+		auto shared = sharedSets.try_emplace(oldSet, setCount);
+		setIndices[i] = shared.first->second;
+		setCount += shared.second;
+	}
+	std::vector<VkDescriptorSet> sets(setCount, VK_NULL_HANDLE);
+	if (!sets.empty()) {
+		std::vector<VkDescriptorSetLayout> layouts(sets.size(), _singleTextureSetLayout);
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.pNext = nullptr;
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = _descriptorPool;
+		allocInfo.descriptorSetCount = static_cast<uint32_t>(sets.size());
+		allocInfo.pSetLayouts = layouts.data();
+		//only MAX_STREAMING_SETS are spare, they come back as retired sets are freed
+		if (vkAllocateDescriptorSets(_device, &allocInfo, sets.data()) != VK_SUCCESS) {
+			return false;
+		}
+	}
+	//the old sets and texture go once no frame in flight can sample them
+	std::vector<bool> written(setCount, false);
+	for (size_t i = 0; i < bindings.size(); i++) {
+		Material& material = _objectsSet._materials[bindings[i].material];
+		const size_t set = setIndices[i];
+		//the first material of a shared set writes it and retires the old one
+		if (!written[set]) {
+			VkDescriptorImageInfo imageInfo;
+			imageInfo.sampler = bindings[i].sampler;
+			imageInfo.imageView = texture.imageView;
+			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			VkWriteDescriptorSet write = vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, sets[set], &imageInfo, 0);
+			vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+			if (material.textureSet != VK_NULL_HANDLE) {
+				_mainDeletionQueue.retire(material.textureSet, _descriptorPool);
+			}
+			written[set] = true;
+		}
+		material.textureSet = sets[set];
+	}
+	if (destroyOld) {
+		const Texture& old = _loadedTextures[name];
+		_mainDeletionQueue.retire(old.imageView);
+		_mainDeletionQueue.retire(old.image._image, old.image._allocation);
+	}
+	_loadedTextures[name] = texture;
+	for (const auto& alias : _textureCache.aliases()) {
+		if (alias.second == name) {
+			_loadedTextures[alias.first] = texture;
+		}
+	}
+	return true;
+}
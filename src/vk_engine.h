@@ -4,7 +4,6 @@
 #pragma once
 #include <vector>
 #include <string>
-#include <deque>
 #include <functional>
 #include <chrono>
 
@@ -20,29 +19,50 @@
 #include "imgui_impl_vulkan.h"
 
 #include "vk_descriptor.h"
+#include <vk_texture_streamer.h>
+#include <vk_texture_loader.h>
+#include <vk_upload_batcher.h>
+#include <content_cache.h>
+#include <ring_allocator.h>
+#include <deletion_queue.h>
 //number of frames to overlap when rendering
 constexpr unsigned int FRAME_OVERLAP = 2;
+//texture descriptor sets reserved for submesh materials, materials past this share the base texture
+constexpr unsigned int MAX_MATERIAL_SETS = 256;
+//spare texture descriptor sets for the streamer, new sets are allocated before the replaced ones retire
+constexpr unsigned int MAX_STREAMING_SETS = 256;
+//descriptor sets of packed texture arrays, one per array shared by every material packed into it
+constexpr unsigned int MAX_TEXTURE_ARRAYS = 16;
+//size of the shared vertex and index buffers every mesh is suballocated from
+constexpr VkDeviceSize GEOMETRY_POOL_VERTEX_BYTES = 64ull * 1024 * 1024;
+constexpr VkDeviceSize GEOMETRY_POOL_INDEX_BYTES = 32ull * 1024 * 1024;
+//persistently mapped staging shared by the upload batches, a third each
+constexpr VkDeviceSize UPLOAD_ARENA_BYTES = 96ull * 1024 * 1024;
+//an upload batch is submitted once it copies this much or this many regions
+constexpr VkDeviceSize UPLOAD_FLUSH_BYTES = 32ull * 1024 * 1024;
+constexpr uint32_t UPLOAD_FLUSH_COPIES = 256;
+//objects draw_objects writes matrices for, the range of the object descriptor
+constexpr unsigned int MAX_OBJECTS = 10000;
+//persistently mapped ring the frames in flight push their camera, scene and object data into
+constexpr VkDeviceSize FRAME_RING_BYTES = 4ull * 1024 * 1024;
+//starting size of each frame's cpu arena, it grows when a frame needs more
+constexpr size_t FRAME_ALLOCATOR_BYTES = 256 * 1024;
 
 const std::string SHADER_SOURCE_PATH = "D:/VulKan/Vulkan_Engine/vulkan-guide-all-chapters/shaders/";
 //const std::string SHADER_SOURCE_PATH = "D:/VulKan/Vulkanstart/shaders/";
 const std::string ASSERT_SOURCE_PATH = "D:/VulKan/Vulkan_Engine/vulkan-guide-all-chapters/assets/";
 
-struct DeletionQueue
-{
-	std::deque<std::function<void()>> deletors;
-
-	void push_function(std::function<void()>&& function) {
-		deletors.push_back(function);
-	}
-
-	void flush() {
-		// reverse iterate the deletion queue to execute all the functions
-		for (auto it = deletors.rbegin(); it != deletors.rend(); it++) {
-			(*it)(); //call the function
-		}
+//material sampling a texture of _loadedTextures through its own descriptor set
+struct TextureBinding {
+	MaterialHandle material;
+	VkSampler sampler;
+};
 
-		deletors.clear();
-	}
+//layer of a packed texture array a texture was cooked into
+struct ArrayTexture {
+	VkDescriptorSet set;
+	//Material::textureArrayRect of materials sampling it
+	glm::vec4 rect;
 };
 
 class VulkanEngine {
@@ -112,6 +132,8 @@ public:
 
 	//vkutil::DescriptorAllocator _textureDesciptorAllocator;
 	//vkutil::DescriptorLayoutCache _descriptorLayoutCache;
+	//every sampler of the materials, one per distinct create info
+	vkutil::SamplerCache _samplerCache;
 	//vkutil::DescriptorBuilder _descriptorBuilder;
 
 	//render objects set
@@ -126,6 +148,15 @@ public:
 	VkDescriptorSetLayout _objectSetLayout;
 	//upload vertex data into GPU
 	UploadContext _uploadContext;
+	//mesh and texture uploads, recorded into shared command buffers and submitted in batches
+	UploadBatcher _uploadBatcher;
+	//transient per frame data bound with dynamic offsets, see push_frame_data
+	AllocatedBuffer _frameRingBuffer;
+	RingAllocator _frameRing;
+	//upload meshes as 16 byte CompactVertex instead of 44 byte Vertex, meshes out of tolerance stay fp32
+	bool _compactVertices{ false };
+	//shared vertex/index buffers the meshes are uploaded into
+	GeometryPool _geometryPool;
 
 	//mipmap levels
 	uint32_t mipLevels;
@@ -133,6 +164,22 @@ public:
 	std::unordered_map<std::string, Texture> _loadedTextures;
 	// texture desriptorSet layout
 	VkDescriptorSetLayout _singleTextureSetLayout;
+	//materials to rewrite when a texture of _loadedTextures is replaced, by texture name
+	std::unordered_map<std::string, std::vector<TextureBinding>> _textureBindings;
+	//streams the levels of cooked textures in and out under the VRAM budget
+	TextureStreamer _textureStreamer;
+	//decodes png textures on the thread pool, they sample a placeholder until they land
+	TextureLoader _textureLoader;
+	//the same file bytes under another name share the texture or mesh loaded first
+	ContentCache _textureCache;
+	ContentCache _meshCache;
+	//textures packed into texture arrays by asset_cooker -pack-arrays, by texture file
+	std::unordered_map<std::string, ArrayTexture> _arrayTextures;
+	uint32_t _textureArrayCount{ 0 };
+	//texture set binds of the last draw_objects, materials sharing an array share one set
+	uint32_t _textureSetBinds{ 0 };
+	//operator new calls of the last draw(), only counted in COUNT_HEAP_ALLOCATIONS builds
+	uint64_t _frameHeapAllocations{ 0 };
 	
 public:
 
@@ -180,8 +227,21 @@ public:
 
 	//
 	void load_meshes();
+	//load a cooked or obj mesh and upload it into _objectsSet under name, false when neither exists
+	//a file with the same bytes as one loaded before shares its buffers
+	bool load_mesh(const std::string& file, const std::string& name);
+
+	//create the shared vertex and index buffers of _geometryPool
+	void init_geometry_pool();
 
 	void upload_mesh(Mesh& mesh);
+	//drop name, with the last name of a mesh its pool ranges and buffers retire until the frames in flight are done with them
+	//false when no mesh has that name
+	bool unload_mesh(const std::string& name);
+	//hand the pool ranges and own buffers of mesh to the deletion queue
+	void retire_mesh_geometry(Mesh& mesh);
+	//retire the mesh reached only through name, before name is given to another one
+	void retire_replaced_mesh(const std::string& name);
 
 	//
 	void init_scene();
@@ -191,14 +251,34 @@ public:
 	//getter for the frame we are rendering to right now.
 	FrameData& get_current_frame();
 
-	AllocatedBuffer create_buffer(bool immediate_destroy,size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage);
-	//tool function get the alignment boundary,
-	size_t pad_uniform_buffer_size(size_t originalSize);
+	//allocFlags VMA_ALLOCATION_CREATE_MAPPED_BIT keeps the buffer mapped and fills _mapped, no vmaMapMemory per write
+	AllocatedBuffer create_buffer(bool immediate_destroy,size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage,
+		VmaAllocationCreateFlags allocFlags = 0);
+	//size bytes of the frame ring for the frame being recorded, aligned for usage and valid until its fence signals again
+	//bind it as a dynamic offset of a descriptor on _frameRingBuffer, null when the frames in flight fill the ring
+	void* push_frame_data(size_t size, RingUsage usage, uint32_t& outOffset);
 
 	void immediate_submit(std::function<void(VkCommandBuffer cmd)>&& function);
 
 	void load_texture();
 
 	void load_mipmap_texture();
+
+	//load a cooked or png texture with mipmaps into _loadedTextures[name], false when neither exists
+	//pngs decode in the background and are a placeholder until they land
+	//a file with the same bytes as one loaded before shares its texture, name is an alias of the first name then
+	bool load_mipmap_texture(const std::string& file, const std::string& name);
+	//load_mipmap_texture without the content cache
+	bool load_texture_file(const std::string& file, const std::string& name);
+	//upload the texture arrays of a cooked "TEXA" file and add its textures to _arrayTextures,
+	//arrays the device cannot sample are skipped and their textures load one by one
+	void load_texture_arrays(const std::string& file);
+
+	//remember that material samples _loadedTextures[name] with sampler through its texture set
+	void bind_texture(const std::string& name, MaterialHandle material, VkSampler sampler);
+	//swap _loadedTextures[name] for texture and give every material bound to it a new descriptor set,
+	//the old sets, and the old texture when destroyOld, go once no frame in flight can use them
+	//false when the pool has no spare sets, nothing changed then
+	bool replace_texture(const std::string& name, const Texture& texture, bool destroyOld);
 	
 };
@@ -6,6 +6,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include <vk_descriptor.h>
+#include <frame_allocator.h>
 struct GPUObjectData {
 	glm::mat4 modelMatrix;
 };
@@ -24,8 +25,8 @@ struct GPUSceneData {
 };
 //
 struct SceneObject {
+	//pushed into the engine's frame ring every frame
 	GPUSceneData _sceneParameters;
-	AllocatedBuffer _sceneParameterBuffer;
 };
 //
 struct FrameData
@@ -37,17 +38,14 @@ struct FrameData
 	//command pool and command buffer;
 	VkCommandPool _commandPool; //the command pool for our commands
 	VkCommandBuffer _mainCommandBuffer; //the buffer we will record into
-	//MVP matrix buffer that shader using
-	//buffer that holds a single GPUCameraData to use when rendering
-	
-	AllocatedBuffer cameraBuffer;
-	//every frame has a gloablDescriptor
+	//camera and scene parameters, dynamic offsets into the engine's frame ring
 	VkDescriptorSet globalDescriptor;
 	//vkutil::DescriptorAllocator _globalDescrptorAllocator;
 
-	//storage object data (module matrix)buffer
-	AllocatedBuffer objectBuffer;
+	//object matrices, a dynamic offset into the engine's frame ring
 	VkDescriptorSet objectDescriptor;
 	//vkutil::DescriptorAllocator _objectDescrptorAllocator;
+	//cpu scratch of the frame, reset once its fence signalled so what the frame before allocated is still there
+	FrameAllocator _frameAllocator;
 };
 #endif // !VK_FRAMEDATA_H
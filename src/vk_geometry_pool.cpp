@@ -0,0 +1,42 @@
+#include "vk_geometry_pool.h"
+#include <iostream>
+
+void GeometryPool::init(AllocatedBuffer vertexBuffer, VkDeviceSize vertexCapacity, AllocatedBuffer indexBuffer, VkDeviceSize indexCapacity)
+{
+	_vertexBuffer = vertexBuffer;
+	_indexBuffer = indexBuffer;
+	_vertexRanges.reset(vertexCapacity);
+	_indexRanges.reset(indexCapacity);
+}
+
+bool GeometryPool::allocate(VkDeviceSize vertexBytes, uint32_t vertexStride, VkDeviceSize indexBytes, uint32_t indexSize,
+	GeometryAllocation& outAllocation)
+{
+	GeometryAllocation allocation;
+	if (!_vertexRanges.allocate(vertexBytes, vertexStride, allocation.vertices)) {
+		return false;
+	}
+	if (!_indexRanges.allocate(indexBytes, indexSize, allocation.indices)) {
+		_vertexRanges.free(allocation.vertices);
+		return false;
+	}
+	outAllocation = allocation;
+	return true;
+}
+
+void GeometryPool::free(const GeometryAllocation& allocation)
+{
+	_vertexRanges.free(allocation.vertices);
+	_indexRanges.free(allocation.indices);
+}
+
+void GeometryPool::print_stats(const char* label) const
+{
+	const RangeAllocatorStats stats[2] = { _vertexRanges.stats(), _indexRanges.stats() };
+	const char* names[2] = { "vertices", "indices" };
+	for (int i = 0; i < 2; i++) {
+		std::cout << label << " " << names[i] << ": " << stats[i].usedBytes << " / " << stats[i].capacity << " bytes in "
+			<< stats[i].allocationCount << " ranges, " << stats[i].freeRangeCount << " free ranges, largest "
+			<< stats[i].largestFreeRange << " bytes, fragmentation " << stats[i].fragmentation() << std::endl;
+	}
+}
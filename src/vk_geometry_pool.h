@@ -0,0 +1,35 @@
+#pragma once
+#ifndef VK_GEOMETRY_POOL_H
+#define VK_GEOMETRY_POOL_H
+#include <vk_types.h>
+#include <range_allocator.h>
+
+//where a mesh lives inside the pool buffers
+struct GeometryAllocation {
+	RangeAllocation vertices;
+	RangeAllocation indices;
+};
+
+//one device local vertex buffer and one index buffer shared by every mesh,
+//so the draw loop binds them once instead of per mesh
+//the buffers are created and destroyed by the engine, the pool only hands out ranges
+class GeometryPool {
+public:
+	void init(AllocatedBuffer vertexBuffer, VkDeviceSize vertexCapacity, AllocatedBuffer indexBuffer, VkDeviceSize indexCapacity);
+
+	//vertex ranges start on a multiple of vertexStride and index ranges on a multiple of indexSize,
+	//so they can be addressed with vkCmdDrawIndexed's vertexOffset and firstIndex
+	//returns false and allocates nothing when either buffer is full
+	bool allocate(VkDeviceSize vertexBytes, uint32_t vertexStride, VkDeviceSize indexBytes, uint32_t indexSize,
+		GeometryAllocation& outAllocation);
+	void free(const GeometryAllocation& allocation);
+
+	//used/free bytes, range counts and fragmentation of both buffers
+	void print_stats(const char* label) const;
+
+	AllocatedBuffer _vertexBuffer{};
+	AllocatedBuffer _indexBuffer{};
+	RangeAllocator _vertexRanges;
+	RangeAllocator _indexRanges;
+};
+#endif // !VK_GEOMETRY_POOL_H
@@ -1,6 +1,13 @@
 #include "vk_mesh.h"
-#include <tiny_obj_loader.h>
+#include <asset_loader.h>
+#include <obj_loader.h>
+#include <thread_pool.h>
+#include <vk_mesh_optimizer.h>
 #include <iostream>
+#include <cstring>
+#include <unordered_map>
+#include <algorithm>
+#include <glm/gtc/packing.hpp>
 VertexInputDescription Vertex::get_vertex_description()
 {
 	VertexInputDescription description;
@@ -48,78 +55,396 @@ VertexInputDescription Vertex::get_vertex_description()
 	return description;
 }
 
+VertexInputDescription CompactVertex::get_vertex_description()
+{
+	VertexInputDescription description;
+
+	VkVertexInputBindingDescription mainBinding = {};
+	mainBinding.binding = 0;
+	mainBinding.stride = sizeof(CompactVertex);
+	mainBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	description.bindings.push_back(mainBinding);
+
+	//same locations as Vertex, minus the color at location 2
+	VkVertexInputAttributeDescription positionAttribute = {};
+	positionAttribute.binding = 0;
+	positionAttribute.location = 0;
+	positionAttribute.format = VK_FORMAT_R16G16B16A16_SNORM;
+	positionAttribute.offset = offsetof(CompactVertex, position);
+
+	VkVertexInputAttributeDescription normalAttribute = {};
+	normalAttribute.binding = 0;
+	normalAttribute.location = 1;
+	normalAttribute.format = VK_FORMAT_R16G16_SNORM;
+	normalAttribute.offset = offsetof(CompactVertex, normal);
+
+	VkVertexInputAttributeDescription uvAttribute = {};
+	uvAttribute.binding = 0;
+	uvAttribute.location = 3;
+	uvAttribute.format = VK_FORMAT_R16G16_SFLOAT;
+	uvAttribute.offset = offsetof(CompactVertex, uv);
+
+	description.attributes.push_back(positionAttribute);
+	description.attributes.push_back(normalAttribute);
+	description.attributes.push_back(uvAttribute);
+	return description;
+}
+
+//octahedral normal encoding, the shader side lives in tri_mesh_compact.vert
+static glm::vec2 oct_wrap(glm::vec2 v)
+{
+	return glm::vec2(
+		(1.0f - std::abs(v.y)) * (v.x >= 0.0f ? 1.0f : -1.0f),
+		(1.0f - std::abs(v.x)) * (v.y >= 0.0f ? 1.0f : -1.0f));
+}
+
+static glm::vec2 oct_encode(glm::vec3 n)
+{
+	float sum = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	if (sum == 0.0f) {
+		return glm::vec2(0.0f);
+	}
+	n /= sum;
+	glm::vec2 e(n.x, n.y);
+	return n.z >= 0.0f ? e : oct_wrap(e);
+}
+
+static glm::vec3 oct_decode(glm::vec2 e)
+{
+	glm::vec3 n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+	if (n.z < 0.0f) {
+		glm::vec2 w = oct_wrap(glm::vec2(n.x, n.y));
+		n.x = w.x;
+		n.y = w.y;
+	}
+	return glm::normalize(n);
+}
+
+bool QuantizationError::within_tolerance(float positionStep) const
+{
+	//half a step per axis rounds to at most one step in length
+	//16 bit octahedral normals stay well below 0.01 degrees
+	//half floats keep 11 significant bits
+	return position <= positionStep && normal <= 0.01f && uv <= 1.0f / 2048.0f;
+}
+
+bool Vertex::operator==(const Vertex& other) const
+{
+	//Vertex is tightly packed floats, so a bitwise compare matches the hash below
+	return memcmp(this, &other, sizeof(Vertex)) == 0;
+}
+
+size_t VertexHash::operator()(const Vertex& v) const
+{
+	//FNV-1a over the raw attribute words
+	uint32_t words[sizeof(Vertex) / sizeof(uint32_t)];
+	memcpy(words, &v, sizeof(Vertex));
+	uint64_t hash = 14695981039346656037ull;
+	for (uint32_t w : words) {
+		hash ^= w;
+		hash *= 1099511628211ull;
+	}
+	return static_cast<size_t>(hash);
+}
+
 bool Mesh::load_from_obj(const char* filename) {
-	//attrib will contain the vertex arrays of the file
-	tinyobj::attrib_t attrib;
-	//shapes contains the info for each separate object in the file
-	std::vector<tinyobj::shape_t> shapes;
-	//materials contains the information about the material of each shape, but we won't use it.
-	std::vector<tinyobj::material_t> materials;
-
-	//error and warning output from the load function
-	std::string warn;
-	std::string err;
-
-	//load the OBJ file
-	tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename, nullptr);
-	//make sure to output the warnings to the console, in case there are issues with the file
-	if (!warn.empty()) {
-		std::cout << "WARN: " << warn << std::endl;
-	}
-	//if we have any error, print it to the console, and break the mesh loading.
-	//This happens if the file can't be found or is malformed
-	if (!err.empty()) {
-		std::cerr << err << std::endl;
+	//mapped and parsed in parallel, errors are printed by the parser
+	assets::ObjData obj;
+	ThreadPool& pool = ThreadPool::shared();
+	if (!assets::parse_obj(filename, obj, pool)) {
 		return false;
 	}
-	// Loop over shapes
-	for (size_t s = 0; s < shapes.size(); s++) {
-		// Loop over faces(polygon)
-		size_t index_offset = 0;
-		for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
-
-			//hardcode loading to triangles
-			int fv = 3;
-
-			// Loop over vertices in the face.
-			for (size_t v = 0; v < fv; v++) {
-				// access to vertex
-				tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-
-				//vertex position
-				tinyobj::real_t vx = attrib.vertices[3 * idx.vertex_index + 0];
-				tinyobj::real_t vy = attrib.vertices[3 * idx.vertex_index + 1];
-				tinyobj::real_t vz = attrib.vertices[3 * idx.vertex_index + 2];
-				//vertex normal
-				tinyobj::real_t nx = attrib.normals[3 * idx.normal_index + 0];
-				tinyobj::real_t ny = attrib.normals[3 * idx.normal_index + 1];
-				tinyobj::real_t nz = attrib.normals[3 * idx.normal_index + 2];
-				//vertex uv
-				tinyobj::real_t ux = attrib.texcoords[2 * idx.texcoord_index + 0];
-				tinyobj::real_t uy = attrib.texcoords[2 * idx.texcoord_index + 1];
-
-
-				//copy it into our vertex
-				Vertex new_vert;
-				new_vert.position.x = vx;
-				new_vert.position.y = vy;
-				new_vert.position.z = vz;
-
-				new_vert.normal.x = nx;
-				new_vert.normal.y = ny;
-				new_vert.normal.z = nz;
-
-				//we are setting the vertex color as the vertex normal. This is just for display purposes
-				new_vert.color = new_vert.normal;
-				//NOTE: vulkan uv.y = 1-uy;
-				new_vert.uv.x = ux;
-				new_vert.uv.y = 1 - uy;
-
-				_vertices.push_back(new_vert);
-			}
-			index_offset += fv;
+	//one entry per face corner, welded into _vertices/_indices below
+	std::vector<Vertex> faceVertices(obj.corners.size());
+	pool.parallel_for(obj.corners.size(), 1 << 16, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			const assets::ObjIndex& idx = obj.corners[i];
+			Vertex& new_vert = faceVertices[i];
+			new_vert.position = obj.positions[idx.position];
+			//corners without a normal or uv get zeros
+			new_vert.normal = idx.normal >= 0 ? obj.normals[idx.normal] : glm::vec3(0.0f);
+			//we are setting the vertex color as the vertex normal. This is just for display purposes
+			new_vert.color = new_vert.normal;
+			//NOTE: vulkan uv.y = 1-uy;
+			const glm::vec2 uv = idx.texcoord >= 0 ? obj.texcoords[idx.texcoord] : glm::vec2(0.0f);
+			new_vert.uv.x = uv.x;
+			new_vert.uv.y = 1 - uv.y;
+		}
+	});
+	weld_vertices(faceVertices);
+
+	//triangles before the first usemtl, or from a file without materials, get a default white material
+	_materials.clear();
+	for (const assets::ObjMaterial& material : obj.materials) {
+		_materials.push_back(MeshMaterial{ material.name, material.diffuse, material.diffuseTexture });
+	}
+	std::vector<uint32_t> triangleMaterials(obj.triangleMaterials.size());
+	uint32_t defaultMaterial = UINT32_MAX;
+	for (size_t i = 0; i < triangleMaterials.size(); i++) {
+		if (obj.triangleMaterials[i] < 0 && defaultMaterial == UINT32_MAX) {
+			defaultMaterial = static_cast<uint32_t>(_materials.size());
+			_materials.push_back(MeshMaterial{ "default", glm::vec3(1.0f), std::string() });
 		}
+		triangleMaterials[i] = obj.triangleMaterials[i] < 0 ? defaultMaterial : static_cast<uint32_t>(obj.triangleMaterials[i]);
 	}
+	if (_materials.empty()) {
+		_materials.push_back(MeshMaterial{ "default", glm::vec3(1.0f), std::string() });
+	}
+	build_submeshes(triangleMaterials);
+	//triangle order straight from the file is poor for the vertex cache, optimized within each submesh
+	vkutil::optimize_mesh(*this);
+	update_bounds();
+
+	//report how much the welding saved compared to one vertex per face corner
+	const size_t unindexedBytes = faceVertices.size() * sizeof(Vertex);
+	const size_t indexedBytes = _vertices.size() * sizeof(Vertex) + choose_index_type();
+	std::cout << "Mesh " << filename << ": " << faceVertices.size() << " -> " << _vertices.size()
+		<< " vertices, " << unindexedBytes << " -> " << indexedBytes << " bytes ("
+		<< (_indexType == VK_INDEX_TYPE_UINT16 ? 16 : 32) << " bit indices)" << std::endl;
+	return true;
+}
 
+bool Mesh::load_from_asset(const char* filename)
+{
+	assets::MappedFile file;
+	if (!file.open(filename)) {
+		return false;
+	}
+	assets::AssetView view;
+	if (!assets::open_asset(file, "MESH", view) || view.header->sectionCount != 5
+		|| view.header->metadataSize < sizeof(assets::MeshInfo)) {
+		return false;
+	}
+	assets::MeshInfo info;
+	memcpy(&info, view.metadata, sizeof(assets::MeshInfo));
+	if (info.vertexFormat != assets::VertexFormat::PNCV_F32 || info.vertexSize != sizeof(Vertex)
+		|| view.sections[0].rawSize != info.vertexCount * sizeof(Vertex)
+		|| view.sections[1].rawSize != info.indexCount * sizeof(uint32_t)
+		|| info.lodSize != sizeof(MeshLod) || view.sections[2].rawSize != info.lodCount * sizeof(MeshLod)
+		|| view.sections[3].rawSize != info.submeshCount * sizeof(Submesh)
+		|| view.sections[4].rawSize != info.materialCount * sizeof(assets::MaterialInfo)) {
+		std::cout << "Mesh asset " << filename << " has an unexpected vertex layout" << std::endl;
+		return false;
+	}
+	//decompress straight out of the mapping into the final arrays
+	_vertices.resize(info.vertexCount);
+	_indices.resize(info.indexCount);
+	_lods.resize(info.lodCount);
+	_submeshes.resize(info.submeshCount);
+	std::vector<assets::MaterialInfo> materials(info.materialCount);
+	if (!assets::unpack_section(view, 0, _vertices.data()) || !assets::unpack_section(view, 1, _indices.data())
+		|| !assets::unpack_section(view, 2, _lods.data()) || !assets::unpack_section(view, 3, _submeshes.data())
+		|| !assets::unpack_section(view, 4, materials.data())) {
+		std::cerr << "Corrupt mesh asset " << filename << std::endl;
+		return false;
+	}
+	_materials.clear();
+	for (const assets::MaterialInfo& material : materials) {
+		//strnlen guards against records that lost their terminator
+		_materials.push_back(MeshMaterial{ std::string(material.name, strnlen(material.name, sizeof(material.name))),
+			glm::vec3(material.diffuse[0], material.diffuse[1], material.diffuse[2]),
+			std::string(material.diffuseTexture, strnlen(material.diffuseTexture, sizeof(material.diffuseTexture))) });
+	}
+	update_bounds();
 	return true;
-}
\ No newline at end of file
+}
+
+void Mesh::weld_vertices(const std::vector<Vertex>& faceVertices)
+{
+	_vertices.clear();
+	_indices.clear();
+	_indices.reserve(faceVertices.size());
+
+	std::unordered_map<Vertex, uint32_t, VertexHash> uniqueVertices;
+	uniqueVertices.reserve(faceVertices.size());
+	for (const Vertex& v : faceVertices) {
+		auto it = uniqueVertices.find(v);
+		if (it == uniqueVertices.end()) {
+			//first time we see this vertex, append it
+			uint32_t index = static_cast<uint32_t>(_vertices.size());
+			uniqueVertices.emplace(v, index);
+			_vertices.push_back(v);
+			_indices.push_back(index);
+		}
+		else {
+			_indices.push_back(it->second);
+		}
+	}
+}
+
+size_t Mesh::choose_index_type()
+{
+	//16 bit indices can address vertices 0..65535
+	if (_vertices.size() <= 65536) {
+		_indexType = VK_INDEX_TYPE_UINT16;
+		return _indices.size() * sizeof(uint16_t);
+	}
+	_indexType = VK_INDEX_TYPE_UINT32;
+	return _indices.size() * sizeof(uint32_t);
+}
+void Mesh::quantize_vertices()
+{
+	if (_vertices.empty()) {
+		return;
+	}
+	glm::vec3 minPos = _vertices[0].position;
+	glm::vec3 maxPos = _vertices[0].position;
+	for (const Vertex& v : _vertices) {
+		minPos = glm::min(minPos, v.position);
+		maxPos = glm::max(maxPos, v.position);
+	}
+	const glm::vec3 center = (minPos + maxPos) * 0.5f;
+	//flat meshes still need a non zero scale on every axis
+	const glm::vec3 extent = glm::max((maxPos - minPos) * 0.5f, glm::vec3(1e-6f));
+	_positionDequantize = glm::translate(center) * glm::scale(extent);
+
+	_compactVertices.resize(_vertices.size());
+	for (size_t i = 0; i < _vertices.size(); i++) {
+		const Vertex& v = _vertices[i];
+		CompactVertex& c = _compactVertices[i];
+		const glm::vec3 p = (v.position - center) / extent;
+		c.position[0] = static_cast<int16_t>(glm::packSnorm1x16(p.x));
+		c.position[1] = static_cast<int16_t>(glm::packSnorm1x16(p.y));
+		c.position[2] = static_cast<int16_t>(glm::packSnorm1x16(p.z));
+		c.position[3] = INT16_MAX;
+		const glm::vec2 n = oct_encode(v.normal);
+		c.normal[0] = static_cast<int16_t>(glm::packSnorm1x16(n.x));
+		c.normal[1] = static_cast<int16_t>(glm::packSnorm1x16(n.y));
+		c.uv[0] = glm::packHalf1x16(v.uv.x);
+		c.uv[1] = glm::packHalf1x16(v.uv.y);
+	}
+	_vertexFormat = MeshVertexFormat::Compact;
+}
+
+void Mesh::drop_quantized_vertices()
+{
+	std::vector<CompactVertex>().swap(_compactVertices);
+	_vertexFormat = MeshVertexFormat::Float32;
+	_positionDequantize = glm::mat4{ 1.0f };
+}
+
+QuantizationError Mesh::measure_quantization_error() const
+{
+	QuantizationError error = {};
+	for (size_t i = 0; i < _compactVertices.size() && i < _vertices.size(); i++) {
+		const Vertex& v = _vertices[i];
+		const CompactVertex& c = _compactVertices[i];
+		//decode exactly like the vertex input stage and tri_mesh_compact.vert
+		const glm::vec4 p = _positionDequantize * glm::vec4(
+			glm::unpackSnorm1x16(static_cast<uint16_t>(c.position[0])),
+			glm::unpackSnorm1x16(static_cast<uint16_t>(c.position[1])),
+			glm::unpackSnorm1x16(static_cast<uint16_t>(c.position[2])), 1.0f);
+		error.position = std::max(error.position, glm::length(glm::vec3(p) - v.position));
+
+		const float normalLength = glm::length(v.normal);
+		if (normalLength > 0.0f) {
+			const glm::vec3 n = oct_decode(glm::vec2(
+				glm::unpackSnorm1x16(static_cast<uint16_t>(c.normal[0])),
+				glm::unpackSnorm1x16(static_cast<uint16_t>(c.normal[1]))));
+			//atan2 stays precise for tiny angles where acos of the dot product does not
+			const glm::vec3 reference = v.normal / normalLength;
+			const float angle = std::atan2(glm::length(glm::cross(n, reference)), glm::dot(n, reference));
+			error.normal = std::max(error.normal, glm::degrees(angle));
+		}
+
+		//uv error is relative once coordinates leave [0,1], like the half float precision
+		const glm::vec2 uv(glm::unpackHalf1x16(c.uv[0]), glm::unpackHalf1x16(c.uv[1]));
+		const glm::vec2 uvError = glm::abs(uv - v.uv) / glm::max(glm::abs(v.uv), glm::vec2(1.0f));
+		error.uv = std::max(error.uv, std::max(uvError.x, uvError.y));
+	}
+	return error;
+}
+
+const void* Mesh::vertex_data() const
+{
+	if (_vertexFormat == MeshVertexFormat::Compact) {
+		return _compactVertices.data();
+	}
+	return _vertices.data();
+}
+
+size_t Mesh::vertex_buffer_size() const
+{
+	if (_vertexFormat == MeshVertexFormat::Compact) {
+		return _compactVertices.size() * sizeof(CompactVertex);
+	}
+	return _vertices.size() * sizeof(Vertex);
+}
+
+float Mesh::position_step() const
+{
+	//snorm16 spends 32767 steps on each half extent
+	const glm::vec3 extent(_positionDequantize[0][0], _positionDequantize[1][1], _positionDequantize[2][2]);
+	return std::max(extent.x, std::max(extent.y, extent.z)) / 32767.0f;
+}
+
+void Mesh::build_submeshes(const std::vector<uint32_t>& triangleMaterials)
+{
+	//counting sort keeps the file order inside a material
+	std::vector<uint32_t> offsets(_materials.size() + 1, 0);
+	for (uint32_t material : triangleMaterials) {
+		offsets[material + 1]++;
+	}
+	for (size_t m = 0; m < _materials.size(); m++) {
+		offsets[m + 1] += offsets[m];
+	}
+	std::vector<uint32_t> sorted(_indices.size());
+	std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+	for (size_t t = 0; t < triangleMaterials.size(); t++) {
+		const uint32_t target = cursor[triangleMaterials[t]]++;
+		memcpy(&sorted[target * 3], &_indices[t * 3], 3 * sizeof(uint32_t));
+	}
+	_indices.swap(sorted);
+
+	//unused materials get no submesh
+	_submeshes.clear();
+	_lods.clear();
+	for (uint32_t m = 0; m < _materials.size(); m++) {
+		if (offsets[m + 1] > offsets[m]) {
+			_submeshes.push_back(Submesh{ offsets[m] * 3, (offsets[m + 1] - offsets[m]) * 3, m });
+		}
+	}
+}
+
+void Mesh::update_bounds()
+{
+	//positions are read in place out of the interleaved vertices
+	_bounds = vkutil::compute_bounds(_vertices.empty() ? nullptr : &_vertices[0].position, _vertices.size(), sizeof(Vertex));
+}
+
+void Mesh::release_cpu_geometry()
+{
+	if (_lods.empty()) {
+		_lods.push_back(base_lod());
+	}
+	//swapping with empty vectors gives the memory back, clear() would keep the capacity
+	std::vector<Vertex>().swap(_vertices);
+	std::vector<uint32_t>().swap(_indices);
+	std::vector<CompactVertex>().swap(_compactVertices);
+	std::vector<Meshlet>().swap(_meshlets);
+	std::vector<uint32_t>().swap(_meshletVertices);
+	std::vector<uint8_t>().swap(_meshletTriangles);
+}
+
+MeshLod Mesh::base_lod() const
+{
+	if (_lods.empty()) {
+		return MeshLod{ 0, static_cast<uint32_t>(_indices.size()), 0.0f, 0, static_cast<uint32_t>(_submeshes.size()) };
+	}
+	return _lods[0];
+}
+
+MeshLod Mesh::select_lod(float distance, float pixelsPerUnit, float pixelThreshold) const
+{
+	MeshLod selected = base_lod();
+	const float safeDistance = std::max(distance, 1e-4f);
+	for (size_t i = 1; i < _lods.size(); i++) {
+		//levels get coarser with every step, stop at the first one that would be visible
+		if (_lods[i].error * pixelsPerUnit / safeDistance > pixelThreshold) {
+			break;
+		}
+		selected = _lods[i];
+	}
+	return selected;
+}
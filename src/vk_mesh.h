@@ -3,10 +3,13 @@
 #define VK_MESH_H
 #include <vk_types.h>
 #include <vector>
+#include <string>
 #include <glm/vec3.hpp>
 #include <glm/vec2.hpp> //now needed for the Vertex struct
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
+#include <vk_bounds.h>
+#include <vk_geometry_pool.h>
 
 struct MeshPushConstants {
     glm::vec4 data;
@@ -28,13 +31,157 @@ struct Vertex {
     glm::vec3 color;
     glm::vec2 uv;
     static VertexInputDescription get_vertex_description();
+
+    bool operator==(const Vertex& other) const;
+};
+
+//16 byte vertex for bandwidth bound scenes, opt in per mesh with Mesh::quantize_vertices
+//position: snorm16 relative to the mesh AABB, w is always 1
+//normal: octahedral encoded snorm16
+//uv: half floats, the color attribute is dropped
+struct CompactVertex {
+
+    int16_t position[4];
+    int16_t normal[2];
+    uint16_t uv[2];
+    static VertexInputDescription get_vertex_description();
+};
+
+enum class MeshVertexFormat : uint8_t {
+    Float32,  //Vertex
+    Compact,  //CompactVertex
+};
+
+//worst case difference between the fp32 vertices and their quantized copy
+struct QuantizationError {
+    float position;  //in mesh units
+    float normal;    //in degrees
+    float uv;
+    //tolerances are one quantization step of each encoding
+    bool within_tolerance(float positionStep) const;
+};
+
+//bitwise hash of all vertex attributes, used to weld duplicated face vertices
+struct VertexHash {
+    size_t operator()(const Vertex& v) const;
+};
+
+//cluster of at most MESHLET_MAX_VERTICES / MESHLET_MAX_TRIANGLES, laid out for a std430 buffer
+struct Meshlet {
+    //bounding sphere, xyz center and w radius in mesh space
+    glm::vec4 sphere;
+    //backface cone, xyz axis and w cutoff; all triangles face away when
+    //dot(center - camera, axis) >= cutoff * length(center - camera) + radius
+    glm::vec4 cone;
+    //first entry in Mesh::_meshletVertices
+    uint32_t vertexOffset;
+    //first byte in Mesh::_meshletTriangles
+    uint32_t triangleOffset;
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+};
+
+//surface description from the .mtl, RenderObjectsSets turns every entry into a Material
+struct MeshMaterial {
+    std::string name;
+    glm::vec3 diffuse{ 1.0f };
+    //empty when untextured
+    std::string diffuseTexture;
+};
+
+//contiguous range of Mesh::_indices drawn with one material
+struct Submesh {
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    //index into Mesh::_materials
+    uint32_t materialId;
+};
+
+//one level of detail, a range of Mesh::_indices drawn with the shared vertex buffer
+struct MeshLod {
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    //geometric error against LOD 0 in mesh units
+    float error;
+    //the level split by material, a range of Mesh::_submeshes that tiles the index range in order
+    uint32_t submeshOffset;
+    uint32_t submeshCount;
 };
 
 struct Mesh {
+    //unique vertices after welding
     std::vector<Vertex> _vertices;
+    //triangle list indexing into _vertices, LOD levels are stored back to back
+    std::vector<uint32_t> _indices;
+    //ranges of _indices from finest to coarsest, empty when the mesh has no LODs
+    std::vector<MeshLod> _lods;
+    //per material ranges of every level, sorted by material within a level
+    std::vector<Submesh> _submeshes;
+    //materials of the obj, at least one so every submesh has an entry
+    std::vector<MeshMaterial> _materials;
+    //mesh space bounds of _vertices, filled by the loaders
+    Bounds _bounds;
+    //quantized copy of _vertices, only filled for MeshVertexFormat::Compact
+    std::vector<CompactVertex> _compactVertices;
+    MeshVertexFormat _vertexFormat{ MeshVertexFormat::Float32 };
+    //maps quantized positions back to mesh space, identity for fp32 meshes
+    glm::mat4 _positionDequantize{ 1.0f };
 
+    //clusters built by vkutil::build_meshlets
+    std::vector<Meshlet> _meshlets;
+    //mesh vertex index of every meshlet vertex
+    std::vector<uint32_t> _meshletVertices;
+    //3 meshlet local indices per triangle, every meshlet starts on a 4 byte boundary
+    std::vector<uint8_t> _meshletTriangles;
+
+    //the geometry pool buffers, or buffers of its own when the pool was full
     AllocatedBuffer _vertexBuffer;
+    AllocatedBuffer _indexBuffer;
+    //ranges of the mesh inside the pool buffers, only valid when _pooled
+    GeometryAllocation _geometry;
+    bool _pooled{ false };
+    //added to every draw: first index of the mesh in _indexBuffer and first vertex in _vertexBuffer
+    uint32_t _firstIndex{ 0 };
+    int32_t _vertexOffset{ 0 };
+    //storage buffers holding the three meshlet arrays, only created when the mesh has meshlets
+    AllocatedBuffer _meshletBuffer;
+    AllocatedBuffer _meshletVertexBuffer;
+    AllocatedBuffer _meshletTriangleBuffer;
+    //16 bit indices when every vertex fits, 32 bit otherwise
+    VkIndexType _indexType{ VK_INDEX_TYPE_UINT32 };
+
     bool load_from_obj(const char* filename);
+    //load a mesh cooked by asset_cooker, returns false if the file is missing or stale
+    bool load_from_asset(const char* filename);
+    //build _vertices and _indices from an unindexed triangle list, merging identical vertices
+    void weld_vertices(const std::vector<Vertex>& faceVertices);
+    //sort the triangles of _indices by material (one id per triangle) and fill _submeshes
+    void build_submeshes(const std::vector<uint32_t>& triangleMaterials);
+    //pick index type from vertex count and return the index buffer size in bytes
+    size_t choose_index_type();
+    //switch the mesh to CompactVertex, keeping _vertices as the reference copy
+    void quantize_vertices();
+    //back to fp32 Vertex, for meshes whose compact copy lost too much precision
+    void drop_quantized_vertices();
+    //decode _compactVertices and compare against _vertices
+    QuantizationError measure_quantization_error() const;
+    //vertex buffer contents for the current format
+    const void* vertex_data() const;
+    size_t vertex_buffer_size() const;
+    //largest distance between two neighbouring quantized positions
+    float position_step() const;
+    //recompute _bounds after _vertices changed
+    void update_bounds();
+    //free the vertex, index and meshlet arrays once they are uploaded, draws only need the ranges and bounds
+    //base_lod keeps working, a mesh without LODs gets its single level written to _lods first
+    void release_cpu_geometry();
+    //submeshes of a level returned by base_lod or select_lod
+    const Submesh* lod_submeshes(const MeshLod& lod) const { return _submeshes.data() + lod.submeshOffset; }
+    //full detail range, all of _indices when no LODs were generated
+    MeshLod base_lod() const;
+    //coarsest level whose error projects to at most pixelThreshold pixels
+    //pixelsPerUnit is the screen height over 2 * tan(fovy / 2)
+    MeshLod select_lod(float distance, float pixelsPerUnit, float pixelThreshold) const;
 };
 
 struct UploadContext {
@@ -0,0 +1,394 @@
+#include "vk_mesh_optimizer.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+//fifo cache used by the analyzer and the overdraw cluster split
+struct FifoCache {
+	std::vector<uint32_t> timestamps;
+	uint32_t time;
+	uint32_t size;
+
+	FifoCache(size_t vertexCount, uint32_t cacheSize) : timestamps(vertexCount, 0), time(cacheSize + 1), size(cacheSize) {}
+
+	//returns true when the vertex had to be transformed
+	bool miss(uint32_t v) {
+		if (time - timestamps[v] > size) {
+			timestamps[v] = time++;
+			return true;
+		}
+		return false;
+	}
+
+	void reset() {
+		//pushing every entry out is cheaper than clearing the timestamps
+		time += size + 1;
+	}
+};
+
+VertexCacheStats vkutil::analyze_vertex_cache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+	VertexCacheStats stats = {};
+	if (indexCount < 3 || vertexCount == 0) {
+		return stats;
+	}
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<uint8_t> used(vertexCount, 0);
+	size_t misses = 0;
+	size_t uniqueVertices = 0;
+	for (size_t i = 0; i < indexCount; i++) {
+		misses += cache.miss(indices[i]) ? 1 : 0;
+		if (!used[indices[i]]) {
+			used[indices[i]] = 1;
+			uniqueVertices++;
+		}
+	}
+	stats.acmr = float(misses) / float(indexCount / 3);
+	stats.atvr = float(misses) / float(uniqueVertices);
+	return stats;
+}
+
+float vkutil::analyze_overdraw(const std::vector<Vertex>& vertices, const uint32_t* indices, size_t indexCount)
+{
+	constexpr int GRID = 256;
+	if (vertices.empty() || indexCount < 3) {
+		return 1.0f;
+	}
+	glm::vec3 minPos = vertices[0].position;
+	glm::vec3 maxPos = vertices[0].position;
+	for (const Vertex& v : vertices) {
+		minPos = glm::min(minPos, v.position);
+		maxPos = glm::max(maxPos, v.position);
+	}
+	const float extent = std::max(std::max(maxPos.x - minPos.x, maxPos.y - minPos.y), std::max(maxPos.z - minPos.z, 1e-6f));
+	const float scale = (GRID - 1) / extent;
+
+	std::vector<float> depth(GRID * GRID);
+	size_t shaded = 0;
+	size_t covered = 0;
+	for (int view = 0; view < 6; view++) {
+		//look down +/- x, y and z; the other two axes span the grid
+		const int axis = view / 2;
+		const float sign = (view % 2) ? -1.0f : 1.0f;
+		const int uAxis = (axis + 1) % 3;
+		const int vAxis = (axis + 2) % 3;
+		std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::max());
+
+		for (size_t i = 0; i + 2 < indexCount; i += 3) {
+			glm::vec3 p[3];
+			for (int k = 0; k < 3; k++) {
+				const glm::vec3& pos = vertices[indices[i + k]].position;
+				p[k] = glm::vec3((pos[uAxis] - minPos[uAxis]) * scale, (pos[vAxis] - minPos[vAxis]) * scale, sign * pos[axis]);
+			}
+			//no culling, the pipelines draw both faces
+			const float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y);
+			if (area == 0.0f) {
+				continue;
+			}
+			const float invArea = 1.0f / area;
+			const int x0 = std::max(0, int(std::floor(std::min(p[0].x, std::min(p[1].x, p[2].x)))));
+			const int x1 = std::min(GRID - 1, int(std::ceil(std::max(p[0].x, std::max(p[1].x, p[2].x)))));
+			const int y0 = std::max(0, int(std::floor(std::min(p[0].y, std::min(p[1].y, p[2].y)))));
+			const int y1 = std::min(GRID - 1, int(std::ceil(std::max(p[0].y, std::max(p[1].y, p[2].y)))));
+			for (int y = y0; y <= y1; y++) {
+				for (int x = x0; x <= x1; x++) {
+					//barycentrics of the pixel center
+					const float px = x + 0.5f, py = y + 0.5f;
+					const float w0 = ((p[1].x - px) * (p[2].y - py) - (p[2].x - px) * (p[1].y - py)) * invArea;
+					const float w1 = ((p[2].x - px) * (p[0].y - py) - (p[0].x - px) * (p[2].y - py)) * invArea;
+					const float w2 = 1.0f - w0 - w1;
+					if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) {
+						continue;
+					}
+					//same depth test as the mesh pipelines, less or equal
+					const float z = w0 * p[0].z + w1 * p[1].z + w2 * p[2].z;
+					float& stored = depth[y * GRID + x];
+					if (z <= stored) {
+						covered += stored == std::numeric_limits<float>::max() ? 1 : 0;
+						stored = z;
+						shaded++;
+					}
+				}
+			}
+		}
+	}
+	return covered ? float(shaded) / float(covered) : 1.0f;
+}
+
+void vkutil::optimize_vertex_cache(uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+	//Forsyth's scoring, the cache is larger than the hardware one on purpose
+	constexpr int CACHE_SIZE = 32;
+	constexpr float CACHE_DECAY_POWER = 1.5f;
+	constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+	constexpr float VALENCE_BOOST_SCALE = 2.0f;
+	constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+	const size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0) {
+		return;
+	}
+
+	float cacheScores[CACHE_SIZE];
+	for (int i = 0; i < CACHE_SIZE; i++) {
+		//the last triangle's vertices get a fixed score so it isn't simply repeated
+		cacheScores[i] = i < 3 ? LAST_TRIANGLE_SCORE
+			: std::pow(1.0f - float(i - 3) / float(CACHE_SIZE - 3), CACHE_DECAY_POWER);
+	}
+	auto vertex_score = [&](int cachePosition, uint32_t remaining) {
+		if (remaining == 0) {
+			return -1.0f;
+		}
+		float score = cachePosition >= 0 ? cacheScores[cachePosition] : 0.0f;
+		//favour vertices with few triangles left so they get finished and leave the cache
+		return score + VALENCE_BOOST_SCALE * std::pow(float(remaining), -VALENCE_BOOST_POWER);
+	};
+
+	//vertex -> triangle adjacency in one flat array, live triangles first in each range
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++) {
+		remaining[indices[i]]++;
+	}
+	std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++) {
+		adjacencyOffset[v + 1] = adjacencyOffset[v] + remaining[v];
+	}
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	{
+		std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+		for (size_t t = 0; t < triangleCount; t++) {
+			for (int k = 0; k < 3; k++) {
+				adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+			}
+		}
+	}
+
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) {
+		vertexScores[v] = vertex_score(-1, remaining[v]);
+	}
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<uint8_t> emitted(triangleCount, 0);
+	size_t best = 0;
+	for (size_t t = 0; t < triangleCount; t++) {
+		triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+		if (triangleScores[t] > triangleScores[best]) {
+			best = t;
+		}
+	}
+
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+	uint32_t cache[CACHE_SIZE + 3];
+	uint32_t cacheCount = 0;
+	size_t cursor = 0;
+
+	while (output.size() < triangleCount * 3) {
+		if (best == SIZE_MAX) {
+			//nothing in the cache has triangles left, continue with the next one in input order
+			while (emitted[cursor]) {
+				cursor++;
+			}
+			best = cursor;
+		}
+		const uint32_t* triangle = &indices[best * 3];
+		output.insert(output.end(), triangle, triangle + 3);
+		emitted[best] = 1;
+
+		//drop the triangle from the adjacency of its vertices
+		for (int k = 0; k < 3; k++) {
+			const uint32_t v = triangle[k];
+			uint32_t* list = &adjacency[adjacencyOffset[v]];
+			for (uint32_t i = 0; i < remaining[v]; i++) {
+				if (list[i] == best) {
+					std::swap(list[i], list[remaining[v] - 1]);
+					remaining[v]--;
+					break;
+				}
+			}
+		}
+
+		//move the triangle's vertices to the front of the LRU cache
+		uint32_t newCache[CACHE_SIZE + 3];
+		uint32_t newCount = 0;
+		for (int k = 0; k < 3; k++) {
+			if (std::find(newCache, newCache + newCount, triangle[k]) == newCache + newCount) {
+				newCache[newCount++] = triangle[k];
+			}
+		}
+		for (uint32_t i = 0; i < cacheCount; i++) {
+			const uint32_t v = cache[i];
+			if (std::find(newCache, newCache + newCount, v) == newCache + newCount) {
+				newCache[newCount++] = v;
+			}
+		}
+		//vertices pushed past the cache lose their cache score
+		for (uint32_t i = CACHE_SIZE; i < newCount; i++) {
+			vertexScores[newCache[i]] = vertex_score(-1, remaining[newCache[i]]);
+		}
+		cacheCount = std::min<uint32_t>(newCount, CACHE_SIZE);
+		std::copy(newCache, newCache + cacheCount, cache);
+		for (uint32_t i = 0; i < cacheCount; i++) {
+			vertexScores[cache[i]] = vertex_score(static_cast<int>(i), remaining[cache[i]]);
+		}
+
+		//rescore the triangles touching the cache and pick the best one
+		best = SIZE_MAX;
+		float bestScore = -1.0f;
+		for (uint32_t i = 0; i < cacheCount; i++) {
+			const uint32_t v = cache[i];
+			const uint32_t* list = &adjacency[adjacencyOffset[v]];
+			for (uint32_t j = 0; j < remaining[v]; j++) {
+				const uint32_t t = list[j];
+				const float score = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+				triangleScores[t] = score;
+				if (score > bestScore) {
+					bestScore = score;
+					best = t;
+				}
+			}
+		}
+	}
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void vkutil::optimize_overdraw(const std::vector<Vertex>& vertices, uint32_t* indices, size_t indexCount, float threshold)
+{
+	const size_t triangleCount = indexCount / 3;
+	if (triangleCount < 2) {
+		return;
+	}
+	constexpr uint32_t CACHE_SIZE = 16;
+	FifoCache cache(vertices.size(), CACHE_SIZE);
+	auto triangle_misses = [&](size_t t) {
+		return (cache.miss(indices[t * 3]) ? 1 : 0) + (cache.miss(indices[t * 3 + 1]) ? 1 : 0) + (cache.miss(indices[t * 3 + 2]) ? 1 : 0);
+	};
+
+	//hard boundaries: triangles that miss all three vertices start from a cold cache anyway
+	std::vector<size_t> hardClusters;
+	std::vector<uint32_t> hardMisses;
+	for (size_t t = 0; t < triangleCount; t++) {
+		const int misses = triangle_misses(t);
+		if (t == 0 || misses == 3) {
+			hardClusters.push_back(t);
+			hardMisses.push_back(0);
+		}
+		hardMisses.back() += misses;
+	}
+	hardClusters.push_back(triangleCount);
+
+	//soft boundaries: cut a hard cluster as soon as the piece is within threshold of the cluster ACMR
+	std::vector<size_t> clusters;
+	for (size_t h = 0; h + 1 < hardClusters.size(); h++) {
+		const size_t start = hardClusters[h];
+		const size_t end = hardClusters[h + 1];
+		const float clusterThreshold = threshold * float(hardMisses[h]) / float(end - start);
+		cache.reset();
+		size_t pieceStart = start;
+		uint32_t pieceMisses = 0;
+		clusters.push_back(start);
+		for (size_t t = start; t < end; t++) {
+			pieceMisses += triangle_misses(t);
+			if (t + 1 < end && float(pieceMisses) / float(t + 1 - pieceStart) <= clusterThreshold) {
+				clusters.push_back(t + 1);
+				cache.reset();
+				pieceStart = t + 1;
+				pieceMisses = 0;
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	//sort clusters by how much they face away from the mesh center, outer shells occlude inner ones
+	glm::vec3 meshCenter(0.0f);
+	for (const Vertex& v : vertices) {
+		meshCenter += v.position;
+	}
+	meshCenter /= float(vertices.size());
+
+	struct ClusterSort {
+		float key;
+		size_t cluster;
+	};
+	std::vector<ClusterSort> order(clusters.size() - 1);
+	for (size_t c = 0; c + 1 < clusters.size(); c++) {
+		glm::vec3 centroid(0.0f);
+		glm::vec3 normal(0.0f);
+		float totalArea = 0.0f;
+		for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+			const glm::vec3& p0 = vertices[indices[t * 3]].position;
+			const glm::vec3& p1 = vertices[indices[t * 3 + 1]].position;
+			const glm::vec3& p2 = vertices[indices[t * 3 + 2]].position;
+			const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+			const float area = glm::length(n);
+			centroid += (p0 + p1 + p2) * (area / 3.0f);
+			normal += n;
+			totalArea += area;
+		}
+		const float normalLength = glm::length(normal);
+		float key = 0.0f;
+		if (totalArea > 0.0f && normalLength > 0.0f) {
+			key = glm::dot(centroid / totalArea - meshCenter, normal / normalLength);
+		}
+		order[c] = { key, c };
+	}
+	std::stable_sort(order.begin(), order.end(), [](const ClusterSort& a, const ClusterSort& b) { return a.key > b.key; });
+
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+	for (const ClusterSort& entry : order) {
+		output.insert(output.end(), indices + clusters[entry.cluster] * 3, indices + clusters[entry.cluster + 1] * 3);
+	}
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void vkutil::optimize_vertex_fetch(Mesh& mesh)
+{
+	std::vector<uint32_t> remap(mesh._vertices.size(), UINT32_MAX);
+	std::vector<Vertex> vertices;
+	vertices.reserve(mesh._vertices.size());
+	for (uint32_t& index : mesh._indices) {
+		if (remap[index] == UINT32_MAX) {
+			remap[index] = static_cast<uint32_t>(vertices.size());
+			vertices.push_back(mesh._vertices[index]);
+		}
+		index = remap[index];
+	}
+	//unreferenced vertices are dropped
+	mesh._vertices.swap(vertices);
+}
+
+void vkutil::optimize_mesh(Mesh& mesh)
+{
+	const VertexCacheStats cacheBefore = analyze_vertex_cache(mesh._indices.data(), mesh._indices.size(), mesh._vertices.size());
+	const float overdrawBefore = analyze_overdraw(mesh._vertices, mesh._indices.data(), mesh._indices.size());
+
+	//triangles only move inside their submesh so the material ranges stay valid
+	const MeshLod base = mesh.base_lod();
+	std::vector<Submesh> ranges(mesh.lod_submeshes(base), mesh.lod_submeshes(base) + base.submeshCount);
+	if (ranges.empty()) {
+		ranges.push_back(Submesh{ base.indexOffset, base.indexCount, 0 });
+	}
+	for (const Submesh& range : ranges) {
+		optimize_vertex_cache(&mesh._indices[range.indexOffset], range.indexCount, mesh._vertices.size());
+	}
+	//the cluster sort is a heuristic, keep the cache order when it doesn't pay off on this mesh
+	std::vector<uint32_t> cacheOrder = mesh._indices;
+	const float cacheOrderOverdraw = analyze_overdraw(mesh._vertices, mesh._indices.data(), mesh._indices.size());
+	for (const Submesh& range : ranges) {
+		optimize_overdraw(mesh._vertices, &mesh._indices[range.indexOffset], range.indexCount);
+	}
+	float overdrawAfter = analyze_overdraw(mesh._vertices, mesh._indices.data(), mesh._indices.size());
+	if (overdrawAfter > cacheOrderOverdraw) {
+		mesh._indices.swap(cacheOrder);
+		overdrawAfter = cacheOrderOverdraw;
+	}
+	//renumbering vertices changes neither cache hits nor overdraw, only the fetch pattern
+	optimize_vertex_fetch(mesh);
+
+	const VertexCacheStats cacheAfter = analyze_vertex_cache(mesh._indices.data(), mesh._indices.size(), mesh._vertices.size());
+	std::cout << "Optimized indices: ACMR " << cacheBefore.acmr << " -> " << cacheAfter.acmr
+		<< ", ATVR " << cacheBefore.atvr << " -> " << cacheAfter.atvr
+		<< ", overdraw " << overdrawBefore << " -> " << overdrawAfter << std::endl;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#ifndef VK_MESH_OPTIMIZER_H
+#define VK_MESH_OPTIMIZER_H
+#include <vk_mesh.h>
+
+//post-transform cache efficiency of an index buffer, simulated with a FIFO cache
+struct VertexCacheStats {
+	//average cache miss ratio, vertex shader invocations per triangle (0.5 is ideal, 3 is worst)
+	float acmr;
+	//average transform to vertex ratio, vertex shader invocations per unique vertex (1 is ideal)
+	float atvr;
+};
+
+namespace vkutil {
+	//simulate a FIFO post-transform cache of cacheSize entries over a triangle list
+	VertexCacheStats analyze_vertex_cache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = 16);
+
+	//rasterize the mesh from the 6 axis directions into a small depth buffer in index order,
+	//returns shaded pixels / covered pixels (1 means no overdraw)
+	float analyze_overdraw(const std::vector<Vertex>& vertices, const uint32_t* indices, size_t indexCount);
+
+	//reorder triangles for the post-transform vertex cache (Forsyth's linear speed optimizer)
+	void optimize_vertex_cache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+	//split the cache optimized order into clusters and draw outward facing clusters first,
+	//threshold is how much worse the ACMR is allowed to get, 1.05 keeps it within 5%
+	void optimize_overdraw(const std::vector<Vertex>& vertices, uint32_t* indices, size_t indexCount, float threshold = 1.05f);
+
+	//renumber vertices in first use order so vertex fetch walks memory linearly
+	void optimize_vertex_fetch(Mesh& mesh);
+
+	//run the three passes above on a freshly welded mesh and print the stats before and after
+	//triangles are reordered within each submesh of LOD 0
+	//must run before quantize_vertices and build_meshlets, it reorders _vertices
+	void optimize_mesh(Mesh& mesh);
+}
+#endif // !VK_MESH_OPTIMIZER_H
@@ -0,0 +1,669 @@
+#include "vk_mesh_simplify.h"
+#include <vk_mesh_optimizer.h>
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+#include <chrono>
+#include <cstring>
+#include <cfloat>
+#include <unordered_map>
+
+//symmetric 4x4 error quadric, divided by weight to get squared distance
+struct Quadric {
+	double xx, xy, xz, xw, yy, yz, yw, zz, zw, ww;
+	double weight;
+};
+
+static Quadric plane_quadric(const glm::dvec3& n, double d, double weight)
+{
+	Quadric q;
+	q.xx = weight * n.x * n.x;
+	q.xy = weight * n.x * n.y;
+	q.xz = weight * n.x * n.z;
+	q.xw = weight * n.x * d;
+	q.yy = weight * n.y * n.y;
+	q.yz = weight * n.y * n.z;
+	q.yw = weight * n.y * d;
+	q.zz = weight * n.z * n.z;
+	q.zw = weight * n.z * d;
+	q.ww = weight * d * d;
+	q.weight = weight;
+	return q;
+}
+
+static void quadric_add(Quadric& q, const Quadric& r)
+{
+	q.xx += r.xx; q.xy += r.xy; q.xz += r.xz; q.xw += r.xw;
+	q.yy += r.yy; q.yz += r.yz; q.yw += r.yw;
+	q.zz += r.zz; q.zw += r.zw;
+	q.ww += r.ww;
+	q.weight += r.weight;
+}
+
+//squared distance from p to the planes accumulated in q
+static double quadric_error(const Quadric& q, const glm::vec3& p)
+{
+	const double x = p.x, y = p.y, z = p.z;
+	const double error = q.xx * x * x + 2 * q.xy * x * y + 2 * q.xz * x * z + 2 * q.xw * x
+		+ q.yy * y * y + 2 * q.yz * y * z + 2 * q.yw * y
+		+ q.zz * z * z + 2 * q.zw * z
+		+ q.ww;
+	return q.weight > 0.0 ? std::abs(error) / q.weight : 0.0;
+}
+
+enum class VertexKind : uint8_t {
+	Manifold, //free to collapse along any edge
+	Border,   //on an open edge, only collapses along the border
+	Seam,     //uv or normal discontinuity, only collapses along the seam
+	Locked,   //corners where borders or seams meet
+};
+
+static uint64_t edge_key(uint32_t a, uint32_t b)
+{
+	return (uint64_t(a) << 32) | b;
+}
+
+std::vector<uint32_t> vkutil::simplify_mesh(const std::vector<Vertex>& vertices, const uint32_t* indices, size_t indexCount,
+	size_t targetIndexCount, const uint8_t* lockedVertices, float& outError)
+{
+	//open edges and seams are weighted far above faces so they keep their shape
+	constexpr double BOUNDARY_WEIGHT = 10.0;
+	//uv and normal differences only bias the collapse order, a full uv unit costs 1% of the mesh size
+	constexpr float ATTRIBUTE_WEIGHT = 0.01f;
+
+	std::vector<uint32_t> result(indices, indices + indexCount);
+	outError = 0.0f;
+	const size_t vertexCount = vertices.size();
+	if (indexCount <= targetIndexCount || vertexCount == 0) {
+		return result;
+	}
+
+	//wedges: vertices that share a position but differ in normal or uv map to one position id
+	std::vector<uint32_t> positionId(vertexCount);
+	{
+		//adding zero turns -0 into +0, so bitwise equal keys match operator==
+		std::vector<glm::vec3> keys(vertexCount);
+		for (size_t i = 0; i < vertexCount; i++) {
+			keys[i] = vertices[i].position + glm::vec3(0.0f);
+		}
+		std::vector<uint32_t> order(vertexCount);
+		std::iota(order.begin(), order.end(), 0);
+		auto position_less = [&](uint32_t a, uint32_t b) {
+			return memcmp(&keys[a], &keys[b], sizeof(glm::vec3)) < 0;
+		};
+		std::sort(order.begin(), order.end(), position_less);
+		for (size_t i = 0; i < vertexCount; i++) {
+			const bool same = i > 0 && memcmp(&keys[order[i]], &keys[order[i - 1]], sizeof(glm::vec3)) == 0;
+			positionId[order[i]] = same ? positionId[order[i - 1]] : order[i];
+		}
+	}
+
+	//caller pinned positions never move, any of their wedges pins the position
+	std::vector<uint8_t> pinned(vertexCount, 0);
+	if (lockedVertices) {
+		for (size_t i = 0; i < vertexCount; i++) {
+			pinned[positionId[i]] |= lockedVertices[i];
+		}
+	}
+
+	//triangles that are already degenerate in the source would survive every pass
+	auto drop_degenerate = [&](const std::vector<uint32_t>& map) {
+		size_t write = 0;
+		for (size_t i = 0; i < result.size(); i += 3) {
+			const uint32_t a = map[result[i]], b = map[result[i + 1]], c = map[result[i + 2]];
+			if (positionId[a] == positionId[b] || positionId[b] == positionId[c] || positionId[a] == positionId[c]) {
+				continue;
+			}
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+		result.resize(write);
+	};
+	std::vector<uint32_t> remap(vertexCount);
+	std::iota(remap.begin(), remap.end(), 0);
+	drop_degenerate(remap);
+
+	glm::vec3 minPos = vertices[0].position;
+	glm::vec3 maxPos = vertices[0].position;
+	for (const Vertex& v : vertices) {
+		minPos = glm::min(minPos, v.position);
+		maxPos = glm::max(maxPos, v.position);
+	}
+	const float attributeScale = glm::length(maxPos - minPos) * ATTRIBUTE_WEIGHT;
+
+	//directed position edge -> wedge pair, rebuilt every pass from the current triangles
+	std::unordered_map<uint64_t, uint64_t> edges;
+	auto classify_edge = [&](uint32_t a, uint32_t b, uint32_t pa, uint32_t pb) {
+		auto reverse = edges.find(edge_key(pb, pa));
+		if (reverse == edges.end()) {
+			return VertexKind::Border;
+		}
+		return reverse->second == edge_key(b, a) ? VertexKind::Manifold : VertexKind::Seam;
+	};
+
+	//face planes weighted by area, plus constraint planes through border and seam edges
+	std::vector<Quadric> quadrics(vertexCount, Quadric{});
+	for (size_t i = 0; i + 2 < result.size(); i += 3) {
+		for (int k = 0; k < 3; k++) {
+			edges[edge_key(positionId[result[i + k]], positionId[result[i + (k + 1) % 3]])] =
+				edge_key(result[i + k], result[i + (k + 1) % 3]);
+		}
+	}
+	for (size_t i = 0; i + 2 < result.size(); i += 3) {
+		const glm::dvec3 p0 = vertices[result[i]].position;
+		const glm::dvec3 p1 = vertices[result[i + 1]].position;
+		const glm::dvec3 p2 = vertices[result[i + 2]].position;
+		glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+		const double area = glm::length(n);
+		if (area == 0.0) {
+			continue;
+		}
+		n /= area;
+		const Quadric face = plane_quadric(n, -glm::dot(n, p0), area);
+		for (int k = 0; k < 3; k++) {
+			quadric_add(quadrics[positionId[result[i + k]]], face);
+		}
+		for (int k = 0; k < 3; k++) {
+			const uint32_t a = result[i + k], b = result[i + (k + 1) % 3];
+			if (classify_edge(a, b, positionId[a], positionId[b]) == VertexKind::Manifold) {
+				continue;
+			}
+			const glm::dvec3 pa = vertices[a].position;
+			const glm::dvec3 edge = glm::dvec3(vertices[b].position) - pa;
+			const double length = glm::length(edge);
+			if (length == 0.0) {
+				continue;
+			}
+			const glm::dvec3 m = glm::normalize(glm::cross(edge, n));
+			const Quadric constraint = plane_quadric(m, -glm::dot(m, pa), length * length * BOUNDARY_WEIGHT);
+			quadric_add(quadrics[positionId[a]], constraint);
+			quadric_add(quadrics[positionId[b]], constraint);
+		}
+	}
+
+	struct Collapse {
+		uint32_t from;  //position id collapsing away
+		uint32_t to;    //position id it moves onto
+		float error;    //squared geometric error
+		float cost;     //error plus attribute bias, sort key
+	};
+	std::vector<VertexKind> kinds(vertexCount);
+	std::vector<uint8_t> borderCount(vertexCount);
+	std::vector<uint8_t> seamCount(vertexCount);
+	std::vector<uint32_t> adjacencyOffset(vertexCount + 1);
+	std::vector<uint32_t> adjacency;
+	std::vector<uint8_t> locked(vertexCount);
+	std::vector<Collapse> collapses;
+	std::vector<VertexKind> edgeKinds;
+	std::vector<std::pair<uint32_t, uint32_t>> wedgeTargets;
+	double maxError = 0.0;
+
+	while (result.size() > targetIndexCount) {
+		const size_t triangleCount = result.size() / 3;
+
+		//classify positions on the current triangles
+		edges.clear();
+		edges.reserve(result.size());
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (int k = 0; k < 3; k++) {
+				edges[edge_key(positionId[result[i + k]], positionId[result[i + (k + 1) % 3]])] =
+					edge_key(result[i + k], result[i + (k + 1) % 3]);
+			}
+		}
+		std::fill(borderCount.begin(), borderCount.end(), 0);
+		std::fill(seamCount.begin(), seamCount.end(), 0);
+		edgeKinds.resize(result.size());
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (int k = 0; k < 3; k++) {
+				const uint32_t a = result[i + k], b = result[i + (k + 1) % 3];
+				const uint32_t pa = positionId[a], pb = positionId[b];
+				const VertexKind kind = classify_edge(a, b, pa, pb);
+				edgeKinds[i + k] = kind;
+				//a seam edge is seen from both sides, count it once
+				if (kind == VertexKind::Border || (kind == VertexKind::Seam && pa < pb)) {
+					std::vector<uint8_t>& count = kind == VertexKind::Border ? borderCount : seamCount;
+					count[pa] = static_cast<uint8_t>(std::min(count[pa] + 1, 255));
+					count[pb] = static_cast<uint8_t>(std::min(count[pb] + 1, 255));
+				}
+			}
+		}
+		for (size_t p = 0; p < vertexCount; p++) {
+			if (pinned[p]) {
+				kinds[p] = VertexKind::Locked;
+			}
+			else if (borderCount[p] == 0 && seamCount[p] == 0) {
+				kinds[p] = VertexKind::Manifold;
+			}
+			else if (borderCount[p] == 2 && seamCount[p] == 0) {
+				kinds[p] = VertexKind::Border;
+			}
+			else if (seamCount[p] == 2 && borderCount[p] == 0) {
+				kinds[p] = VertexKind::Seam;
+			}
+			else {
+				kinds[p] = VertexKind::Locked;
+			}
+		}
+
+		//position -> triangles around it
+		std::fill(adjacencyOffset.begin(), adjacencyOffset.end(), 0);
+		for (uint32_t index : result) {
+			adjacencyOffset[positionId[index] + 1]++;
+		}
+		std::partial_sum(adjacencyOffset.begin(), adjacencyOffset.end(), adjacencyOffset.begin());
+		adjacency.resize(result.size());
+		{
+			std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+			for (size_t i = 0; i < result.size(); i++) {
+				adjacency[fill[positionId[result[i]]]++] = static_cast<uint32_t>(i / 3);
+			}
+		}
+
+		//candidate collapses along every edge, in both directions
+		//interior edges are seen from both triangles, take them from one side only
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (int k = 0; k < 3; k++) {
+				const uint32_t a = result[i + k], b = result[i + (k + 1) % 3];
+				const uint32_t pa = positionId[a], pb = positionId[b];
+				const VertexKind edgeKind = edgeKinds[i + k];
+				if (pa == pb || (pa > pb && edgeKind != VertexKind::Border)) {
+					continue;
+				}
+				const Vertex& va = vertices[a];
+				const Vertex& vb = vertices[b];
+				const float attribute = glm::dot(va.uv - vb.uv, va.uv - vb.uv) + 0.25f * glm::dot(va.normal - vb.normal, va.normal - vb.normal);
+				const uint32_t from[2] = { pa, pb };
+				const uint32_t to[2] = { pb, pa };
+				for (int d = 0; d < 2; d++) {
+					const VertexKind kind = kinds[from[d]];
+					//borders and seams may only slide along themselves
+					if (kind == VertexKind::Locked || (kind != VertexKind::Manifold && kind != edgeKind)) {
+						continue;
+					}
+					const float error = static_cast<float>(quadric_error(quadrics[from[d]], vertices[to[d]].position));
+					collapses.push_back({ from[d], to[d], error, error + attribute * attributeScale * attributeScale });
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		//every collapse removes about two triangles
+		const size_t goal = (triangleCount - targetIndexCount / 3) / 2 + 1;
+		//locked one rings make a pass skip candidates, don't let it reach far past the cheap ones
+		const float passLimit = collapses.empty() ? 0.0f : collapses[std::min(goal, collapses.size()) - 1].cost * 1.5f;
+		size_t performed = 0;
+		std::iota(remap.begin(), remap.end(), 0);
+		std::fill(locked.begin(), locked.end(), 0);
+		for (const Collapse& collapse : collapses) {
+			//past the limit only while nothing was collapsed yet, so a pass never stalls on invalid cheap edges
+			if (performed >= goal || (collapse.cost > passLimit && performed > 0)) {
+				break;
+			}
+			if (locked[collapse.from] || locked[collapse.to]) {
+				continue;
+			}
+			const glm::vec3& target = vertices[collapse.to].position;
+			//every wedge of the collapsing position needs a wedge of the target on a shared triangle,
+			//otherwise uvs or normals would be stretched across the seam
+			wedgeTargets.clear();
+			bool valid = true;
+			for (uint32_t j = adjacencyOffset[collapse.from]; j < adjacencyOffset[collapse.from + 1] && valid; j++) {
+				const uint32_t* triangle = &result[adjacency[j] * 3];
+				int corner = 0;
+				int targetCorner = -1;
+				for (int k = 0; k < 3; k++) {
+					if (positionId[triangle[k]] == collapse.from) corner = k;
+					if (positionId[triangle[k]] == collapse.to) targetCorner = k;
+				}
+				if (targetCorner >= 0) {
+					wedgeTargets.push_back({ triangle[corner], triangle[targetCorner] });
+					continue;
+				}
+				//the triangle survives, it must not flip
+				glm::vec3 p[3];
+				for (int k = 0; k < 3; k++) {
+					p[k] = vertices[triangle[k]].position;
+				}
+				const glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+				p[corner] = target;
+				const glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+				valid = glm::dot(before, after) > 0.0f;
+			}
+			for (uint32_t j = adjacencyOffset[collapse.from]; j < adjacencyOffset[collapse.from + 1] && valid; j++) {
+				const uint32_t* triangle = &result[adjacency[j] * 3];
+				for (int k = 0; k < 3; k++) {
+					if (positionId[triangle[k]] == collapse.from) {
+						const uint32_t wedge = triangle[k];
+						valid = std::find_if(wedgeTargets.begin(), wedgeTargets.end(),
+							[&](const std::pair<uint32_t, uint32_t>& w) { return w.first == wedge; }) != wedgeTargets.end();
+					}
+				}
+			}
+			if (!valid) {
+				continue;
+			}
+
+			for (const auto& wedge : wedgeTargets) {
+				remap[wedge.first] = wedge.second;
+			}
+			quadric_add(quadrics[collapse.to], quadrics[collapse.from]);
+			maxError = std::max(maxError, double(collapse.error));
+			//the one ring changed, nothing around it may collapse again in this pass
+			for (uint32_t j = adjacencyOffset[collapse.from]; j < adjacencyOffset[collapse.from + 1]; j++) {
+				const uint32_t* triangle = &result[adjacency[j] * 3];
+				for (int k = 0; k < 3; k++) {
+					locked[positionId[triangle[k]]] = 1;
+				}
+			}
+			performed++;
+		}
+		if (performed == 0) {
+			//every remaining edge is locked or would flip a triangle
+			break;
+		}
+
+		drop_degenerate(remap);
+	}
+
+	outError = static_cast<float>(std::sqrt(maxError));
+	return result;
+}
+
+//distance from p to the triangle abc
+static float point_triangle_distance(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+	const glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+	const float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+	if (d1 <= 0.0f && d2 <= 0.0f) return glm::length(ap);
+	const glm::vec3 bp = p - b;
+	const float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+	if (d3 >= 0.0f && d4 <= d3) return glm::length(bp);
+	const float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return glm::length(ap - ab * (d1 / (d1 - d3)));
+	const glm::vec3 cp = p - c;
+	const float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+	if (d6 >= 0.0f && d5 <= d6) return glm::length(cp);
+	const float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return glm::length(ap - ac * (d2 / (d2 - d6)));
+	const float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+		return glm::length(bp - (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6))));
+	}
+	const float denom = 1.0f / (va + vb + vc);
+	return glm::length(ap - ab * (vb * denom) - ac * (vc * denom));
+}
+
+//uniform grid over the triangles of one level, answers nearest surface distance queries
+struct TriangleGrid {
+	glm::vec3 origin;
+	float cellSize;
+	glm::ivec3 dims;
+	std::vector<uint32_t> cellOffset;
+	std::vector<uint32_t> cellTriangles;
+
+	void build(const Mesh& mesh, const MeshLod& lod) {
+		const uint32_t triangleCount = lod.indexCount / 3;
+		glm::vec3 minPos(FLT_MAX), maxPos(-FLT_MAX);
+		for (uint32_t i = lod.indexOffset; i < lod.indexOffset + lod.indexCount; i++) {
+			minPos = glm::min(minPos, mesh._vertices[mesh._indices[i]].position);
+			maxPos = glm::max(maxPos, mesh._vertices[mesh._indices[i]].position);
+		}
+		//about one triangle per cell
+		const glm::vec3 size = glm::max(maxPos - minPos, glm::vec3(1e-6f));
+		cellSize = std::max(std::cbrt(size.x * size.y * size.z / std::max(triangleCount, 1u)), 1e-6f);
+		dims = glm::clamp(glm::ivec3(size / cellSize) + 1, glm::ivec3(1), glm::ivec3(256));
+		cellSize = std::max(std::max(size.x / dims.x, size.y / dims.y), size.z / dims.z) * 1.001f;
+		origin = minPos;
+
+		//two passes, count then fill
+		cellOffset.assign(size_t(dims.x) * dims.y * dims.z + 1, 0);
+		for (int pass = 0; pass < 2; pass++) {
+			std::vector<uint32_t> fill(pass ? std::vector<uint32_t>(cellOffset.begin(), cellOffset.end() - 1) : std::vector<uint32_t>());
+			for (uint32_t t = 0; t < triangleCount; t++) {
+				const uint32_t* triangle = &mesh._indices[lod.indexOffset + t * 3];
+				glm::vec3 triMin(FLT_MAX), triMax(-FLT_MAX);
+				for (int k = 0; k < 3; k++) {
+					triMin = glm::min(triMin, mesh._vertices[triangle[k]].position);
+					triMax = glm::max(triMax, mesh._vertices[triangle[k]].position);
+				}
+				const glm::ivec3 c0 = cell(triMin), c1 = cell(triMax);
+				for (int z = c0.z; z <= c1.z; z++) {
+					for (int y = c0.y; y <= c1.y; y++) {
+						for (int x = c0.x; x <= c1.x; x++) {
+							const size_t index = (size_t(z) * dims.y + y) * dims.x + x;
+							if (pass) cellTriangles[fill[index]++] = t;
+							else cellOffset[index + 1]++;
+						}
+					}
+				}
+			}
+			if (!pass) {
+				std::partial_sum(cellOffset.begin(), cellOffset.end(), cellOffset.begin());
+				cellTriangles.resize(cellOffset.back());
+			}
+		}
+	}
+
+	glm::ivec3 cell(const glm::vec3& p) const {
+		return glm::clamp(glm::ivec3(glm::floor((p - origin) / cellSize)), glm::ivec3(0), dims - 1);
+	}
+
+	//search rings of cells outwards until no unvisited cell can be closer
+	float distance(const Mesh& mesh, const MeshLod& lod, const glm::vec3& p) const {
+		const glm::ivec3 center = cell(p);
+		float best = FLT_MAX;
+		const int maxRing = std::max(dims.x, std::max(dims.y, dims.z));
+		for (int ring = 0; ring <= maxRing; ring++) {
+			for (int z = center.z - ring; z <= center.z + ring; z++) {
+				for (int y = center.y - ring; y <= center.y + ring; y++) {
+					for (int x = center.x - ring; x <= center.x + ring; x++) {
+						const bool shell = std::abs(x - center.x) == ring || std::abs(y - center.y) == ring || std::abs(z - center.z) == ring;
+						if (!shell || x < 0 || y < 0 || z < 0 || x >= dims.x || y >= dims.y || z >= dims.z) {
+							continue;
+						}
+						const size_t index = (size_t(z) * dims.y + y) * dims.x + x;
+						for (uint32_t j = cellOffset[index]; j < cellOffset[index + 1]; j++) {
+							const uint32_t* triangle = &mesh._indices[lod.indexOffset + cellTriangles[j] * 3];
+							best = std::min(best, point_triangle_distance(p, mesh._vertices[triangle[0]].position,
+								mesh._vertices[triangle[1]].position, mesh._vertices[triangle[2]].position));
+						}
+					}
+				}
+			}
+			//cells past this ring are at least ring cells away, points outside the grid only more so
+			if (best <= ring * cellSize) {
+				break;
+			}
+		}
+		return best;
+	}
+};
+
+float vkutil::measure_lod_error(const Mesh& mesh, size_t level, const std::vector<glm::vec3>& points)
+{
+	if (level >= mesh._lods.size() || mesh._lods[level].indexCount == 0) {
+		return 0.0f;
+	}
+	TriangleGrid grid;
+	grid.build(mesh, mesh._lods[level]);
+	float maxDistance = 0.0f;
+	for (const glm::vec3& p : points) {
+		maxDistance = std::max(maxDistance, grid.distance(mesh, mesh._lods[level], p));
+	}
+	return maxDistance;
+}
+
+//vertices whose position is used by more than one submesh, simplifying one side would open a crack
+static std::vector<uint8_t> shared_submesh_vertices(const Mesh& mesh, const MeshLod& base)
+{
+	const size_t vertexCount = mesh._vertices.size();
+	std::vector<uint8_t> locked(vertexCount, 0);
+	if (base.submeshCount < 2) {
+		return locked;
+	}
+	constexpr uint32_t UNUSED = UINT32_MAX;
+	constexpr uint32_t SHARED = UINT32_MAX - 1;
+	std::vector<uint32_t> owner(vertexCount, UNUSED);
+	const Submesh* submeshes = mesh.lod_submeshes(base);
+	for (uint32_t s = 0; s < base.submeshCount; s++) {
+		for (uint32_t i = submeshes[s].indexOffset; i < submeshes[s].indexOffset + submeshes[s].indexCount; i++) {
+			uint32_t& o = owner[mesh._indices[i]];
+			o = o == UNUSED || o == s ? s : SHARED;
+		}
+	}
+	//wedges of one position can belong to different submeshes, group them like simplify_mesh does
+	std::vector<glm::vec3> keys(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++) {
+		keys[i] = mesh._vertices[i].position + glm::vec3(0.0f);
+	}
+	std::vector<uint32_t> order(vertexCount);
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		return memcmp(&keys[a], &keys[b], sizeof(glm::vec3)) < 0;
+	});
+	for (size_t first = 0; first < vertexCount;) {
+		size_t last = first + 1;
+		while (last < vertexCount && memcmp(&keys[order[last]], &keys[order[first]], sizeof(glm::vec3)) == 0) {
+			last++;
+		}
+		uint32_t groupOwner = UNUSED;
+		for (size_t i = first; i < last; i++) {
+			const uint32_t o = owner[order[i]];
+			if (o != UNUSED) {
+				groupOwner = groupOwner == UNUSED || groupOwner == o ? o : SHARED;
+			}
+		}
+		if (groupOwner == SHARED) {
+			for (size_t i = first; i < last; i++) {
+				locked[order[i]] = 1;
+			}
+		}
+		first = last;
+	}
+	return locked;
+}
+
+float vkutil::generate_lods(Mesh& mesh, const float* ratios, size_t ratioCount)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	MeshLod base = mesh.base_lod();
+	mesh._indices.resize(base.indexOffset + base.indexCount);
+	//meshes built without materials get one submesh covering everything
+	if (base.submeshCount == 0) {
+		mesh._submeshes.assign(1, Submesh{ base.indexOffset, base.indexCount, 0 });
+		base.submeshOffset = 0;
+		base.submeshCount = 1;
+	}
+	mesh._submeshes.resize(base.submeshOffset + base.submeshCount);
+	mesh._lods.clear();
+	mesh._lods.push_back(base);
+
+	//the quadric error is an area weighted average, the selector needs the worst case as well
+	//sampled at LOD 0's vertices and triangle centroids, vertices alone miss where a coarse level cuts through a face
+	std::vector<glm::vec3> basePositions;
+	basePositions.reserve(mesh._vertices.size() + base.indexCount / 3);
+	for (const Vertex& v : mesh._vertices) {
+		basePositions.push_back(v.position);
+	}
+	for (uint32_t i = base.indexOffset; i < base.indexOffset + base.indexCount; i += 3) {
+		basePositions.push_back((mesh._vertices[mesh._indices[i]].position + mesh._vertices[mesh._indices[i + 1]].position
+			+ mesh._vertices[mesh._indices[i + 2]].position) / 3.0f);
+	}
+	//each submesh is simplified on its own with the material borders pinned
+	const std::vector<uint8_t> locked = shared_submesh_vertices(mesh, base);
+
+	for (size_t r = 0; r < ratioCount; r++) {
+		const float ratio = ratios[r];
+		//each level starts from the previous one, the measured error below is still against LOD 0
+		const MeshLod previous = mesh._lods.back();
+		MeshLod lod;
+		lod.indexOffset = static_cast<uint32_t>(mesh._indices.size());
+		lod.indexCount = 0;
+		lod.submeshOffset = static_cast<uint32_t>(mesh._submeshes.size());
+		lod.submeshCount = base.submeshCount;
+		float error = 0.0f;
+		size_t target = 0;
+		for (uint32_t s = 0; s < base.submeshCount; s++) {
+			//copied, the push_back below may reallocate _submeshes
+			const Submesh from = mesh._submeshes[previous.submeshOffset + s];
+			const size_t submeshTarget = static_cast<size_t>(mesh._submeshes[base.submeshOffset + s].indexCount / 3 * ratio) * 3;
+			target += submeshTarget;
+			float submeshError = 0.0f;
+			std::vector<uint32_t> level = simplify_mesh(mesh._vertices, mesh._indices.data() + from.indexOffset, from.indexCount,
+				submeshTarget, locked.data(), submeshError);
+			optimize_vertex_cache(level.data(), level.size(), mesh._vertices.size());
+			error = std::max(error, submeshError);
+
+			mesh._submeshes.push_back(Submesh{ lod.indexOffset + lod.indexCount, static_cast<uint32_t>(level.size()), from.materialId });
+			mesh._indices.insert(mesh._indices.end(), level.begin(), level.end());
+			lod.indexCount += static_cast<uint32_t>(level.size());
+		}
+		if (lod.indexCount > previous.indexCount * (1.0f - LOD_MIN_REDUCTION)) {
+			//the simplifier stalled, a level with nearly the same triangles costs memory and saves nothing
+			mesh._indices.resize(lod.indexOffset);
+			mesh._submeshes.resize(lod.submeshOffset);
+			break;
+		}
+
+		mesh._lods.push_back(lod);
+		const float measured = measure_lod_error(mesh, mesh._lods.size() - 1, basePositions);
+		mesh._lods.back().error = std::max(std::max(error + previous.error, measured), previous.error);
+		if (lod.indexCount > target) {
+			//stopped short of the target, simplifying this level again would not get further
+			break;
+		}
+	}
+	return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+bool vkutil::validate_lods(const Mesh& mesh)
+{
+	for (size_t l = 0; l < mesh._lods.size(); l++) {
+		const MeshLod& lod = mesh._lods[l];
+		if (lod.indexCount % 3 != 0 || size_t(lod.indexOffset) + lod.indexCount > mesh._indices.size()) {
+			std::cout << "LOD " << l << " range is outside the index buffer" << std::endl;
+			return false;
+		}
+		if (l > 0 && (lod.indexCount > mesh._lods[l - 1].indexCount || lod.error < mesh._lods[l - 1].error)) {
+			std::cout << "LOD " << l << " is finer than LOD " << l - 1 << std::endl;
+			return false;
+		}
+		//submeshes tile the level in order
+		if (size_t(lod.submeshOffset) + lod.submeshCount > mesh._submeshes.size()) {
+			std::cout << "LOD " << l << " submesh range is outside the submesh list" << std::endl;
+			return false;
+		}
+		uint32_t cursor = lod.indexOffset;
+		for (uint32_t s = 0; s < lod.submeshCount; s++) {
+			const Submesh& submesh = mesh._submeshes[lod.submeshOffset + s];
+			if (submesh.indexOffset != cursor || submesh.indexCount % 3 != 0 || submesh.materialId >= mesh._materials.size()) {
+				std::cout << "LOD " << l << " submesh " << s << " does not continue the level" << std::endl;
+				return false;
+			}
+			cursor += submesh.indexCount;
+		}
+		if (cursor != lod.indexOffset + lod.indexCount) {
+			std::cout << "LOD " << l << " submeshes don't cover the level" << std::endl;
+			return false;
+		}
+		//LOD 0 is the source mesh, only generated levels have to be clean
+		if (l == 0) {
+			continue;
+		}
+		for (uint32_t i = lod.indexOffset; i < lod.indexOffset + lod.indexCount; i += 3) {
+			const uint32_t a = mesh._indices[i], b = mesh._indices[i + 1], c = mesh._indices[i + 2];
+			if (a >= mesh._vertices.size() || b >= mesh._vertices.size() || c >= mesh._vertices.size()) {
+				std::cout << "LOD " << l << " indexes past the vertex buffer" << std::endl;
+				return false;
+			}
+			if (mesh._vertices[a].position == mesh._vertices[b].position || mesh._vertices[b].position == mesh._vertices[c].position
+				|| mesh._vertices[a].position == mesh._vertices[c].position) {
+				std::cout << "LOD " << l << " has a degenerate triangle" << std::endl;
+				return false;
+			}
+		}
+	}
+	return true;
+}
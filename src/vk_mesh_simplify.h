@@ -0,0 +1,37 @@
+#pragma once
+#ifndef VK_MESH_SIMPLIFY_H
+#define VK_MESH_SIMPLIFY_H
+#include <vk_mesh.h>
+#include <array>
+
+//fractions of LOD 0 triangles used when no ratios are given, 5 levels in total
+inline constexpr std::array<float, 4> DEFAULT_LOD_RATIOS{ 0.5f, 0.25f, 0.125f, 0.0625f };
+//a level has to drop at least this fraction of the previous level's triangles, generate_lods stops at one that does not
+inline constexpr float LOD_MIN_REDUCTION = 0.25f;
+//how far over its target triangle count a kept level may stay, seams and borders can leave nothing more to collapse
+inline constexpr float LOD_TARGET_SLACK = 0.1f;
+
+namespace vkutil {
+	//quadric error edge collapse down to targetIndexCount
+	//only existing vertices are kept, so every level can share the mesh vertex buffer
+	//borders and uv/normal seams only collapse along themselves, vertices flagged in lockedVertices
+	//(one byte per vertex, may be null) keep their position fixed
+	//outError receives the geometric error in mesh units
+	std::vector<uint32_t> simplify_mesh(const std::vector<Vertex>& vertices, const uint32_t* indices, size_t indexCount,
+		size_t targetIndexCount, const uint8_t* lockedVertices, float& outError);
+
+	//simplify LOD 0 once per ratio (fraction of its triangles) and append the levels to mesh._indices,
+	//every submesh separately with positions shared between submeshes locked
+	//a level missing LOD_MIN_REDUCTION is dropped, one stopping short of its target is kept as the last
+	//must run after optimize_mesh, returns the build time in milliseconds
+	float generate_lods(Mesh& mesh, const float* ratios, size_t ratioCount);
+
+	//check every level references valid vertices, has no degenerate triangles,
+	//never grows and never reports less error than the level before
+	//prints the first failure and returns false
+	bool validate_lods(const Mesh& mesh);
+
+	//largest distance from any of the points to the surface of a level
+	float measure_lod_error(const Mesh& mesh, size_t level, const std::vector<glm::vec3>& points);
+}
+#endif // !VK_MESH_SIMPLIFY_H
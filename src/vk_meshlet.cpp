@@ -0,0 +1,223 @@
+#include "vk_meshlet.h"
+#include <iostream>
+#include <algorithm>
+#include <array>
+#include <chrono>
+
+//ritter's bounding sphere: start from the most distant pair of axis extremes, grow to fit the rest
+static glm::vec4 compute_sphere(const Mesh& mesh, const uint32_t* vertices, uint32_t count)
+{
+	uint32_t minIndex[3] = { vertices[0], vertices[0], vertices[0] };
+	uint32_t maxIndex[3] = { vertices[0], vertices[0], vertices[0] };
+	for (uint32_t i = 0; i < count; i++) {
+		const glm::vec3& p = mesh._vertices[vertices[i]].position;
+		for (int axis = 0; axis < 3; axis++) {
+			if (p[axis] < mesh._vertices[minIndex[axis]].position[axis]) minIndex[axis] = vertices[i];
+			if (p[axis] > mesh._vertices[maxIndex[axis]].position[axis]) maxIndex[axis] = vertices[i];
+		}
+	}
+	glm::vec3 a = mesh._vertices[minIndex[0]].position;
+	glm::vec3 b = mesh._vertices[maxIndex[0]].position;
+	for (int axis = 1; axis < 3; axis++) {
+		const glm::vec3& minP = mesh._vertices[minIndex[axis]].position;
+		const glm::vec3& maxP = mesh._vertices[maxIndex[axis]].position;
+		if (glm::dot(maxP - minP, maxP - minP) > glm::dot(b - a, b - a)) {
+			a = minP;
+			b = maxP;
+		}
+	}
+	glm::vec3 center = (a + b) * 0.5f;
+	float radius = glm::length(b - a) * 0.5f;
+	for (uint32_t i = 0; i < count; i++) {
+		const glm::vec3& p = mesh._vertices[vertices[i]].position;
+		const float distance = glm::length(p - center);
+		if (distance > radius) {
+			const float newRadius = (radius + distance) * 0.5f;
+			center += (p - center) * ((newRadius - radius) / distance);
+			radius = newRadius;
+		}
+	}
+	return glm::vec4(center, radius);
+}
+
+//cone around the average triangle normal, cutoff is the sine of the widest normal angle
+static glm::vec4 compute_cone(const Mesh& mesh, const Meshlet& meshlet)
+{
+	const uint32_t* vertices = &mesh._meshletVertices[meshlet.vertexOffset];
+	const uint8_t* triangles = &mesh._meshletTriangles[meshlet.triangleOffset];
+
+	glm::vec3 normals[MESHLET_MAX_TRIANGLES];
+	uint32_t normalCount = 0;
+	glm::vec3 axis(0.0f);
+	for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+		const glm::vec3& p0 = mesh._vertices[vertices[triangles[t * 3 + 0]]].position;
+		const glm::vec3& p1 = mesh._vertices[vertices[triangles[t * 3 + 1]]].position;
+		const glm::vec3& p2 = mesh._vertices[vertices[triangles[t * 3 + 2]]].position;
+		const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+		const float area = glm::length(n);
+		//degenerate triangles never rasterize, they can't widen the cone
+		if (area == 0.0f) {
+			continue;
+		}
+		normals[normalCount] = n / area;
+		axis += normals[normalCount];
+		normalCount++;
+	}
+	const float axisLength = glm::length(axis);
+	if (normalCount == 0 || axisLength == 0.0f) {
+		//a cutoff of 1 never passes the culling test
+		return glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+	axis /= axisLength;
+	float minDot = 1.0f;
+	for (uint32_t i = 0; i < normalCount; i++) {
+		minDot = std::min(minDot, glm::dot(axis, normals[i]));
+	}
+	//normals spread over more than ~85 degrees, culling would almost never succeed
+	if (minDot <= 0.1f) {
+		return glm::vec4(axis, 1.0f);
+	}
+	return glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+}
+
+float vkutil::build_meshlets(Mesh& mesh)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	mesh._meshlets.clear();
+	mesh._meshletVertices.clear();
+	mesh._meshletTriangles.clear();
+
+	//LOD levels share the vertices, clusters are only built for full detail
+	const MeshLod base = mesh.base_lod();
+	const size_t triangleCount = base.indexCount / 3;
+	mesh._meshletVertices.reserve(triangleCount);
+	mesh._meshletTriangles.reserve(triangleCount * 3 + triangleCount / 8);
+
+	//meshlet local index of every mesh vertex, 0xff when not in the current meshlet
+	std::vector<uint8_t> localIndex(mesh._vertices.size(), 0xff);
+	Meshlet current = {};
+
+	auto finish_meshlet = [&]() {
+		if (current.triangleCount == 0) {
+			return;
+		}
+		const uint32_t* vertices = &mesh._meshletVertices[current.vertexOffset];
+		for (uint32_t i = 0; i < current.vertexCount; i++) {
+			localIndex[vertices[i]] = 0xff;
+		}
+		current.sphere = compute_sphere(mesh, vertices, current.vertexCount);
+		//pad so the next meshlet can be read as whole uint words on the gpu
+		while (mesh._meshletTriangles.size() % 4 != 0) {
+			mesh._meshletTriangles.push_back(0);
+		}
+		current.cone = compute_cone(mesh, current);
+		mesh._meshlets.push_back(current);
+
+		current = {};
+		current.vertexOffset = static_cast<uint32_t>(mesh._meshletVertices.size());
+		current.triangleOffset = static_cast<uint32_t>(mesh._meshletTriangles.size());
+	};
+
+	//a meshlet never spans two submeshes, so every cluster has one material
+	std::vector<uint32_t> submeshEnds;
+	for (uint32_t s = 0; s < base.submeshCount; s++) {
+		const Submesh& submesh = mesh.lod_submeshes(base)[s];
+		submeshEnds.push_back((submesh.indexOffset + submesh.indexCount - base.indexOffset) / 3);
+	}
+	size_t nextEnd = 0;
+
+	for (size_t t = 0; t < triangleCount; t++) {
+		while (nextEnd < submeshEnds.size() && submeshEnds[nextEnd] <= t) {
+			finish_meshlet();
+			nextEnd++;
+		}
+		const uint32_t* triangle = &mesh._indices[base.indexOffset + t * 3];
+		uint32_t newVertices = 0;
+		for (int i = 0; i < 3; i++) {
+			newVertices += localIndex[triangle[i]] == 0xff ? 1 : 0;
+		}
+		if (current.vertexCount + newVertices > MESHLET_MAX_VERTICES || current.triangleCount == MESHLET_MAX_TRIANGLES) {
+			finish_meshlet();
+		}
+		for (int i = 0; i < 3; i++) {
+			uint8_t& local = localIndex[triangle[i]];
+			if (local == 0xff) {
+				local = static_cast<uint8_t>(current.vertexCount++);
+				mesh._meshletVertices.push_back(triangle[i]);
+			}
+			mesh._meshletTriangles.push_back(local);
+		}
+		current.triangleCount++;
+	}
+	finish_meshlet();
+
+	return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+bool vkutil::validate_meshlets(const Mesh& mesh)
+{
+	//triangles are compared with their smallest index first, keeping the winding
+	auto canonical = [](uint32_t a, uint32_t b, uint32_t c) {
+		if (b < a && b < c) return std::array<uint32_t, 3>{ b, c, a };
+		if (c < a && c < b) return std::array<uint32_t, 3>{ c, a, b };
+		return std::array<uint32_t, 3>{ a, b, c };
+	};
+
+	const MeshLod base = mesh.base_lod();
+	std::vector<std::array<uint32_t, 3>> meshTriangles;
+	meshTriangles.reserve(base.indexCount / 3);
+	for (size_t i = base.indexOffset; i + 2 < base.indexOffset + base.indexCount; i += 3) {
+		meshTriangles.push_back(canonical(mesh._indices[i], mesh._indices[i + 1], mesh._indices[i + 2]));
+	}
+
+	std::vector<std::array<uint32_t, 3>> meshletTriangles;
+	meshletTriangles.reserve(meshTriangles.size());
+	for (size_t m = 0; m < mesh._meshlets.size(); m++) {
+		const Meshlet& meshlet = mesh._meshlets[m];
+		if (meshlet.vertexCount > MESHLET_MAX_VERTICES || meshlet.triangleCount > MESHLET_MAX_TRIANGLES
+			|| meshlet.triangleOffset % 4 != 0) {
+			std::cout << "Meshlet " << m << " exceeds the limits" << std::endl;
+			return false;
+		}
+		const uint32_t* vertices = &mesh._meshletVertices[meshlet.vertexOffset];
+		const uint8_t* triangles = &mesh._meshletTriangles[meshlet.triangleOffset];
+		const glm::vec3 center(meshlet.sphere);
+		const float tolerance = meshlet.sphere.w * 1e-5f + 1e-6f;
+		for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+			if (glm::length(mesh._vertices[vertices[i]].position - center) > meshlet.sphere.w + tolerance) {
+				std::cout << "Meshlet " << m << " sphere misses vertex " << vertices[i] << std::endl;
+				return false;
+			}
+		}
+		//every triangle normal must lie inside the cone for culling to be conservative
+		const glm::vec3 axis(meshlet.cone);
+		const float minDot = std::sqrt(std::max(0.0f, 1.0f - meshlet.cone.w * meshlet.cone.w));
+		for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+			const uint8_t* local = &triangles[t * 3];
+			if (local[0] >= meshlet.vertexCount || local[1] >= meshlet.vertexCount || local[2] >= meshlet.vertexCount) {
+				std::cout << "Meshlet " << m << " triangle " << t << " indexes past its vertices" << std::endl;
+				return false;
+			}
+			const uint32_t a = vertices[local[0]], b = vertices[local[1]], c = vertices[local[2]];
+			meshletTriangles.push_back(canonical(a, b, c));
+
+			const glm::vec3 n = glm::cross(mesh._vertices[b].position - mesh._vertices[a].position,
+				mesh._vertices[c].position - mesh._vertices[a].position);
+			const float area = glm::length(n);
+			if (meshlet.cone.w < 1.0f && area > 0.0f && glm::dot(n / area, axis) < minDot - 1e-4f) {
+				std::cout << "Meshlet " << m << " cone misses triangle " << t << std::endl;
+				return false;
+			}
+		}
+	}
+
+	//coverage: the meshlets hold exactly the mesh triangles, each once
+	std::sort(meshTriangles.begin(), meshTriangles.end());
+	std::sort(meshletTriangles.begin(), meshletTriangles.end());
+	if (meshTriangles != meshletTriangles) {
+		std::cout << "Meshlets cover " << meshletTriangles.size() << " triangles, mesh has "
+			<< meshTriangles.size() << " or a different set" << std::endl;
+		return false;
+	}
+	return true;
+}
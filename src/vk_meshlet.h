@@ -0,0 +1,19 @@
+#pragma once
+#ifndef VK_MESHLET_H
+#define VK_MESHLET_H
+#include <vk_mesh.h>
+
+constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+namespace vkutil {
+	//split the full detail range of mesh._indices into meshlets in index order and compute their bounds
+	//returns the build time in milliseconds
+	float build_meshlets(Mesh& mesh);
+
+	//check limits, that every triangle is covered exactly once,
+	//that spheres contain their vertices and that cones contain their triangle normals
+	//prints the first failure and returns false
+	bool validate_meshlets(const Mesh& mesh);
+}
+#endif // !VK_MESHLET_H
@@ -1,34 +1,205 @@
 #include "vk_renderObjects.h"
-Material* RenderObjectsSets::create_material(VkPipeline pipeline, VkPipelineLayout layout, const std::string& name)
+#include <algorithm>
+#include <numeric>
+#include <tuple>
+uint32_t RenderObjectsSets::add_renderable(const RenderObject& object, const glm::mat4& transform)
+{
+	_renderables.push_back(object);
+	_renderableBounds.emplace_back();
+	const uint32_t index = static_cast<uint32_t>(_renderables.size() - 1);
+	set_transform(index, transform);
+	return index;
+}
+
+void RenderObjectsSets::set_transform(uint32_t index, const glm::mat4& transform)
+{
+	RenderObject& object = _renderables[index];
+	object.transformMatrix = transform;
+	_renderableBounds[index] = vkutil::transform_bounds(_meshes[object.mesh]._bounds, transform);
+}
+
+void RenderObjectsSets::sort_renderables()
+{
+	//objects with a stale material sort first, drawing skips nothing for them either way
+	std::vector<std::tuple<VkPipeline, VkDescriptorSet>> keys(_renderables.size());
+	for (size_t i = 0; i < _renderables.size(); i++) {
+		if (const Material* material = _materials.get(_renderables[i].material)) {
+			keys[i] = std::make_tuple(material->pipeline, material->textureSet);
+		}
+	}
+	std::vector<uint32_t> order(_renderables.size());
+	std::iota(order.begin(), order.end(), 0u);
+	std::stable_sort(order.begin(), order.end(), [&keys](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+
+	std::vector<RenderObject> renderables;
+	std::vector<Bounds> bounds;
+	renderables.reserve(order.size());
+	bounds.reserve(order.size());
+	for (uint32_t i : order) {
+		renderables.push_back(_renderables[i]);
+		bounds.push_back(_renderableBounds[i]);
+	}
+	_renderables.swap(renderables);
+	_renderableBounds.swap(bounds);
+}
+
+template<typename Predicate>
+void RenderObjectsSets::remove_renderables(Predicate drawsRemoved)
+{
+	size_t kept = 0;
+	for (size_t i = 0; i < _renderables.size(); i++) {
+		if (!drawsRemoved(_renderables[i])) {
+			_renderables[kept] = _renderables[i];
+			_renderableBounds[kept] = _renderableBounds[i];
+			kept++;
+		}
+	}
+	_renderables.resize(kept);
+	_renderableBounds.resize(kept);
+}
+
+MaterialHandle RenderObjectsSets::create_material(VkPipeline pipeline, VkPipelineLayout layout, const std::string& name)
 {
 	Material mat;
 	mat.pipeline = pipeline;
 	mat.pipelineLayout = layout;
-	_materials[name] = mat;
-	return &_materials[name];
+	auto it = _materialNames.find(name);
+	if (it != _materialNames.end()) {
+		_materials[it->second] = mat;
+		return it->second;
+	}
+	MaterialHandle handle = _materials.add(mat);
+	_materialNames[name] = handle;
+	return handle;
+}
+
+MaterialHandle RenderObjectsSets::get_material(const std::string& name) const
+{
+	//search for the object, and return the null handle if not found
+	auto it = _materialNames.find(name);
+	if (it == _materialNames.end()) {
+		return MaterialHandle{};
+	}
+	else {
+		return it->second;
+	}
 }
 
-Material* RenderObjectsSets::get_material(const std::string& name)
+
+uint32_t RenderObjectsSets::create_mesh_materials(const std::string& meshName, const Mesh& mesh, VkPipeline pipeline, VkPipelineLayout layout)
 {
-	//search for the object, and return nullptr if not found
-	auto it = _materials.find(name);
-	if (it == _materials.end()) {
-		return nullptr;
+	const uint32_t count = static_cast<uint32_t>(mesh._materials.size());
+	auto it = _meshMaterials.find(meshName);
+	//a table of the same length is rewritten in place, the objects pointing at it stay valid
+	uint32_t first;
+	if (it != _meshMaterials.end() && it->second.second == count) {
+		first = it->second.first;
 	}
 	else {
-		return &(*it).second;
+		first = static_cast<uint32_t>(_submeshMaterials.size());
+		_submeshMaterials.resize(_submeshMaterials.size() + count);
+		_meshMaterials[meshName] = { first, count };
 	}
+	for (uint32_t m = 0; m < count; m++) {
+		_submeshMaterials[first + m] = create_material(pipeline, layout, meshName + "/" + mesh._materials[m].name);
+	}
+	return first;
+}
+
+MeshHandle RenderObjectsSets::add_mesh(const std::string& name, Mesh&& mesh)
+{
+	auto it = _meshNames.find(name);
+	if (it != _meshNames.end()) {
+		if (_meshNameCounts[it->second.index()] == 1) {
+			_meshes[it->second] = std::move(mesh);
+			return it->second;
+		}
+		//the other names keep the shared mesh
+		_meshNameCounts[it->second.index()]--;
+	}
+	MeshHandle handle = _meshes.add(std::move(mesh));
+	if (_meshNameCounts.size() <= handle.index()) {
+		_meshNameCounts.resize(handle.index() + 1, 0);
+	}
+	_meshNameCounts[handle.index()] = 1;
+	_meshNames[name] = handle;
+	return handle;
 }
 
+void RenderObjectsSets::alias_mesh(const std::string& name, MeshHandle mesh)
+{
+	auto it = _meshNames.find(name);
+	if (it != _meshNames.end()) {
+		if (it->second == mesh) {
+			return;
+		}
+		release_mesh_name(it->second);
+	}
+	_meshNames[name] = mesh;
+	_meshNameCounts[mesh.index()]++;
+}
+
+uint32_t RenderObjectsSets::mesh_name_count(MeshHandle mesh) const
+{
+	return _meshes.contains(mesh) ? _meshNameCounts[mesh.index()] : 0;
+}
 
-Mesh* RenderObjectsSets::get_mesh(const std::string& name)
+MeshHandle RenderObjectsSets::get_mesh(const std::string& name) const
 {
-	//search for the mesh, and return nullptr if not found
-	auto it = _meshes.find(name);
-	if (it == _meshes.end()) {
-		return nullptr;
+	//search for the mesh, and return the null handle if not found
+	auto it = _meshNames.find(name);
+	if (it == _meshNames.end()) {
+		return MeshHandle{};
 	}
 	else {
-		return &(*it).second;
+		return it->second;
+	}
+}
+
+bool RenderObjectsSets::remove_mesh(const std::string& name)
+{
+	auto it = _meshNames.find(name);
+	if (it == _meshNames.end()) {
+		return false;
+	}
+	const MeshHandle handle = it->second;
+	_meshNames.erase(it);
+	release_mesh_name(handle);
+	return true;
+}
+
+void RenderObjectsSets::release_mesh_name(MeshHandle mesh)
+{
+	if (--_meshNameCounts[mesh.index()] > 0) {
+		return;
+	}
+	remove_renderables([mesh](const RenderObject& object) { return object.mesh == mesh; });
+	_meshes.remove(mesh);
+}
+
+bool RenderObjectsSets::remove_material(const std::string& name)
+{
+	auto it = _materialNames.find(name);
+	if (it == _materialNames.end()) {
+		return false;
 	}
+	const MaterialHandle handle = it->second;
+	remove_renderables([this, handle](const RenderObject& object) {
+		if (object.material == handle) {
+			return true;
+		}
+		if (object.submeshMaterials == NO_SUBMESH_MATERIALS) {
+			return false;
+		}
+		const uint32_t count = static_cast<uint32_t>(_meshes[object.mesh]._materials.size());
+		for (uint32_t m = 0; m < count; m++) {
+			if (_submeshMaterials[object.submeshMaterials + m] == handle) {
+				return true;
+			}
+		}
+		return false;
+	});
+	_materials.remove(handle);
+	_materialNames.erase(it);
+	return true;
 }
\ No newline at end of file
@@ -4,7 +4,9 @@
 //add unordered_map to the headers on top
 #include <vk_types.h>
 #include <vk_mesh.h>
+#include <resource_pool.h>
 #include <unordered_map>
+#include <type_traits>
 //note that we store the VkPipeline and layout by value, not pointer.
 //They are 64 bit handles to internal driver structures anyway so storing pointers to them isn't very useful
 
@@ -12,30 +14,93 @@ struct Material {
 	VkDescriptorSet textureSet{ VK_NULL_HANDLE }; //texture defaulted to null
 	VkPipeline pipeline;
 	VkPipelineLayout pipelineLayout;
+	//materials of a texture array pipeline: uv scale of their texture in xy, its layer in z
+	glm::vec4 textureArrayRect{ 1.0f, 1.0f, 0.0f, 0.0f };
 };
 
+using MeshHandle = Handle<Mesh>;
+using MaterialHandle = Handle<Material>;
+
+//RenderObject::submeshMaterials of objects drawing every submesh with their material
+constexpr uint32_t NO_SUBMESH_MATERIALS = UINT32_MAX;
+
+//plain data, copied around as bytes: meshes and materials are handles resolved through RenderObjectsSets,
+//which takes the objects of a mesh or material out of _renderables when removing it, so drawing never meets a stale one
 struct RenderObject {
-	Mesh* mesh;
+	MeshHandle mesh;
 
-	Material* material;
+	MaterialHandle material;
+
+	//first of the object's table in RenderObjectsSets::_submeshMaterials, one material per entry of the mesh's
+	//_materials indexed by Submesh::materialId, NO_SUBMESH_MATERIALS draws every submesh with material
+	uint32_t submeshMaterials{ NO_SUBMESH_MATERIALS };
 
 	glm::mat4 transformMatrix;
 };
+static_assert(std::is_trivially_copyable<RenderObject>::value, "RenderObject is copied as plain data");
+
 struct RenderObjectsSets {
 	//default array of renderable objects
 	std::vector<RenderObject> _renderables;
+	//world space mesh bounds of _renderables[i], apart from the objects so walking them for draws leaves these out of the cache
+	std::vector<Bounds> _renderableBounds;
 
-	std::unordered_map<std::string, Material> _materials;
-	std::unordered_map<std::string, Mesh> _meshes;
+	ResourcePool<Material> _materials;
+	ResourcePool<Mesh> _meshes;
+	//names are for loading and lookups, drawing only goes through the handles
+	std::unordered_map<std::string, MaterialHandle> _materialNames;
+	std::unordered_map<std::string, MeshHandle> _meshNames;
+	//per mesh slot, the names in _meshNames reaching the mesh, it goes with the last one
+	std::vector<uint32_t> _meshNameCounts;
+	//material tables back to back, RenderObject::submeshMaterials is where one starts
+	std::vector<MaterialHandle> _submeshMaterials;
+	//mesh name to the first entry and length of its table
+	std::unordered_map<std::string, std::pair<uint32_t, uint32_t>> _meshMaterials;
 	//functions
 
-	//create material and add it to the map
-	Material* create_material(VkPipeline pipeline, VkPipelineLayout layout, const std::string& name);
+	//create material and add it to the pool, a material of the same name is reset and keeps its handle
+	MaterialHandle create_material(VkPipeline pipeline, VkPipelineLayout layout, const std::string& name);
+
+	//returns the null handle if it can't be found
+	MaterialHandle get_material(const std::string& name) const;
+
+	//create "meshName/materialName" for every material of the mesh and return where their table starts
+	uint32_t create_mesh_materials(const std::string& meshName, const Mesh& mesh, VkPipeline pipeline, VkPipelineLayout layout);
+
+	//append object with its mesh bounds at transform, returns its index in _renderables
+	uint32_t add_renderable(const RenderObject& object, const glm::mat4& transform);
+
+	//change the transformMatrix of _renderables[index] and move its bounds along, so only objects that moved pay for it
+	void set_transform(uint32_t index, const glm::mat4& transform);
+
+	//order _renderables by the pipeline and texture set of their material, bounds moving along, so draw_objects
+	//binds each once per run; stable, objects with equal state keep their order. indices from add_renderable go stale
+	void sort_renderables();
+
+	//add the mesh to the pool, a mesh of the same name is replaced and keeps its handle unless other names share it
+	MeshHandle add_mesh(const std::string& name, Mesh&& mesh);
+
+	//name reaches the existing mesh too, both draw from its buffers
+	void alias_mesh(const std::string& name, MeshHandle mesh);
+
+	//names reaching mesh, 0 for stale handles
+	uint32_t mesh_name_count(MeshHandle mesh) const;
+
+	//returns the null handle if it can't be found
+	MeshHandle get_mesh(const std::string& name) const;
+
+	//drops name, with the last name of the mesh its handles stop resolving and the objects drawing it leave _renderables,
+	//the caller gives its gpu ranges back first when mesh_name_count is 1
+	bool remove_mesh(const std::string& name);
 
-	//returns nullptr if it can't be found
-	Material* get_material(const std::string& name);
+	//handles to the material stop resolving and the objects drawing it, through their submesh table too, leave _renderables
+	bool remove_material(const std::string& name);
 
-	//returns nullptr if it can't be found
-	Mesh* get_mesh(const std::string& name);
+private:
+	//keeps _renderables and _renderableBounds in step, draw order stays as it was
+	template<typename Predicate>
+	void remove_renderables(Predicate drawsRemoved);
+	//the name no longer reaches its mesh, removed with its last name
+	void release_mesh_name(MeshHandle mesh);
 };
 #endif // ! VK_RENDER_OBJECTS_H
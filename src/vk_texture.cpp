@@ -2,12 +2,19 @@
 #include <iostream>
 
 #include <vk_initializers.h>
+#include <asset_loader.h>
+#include <mip_generator.h>
+#include <image_decode.h>
+#include <bc_encoder.h>
+#include <ktx2_loader.h>
+#include <atomic>
+#include <functional>
+#include <thread_pool.h>
 
-#define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
 void vkutil::adjustImageLayout(VkCommandBuffer command, VkImage image, VkImageLayout oldLayout,
-    VkImageLayout newLayout, uint32_t levelCount)
+    VkImageLayout newLayout, uint32_t levelCount, uint32_t layerCount)
 {
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -20,7 +27,7 @@ void vkutil::adjustImageLayout(VkCommandBuffer command, VkImage image, VkImageLa
     barrier.subresourceRange.baseMipLevel = 0;
     barrier.subresourceRange.levelCount = levelCount;
     barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
+    barrier.subresourceRange.layerCount = layerCount;
 
     VkPipelineStageFlags sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
     VkPipelineStageFlags destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
@@ -264,10 +271,7 @@ bool vkutil::load_image_from_file(VulkanEngine* engine, const char* file, Alloca
     vmaCreateImage(engine->_allocator, &dimg_info, &dimg_allocinfo, &newImage._image, &newImage._allocation, nullptr);
     //add image destroy function to main deletion queue
 
-    engine->_mainDeletionQueue.push_function([=]() {
-        vmaDestroyImage(engine->_allocator, newImage._image, newImage._allocation);
-        std::cout << "newImage" << std::endl;
-        });
+    engine->_mainDeletionQueue.push(newImage._image, newImage._allocation);
 
     //submit transfer image layout command buffer
     engine->immediate_submit([&](VkCommandBuffer cmd) {
@@ -317,84 +321,246 @@ bool vkutil::load_image_from_file(VulkanEngine* engine, const char* file, Alloca
 
 }
 
-bool vkutil::load_image_from_file(VulkanEngine* engine, const char* file, AllocatedImage& outImage, uint32_t& mipLevels) {
-    int texWidth, texHeight, texChannels;
+AllocatedImage vkutil::upload_mip_chain(VulkanEngine* engine, VkBuffer stagingBuffer, VkDeviceSize stagingOffset, VkExtent3D extent,
+    uint32_t mipLevels, VkFormat format, assets::TextureFormat layout, bool immediate_destroy, uint32_t layerCount)
+{
+    VkImageCreateInfo dimg_info = vkinit::image_create_info(
+        extent,
+        mipLevels,
+        format,
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+    dimg_info.arrayLayers = layerCount;
 
-    stbi_uc* pixels = stbi_load(file, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+    AllocatedImage newImage;
+    newImage._format = format;
+    VmaAllocationCreateInfo dimg_allocinfo = {};
+    dimg_allocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    vmaCreateImage(engine->_allocator, &dimg_info, &dimg_allocinfo, &newImage._image, &newImage._allocation, nullptr);
+    //same as create_buffer, immediate_destroy leaves destroying the image to the caller
+    if (!immediate_destroy) {
+        engine->_mainDeletionQueue.push(newImage._image, newImage._allocation);
+    }
 
-    if (!pixels) {
+    //one copy region per level
+    std::vector<VkBufferImageCopy> regions(mipLevels);
+    VkDeviceSize bufferOffset = stagingOffset;
+    for (uint32_t i = 0; i < mipLevels; i++) {
+        VkBufferImageCopy& copyRegion = regions[i];
+        copyRegion = {};
+        copyRegion.bufferOffset = bufferOffset;
+        copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copyRegion.imageSubresource.mipLevel = i;
+        copyRegion.imageSubresource.baseArrayLayer = 0;
+        copyRegion.imageSubresource.layerCount = layerCount;
+        copyRegion.imageExtent = { std::max(1u, extent.width >> i), std::max(1u, extent.height >> i), 1 };
+        //block formats copy whole 4x4 blocks, the region extent stays the real level size
+        bufferOffset += assets::texture_level_size(layout, copyRegion.imageExtent.width, copyRegion.imageExtent.height) * layerCount;
+    }
+    //layout transitions and the copy go into the upload batch, submitted with the other uploads
+    engine->_uploadBatcher.copy_image(stagingBuffer, newImage._image, mipLevels, regions.data(),
+        static_cast<uint32_t>(regions.size()), bufferOffset - stagingOffset, layerCount);
+    return newImage;
+}
+
+void vkutil::destroy_texture(VulkanEngine* engine, const Texture& texture)
+{
+    vkDestroyImageView(engine->_device, texture.imageView, nullptr);
+    vmaDestroyImage(engine->_allocator, texture.image._image, texture.image._allocation);
+}
+
+namespace {
+    //shared tail of the cooked loaders: unpackLevel writes level i (texture_level_size bytes of format) to dst,
+    //levels are independent so they unpack in parallel straight into the staging buffer, then one copy fills the image
+    bool upload_cooked_levels(VulkanEngine* engine, const char* file, assets::TextureFormat format, uint32_t width,
+        uint32_t height, uint32_t levelCount, const std::function<bool(uint32_t level, void* dst)>& unpackLevel,
+        AllocatedImage& outImage, uint32_t& mipLevels)
+    {
+        std::vector<VkDeviceSize> offsets(levelCount);
+        VkDeviceSize packedSize = 0;
+        for (uint32_t i = 0; i < levelCount; i++) {
+            offsets[i] = packedSize;
+            packedSize += assets::texture_level_size(format, std::max(1u, width >> i), std::max(1u, height >> i));
+        }
+        auto unpack_levels = [&](char* dst) {
+            std::atomic<bool> unpacked{ true };
+            ThreadPool::shared().parallel_for(levelCount, 1, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    if (!unpackLevel(static_cast<uint32_t>(i), dst + offsets[i])) {
+                        unpacked = false;
+                    }
+                }
+            });
+            if (!unpacked) {
+                std::cerr << "Corrupt texture asset " << file << std::endl;
+            }
+            return unpacked.load();
+        };
+
+        //block formats are core but optional, devices that cannot sample them get the levels decoded back to RGBA8
+        bool decodeBlocks = false;
+        if (vkutil::is_block_format(format)) {
+            VkFormatProperties formatProperties{};
+            vkGetPhysicalDeviceFormatProperties(engine->_chosenGPU, assets::texture_vk_format(format), &formatProperties);
+            decodeBlocks = !(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+            if (decodeBlocks) {
+                std::cout << "Device cannot sample the block format of " << file << ", decoding it on the cpu" << std::endl;
+            }
+        }
+
+        //the chain is built on the cpu for a single cooked level (older cooker) and for decoded block formats
+        const bool cookedMips = levelCount > 1;
+        const bool cpuChain = !cookedMips || decodeBlocks;
+        MipChain chain;
+        if (cpuChain) {
+            std::vector<char> packed(packedSize);
+            if (!unpack_levels(packed.data())) {
+                return false;
+            }
+            chain.width = width;
+            chain.height = height;
+            for (uint32_t i = 0; i < levelCount; i++) {
+                chain.levelOffsets.push_back(chain.pixels.size());
+                chain.pixels.resize(chain.pixels.size() + chain.level_size(i));
+                uint8_t* level = chain.pixels.data() + chain.levelOffsets[i];
+                if (vkutil::is_block_format(format)) {
+                    if (!vkutil::decompress_image((const uint8_t*)packed.data() + offsets[i], chain.level_width(i), chain.level_height(i), format, level)) {
+                        std::cout << "Failed to decode level " << i << " of texture " << file << std::endl;
+                        return false;
+                    }
+                }
+                else {
+                    memcpy(level, packed.data() + offsets[i], chain.level_size(i));
+                }
+            }
+            if (!cookedMips) {
+                MipChain full;
+                vkutil::generate_mips(chain.level_data(0), width, height, format != assets::TextureFormat::BC5_UNORM,
+                    MipFilter::Box, ThreadPool::shared(), full);
+                chain = std::move(full);
+            }
+        }
+        mipLevels = cpuChain ? chain.level_count() : levelCount;
+        //BC5 holds linear data (normal maps) and stays linear when decoded
+        const assets::TextureFormat layout = cpuChain ? assets::TextureFormat::RGBA8_SRGB : format;
+        const VkFormat vkFormat = !cpuChain ? assets::texture_vk_format(format)
+            : format == assets::TextureFormat::BC5_UNORM ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R8G8B8A8_SRGB;
+
+        //all levels go into the staging arena, one after another
+        const VkDeviceSize imageSize = cpuChain ? chain.pixels.size() : packedSize;
+        VkDeviceSize uncompressedSize = 0;
+        for (uint32_t i = 0; i < mipLevels; i++) {
+            uncompressedSize += VkDeviceSize(std::max(1u, width >> i)) * std::max(1u, height >> i) * 4;
+        }
+        UploadStaging staging = engine->_uploadBatcher.stage(imageSize);
+        if (cpuChain) {
+            memcpy(staging.data, chain.pixels.data(), chain.pixels.size());
+        }
+        //a corrupt texture leaves its staging unused, it is reclaimed with the batch
+        else if (!unpack_levels(staging.data)) {
+            return false;
+        }
+
+        VkExtent3D imageExtent;
+        imageExtent.width = width;
+        imageExtent.height = height;
+        imageExtent.depth = 1;
+        outImage = vkutil::upload_mip_chain(engine, staging.buffer, staging.offset, imageExtent, mipLevels, vkFormat, layout, false);
+
+        std::cout << "Texture asset " << file << ": " << imageSize << " bytes of texel data, " << uncompressedSize
+            << " as RGBA8" << std::endl;
+        return true;
+    }
+}
+
+bool vkutil::load_image_from_file(VulkanEngine* engine, const char* file, AllocatedImage& outImage, uint32_t& mipLevels) {
+    int texWidth, texHeight, texChannels;
+    //the header gives the size of the chain, so the image decodes straight into its staging space
+    if (!stbi_info(file, &texWidth, &texHeight, &texChannels)) {
         std::cout << "Failed to load texture file " << file << std::endl;
         return false;
     }
-    void* pixel_ptr = pixels;
-    VkDeviceSize imageSize = texWidth * texHeight * 4;
-     mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texHeight, texWidth)))) + 1;
-     //the format R8G8B8A8 matches exactly with the pixels loaded from stb_image lib
-     VkFormat image_format = VK_FORMAT_R8G8B8A8_SRGB;
-
-     //allocate temporary buffer for holding texture data to upload
-     AllocatedBuffer  stagingBuffer = engine->create_buffer(
-         true,
-         imageSize,
-         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-         VMA_MEMORY_USAGE_CPU_ONLY);
-     //copy data to buffer
-     void* data;
-     vmaMapMemory(engine->_allocator, stagingBuffer._allocation, &data);
-     memcpy(data, pixel_ptr, static_cast<size_t>(imageSize));
-     vmaUnmapMemory(engine->_allocator, stagingBuffer._allocation);
-     //we no longer need the loaded data, so we can free the pixels as they are now in the staging buffer
-     stbi_image_free(pixels);
+    const uint32_t width = static_cast<uint32_t>(texWidth);
+    const uint32_t height = static_cast<uint32_t>(texHeight);
+    //staging space for every level to upload, reclaimed once the upload batch completed
+    UploadStaging staging = engine->_uploadBatcher.stage(vkutil::mip_chain_size(width, height));
+    if (!decode_image_into(file, width, height, (uint8_t*)staging.data)) {
+        //the staging space is only wasted until its batch completes
+        std::cout << "Failed to load texture file " << file << std::endl;
+        return false;
+    }
+    //build the chain on the cpu behind level 0, gamma correct and without needing linear blit support for the format
+    //box filter at load time, the cooker spends the time on kaiser
+    vkutil::generate_mips_in_place((uint8_t*)staging.data, width, height, true, MipFilter::Box, ThreadPool::shared());
+    mipLevels = vkutil::mip_level_count(width, height);
 
      VkExtent3D imageExtent;
-     imageExtent.width = static_cast<uint32_t>(texWidth);
-     imageExtent.height = static_cast<uint32_t>(texHeight);
+     imageExtent.width = width;
+     imageExtent.height = height;
      imageExtent.depth = 1;
 
-     VkImageCreateInfo dimg_info = vkinit::image_create_info(
-         imageExtent,
-         mipLevels,
-         image_format,
-         VK_IMAGE_TILING_OPTIMAL,
-         VK_IMAGE_USAGE_TRANSFER_SRC_BIT | 
-         VK_IMAGE_USAGE_SAMPLED_BIT | 
-         VK_IMAGE_USAGE_TRANSFER_DST_BIT);
-
-     AllocatedImage newImage;
-     VmaAllocationCreateInfo dimg_allocinfo = {};
-     dimg_allocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-     //allocate and create the image
-     vmaCreateImage(engine->_allocator, &dimg_info, &dimg_allocinfo, &newImage._image, &newImage._allocation, nullptr);
-     //add image destroy function to main deletion queue
-     engine->_mainDeletionQueue.push_function([=]() {
-         vmaDestroyImage(engine->_allocator, newImage._image, newImage._allocation);
-         std::cout << "newImage" << std::endl;
-         });
-     //VkCommandBuffer cmd = engine->_uploadContext._commandBuffer;
-     VkCommandBuffer cmd = vkutil::beginSigleTimeCommands(engine);
-     //submit transfer image layout command buffer
-     //adjust image undefined layout to optimal transfer destination layout
-     //set pipeline barrier
-     vkutil::adjustImageLayout(
-         cmd,
-         newImage._image,
-         VK_IMAGE_LAYOUT_UNDEFINED,
-         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-         mipLevels
-     );
-     //set copy buffer data to image command buffer
-     vkutil::copyBufferToImage(engine, cmd, stagingBuffer._buffer, newImage._image, imageExtent);
-
-     vkutil::generateMipmaps(engine, newImage._image, dimg_info);
-
-     //NOTE: remember destroy staging buffer
-     vmaDestroyBuffer(engine->_allocator, stagingBuffer._buffer, stagingBuffer._allocation);
+     AllocatedImage newImage = upload_mip_chain(engine, staging.buffer, staging.offset, imageExtent, mipLevels,
+         VK_FORMAT_R8G8B8A8_SRGB, assets::TextureFormat::RGBA8_SRGB, false);
 
      std::cout << "Texture loaded successfully " << file << std::endl;
      outImage = newImage;
      return true;
 }
 
+bool vkutil::load_image_from_asset(VulkanEngine* engine, const char* file, AllocatedImage& outImage, uint32_t& mipLevels) {
+    assets::MappedFile mapped;
+    if (!mapped.open(file)) {
+        return false;
+    }
+    assets::AssetView view;
+    if (!assets::open_asset(mapped, "TEXI", view) || view.header->metadataSize < sizeof(assets::TextureInfo)) {
+        return false;
+    }
+    assets::TextureInfo info;
+    memcpy(&info, view.metadata, sizeof(assets::TextureInfo));
+    if ((info.format != assets::TextureFormat::RGBA8_SRGB && !vkutil::is_block_format(info.format)) || info.mipLevels == 0
+        || view.header->sectionCount != info.mipLevels) {
+        std::cout << "Texture asset " << file << " has an unsupported format" << std::endl;
+        return false;
+    }
+    //levels are copied tightly packed, so every section has to be exactly one level
+    for (uint32_t i = 0; i < info.mipLevels; i++) {
+        if (view.sections[i].rawSize != assets::texture_level_size(info.format, std::max(1u, info.width >> i), std::max(1u, info.height >> i))) {
+            std::cout << "Texture asset " << file << " has a level of the wrong size" << std::endl;
+            return false;
+        }
+    }
+
+    //sections are LZ4 blocks of the mapped file
+    auto unpack_level = [&view](uint32_t level, void* dst) { return assets::unpack_section(view, level, dst); };
+    if (!upload_cooked_levels(engine, file, info.format, info.width, info.height, info.mipLevels, unpack_level, outImage, mipLevels)) {
+        return false;
+    }
+    std::cout << "Texture asset loaded successfully " << file << std::endl;
+    return true;
+}
+
+bool vkutil::load_image_from_ktx2(VulkanEngine* engine, const char* file, AllocatedImage& outImage, uint32_t& mipLevels) {
+    assets::MappedFile mapped;
+    if (!mapped.open(file)) {
+        return false;
+    }
+    assets::Ktx2View view;
+    if (!assets::open_ktx2(mapped, view)) {
+        std::cout << "Texture " << file << " is not a KTX2 texture the engine can load" << std::endl;
+        return false;
+    }
+    //level spans point into the mapping, plain levels are copied straight to staging and zstd ones
+    //decompressed there, each on its own worker
+    auto unpack_level = [&view](uint32_t level, void* dst) { return assets::unpack_ktx2_level(view, level, dst); };
+    if (!upload_cooked_levels(engine, file, view.format, view.header->pixelWidth, view.header->pixelHeight,
+        view.level_count(), unpack_level, outImage, mipLevels)) {
+        return false;
+    }
+    std::cout << "KTX2 texture loaded successfully " << file << std::endl;
+    return true;
+}
+
 
 
 
@@ -3,9 +3,11 @@
 #define VK_TEXTURE_H
 #include <vk_types.h>
 #include <vk_engine.h>
+#include <asset_loader.h>
 
 namespace vkutil {
-	void adjustImageLayout(VkCommandBuffer command, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t levelCount);
+	void adjustImageLayout(VkCommandBuffer command, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t levelCount,
+		uint32_t layerCount = 1);
 
 	void copyBufferToImage(VulkanEngine* engine,VkCommandBuffer cmd, VkBuffer stagineBuffer, VkImage image, VkExtent3D extent);
 
@@ -13,10 +15,31 @@ namespace vkutil {
 
 	void endSigleTimeCommands(VulkanEngine* engine, VkCommandBuffer commandBuffer);
 
+	//gpu chain with vkCmdBlitImage, needs linear blit support for the format
+	//the loaders build chains on the cpu with vkutil::generate_mips instead
 	void generateMipmaps(VulkanEngine* engine, VkImage image, VkImageCreateInfo imageInfo);
 
+	//create a sampled image and record the copy of every level into the engine's upload batch, from a staging buffer
+	//holding the levels back to back at stagingOffset, largest first (a MipChain or a cooked texture), sized as layout
+	//the staging has to stay until the batch completed, space from UploadBatcher::stage() or an adopted buffer does
+	//immediate_destroy leaves destroying the image to the caller instead of the main deletion queue
+	//layerCount above 1 makes an array image, each level then holds that level of every layer back to back
+	AllocatedImage upload_mip_chain(VulkanEngine* engine, VkBuffer stagingBuffer, VkDeviceSize stagingOffset, VkExtent3D extent,
+		uint32_t mipLevels, VkFormat format, assets::TextureFormat layout, bool immediate_destroy, uint32_t layerCount = 1);
+
+	//destroy the view and image of a texture uploaded with immediate_destroy
+	void destroy_texture(VulkanEngine* engine, const Texture& texture);
+
 	bool load_image_from_file(VulkanEngine* engine, const char* file, AllocatedImage& outImage);
 
+	//decode into staging and build the mip chain there on the cpu, all levels are uploaded with one copy
 	bool load_image_from_file(VulkanEngine* engine, const char* file, AllocatedImage& outImage, uint32_t& mipLevels);
+
+	//load a texture cooked by asset_cooker, mip levels are decompressed straight into the staging buffer
+	bool load_image_from_asset(VulkanEngine* engine, const char* file, AllocatedImage& outImage, uint32_t& mipLevels);
+
+	//load a KTX2 texture, plain levels are copied from the mapping and zstd supercompressed ones
+	//decompressed in parallel, both straight into the staging buffer
+	bool load_image_from_ktx2(VulkanEngine* engine, const char* file, AllocatedImage& outImage, uint32_t& mipLevels);
 }
 #endif // !VK_TEXTURE_H
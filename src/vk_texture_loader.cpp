@@ -0,0 +1,166 @@
+#include "vk_texture_loader.h"
+#include <vk_engine.h>
+#include <vk_initializers.h>
+#include <vk_texture.h>
+#include <mip_generator.h>
+#include <image_decode.h>
+#include <memory_stats.h>
+#include <thread_pool.h>
+#include <cvar_system.h>
+#include <stb_image.h>
+#include <iostream>
+#include <cstring>
+
+namespace {
+	AutoCVar_Int CVAR_AsyncDecode("textures.asyncDecode",
+		"decode png textures on the thread pool behind a placeholder, 0 decodes them one by one at load", 1);
+
+	//runs on a worker: decode straight into a staging buffer and build the chain there, vma is internally synchronized
+	//width and height come from the header read at load(), the chain size has to be known before the decode
+	DecodedTexture decode_texture(VulkanEngine* engine, const std::string& file, uint32_t width, uint32_t height)
+	{
+		DecodedTexture result;
+		AllocatedBuffer staging = engine->create_buffer(
+			true,
+			vkutil::mip_chain_size(width, height),
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VMA_MEMORY_USAGE_CPU_ONLY,
+			VMA_ALLOCATION_CREATE_MAPPED_BIT);
+		uint8_t* data = (uint8_t*)staging._mapped;
+		const bool decoded = vkutil::decode_image_into(file.c_str(), width, height, data);
+		if (decoded) {
+			//the chain build splits over the pool too, with every worker busy decoding it runs on this one
+			vkutil::generate_mips_in_place(data, width, height, true, MipFilter::Box, ThreadPool::shared());
+		}
+		if (!decoded) {
+			vmaDestroyBuffer(engine->_allocator, staging._buffer, staging._allocation);
+			return result;
+		}
+		result.staging = staging;
+		result.extent = { width, height, 1 };
+		result.mipLevels = vkutil::mip_level_count(width, height);
+		result.decoded = true;
+		return result;
+	}
+}
+
+void TextureLoader::init(VulkanEngine* engine)
+{
+	_engine = engine;
+
+	//4x4 magenta and grey checker, obviously not the real texture
+	uint32_t texels[16];
+	for (uint32_t i = 0; i < 16; i++) {
+		texels[i] = ((i & 1) ^ ((i >> 2) & 1)) ? 0xffff00ffu : 0xff808080u;
+	}
+	UploadStaging staging = _engine->_uploadBatcher.stage(sizeof(texels));
+	memcpy(staging.data, texels, sizeof(texels));
+	_placeholder.image = vkutil::upload_mip_chain(_engine, staging.buffer, staging.offset, { 4, 4, 1 }, 1,
+		VK_FORMAT_R8G8B8A8_SRGB, assets::TextureFormat::RGBA8_SRGB, false);
+
+	VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(_placeholder.image._image, _placeholder.image._format,
+		1, VK_IMAGE_ASPECT_COLOR_BIT);
+	vkCreateImageView(_engine->_device, &viewInfo, nullptr, &_placeholder.imageView);
+	_engine->_mainDeletionQueue.push(_placeholder.imageView);
+}
+
+bool TextureLoader::async() const
+{
+	return CVAR_AsyncDecode.Get() != 0;
+}
+
+TextureLoadHandle TextureLoader::load(const std::string& file, const std::string& name)
+{
+	//only the header is read here, a file stb cannot open fails now instead of after the decode,
+	//and the size it gives lets the worker decode straight into staging
+	int width, height, channels;
+	if (!stbi_info(file.c_str(), &width, &height, &channels)) {
+		return INVALID_TEXTURE_LOAD;
+	}
+	if (_pending == 0) {
+		_batchStart = std::chrono::high_resolution_clock::now();
+		_batchCount = 0;
+	}
+	Load load;
+	load.file = file;
+	load.name = name;
+	load.decoded = ThreadPool::shared().submit([engine = _engine, file, width = uint32_t(width), height = uint32_t(height)]() {
+		return decode_texture(engine, file, width, height);
+	});
+	_loads.push_back(std::move(load));
+	_pending++;
+	_batchCount++;
+	_engine->_loadedTextures[name] = _placeholder;
+	return static_cast<TextureLoadHandle>(_loads.size() - 1);
+}
+
+void TextureLoader::update()
+{
+	if (_pending == 0) {
+		return;
+	}
+	for (Load& load : _loads) {
+		if (load.state == LoadState::Decoding && load.decoded.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+			land(load);
+		}
+	}
+}
+
+void TextureLoader::wait_all()
+{
+	for (Load& load : _loads) {
+		if (load.state == LoadState::Decoding) {
+			load.decoded.wait();
+			land(load);
+		}
+	}
+}
+
+void TextureLoader::cleanup()
+{
+	//decodes still running own a staging buffer each
+	for (Load& load : _loads) {
+		if (load.state == LoadState::Decoding) {
+			DecodedTexture decoded = load.decoded.get();
+			if (decoded.decoded) {
+				vmaDestroyBuffer(_engine->_allocator, decoded.staging._buffer, decoded.staging._allocation);
+			}
+		}
+	}
+	_loads.clear();
+	_pending = 0;
+}
+
+void TextureLoader::land(Load& load)
+{
+	DecodedTexture decoded = load.decoded.get();
+	_pending--;
+	load.state = LoadState::Failed;
+	if (!decoded.decoded) {
+		std::cerr << "Failed to decode texture " << load.file << ", keeping the placeholder" << std::endl;
+	}
+	else {
+		Texture texture;
+		//the worker's staging is copied from directly and destroyed with the upload batch
+		_engine->_uploadBatcher.adopt(decoded.staging);
+		texture.image = vkutil::upload_mip_chain(_engine, decoded.staging._buffer, 0, decoded.extent, decoded.mipLevels,
+			VK_FORMAT_R8G8B8A8_SRGB, assets::TextureFormat::RGBA8_SRGB, false);
+		VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(texture.image._image, texture.image._format,
+			decoded.mipLevels, VK_IMAGE_ASPECT_COLOR_BIT);
+		vkCreateImageView(_engine->_device, &viewInfo, nullptr, &texture.imageView);
+		_engine->_mainDeletionQueue.push(texture.imageView);
+		//the placeholder is shared, only the material sets are retired
+		if (_engine->replace_texture(load.name, texture, false)) {
+			load.state = LoadState::Landed;
+		}
+		else {
+			std::cerr << "No descriptor sets left to swap in " << load.file << ", keeping the placeholder" << std::endl;
+		}
+	}
+	if (_pending == 0) {
+		auto endTime = std::chrono::high_resolution_clock::now();
+		std::cout << "Texture loader: " << _batchCount << " textures decoded on " << ThreadPool::shared().thread_count()
+			<< " threads, last one landed " << std::chrono::duration<float, std::milli>(endTime - _batchStart).count()
+			<< " ms after the first load, peak RSS " << vkutil::peak_rss_bytes() / (1024 * 1024) << " MB" << std::endl;
+	}
+}
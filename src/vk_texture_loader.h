@@ -0,0 +1,74 @@
+#pragma once
+#ifndef VK_TEXTURE_LOADER_H
+#define VK_TEXTURE_LOADER_H
+#include <vk_types.h>
+#include <string>
+#include <vector>
+#include <future>
+#include <chrono>
+
+class VulkanEngine;
+
+//index of a load in the TextureLoader, valid until cleanup
+using TextureLoadHandle = uint32_t;
+constexpr TextureLoadHandle INVALID_TEXTURE_LOAD = ~0u;
+
+//levels decoded on a worker, already in a staging buffer the worker allocated and filled
+struct DecodedTexture {
+	AllocatedBuffer staging{};
+	VkExtent3D extent{};
+	uint32_t mipLevels{ 0 };
+	bool decoded{ false };
+};
+
+//decodes png/jpg textures on the thread pool instead of one after another on the main thread:
+//load() starts the decode and makes _loadedTextures[name] the placeholder, a worker decodes the image into
+//staging and builds the mip chain there, and update() on the main thread records its upload and has
+//the engine swap it into the materials bound to name, the upload is submitted with the frame's batch
+class TextureLoader {
+public:
+	//create the placeholder textures sample until they land
+	void init(VulkanEngine* engine);
+
+	//false when the textures.asyncDecode cvar is off and textures decode on the main thread
+	bool async() const;
+
+	//start decoding file, INVALID_TEXTURE_LOAD when stb cannot read its header
+	TextureLoadHandle load(const std::string& file, const std::string& name);
+
+	//the load landed, successfully or with the placeholder left in place
+	bool ready(TextureLoadHandle handle) const { return _loads[handle].state != LoadState::Decoding; }
+	size_t pending() const { return _pending; }
+
+	//upload the decodes that finished and swap them in, call after the frame fence wait
+	void update();
+	//block until every decode landed
+	void wait_all();
+	void cleanup();
+
+	const Texture& placeholder() const { return _placeholder; }
+
+private:
+	enum class LoadState : uint8_t {
+		Decoding,
+		Landed,
+		Failed,
+	};
+	struct Load {
+		std::string file;
+		std::string name;
+		LoadState state{ LoadState::Decoding };
+		std::future<DecodedTexture> decoded;
+	};
+
+	void land(Load& load);
+
+	VulkanEngine* _engine{ nullptr };
+	Texture _placeholder{};
+	std::vector<Load> _loads;
+	size_t _pending{ 0 };
+	//time from the first load of a batch until its last one landed
+	std::chrono::high_resolution_clock::time_point _batchStart;
+	size_t _batchCount{ 0 };
+};
+#endif // !VK_TEXTURE_LOADER_H
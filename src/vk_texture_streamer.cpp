@@ -0,0 +1,295 @@
+#include "vk_texture_streamer.h"
+#include <vk_engine.h>
+#include <vk_initializers.h>
+#include <vk_texture.h>
+#include <ktx2_loader.h>
+#include <bc_encoder.h>
+#include <thread_pool.h>
+#include <cvar_system.h>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+	AutoCVar_Int CVAR_TextureBudget("streaming.textureBudgetMB",
+		"VRAM budget of streamed textures in MB, 0 takes what the VMA heap budget has left", 0);
+
+	//a cooked texture of either container, mapped for as long as it is open
+	struct CookedFile {
+		assets::MappedFile mapped;
+		bool ktx2{ false };
+		assets::Ktx2View ktx2View;
+		assets::AssetView assetView;
+		assets::TextureFormat format{ assets::TextureFormat::RGBA8_SRGB };
+		uint32_t width{ 0 };
+		uint32_t height{ 0 };
+		uint32_t levelCount{ 0 };
+
+		bool open(const std::string& path, bool isKtx2)
+		{
+			ktx2 = isKtx2;
+			if (!mapped.open(path.c_str())) {
+				return false;
+			}
+			if (ktx2) {
+				if (!assets::open_ktx2(mapped, ktx2View)) {
+					return false;
+				}
+				format = ktx2View.format;
+				width = ktx2View.header->pixelWidth;
+				height = ktx2View.header->pixelHeight;
+				levelCount = ktx2View.level_count();
+				return true;
+			}
+			if (!assets::open_asset(mapped, "TEXI", assetView) || assetView.header->metadataSize < sizeof(assets::TextureInfo)) {
+				return false;
+			}
+			assets::TextureInfo info;
+			memcpy(&info, assetView.metadata, sizeof(assets::TextureInfo));
+			if ((info.format != assets::TextureFormat::RGBA8_SRGB && !vkutil::is_block_format(info.format))
+				|| info.mipLevels == 0 || assetView.header->sectionCount != info.mipLevels) {
+				return false;
+			}
+			format = info.format;
+			width = info.width;
+			height = info.height;
+			levelCount = info.mipLevels;
+			for (uint32_t i = 0; i < levelCount; i++) {
+				if (assetView.sections[i].rawSize != level_size(i)) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		uint64_t level_size(uint32_t level) const
+		{
+			return assets::texture_level_size(format, std::max(1u, width >> level), std::max(1u, height >> level));
+		}
+
+		bool unpack(uint32_t level, void* dst) const
+		{
+			return ktx2 ? assets::unpack_ktx2_level(ktx2View, level, dst) : assets::unpack_section(assetView, level, dst);
+		}
+	};
+
+	//levels [mip, levelCount) back to back, empty when the file changed or is corrupt
+	//runs on the workers, every load maps the file again so nothing stays open between loads
+	std::vector<char> read_levels(const std::string& path, bool ktx2, uint32_t width, uint32_t height, uint32_t mip)
+	{
+		std::vector<char> levels;
+		CookedFile file;
+		if (!file.open(path, ktx2) || file.width != width || file.height != height || mip >= file.levelCount) {
+			return levels;
+		}
+		size_t size = 0;
+		for (uint32_t i = mip; i < file.levelCount; i++) {
+			size += file.level_size(i);
+		}
+		levels.resize(size);
+		size_t offset = 0;
+		for (uint32_t i = mip; i < file.levelCount; i++) {
+			if (!file.unpack(i, levels.data() + offset)) {
+				levels.clear();
+				break;
+			}
+			offset += file.level_size(i);
+		}
+		return levels;
+	}
+}
+
+void TextureStreamer::init(VulkanEngine* engine)
+{
+	_engine = engine;
+}
+
+bool TextureStreamer::add_texture(const std::string& sourceFile, const std::string& name)
+{
+	CookedFile file;
+	std::string path = assets::cooked_path(sourceFile, ".ktx2");
+	if (!file.open(path, true)) {
+		path = assets::cooked_path(sourceFile, ".tx");
+		if (!file.open(path, false)) {
+			return false;
+		}
+	}
+	//single level files get their chain built at load time, the tail alone has nothing to stream
+	if (file.levelCount < 2 || std::max(file.width, file.height) <= TEXTURE_TAIL_SIZE) {
+		return false;
+	}
+	//block formats the device cannot sample are decoded by the whole texture loaders
+	VkFormatProperties formatProperties{};
+	vkGetPhysicalDeviceFormatProperties(_engine->_chosenGPU, assets::texture_vk_format(file.format), &formatProperties);
+	if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+		return false;
+	}
+
+	std::vector<uint64_t> levelBytes;
+	for (uint32_t i = 0; i < file.levelCount; i++) {
+		levelBytes.push_back(file.level_size(i));
+	}
+	StreamedTexture streamed;
+	streamed.path = path;
+	streamed.ktx2 = file.ktx2;
+	streamed.format = file.format;
+	streamed.width = file.width;
+	streamed.height = file.height;
+	streamed.levelCount = file.levelCount;
+	const uint32_t id = _residency.add_texture(file.width, file.height, levelBytes);
+	streamed.residentMip = _residency.tail_mip(id);
+
+	std::vector<char> tail = read_levels(path, file.ktx2, file.width, file.height, streamed.residentMip);
+	Texture texture;
+	if (tail.empty() || !upload(streamed, streamed.residentMip, tail, texture)) {
+		std::cerr << "Corrupt texture asset " << path << std::endl;
+		//ids have to stay in step with the policy, the entry stays behind without a texture and is never requested
+		_textures.push_back(streamed);
+		return false;
+	}
+	_engine->_loadedTextures[name] = texture;
+	streamed.name = name;
+	_textures.push_back(streamed);
+	_textureIds[name] = id;
+	std::cout << "Streaming texture " << path << ": " << _residency.bytes_from(id, streamed.residentMip) << " of "
+		<< _residency.bytes_from(id, 0) << " bytes resident" << std::endl;
+	return true;
+}
+
+void TextureStreamer::bind_material(const std::string& name, MaterialHandle material)
+{
+	auto it = _textureIds.find(name);
+	if (it != _textureIds.end()) {
+		_materialTextures[material.value] = it->second;
+	}
+}
+
+void TextureStreamer::request(MaterialHandle material, float screenPixels)
+{
+	auto it = _materialTextures.find(material.value);
+	if (it == _materialTextures.end()) {
+		return;
+	}
+	const StreamedTexture& streamed = _textures[it->second];
+	_residency.request(it->second, vkutil::footprint_mip(streamed.width, streamed.height, streamed.levelCount, screenPixels));
+}
+
+void TextureStreamer::update()
+{
+	for (size_t i = 0; i < _loads.size();) {
+		Load& load = _loads[i];
+		if (load.levels.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			i++;
+			continue;
+		}
+		std::vector<char> levels = load.levels.get();
+		StreamedTexture& streamed = _textures[load.texture];
+		if (levels.empty() || !swap(load.texture, load.mip, levels)) {
+			std::cerr << "Failed to stream " << streamed.path << " from level " << load.mip << std::endl;
+		}
+		//on failure the old levels stay and the policy tries again later
+		_residency.complete(load.texture, streamed.residentMip);
+		_loads.erase(_loads.begin() + i);
+	}
+
+	//the frame's arena was reset after its fence in draw(), the planner sorts in it
+	_residency.plan(budget_bytes(), MAX_STREAM_INS_PER_FRAME, _streamIns, _evictions, _engine->get_current_frame()._frameAllocator);
+	//evictions read their levels too, they are coarse so they land quickly
+	for (const std::vector<ResidencyRequest>* moves : { &_evictions, &_streamIns }) {
+		for (const ResidencyRequest& move : *moves) {
+			const StreamedTexture& streamed = _textures[move.texture];
+			Load load;
+			load.texture = move.texture;
+			load.mip = move.targetMip;
+			load.levels = ThreadPool::shared().submit([path = streamed.path, ktx2 = streamed.ktx2, width = streamed.width,
+				height = streamed.height, mip = move.targetMip]() {
+				return read_levels(path, ktx2, width, height, mip);
+			});
+			_loads.push_back(std::move(load));
+		}
+	}
+}
+
+void TextureStreamer::cleanup()
+{
+	for (Load& load : _loads) {
+		load.levels.wait();
+	}
+	_loads.clear();
+	//images replaced earlier are retired with the engine, only the current ones are left here
+	for (const StreamedTexture& streamed : _textures) {
+		if (!streamed.name.empty()) {
+			vkutil::destroy_texture(_engine, _engine->_loadedTextures[streamed.name]);
+		}
+	}
+	_textures.clear();
+	_textureIds.clear();
+	_materialTextures.clear();
+}
+
+uint64_t TextureStreamer::budget_bytes()
+{
+	const int32_t budgetMB = CVAR_TextureBudget.Get();
+	if (budgetMB > 0) {
+		return uint64_t(budgetMB) * 1024 * 1024;
+	}
+	//the largest device local heap holds the images
+	const VkPhysicalDeviceMemoryProperties* memoryProperties;
+	vmaGetMemoryProperties(_engine->_allocator, &memoryProperties);
+	uint32_t heap = 0;
+	for (uint32_t i = 0; i < memoryProperties->memoryHeapCount; i++) {
+		if ((memoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+			&& memoryProperties->memoryHeaps[i].size > memoryProperties->memoryHeaps[heap].size) {
+			heap = i;
+		}
+	}
+	VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+	vmaGetBudget(_engine->_allocator, budgets);
+	//everything else on the heap keeps its share, streamed textures get the rest
+	const uint64_t textureBytes = _residency.stats().residentBytes;
+	const uint64_t otherBytes = budgets[heap].usage > textureBytes ? budgets[heap].usage - textureBytes : 0;
+	return budgets[heap].budget > otherBytes ? budgets[heap].budget - otherBytes : 0;
+}
+
+bool TextureStreamer::upload(const StreamedTexture& streamed, uint32_t mip, const std::vector<char>& levels, Texture& outTexture)
+{
+	UploadStaging staging = _engine->_uploadBatcher.stage(levels.size());
+	memcpy(staging.data, levels.data(), levels.size());
+
+	//level mip of the file is level 0 of the image
+	VkExtent3D extent;
+	extent.width = std::max(1u, streamed.width >> mip);
+	extent.height = std::max(1u, streamed.height >> mip);
+	extent.depth = 1;
+	const uint32_t mipLevels = streamed.levelCount - mip;
+	outTexture.image = vkutil::upload_mip_chain(_engine, staging.buffer, staging.offset, extent, mipLevels,
+		assets::texture_vk_format(streamed.format), streamed.format, true);
+
+	VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(outTexture.image._image, outTexture.image._format,
+		mipLevels, VK_IMAGE_ASPECT_COLOR_BIT);
+	if (vkCreateImageView(_engine->_device, &viewInfo, nullptr, &outTexture.imageView) != VK_SUCCESS) {
+		//the copy into the image is already recorded
+		_engine->_uploadBatcher.wait_idle();
+		vmaDestroyImage(_engine->_allocator, outTexture.image._image, outTexture.image._allocation);
+		return false;
+	}
+	return true;
+}
+
+bool TextureStreamer::swap(uint32_t id, uint32_t mip, const std::vector<char>& levels)
+{
+	StreamedTexture& streamed = _textures[id];
+	Texture texture;
+	if (!upload(streamed, mip, levels, texture)) {
+		return false;
+	}
+	if (!_engine->replace_texture(streamed.name, texture, true)) {
+		//rare, waiting for the upload beats retiring an image nothing samples
+		_engine->_uploadBatcher.wait_idle();
+		vkutil::destroy_texture(_engine, texture);
+		return false;
+	}
+	streamed.residentMip = mip;
+	return true;
+}
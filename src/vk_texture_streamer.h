@@ -0,0 +1,76 @@
+#pragma once
+#ifndef VK_TEXTURE_STREAMER_H
+#define VK_TEXTURE_STREAMER_H
+#include <vk_types.h>
+#include <vk_renderObjects.h>
+#include <asset_loader.h>
+#include <texture_residency.h>
+#include <string>
+#include <vector>
+#include <future>
+#include <unordered_map>
+
+class VulkanEngine;
+
+//stream ins started per frame, each one reads and uploads levels of a single texture
+constexpr unsigned int MAX_STREAM_INS_PER_FRAME = 4;
+
+//mip streaming of cooked textures: only the tail is resident after loading, the residency policy picks
+//levels from the footprint materials are drawn at, workers read them from the mapped file and the next
+//update() after they finish uploads an image holding levels [mip, levelCount) and has the engine swap it in
+class TextureStreamer {
+public:
+	void init(VulkanEngine* engine);
+
+	//register the cooked texture of sourceFile (.ktx2 or .tx with cooked mips) and load its tail into
+	//_loadedTextures[name], false when there is no such file or it has nothing to stream, the caller then loads it whole
+	bool add_texture(const std::string& sourceFile, const std::string& name);
+
+	//material sampling texture name, request() looks its texture up by material
+	void bind_material(const std::string& name, MaterialHandle material);
+
+	//the material is drawn this frame with its texture spread over screenPixels
+	void request(MaterialHandle material, float screenPixels);
+
+	//call after the frame fence wait: swap in finished loads and start the moves of this frame
+	void update();
+
+	void cleanup();
+
+	//the streaming.textureBudgetMB cvar when set, otherwise what is left of the vma device local heap budget
+	uint64_t budget_bytes();
+	const ResidencyStats& stats() const { return _residency.stats(); }
+
+private:
+	struct StreamedTexture {
+		//key of _loadedTextures, empty when the tail failed to load
+		std::string name;
+		std::string path;
+		bool ktx2;
+		assets::TextureFormat format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t levelCount;
+		//finest level in the image, its level 0
+		uint32_t residentMip;
+	};
+	struct Load {
+		uint32_t texture;
+		uint32_t mip;
+		//levels [mip, levelCount) back to back, empty when reading failed
+		std::future<std::vector<char>> levels;
+	};
+	bool upload(const StreamedTexture& streamed, uint32_t mip, const std::vector<char>& levels, Texture& outTexture);
+	bool swap(uint32_t id, uint32_t mip, const std::vector<char>& levels);
+
+	VulkanEngine* _engine{ nullptr };
+	TextureResidency _residency;
+	std::vector<StreamedTexture> _textures;
+	std::unordered_map<std::string, uint32_t> _textureIds;
+	//keyed by MaterialHandle::value
+	std::unordered_map<uint32_t, uint32_t> _materialTextures;
+	std::vector<Load> _loads;
+	std::vector<ResidencyRequest> _streamIns;
+	std::vector<ResidencyRequest> _evictions;
+};
+#endif // !VK_TEXTURE_STREAMER_H
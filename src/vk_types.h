@@ -10,11 +10,16 @@
 struct AllocatedBuffer {
     VkBuffer _buffer;
     VmaAllocation _allocation;
+    //host pointer for the whole lifetime of a buffer created with VMA_ALLOCATION_CREATE_MAPPED_BIT, null otherwise
+    //writes through it need vmaFlushAllocation, which does nothing on host coherent memory
+    void* _mapped{ nullptr };
 };
 // use vma allocate image include VkImage and VmaAllcation
 struct AllocatedImage {
     VkImage _image;
     VmaAllocation _allocation;
+    //views have to match it, block compressed textures are not R8G8B8A8
+    VkFormat _format{ VK_FORMAT_R8G8B8A8_SRGB };
 };
 struct Texture {
     AllocatedImage image;
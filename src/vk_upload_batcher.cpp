@@ -0,0 +1,223 @@
+#include "vk_upload_batcher.h"
+#include <vk_engine.h>
+#include <vk_initializers.h>
+#include <vk_texture.h>
+#include <stdexcept>
+#include <algorithm>
+
+void UploadBatcher::init(VulkanEngine* engine, VkDeviceSize arenaBytes, VkDeviceSize flushBytes, uint32_t flushCopies)
+{
+	_engine = engine;
+	_segmentBytes = arenaBytes / UPLOAD_BATCH_COUNT;
+	//a threshold past the segment would never be reached, the segment fills first
+	_flushBytes = std::min(flushBytes, _segmentBytes);
+	_flushCopies = flushCopies;
+
+	//mapped for as long as the batcher lives, stage() only hands out pointers into it
+	//cpu only memory is host coherent, nothing written through it needs a flush
+	_arena = _engine->create_buffer(true, _segmentBytes * UPLOAD_BATCH_COUNT, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY,
+		VMA_ALLOCATION_CREATE_MAPPED_BIT);
+	_arenaData = (char*)_arena._mapped;
+
+	for (uint32_t i = 0; i < UPLOAD_BATCH_COUNT; i++) {
+		Batch& batch = _batches[i];
+		VkCommandPoolCreateInfo poolInfo = vkinit::command_pool_create_info(_engine->_graphicsQueueFamily);
+		if (vkCreateCommandPool(_engine->_device, &poolInfo, nullptr, &batch.commandPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload command pool!");
+		}
+		VkCommandBufferAllocateInfo allocInfo = vkinit::command_buffer_allocate_info(batch.commandPool, 1);
+		if (vkAllocateCommandBuffers(_engine->_device, &allocInfo, &batch.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate upload command buffer!");
+		}
+		VkFenceCreateInfo fenceInfo = vkinit::fence_create_info();
+		if (vkCreateFence(_engine->_device, &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload fence!");
+		}
+		batch.arenaOffset = _segmentBytes * i;
+		batch.state = BatchState::Idle;
+	}
+}
+
+void UploadBatcher::cleanup()
+{
+	wait_idle();
+	for (Batch& batch : _batches) {
+		vkDestroyFence(_engine->_device, batch.fence, nullptr);
+		vkDestroyCommandPool(_engine->_device, batch.commandPool, nullptr);
+	}
+	vmaDestroyBuffer(_engine->_allocator, _arena._buffer, _arena._allocation);
+}
+
+UploadStaging UploadBatcher::stage(VkDeviceSize size, VkDeviceSize alignment)
+{
+	if (size > _segmentBytes) {
+		AllocatedBuffer buffer = _engine->create_buffer(true, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY,
+			VMA_ALLOCATION_CREATE_MAPPED_BIT);
+		Batch& batch = recording();
+		batch.staging.push_back(buffer);
+		return { buffer._buffer, 0, (char*)buffer._mapped };
+	}
+	Batch* batch = &recording();
+	VkDeviceSize offset = (batch->used + alignment - 1) / alignment * alignment;
+	if (offset + size > _segmentBytes) {
+		//the segment is full, the next batch starts at the beginning of its own
+		flush();
+		batch = &recording();
+		offset = 0;
+	}
+	batch->used = offset + size;
+	return { _arena._buffer, batch->arenaOffset + offset, _arenaData + batch->arenaOffset + offset };
+}
+
+void UploadBatcher::adopt(const AllocatedBuffer& buffer)
+{
+	recording().staging.push_back(buffer);
+}
+
+UploadTicket UploadBatcher::copy_buffers(VkBuffer src, const UploadBufferCopy* copies, uint32_t count)
+{
+	Batch& batch = recording();
+	VkDeviceSize bytes = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		VkBufferCopy region;
+		region.srcOffset = copies[i].srcOffset;
+		region.dstOffset = copies[i].dstOffset;
+		region.size = copies[i].size;
+		vkCmdCopyBuffer(batch.commandBuffer, src, copies[i].dst, 1, &region);
+		bytes += copies[i].size;
+	}
+	return recorded(bytes, count);
+}
+
+UploadTicket UploadBatcher::copy_image(VkBuffer src, VkImage image, uint32_t mipLevels, const VkBufferImageCopy* regions, uint32_t count,
+	VkDeviceSize bytes, uint32_t layerCount)
+{
+	Batch& batch = recording();
+	vkutil::adjustImageLayout(batch.commandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		mipLevels, layerCount);
+	vkCmdCopyBufferToImage(batch.commandBuffer, src, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, count, regions);
+	vkutil::adjustImageLayout(batch.commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		mipLevels, layerCount);
+	return recorded(bytes, count);
+}
+
+UploadTicket UploadBatcher::recorded(VkDeviceSize bytes, uint32_t copies)
+{
+	Batch& batch = _batches[_current];
+	batch.bytes += bytes;
+	batch.copies += copies;
+	_stats.uploads++;
+	_stats.copies += copies;
+	_stats.bytes += bytes;
+	const UploadTicket ticket = batch.ticket;
+	if (batch.bytes >= _flushBytes || batch.copies >= _flushCopies) {
+		flush();
+	}
+	return ticket;
+}
+
+void UploadBatcher::flush()
+{
+	Batch& batch = _batches[_current];
+	if (batch.state != BatchState::Recording) {
+		return;
+	}
+	//later submissions read what this one wrote: vertex and index fetch, storage buffers, and images,
+	//whose own barriers already moved them to shader read
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 1, &barrier, 0, nullptr, 0, nullptr);
+	vkEndCommandBuffer(batch.commandBuffer);
+
+	VkSubmitInfo submitInfo = vkinit::submit_info(&batch.commandBuffer);
+	if (vkQueueSubmit(_engine->_graphicsQueue, 1, &submitInfo, batch.fence) != VK_SUCCESS) {
+		throw std::runtime_error("failed to submit upload batch!");
+	}
+	batch.state = BatchState::InFlight;
+	_stats.submits++;
+	_current = (_current + 1) % UPLOAD_BATCH_COUNT;
+}
+
+UploadBatcher::Batch& UploadBatcher::recording()
+{
+	Batch& batch = _batches[_current];
+	if (batch.state == BatchState::Recording) {
+		return batch;
+	}
+	if (batch.state == BatchState::InFlight) {
+		//batches go out in ring order, so this one and everything before it has to finish
+		if (vkGetFenceStatus(_engine->_device, batch.fence) != VK_SUCCESS) {
+			_stats.stalls++;
+		}
+		collect(batch.ticket, true);
+	}
+	vkResetFences(_engine->_device, 1, &batch.fence);
+	vkResetCommandPool(_engine->_device, batch.commandPool, 0);
+	VkCommandBufferBeginInfo beginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+	batch.used = 0;
+	batch.bytes = 0;
+	batch.copies = 0;
+	batch.ticket = _nextTicket++;
+	batch.state = BatchState::Recording;
+	return batch;
+}
+
+void UploadBatcher::retire(Batch& batch)
+{
+	//persistently mapped ones are unmapped by vma with the buffer
+	for (const AllocatedBuffer& buffer : batch.staging) {
+		vmaDestroyBuffer(_engine->_allocator, buffer._buffer, buffer._allocation);
+	}
+	batch.staging.clear();
+	_completed = batch.ticket;
+	batch.state = BatchState::Idle;
+}
+
+void UploadBatcher::collect(UploadTicket ticket, bool wait)
+{
+	//ring order from the current slot is oldest first, the recording batch is skipped
+	for (uint32_t i = 0; i < UPLOAD_BATCH_COUNT; i++) {
+		Batch& batch = _batches[(_current + i) % UPLOAD_BATCH_COUNT];
+		if (batch.state != BatchState::InFlight) {
+			continue;
+		}
+		const bool needed = wait && batch.ticket <= ticket;
+		if (needed) {
+			vkWaitForFences(_engine->_device, 1, &batch.fence, true, UINT64_MAX);
+		}
+		else if (vkGetFenceStatus(_engine->_device, batch.fence) != VK_SUCCESS) {
+			return;
+		}
+		retire(batch);
+	}
+}
+
+bool UploadBatcher::is_complete(UploadTicket ticket)
+{
+	if (ticket > _completed) {
+		collect(ticket, false);
+	}
+	return ticket <= _completed;
+}
+
+void UploadBatcher::wait(UploadTicket ticket)
+{
+	if (ticket <= _completed) {
+		return;
+	}
+	if (_batches[_current].state == BatchState::Recording && _batches[_current].ticket <= ticket) {
+		flush();
+	}
+	collect(ticket, true);
+}
+
+void UploadBatcher::wait_idle()
+{
+	flush();
+	collect(_nextTicket, true);
+}
@@ -0,0 +1,117 @@
+#pragma once
+#ifndef VK_UPLOAD_BATCHER_H
+#define VK_UPLOAD_BATCHER_H
+#include <vk_types.h>
+#include <vector>
+
+class VulkanEngine;
+
+//batches in flight or recording, each owns an equal segment of the staging arena
+constexpr unsigned int UPLOAD_BATCH_COUNT = 3;
+
+//batch an upload was recorded into, complete once that batch finished on the gpu
+//tickets grow with every batch, so a later ticket being complete implies every earlier one is
+using UploadTicket = uint64_t;
+
+//staging space handed out by UploadBatcher::stage, data is mapped at buffer + offset
+struct UploadStaging {
+	VkBuffer buffer;
+	VkDeviceSize offset;
+	char* data;
+};
+
+struct UploadBufferCopy {
+	//offset in the staging buffer
+	VkDeviceSize srcOffset;
+	VkBuffer dst;
+	VkDeviceSize dstOffset;
+	VkDeviceSize size;
+};
+
+struct UploadStats {
+	//meshes and images recorded, each one was a submit and a queue wait of its own before batching
+	uint64_t uploads{ 0 };
+	uint64_t copies{ 0 };
+	uint64_t bytes{ 0 };
+	uint64_t submits{ 0 };
+	//recording had to wait for a batch in flight to get its arena segment back
+	uint64_t stalls{ 0 };
+};
+
+//gathers buffer and image copies into one command buffer instead of a submit and wait per asset:
+//stage() hands out mapped space in a persistently mapped staging arena, copy_buffers()/copy_image() record
+//the copies and return a ticket, and the batch is submitted with a fence once it holds flushBytes or
+//flushCopies, or when flush() is called (the engine does before every frame and at the end of init)
+//stage() can flush the batch to make room, record the copies of staged data before staging again
+class UploadBatcher {
+public:
+	void init(VulkanEngine* engine, VkDeviceSize arenaBytes, VkDeviceSize flushBytes, uint32_t flushCopies);
+	void cleanup();
+
+	//size bytes of staging, uploads larger than an arena segment get a buffer of their own,
+	//destroyed with the batch that copies from it
+	UploadStaging stage(VkDeviceSize size, VkDeviceSize alignment = 16);
+
+	//a caller filled staging buffer, destroyed once the batch recording now has completed
+	void adopt(const AllocatedBuffer& buffer);
+
+	//buffer copies from src, one upload
+	UploadTicket copy_buffers(VkBuffer src, const UploadBufferCopy* copies, uint32_t count);
+	//move every level and layer of image to transfer dst, copy the regions from src and move it to shader read, one upload
+	//bytes is what the regions read from src, for the flush threshold
+	UploadTicket copy_image(VkBuffer src, VkImage image, uint32_t mipLevels, const VkBufferImageCopy* regions, uint32_t count,
+		VkDeviceSize bytes, uint32_t layerCount = 1);
+
+	//submit the batch being recorded, nothing when there is none
+	void flush();
+	//poll without blocking, a ticket still recording is not complete
+	bool is_complete(UploadTicket ticket);
+	//submit the ticket's batch if needed and block until it completed
+	void wait(UploadTicket ticket);
+	void wait_idle();
+
+	const UploadStats& stats() const { return _stats; }
+
+private:
+	enum class BatchState : uint8_t {
+		Idle,
+		Recording,
+		InFlight,
+	};
+	struct Batch {
+		VkCommandPool commandPool;
+		VkCommandBuffer commandBuffer;
+		VkFence fence;
+		//start of the arena segment
+		VkDeviceSize arenaOffset;
+		VkDeviceSize used;
+		//arena and dedicated bytes, for the flush threshold
+		VkDeviceSize bytes;
+		uint32_t copies;
+		UploadTicket ticket;
+		BatchState state;
+		//staging of uploads over the segment size and adopted caller staging, destroyed once the batch completed
+		std::vector<AllocatedBuffer> staging;
+	};
+
+	//the batch that records, started (and its segment reclaimed) when needed
+	Batch& recording();
+	void retire(Batch& batch);
+	//retire finished batches oldest first, blocking until ticket completed when wait
+	void collect(UploadTicket ticket, bool wait);
+	UploadTicket recorded(VkDeviceSize bytes, uint32_t copies);
+
+	VulkanEngine* _engine{ nullptr };
+	AllocatedBuffer _arena{};
+	char* _arenaData{ nullptr };
+	VkDeviceSize _segmentBytes{ 0 };
+	VkDeviceSize _flushBytes{ 0 };
+	uint32_t _flushCopies{ 0 };
+	Batch _batches[UPLOAD_BATCH_COUNT]{};
+	uint32_t _current{ 0 };
+	//ticket the next recording batch gets
+	UploadTicket _nextTicket{ 1 };
+	UploadTicket _completed{ 0 };
+	UploadStats _stats;
+};
+#endif // !VK_UPLOAD_BATCHER_H
@@ -0,0 +1,59 @@
+// engine_tests: checks of the engine's cpu side modules, one ctest test per entry of tests below.
+// usage: engine_tests [test name]...   runs the named tests, or all of them without arguments
+#include "engine_tests.h"
+#include <iostream>
+#include <string>
+
+struct EngineTest {
+	const char* name;
+	bool (*run)();
+};
+
+static const EngineTest tests[] = {
+	{ "frame_updates", test_frame_updates },
+	{ "ring_allocator", test_ring_allocator },
+	{ "deletion_queue", test_deletion_queue },
+	{ "resource_pool", test_resource_pool },
+	{ "range_allocator", test_range_allocator },
+	{ "texture_residency", test_texture_residency },
+	{ "content_cache", test_content_cache },
+	{ "frame_heap", test_frame_heap },
+	{ "mesh_lods", test_mesh_lods },
+	{ "mesh_quantize", test_mesh_quantize },
+	{ "meshlets", test_meshlets },
+	{ "ktx2", test_ktx2 },
+	{ "bc_encoder", test_bc_encoder },
+};
+
+static bool run_test(const EngineTest& test)
+{
+	std::cout << "[" << test.name << "]" << std::endl;
+	const bool passed = test.run();
+	std::cout << "[" << test.name << "] " << (passed ? "passed" : "FAILED") << std::endl;
+	return passed;
+}
+
+int main(int argc, char* argv[])
+{
+	int failed = 0;
+	if (argc < 2) {
+		for (const EngineTest& test : tests) {
+			failed += !run_test(test);
+		}
+		return failed == 0 ? 0 : 1;
+	}
+	for (int i = 1; i < argc; i++) {
+		const EngineTest* found = nullptr;
+		for (const EngineTest& test : tests) {
+			if (argv[i] == std::string(test.name)) {
+				found = &test;
+			}
+		}
+		if (!found) {
+			std::cerr << "Unknown test " << argv[i] << std::endl;
+			return 1;
+		}
+		failed += !run_test(*found);
+	}
+	return failed == 0 ? 0 : 1;
+}
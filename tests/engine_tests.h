@@ -0,0 +1,25 @@
+#pragma once
+#ifndef ENGINE_TESTS_H
+#define ENGINE_TESTS_H
+#include <chrono>
+
+//checks of the engine modules that run without a device, each prints what it measured and returns false when a check fails
+bool test_frame_updates();
+bool test_ring_allocator();
+bool test_deletion_queue();
+bool test_resource_pool();
+bool test_range_allocator();
+bool test_texture_residency();
+bool test_content_cache();
+bool test_frame_heap();
+bool test_mesh_lods();
+bool test_mesh_quantize();
+bool test_meshlets();
+bool test_ktx2();
+bool test_bc_encoder();
+
+inline float elapsed_ms(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+#endif // !ENGINE_TESTS_H
@@ -0,0 +1,76 @@
+#include "generated_meshes.h"
+#include <vk_mesh_optimizer.h>
+#include <cmath>
+
+static void finish_mesh(Mesh& mesh, const std::vector<Vertex>& faceVertices)
+{
+	mesh.weld_vertices(faceVertices);
+	mesh._materials.assign(1, MeshMaterial{ "default", glm::vec3(1.0f), std::string() });
+	mesh.build_submeshes(std::vector<uint32_t>(mesh._indices.size() / 3, 0));
+	vkutil::optimize_mesh(mesh);
+	mesh.update_bounds();
+}
+
+static Vertex make_vertex(const glm::vec3& position, const glm::vec3& normal, const glm::vec2& uv)
+{
+	Vertex v;
+	v.position = position;
+	v.normal = normal;
+	v.color = normal;
+	v.uv = uv;
+	return v;
+}
+
+Mesh generate_grid_mesh(uint32_t cells)
+{
+	auto corner = [cells](uint32_t x, uint32_t y) {
+		const glm::vec2 p = glm::vec2(x, y) / float(cells) * 2.0f - 1.0f;
+		//gentle waves, enough curvature that simplification has error to report
+		const float height = 0.1f * std::sin(p.x * 3.0f) * std::cos(p.y * 2.0f);
+		const glm::vec3 normal = glm::normalize(glm::vec3(-0.3f * std::cos(p.x * 3.0f) * std::cos(p.y * 2.0f),
+			0.2f * std::sin(p.x * 3.0f) * std::sin(p.y * 2.0f), 1.0f));
+		return make_vertex(glm::vec3(p, height), normal, glm::vec2(x, y) / float(cells));
+	};
+	std::vector<Vertex> faceVertices;
+	faceVertices.reserve(size_t(cells) * cells * 6);
+	for (uint32_t y = 0; y < cells; y++) {
+		for (uint32_t x = 0; x < cells; x++) {
+			const Vertex quad[4] = { corner(x, y), corner(x + 1, y), corner(x + 1, y + 1), corner(x, y + 1) };
+			for (int i : { 0, 1, 2, 0, 2, 3 }) {
+				faceVertices.push_back(quad[i]);
+			}
+		}
+	}
+	Mesh mesh;
+	finish_mesh(mesh, faceVertices);
+	return mesh;
+}
+
+Mesh generate_sphere_mesh(uint32_t rings, uint32_t segments)
+{
+	const float pi = 3.14159265358979f;
+	auto point = [&](uint32_t ring, uint32_t segment) {
+		const float theta = pi * ring / rings;
+		//the last segment wraps to the first position with u = 1, which is the seam
+		const float phi = 2.0f * pi * (segment % segments) / segments;
+		const glm::vec3 n(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta));
+		return make_vertex(n, n, glm::vec2(float(segment) / segments, float(ring) / rings));
+	};
+	std::vector<Vertex> faceVertices;
+	for (uint32_t ring = 0; ring < rings; ring++) {
+		for (uint32_t segment = 0; segment < segments; segment++) {
+			const Vertex a = point(ring, segment), b = point(ring + 1, segment);
+			const Vertex c = point(ring + 1, segment + 1), d = point(ring, segment + 1);
+			//the rings next to the poles are fans, their quads would have a zero length edge
+			if (ring > 0) {
+				faceVertices.insert(faceVertices.end(), { a, b, d });
+			}
+			if (ring + 1 < rings) {
+				faceVertices.insert(faceVertices.end(), { d, b, c });
+			}
+		}
+	}
+	Mesh mesh;
+	finish_mesh(mesh, faceVertices);
+	return mesh;
+}
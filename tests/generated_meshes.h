@@ -0,0 +1,12 @@
+#pragma once
+#ifndef GENERATED_MESHES_H
+#define GENERATED_MESHES_H
+#include <vk_mesh.h>
+
+//meshes built in code for the mesh checks, welded, sorted into one default submesh and optimized like a loaded obj
+//a cells x cells heightfield over [-1, 1]^2 with uvs across it, open borders on all four sides
+Mesh generate_grid_mesh(uint32_t cells);
+//unit sphere around the origin, poles on z, with a uv seam at u = 0: the normals include (0,0,+-1) and (+-1,0,0)
+//when segments is a multiple of 4, the corners of the octahedral encoding
+Mesh generate_sphere_mesh(uint32_t rings, uint32_t segments);
+#endif // !GENERATED_MESHES_H
@@ -0,0 +1,94 @@
+#include "engine_tests.h"
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cmath>
+
+#include <bc_encoder.h>
+#include <thread_pool.h>
+
+//generated 38x30 images, the partial edge blocks repeat the last texels
+static const uint32_t imageWidth = 38;
+static const uint32_t imageHeight = 30;
+
+static std::vector<uint8_t> generate_image(int pattern)
+{
+	std::vector<uint8_t> rgba(size_t(imageWidth) * imageHeight * 4);
+	for (uint32_t y = 0; y < imageHeight; y++) {
+		for (uint32_t x = 0; x < imageWidth; x++) {
+			uint8_t* pixel = &rgba[(size_t(y) * imageWidth + x) * 4];
+			const float u = float(x) / (imageWidth - 1);
+			const float v = float(y) / (imageHeight - 1);
+			if (pattern == 0) {
+				//smooth gradients on every channel, opaque
+				pixel[0] = static_cast<uint8_t>(u * 255.0f);
+				pixel[1] = static_cast<uint8_t>(v * 255.0f);
+				pixel[2] = static_cast<uint8_t>((1.0f - u * v) * 255.0f);
+				pixel[3] = 255;
+			}
+			else if (pattern == 1) {
+				//hard edges: a checker of two colors and a diagonal split of two others through the blocks
+				const bool checker = ((x / 3 + y / 3) & 1) != 0;
+				const bool split = x + 2 * y > imageWidth;
+				pixel[0] = checker ? 240 : 20;
+				pixel[1] = split ? 200 : 40;
+				pixel[2] = checker != split ? 180 : 60;
+				pixel[3] = 255;
+			}
+			else {
+				//alpha: a gradient over the left half, cut out holes over the right half, color varies too
+				pixel[0] = static_cast<uint8_t>(128.0f + 100.0f * std::sin(u * 6.0f));
+				pixel[1] = static_cast<uint8_t>(v * 200.0f);
+				pixel[2] = 90;
+				pixel[3] = x < imageWidth / 2 ? static_cast<uint8_t>(v * 255.0f) : ((x * 7 + y * 3) % 11 < 5 ? 0 : 255);
+			}
+		}
+	}
+	return rgba;
+}
+
+//every block encoder on gradients, hard edges and alpha; each format has to reach its PSNR per pattern on the channels
+//it keeps, the edge blocks hold up to four colors off one line and score lowest
+bool test_bc_encoder()
+{
+	struct Format {
+		assets::TextureFormat format;
+		const char* name;
+		uint32_t channels;
+		//lowest PSNR in dB accepted on gradients, edges and alpha, a few dB below what the encoders reach today
+		double minPsnr[3];
+	};
+	const Format formats[] = {
+		{ assets::TextureFormat::BC1_SRGB, "BC1", 0x7, { 31.0, 21.0, 32.0 } },
+		{ assets::TextureFormat::BC3_SRGB, "BC3", 0xF, { 32.0, 22.0, 33.0 } },
+		{ assets::TextureFormat::BC5_UNORM, "BC5", 0x3, { 45.0, 45.0, 45.0 } },
+		{ assets::TextureFormat::BC7_SRGB, "BC7", 0xF, { 33.0, 22.0, 32.0 } },
+	};
+	const char* patterns[] = { "gradients", "edges", "alpha" };
+
+	bool ok = true;
+	std::vector<uint8_t> blocks;
+	std::vector<uint8_t> decoded(size_t(imageWidth) * imageHeight * 4);
+	std::cout << "  format  gradients      edges      alpha" << std::endl;
+	for (const Format& format : formats) {
+		blocks.resize(assets::texture_level_size(format.format, imageWidth, imageHeight));
+		std::cout << "  " << std::setw(6) << format.name;
+		for (int pattern = 0; pattern < 3; pattern++) {
+			const std::vector<uint8_t> image = generate_image(pattern);
+			vkutil::compress_image(image.data(), imageWidth, imageHeight, format.format, ThreadPool::shared(), blocks.data());
+			if (!vkutil::decompress_image(blocks.data(), imageWidth, imageHeight, format.format, decoded.data())) {
+				std::cout << std::endl;
+				std::cerr << format.name << " wrote blocks its decoder does not read" << std::endl;
+				return false;
+			}
+			const double psnr = vkutil::compute_psnr(image.data(), decoded.data(), size_t(imageWidth) * imageHeight, format.channels);
+			std::cout << std::setw(11) << psnr;
+			if (psnr < format.minPsnr[pattern]) {
+				std::cerr << format.name << " reaches " << psnr << " dB on " << patterns[pattern] << ", needs " << format.minPsnr[pattern] << std::endl;
+				ok = false;
+			}
+		}
+		std::cout << std::endl;
+	}
+	return ok;
+}
@@ -0,0 +1,160 @@
+#include "engine_tests.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <cstring>
+
+#include <content_cache.h>
+#include <asset_loader.h>
+
+namespace fs = std::filesystem;
+
+//the engine's content cache over files: a hit has to be byte for byte the file that owns it,
+//and a miss must not be, any other outcome is a hash collision or a broken cache
+static bool dedup_files(const std::vector<fs::path>& files, uint64_t& outHits)
+{
+	ContentCache cache;
+	//files that own their content, compared byte for byte with every later file
+	std::vector<fs::path> owners;
+	bool ok = true;
+	uint64_t hashedBytes = 0;
+	float hashMs = 0.0f;
+	for (const fs::path& file : files) {
+		assets::MappedFile mapped;
+		if (!mapped.open(file.string().c_str())) {
+			std::cerr << "Cannot open " << file.string() << std::endl;
+			ok = false;
+			continue;
+		}
+		auto start = std::chrono::high_resolution_clock::now();
+		ContentKey key;
+		key.hash = content_hash(mapped.data(), mapped.size());
+		key.size = mapped.size();
+		hashMs += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		hashedBytes += mapped.size();
+
+		const std::string* owner = cache.find(key, file.string());
+		//the cache decides, the bytes have to agree with it
+		bool identical = false;
+		for (const fs::path& other : owners) {
+			assets::MappedFile otherMapped;
+			if (otherMapped.open(other.string().c_str()) && otherMapped.size() == mapped.size()
+				&& memcmp(otherMapped.data(), mapped.data(), mapped.size()) == 0) {
+				identical = true;
+				break;
+			}
+		}
+		if (owner) {
+			std::cout << file.string() << " -> " << *owner << std::endl;
+			cache.alias(file.string(), *owner, key.size);
+			if (!identical) {
+				std::cerr << "Hash collision: " << file.string() << " is not the same as " << *owner << std::endl;
+				ok = false;
+			}
+		}
+		else {
+			if (identical) {
+				std::cerr << "Missed duplicate " << file.string() << std::endl;
+				ok = false;
+			}
+			cache.insert(key, file.string(), file.string());
+			owners.push_back(file);
+		}
+	}
+	outHits = cache.stats().hits;
+	cache.print_stats("Content cache");
+	std::cout << "Hashed " << hashedBytes / (1024.0 * 1024.0) << " MB in " << hashMs << " ms, "
+		<< (hashMs > 0.0f ? hashedBytes / (1024.0 * 1024.0) / (hashMs / 1000.0f) : 0.0) << " MB/s" << std::endl;
+	return ok;
+}
+
+//duplicate assets written to a temporary folder: copies under other names, files of the same size
+//with other bytes and one byte flipped, which must all stay misses
+bool test_content_cache()
+{
+	const fs::path folder = fs::temp_directory_path() / "engine_tests_content_cache";
+	fs::remove_all(folder);
+	fs::create_directories(folder);
+	std::mt19937 rng(7);
+	auto random_bytes = [&rng](size_t size) {
+		std::vector<char> bytes(size);
+		for (char& byte : bytes) {
+			byte = static_cast<char>(rng());
+		}
+		return bytes;
+	};
+	auto write = [&folder](const char* name, const std::vector<char>& bytes) {
+		std::ofstream file(folder / name, std::ios::binary);
+		file.write(bytes.data(), bytes.size());
+	};
+	const std::vector<char> texture = random_bytes(256 * 1024);
+	const std::vector<char> mesh = random_bytes(4096);
+	std::vector<char> flipped = texture;
+	flipped[flipped.size() / 2] ^= 1;
+	write("a_texture.png", texture);
+	write("b_texture_copy.png", texture);
+	write("c_same_size.png", random_bytes(texture.size()));
+	write("d_flipped.png", flipped);
+	write("e_mesh.mesh", mesh);
+	write("f_mesh_copy.mesh", mesh);
+	write("g_texture_copy_again.png", texture);
+
+	std::vector<fs::path> files;
+	for (const auto& entry : fs::directory_iterator(folder)) {
+		files.push_back(entry.path());
+	}
+	//directory order is not stable, owners should be
+	std::sort(files.begin(), files.end());
+	uint64_t hits = 0;
+	bool ok = dedup_files(files, hits);
+	if (ok && hits != 3) {
+		std::cerr << "Content cache found " << hits << " duplicates of the 3 written" << std::endl;
+		ok = false;
+	}
+
+	const std::string texturePath = (folder / "a_texture.png").string();
+	const std::string copyPath = (folder / "b_texture_copy.png").string();
+	const std::string otherPath = (folder / "c_same_size.png").string();
+	ContentKey key;
+	file_content_key(texturePath.c_str(), key);
+	ContentCache cache;
+	cache.insert(key, "texture", texturePath);
+	//a colliding key, the same hash and size over other bytes, has to miss
+	if (cache.find(key, otherPath) || !cache.find(key, copyPath)) {
+		std::cerr << "Content cache trusts the key over the bytes" << std::endl;
+		ok = false;
+	}
+	//finding records nothing, an owner that fails to resolve leaves no alias behind
+	if (!cache.aliases().empty() || cache.stats().hits != 0) {
+		std::cerr << "Content cache recorded a hit before alias()" << std::endl;
+		ok = false;
+	}
+	//removing an owner hands its content to an alias, the next alias follows the heir
+	cache.alias("copy", "texture", key.size);
+	cache.alias("copy_again", "texture", key.size);
+	cache.remove("texture");
+	const std::string* heir = cache.find(key, copyPath);
+	if (!heir || cache.resolve(*heir) != *heir || cache.resolve(*heir == "copy" ? "copy_again" : "copy") != *heir) {
+		std::cerr << "Content cache lost the content of a removed owner with aliases" << std::endl;
+		ok = false;
+	}
+	//the last name going takes the content along, and a new load owns it again
+	cache.remove("copy");
+	cache.remove("copy_again");
+	if (cache.find(key, copyPath)) {
+		std::cerr << "Content cache returns a removed owner" << std::endl;
+		ok = false;
+	}
+	cache.insert(key, "reloaded", copyPath);
+	const std::string* reloaded = cache.find(key, texturePath);
+	if (!reloaded || *reloaded != "reloaded") {
+		std::cerr << "Content cache kept a stale owner over the new load" << std::endl;
+		ok = false;
+	}
+	fs::remove_all(folder);
+	return ok;
+}
@@ -0,0 +1,157 @@
+#include "engine_tests.h"
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <future>
+#include <atomic>
+#include <algorithm>
+
+#include <deletion_queue.h>
+#include <thread_pool.h>
+#include <memory_stats.h>
+
+//what the deletion queue benchmark destroys: fake image view handles holding their index + 1
+struct BenchDeletions {
+	std::vector<uint32_t> retiredFrame;
+	std::vector<uint8_t> destroyed;
+	std::atomic<uint32_t> frame{ 0 };
+	uint32_t frameSlots{ 0 };
+	uint64_t early{ 0 };
+	uint64_t twice{ 0 };
+};
+
+static void test_destroy(const DeletionRecord& record, void* context)
+{
+	BenchDeletions& deletions = *static_cast<BenchDeletions*>(context);
+	const uint64_t index = record.handle - 1;
+	if (deletions.destroyed[index]++) {
+		deletions.twice++;
+	}
+	//retired in frame r, the fence of r is waited on when its slot comes around again
+	if (deletions.frame.load(std::memory_order_relaxed) < deletions.retiredFrame[index] + deletions.frameSlots) {
+		deletions.early++;
+	}
+}
+
+//a million handles through the engine's deletion queue with 2 frames in flight, 1000 retired per frame from the main
+//thread, then from the pool's workers while the main thread keeps running frames; checks that every handle is destroyed
+//once and never before the fence of the frame it was retired in, and times it against the std::function deque the engine used
+bool test_deletion_queue()
+{
+	const uint32_t handles = 1000000;
+	const uint32_t perFrame = 1000;
+	BenchDeletions deletions;
+	deletions.frameSlots = 2;
+	auto fake_view = [](uint32_t index) { return reinterpret_cast<VkImageView>(uintptr_t(index) + 1); };
+	auto check = [&](const char* pass) {
+		const size_t missing = std::count(deletions.destroyed.begin(), deletions.destroyed.end(), 0);
+		if (missing != 0 || deletions.twice != 0 || deletions.early != 0) {
+			std::cerr << "Deletion queue, " << pass << ": " << missing << " handles never destroyed, " << deletions.twice
+				<< " twice, " << deletions.early << " before their frame's fence" << std::endl;
+			return false;
+		}
+		return true;
+	};
+	auto reset = [&]() {
+		deletions.retiredFrame.assign(handles, 0);
+		deletions.destroyed.assign(handles, 0);
+		deletions.frame = 0;
+	};
+
+	//main thread: begin_frame destroys what the slot retired last time, the frame retires its share, end_frame hands it over
+	reset();
+	DeletionQueue queue;
+	queue.init(deletions.frameSlots, test_destroy, &deletions);
+	uint64_t steadyAllocations = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	uint32_t frame = 0;
+	for (uint32_t next = 0; next < handles; frame++) {
+		const uint64_t heapAllocations = vkutil::heap_allocation_count();
+		deletions.frame = frame;
+		queue.begin_frame(frame % deletions.frameSlots);
+		for (uint32_t i = 0; i < perFrame && next < handles; i++, next++) {
+			deletions.retiredFrame[next] = frame;
+			queue.retire(fake_view(next));
+		}
+		queue.end_frame(frame % deletions.frameSlots);
+		//the lists keep their capacity, only the first frames grow them
+		if (frame >= deletions.frameSlots + 1) {
+			steadyAllocations += vkutil::heap_allocation_count() - heapAllocations;
+		}
+	}
+	for (uint32_t i = 0; i < deletions.frameSlots; i++, frame++) {
+		deletions.frame = frame;
+		queue.begin_frame(frame % deletions.frameSlots);
+		queue.end_frame(frame % deletions.frameSlots);
+	}
+	const float queueTime = elapsed_ms(start);
+	const uint32_t mainFrames = frame;
+	if (!check("main thread") || queue.retired_count() != 0) {
+		return false;
+	}
+
+	//workers: the same handles retired from the thread pool, the main thread running frames until they are all gone
+	reset();
+	DeletionQueue workerQueue;
+	workerQueue.init(deletions.frameSlots, test_destroy, &deletions);
+	const uint32_t workers = static_cast<uint32_t>(std::max<size_t>(1, ThreadPool::shared().thread_count()));
+	std::atomic<uint32_t> retired{ 0 };
+	start = std::chrono::high_resolution_clock::now();
+	std::vector<std::future<void>> futures;
+	for (uint32_t w = 0; w < workers; w++) {
+		futures.push_back(ThreadPool::shared().submit([&, w]() {
+			for (uint32_t i = w; i < handles; i += workers) {
+				//read before the retire, the record lands in this frame or a later one
+				deletions.retiredFrame[i] = deletions.frame.load();
+				workerQueue.retire(fake_view(i));
+				retired.fetch_add(1, std::memory_order_relaxed);
+			}
+		}));
+	}
+	frame = 0;
+	for (uint32_t quietFrames = 0; quietFrames <= deletions.frameSlots; frame++) {
+		const bool allRetired = retired.load() == handles;
+		deletions.frame = frame;
+		workerQueue.begin_frame(frame % deletions.frameSlots);
+		workerQueue.end_frame(frame % deletions.frameSlots);
+		quietFrames = allRetired ? quietFrames + 1 : 0;
+	}
+	for (auto& future : futures) {
+		future.get();
+	}
+	const float workerTime = elapsed_ms(start);
+	if (!check("worker threads") || workerQueue.retired_count() != 0) {
+		return false;
+	}
+
+	//the engine's queue before: a std::function per object in a deque, run in reverse at shutdown
+	uint64_t functionDestroyed = 0;
+	start = std::chrono::high_resolution_clock::now();
+	{
+		std::deque<std::function<void()>> deletors;
+		for (uint32_t i = 0; i < handles; i++) {
+			VkImageView view = fake_view(i);
+			deletors.push_back([&functionDestroyed, view]() { functionDestroyed += reinterpret_cast<uintptr_t>(view) != 0; });
+		}
+		for (auto it = deletors.rbegin(); it != deletors.rend(); it++) {
+			(*it)();
+		}
+	}
+	const float functionTime = elapsed_ms(start);
+	if (functionDestroyed != handles) {
+		return false;
+	}
+
+	std::cout << "Deletion queue, " << handles << " handles, " << sizeof(DeletionRecord) << " byte records: main thread "
+		<< queueTime * 1e6f / handles << " ns per handle over " << mainFrames << " frames, " << workers << " worker threads "
+		<< workerTime * 1e6f / handles << " ns, std::function deque " << functionTime * 1e6f / handles << " ns" << std::endl;
+	if (vkutil::heap_allocations_counted()) {
+		std::cout << "  " << steadyAllocations << " heap allocations after the first frames" << std::endl;
+		if (steadyAllocations != 0) {
+			std::cerr << "Retiring allocates once the lists have grown" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,130 @@
+#include "engine_tests.h"
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include <frame_allocator.h>
+#include <ring_allocator.h>
+#include <deletion_queue.h>
+#include <texture_residency.h>
+#include <memory_stats.h>
+
+static void count_destroy(const DeletionRecord&, void* context)
+{
+	(*static_cast<uint64_t*>(context))++;
+}
+
+//the cpu side of draw() headless: per frame a FrameAllocator reset and FrameVector scratch, a RingAllocator frame of
+//uniform and storage data, objects retired through the DeletionQueue and TextureResidency planning for a moving camera,
+//with 2 frames in flight; once the first frames grew every arena and vector, no frame may call operator new
+bool test_frame_heap()
+{
+	if (!vkutil::heap_allocations_counted()) {
+		std::cerr << "engine_tests is built without COUNT_HEAP_ALLOCATIONS" << std::endl;
+		return false;
+	}
+	const uint32_t frameSlots = 2;
+	const int warmupFrames = 60;
+	const int totalFrames = 2000;
+	const uint32_t objectCount = 4096;
+	const uint32_t textureCount = 64;
+
+	//sized up front like the engine's FRAME_ALLOCATOR_BYTES
+	FrameAllocator arenas[frameSlots];
+	for (FrameAllocator& arena : arenas) {
+		arena.reserve(256 * 1024);
+	}
+	RingAllocator ring;
+	ring.reset(4ull * 1024 * 1024, frameSlots, RingAllocatorLimits{});
+	DeletionQueue deletions;
+	uint64_t destroyed = 0;
+	deletions.init(frameSlots, count_destroy, &destroyed);
+	TextureResidency residency;
+	for (uint32_t t = 0; t < textureCount; t++) {
+		std::vector<uint64_t> levels;
+		for (uint32_t size = 1024u << (t % 3); size > 0; size >>= 1) {
+			levels.push_back(uint64_t(size) * size);
+		}
+		residency.add_texture(1024u << (t % 3), 1024u << (t % 3), levels);
+	}
+	std::vector<ResidencyRequest> streamIns;
+	std::vector<ResidencyRequest> evictions;
+	//each texture has at most one move in flight
+	std::vector<ResidencyRequest> landing;
+	landing.reserve(textureCount);
+
+	uint64_t steadyAllocations = 0;
+	uint64_t retired = 0;
+	uint64_t ringFailures = 0;
+	uint64_t moves = 0;
+	for (int frame = 0; frame < totalFrames; frame++) {
+		const uint64_t heapAllocations = vkutil::heap_allocation_count();
+		const uint32_t slot = frame % frameSlots;
+		FrameAllocator& arena = arenas[slot];
+		arena.reset();
+		deletions.begin_frame(slot);
+		ring.begin_frame(slot);
+		//moves planned last frame land now, like the streamer's loads
+		for (const ResidencyRequest& move : landing) {
+			residency.complete(move.texture, move.targetMip);
+		}
+		landing.clear();
+
+		//culling scratch: the visible objects of the frame sorted by a draw key
+		FrameVector<uint32_t> visible{ FrameStlAllocator<uint32_t>(arena) };
+		visible.reserve(objectCount);
+		const float camera = 0.5f + 0.5f * std::sin(frame * 0.01f);
+		for (uint32_t i = 0; i < objectCount; i++) {
+			if ((i * 2654435761u >> 20) % 100 < 40 + uint32_t(camera * 50.0f)) {
+				visible.push_back(i * 2654435761u);
+			}
+		}
+		std::sort(visible.begin(), visible.end());
+
+		//camera data, then the object matrices of the visible objects
+		uint64_t offset;
+		ringFailures += !ring.allocate(256, RingUsage::Uniform, offset);
+		ringFailures += !ring.allocate(visible.size() * 64, RingUsage::Storage, offset);
+		RangeAllocation ranges[2];
+		ring.pending_ranges(ranges);
+
+		//a few objects dropped at runtime every frame, more while the camera moves fast
+		const uint32_t retireCount = 1 + frame % 7;
+		for (uint32_t r = 0; r < retireCount; r++) {
+			deletions.retire(reinterpret_cast<VkImageView>(uintptr_t(++retired)));
+		}
+
+		//footprints sweep from tail to full detail and back as the camera moves
+		for (uint32_t t = 0; t < textureCount; t++) {
+			if ((t + frame / 30) % 4 != 0) {
+				const uint32_t mip = uint32_t((1.0f - camera) * (residency.level_count(t) - 1) + t % 3) % residency.level_count(t);
+				residency.request(t, mip);
+			}
+		}
+		residency.plan(64ull * 1024 * 1024, 4, streamIns, evictions, arena);
+		landing.insert(landing.end(), streamIns.begin(), streamIns.end());
+		landing.insert(landing.end(), evictions.begin(), evictions.end());
+		moves += streamIns.size() + evictions.size();
+
+		ring.end_frame(slot);
+		deletions.end_frame(slot);
+		if (frame >= warmupFrames) {
+			steadyAllocations += vkutil::heap_allocation_count() - heapAllocations;
+		}
+	}
+	deletions.flush();
+
+	std::cout << "Frame path: " << totalFrames << " frames, " << retired << " objects retired, " << moves
+		<< " residency moves, " << steadyAllocations << " heap allocations after " << warmupFrames << " warm-up frames" << std::endl;
+	if (destroyed != retired || ringFailures != 0 || moves == 0) {
+		std::cerr << "Frame path: " << destroyed << " of " << retired << " retired objects destroyed, "
+			<< ringFailures << " ring allocations failed" << std::endl;
+		return false;
+	}
+	if (steadyAllocations != 0) {
+		std::cerr << "Frames allocate on the heap after warm-up" << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,135 @@
+#include "engine_tests.h"
+#include <iostream>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <glm/gtx/transform.hpp>
+
+#include <ring_allocator.h>
+
+//the old path: one host visible buffer per binding, mapped and unmapped around every frame's write
+//vmaMapMemory/vmaUnmapMemory take the allocation's mutex and count the mappings, the first map also calls
+//vkMapMemory, which needs a device and is left out, so this baseline is a lower bound of what the old path cost
+struct MappedPerWriteBuffer {
+	std::mutex mutex;
+	uint32_t mapCount{ 0 };
+	std::vector<char> memory;
+
+	char* map()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		mapCount++;
+		return memory.data();
+	}
+	void unmap()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		mapCount--;
+	}
+};
+
+//the per frame buffer writes of draw_objects at 1, 1k and 100k objects: camera, scene parameters and object matrices,
+//once through map and unmap per buffer like before, and once the way draw() writes them now: push_frame_data
+//suballocations of a RingAllocator over one persistently mapped buffer, begin_frame/end_frame per frame slot and the
+//pending ranges collected for the flush; both write the same bytes into memory touched up front
+bool test_frame_updates()
+{
+	const size_t counts[] = { 1, 1000, 100000 };
+	const uint32_t frameSlots = 2;
+	const size_t sceneStride = 256;
+	const size_t cameraBytes = sizeof(glm::mat4) * 3;
+	const size_t sceneBytes = sizeof(glm::vec4) * 5;
+	MappedPerWriteBuffer camera, scene, objects;
+	camera.memory.resize(cameraBytes);
+	scene.memory.resize(sceneStride * frameSlots);
+	objects.memory.resize(sizeof(glm::mat4) * counts[2]);
+
+	//room for every frame in flight plus the alignment padding and a wrap
+	const uint64_t ringBytes = (sizeof(glm::mat4) * counts[2] + 3 * 256) * (frameSlots + 1);
+	std::vector<char> ringMemory(ringBytes);
+	RingAllocator ring;
+	ring.reset(ringBytes, frameSlots, RingAllocatorLimits{});
+	//stand in for push_frame_data: the suballocation and the pointer into the mapping
+	auto push_frame_data = [&](size_t size, RingUsage usage) -> char* {
+		uint64_t offset;
+		return ring.allocate(size, usage, offset) ? ringMemory.data() + offset : nullptr;
+	};
+
+	const glm::mat4 model = glm::rotate(glm::mat4(1.0f), 0.5f, glm::vec3(0.0f, 0.0f, 1.0f));
+	std::vector<glm::mat4> dequantize(counts[2], glm::scale(glm::vec3(1.0f / 1024.0f)));
+	const glm::mat4 cameraData[3] = { model, model, model };
+	const glm::vec4 sceneData[5] = {};
+	auto write_frame = [&](size_t count, char* cameraPtr, char* scenePtr, char* objectPtr) {
+		memcpy(cameraPtr, cameraData, cameraBytes);
+		memcpy(scenePtr, sceneData, sceneBytes);
+		glm::mat4* objectMatrices = (glm::mat4*)objectPtr;
+		for (size_t i = 0; i < count; i++) {
+			objectMatrices[i] = model * dequantize[i];
+		}
+	};
+
+	bool ok = true;
+	for (size_t count : counts) {
+		const uint64_t frames = std::max<uint64_t>(200, 20000000 / count);
+		//page faults of the first touch would land on whichever path runs first
+		memset(objects.memory.data(), 0, objects.memory.size());
+		memset(ringMemory.data(), 0, ringMemory.size());
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64_t frame = 0; frame < frames; frame++) {
+			char* cameraPtr = camera.map();
+			char* scenePtr = scene.map();
+			char* objectPtr = objects.map();
+			write_frame(count, cameraPtr, scenePtr + sceneStride * (frame % frameSlots), objectPtr);
+			camera.unmap();
+			scene.unmap();
+			objects.unmap();
+		}
+		const double mapNs = elapsed_ms(start) * 1e6 / frames;
+
+		uint64_t flushedBytes = 0;
+		start = std::chrono::high_resolution_clock::now();
+		for (uint64_t frame = 0; frame < frames; frame++) {
+			const uint32_t slot = frame % frameSlots;
+			ring.begin_frame(slot);
+			char* cameraPtr = push_frame_data(cameraBytes, RingUsage::Uniform);
+			char* scenePtr = push_frame_data(sceneBytes, RingUsage::Uniform);
+			char* objectPtr = push_frame_data(sizeof(glm::mat4) * count, RingUsage::Storage);
+			if (!cameraPtr || !scenePtr || !objectPtr) {
+				ok = false;
+				break;
+			}
+			write_frame(count, cameraPtr, scenePtr, objectPtr);
+			//what draw() hands to vmaFlushAllocation, a no-op on host coherent memory
+			RangeAllocation ranges[2];
+			const uint32_t rangeCount = ring.pending_ranges(ranges);
+			for (uint32_t i = 0; i < rangeCount; i++) {
+				flushedBytes += ranges[i].size;
+			}
+			ring.end_frame(slot);
+		}
+		const double persistentNs = elapsed_ms(start) * 1e6 / frames;
+		std::cout << "Frame buffer updates, " << count << " objects: map per write " << mapNs << " ns (without vkMapMemory), "
+			<< "persistently mapped ring " << persistentNs << " ns per frame, " << flushedBytes / frames << " bytes flushed per frame" << std::endl;
+		if (!ok) {
+			std::cerr << "The frame ring ran out of room at " << count << " objects" << std::endl;
+			return false;
+		}
+		//the flushed ranges have to cover everything the frames wrote
+		if (flushedBytes < frames * (cameraBytes + sceneBytes + sizeof(glm::mat4) * count)) {
+			std::cerr << "The frame ring flushes less than the frames wrote" << std::endl;
+			return false;
+		}
+	}
+	if (camera.mapCount != 0 || scene.mapCount != 0 || objects.mapCount != 0) {
+		std::cerr << "Unbalanced map and unmap" << std::endl;
+		return false;
+	}
+	if (ring.stats().failures != 0) {
+		std::cerr << "The frame ring failed " << ring.stats().failures << " allocations" << std::endl;
+		return false;
+	}
+	return true;
+}
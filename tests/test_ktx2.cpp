@@ -0,0 +1,97 @@
+#include "engine_tests.h"
+#include <iostream>
+#include <filesystem>
+#include <vector>
+#include <atomic>
+#include <cstring>
+
+#include <ktx2_loader.h>
+#include <mip_generator.h>
+#include <thread_pool.h>
+
+namespace fs = std::filesystem;
+
+//write a KTX2 file and read it back the way the engine does (map, validate, unpack the levels in parallel),
+//every level has to come back byte for byte
+static bool round_trip(const fs::path& path, const MipChain& chain, int zstdLevel)
+{
+	std::vector<std::pair<const void*, size_t>> levels;
+	size_t rawBytes = 0;
+	for (uint32_t i = 0; i < chain.level_count(); i++) {
+		levels.push_back({ chain.level_data(i), chain.level_size(i) });
+		rawBytes += chain.level_size(i);
+	}
+	if (!assets::save_ktx2(path.string().c_str(), assets::TextureFormat::RGBA8_SRGB, chain.width, chain.height, levels, zstdLevel)) {
+		std::cerr << "Failed to write " << path << std::endl;
+		return false;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	assets::MappedFile file;
+	assets::Ktx2View view;
+	if (!file.open(path.string().c_str()) || !assets::open_ktx2(file, view)) {
+		std::cerr << "Failed to read back " << path << std::endl;
+		return false;
+	}
+	const assets::Ktx2Supercompression scheme = zstdLevel > 0 ? assets::Ktx2Supercompression::Zstd : assets::Ktx2Supercompression::None;
+	if (view.header->supercompressionScheme != scheme || view.format != assets::TextureFormat::RGBA8_SRGB
+		|| view.level_count() != levels.size() || view.header->pixelWidth != chain.width || view.header->pixelHeight != chain.height) {
+		std::cerr << path << " reads back with another header" << std::endl;
+		return false;
+	}
+	std::vector<std::vector<char>> unpacked(levels.size());
+	std::atomic<bool> valid{ true };
+	ThreadPool::shared().parallel_for(levels.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			unpacked[i].resize(static_cast<size_t>(view.levels[i].uncompressedByteLength));
+			if (!assets::unpack_ktx2_level(view, static_cast<uint32_t>(i), unpacked[i].data())) {
+				valid = false;
+			}
+		}
+	});
+	const float loadTime = elapsed_ms(start);
+	for (size_t i = 0; i < levels.size() && valid; i++) {
+		valid = unpacked[i].size() == levels[i].second && memcmp(unpacked[i].data(), levels[i].first, levels[i].second) == 0;
+		//plain levels are stored as is, the span is the level itself
+		valid = valid && (scheme != assets::Ktx2Supercompression::None || view.level_span(static_cast<uint32_t>(i)).size == levels[i].second);
+		if (!valid) {
+			std::cerr << "Level " << i << " of " << path << " does not round trip" << std::endl;
+		}
+	}
+	std::cout << "KTX2 " << path.filename() << ": " << rawBytes << " -> " << fs::file_size(path) << " bytes, "
+		<< levels.size() << " levels read back in " << loadTime << " ms" << std::endl;
+	return valid;
+}
+
+//a generated 173x96 image, odd sizes so the chain has levels that round down, through both level paths of
+//save_ktx2 and open_ktx2: stored plain and zstd supercompressed
+bool test_ktx2()
+{
+	const uint32_t width = 173;
+	const uint32_t height = 96;
+	std::vector<uint8_t> rgba(size_t(width) * height * 4);
+	for (uint32_t y = 0; y < height; y++) {
+		for (uint32_t x = 0; x < width; x++) {
+			uint8_t* pixel = &rgba[(size_t(y) * width + x) * 4];
+			//gradients and a checker, smooth areas for zstd and hard edges for the mip filter
+			pixel[0] = static_cast<uint8_t>(x * 255 / (width - 1));
+			pixel[1] = static_cast<uint8_t>(y * 255 / (height - 1));
+			pixel[2] = ((x / 8 + y / 8) & 1) ? 220 : 30;
+			pixel[3] = static_cast<uint8_t>(255 - (x + y) % 64);
+		}
+	}
+	MipChain chain;
+	vkutil::generate_mips(rgba.data(), width, height, true, MipFilter::Box, ThreadPool::shared(), chain);
+
+	const fs::path folder = fs::temp_directory_path() / "engine_tests_ktx2";
+	fs::remove_all(folder);
+	fs::create_directories(folder);
+	const bool plain = round_trip(folder / "plain.ktx2", chain, 0);
+	const bool zstd = round_trip(folder / "zstd.ktx2", chain, 10);
+	const bool smaller = zstd && fs::file_size(folder / "zstd.ktx2") < fs::file_size(folder / "plain.ktx2");
+	fs::remove_all(folder);
+	if (plain && zstd && !smaller) {
+		std::cerr << "Supercompression did not shrink the file" << std::endl;
+	}
+	return plain && zstd && smaller;
+}
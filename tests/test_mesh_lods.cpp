@@ -0,0 +1,70 @@
+#include "engine_tests.h"
+#include "generated_meshes.h"
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include <vk_mesh_simplify.h>
+
+//LOD chains of generated meshes, a heightfield grid and a uv sphere with a seam: every kept level has to meet its
+//triangle target within LOD_TARGET_SLACK, and the distance from LOD 0's vertices, triangle centroids and edge midpoints
+//to a level must stay within the error the level records
+bool test_mesh_lods()
+{
+	struct Case {
+		const char* name;
+		Mesh mesh;
+	};
+	Case cases[] = { { "grid", generate_grid_mesh(64) }, { "sphere", generate_sphere_mesh(48, 64) } };
+	for (Case& test : cases) {
+		Mesh& mesh = test.mesh;
+		const float lodTime = vkutil::generate_lods(mesh, DEFAULT_LOD_RATIOS.data(), DEFAULT_LOD_RATIOS.size());
+		if (!vkutil::validate_lods(mesh)) {
+			std::cerr << "LODs of the " << test.name << " failed validation" << std::endl;
+			return false;
+		}
+		const MeshLod base = mesh.base_lod();
+		std::vector<glm::vec3> points;
+		for (const Vertex& v : mesh._vertices) {
+			points.push_back(v.position);
+		}
+		for (uint32_t i = base.indexOffset; i < base.indexOffset + base.indexCount; i += 3) {
+			const glm::vec3 a = mesh._vertices[mesh._indices[i]].position;
+			const glm::vec3 b = mesh._vertices[mesh._indices[i + 1]].position;
+			const glm::vec3 c = mesh._vertices[mesh._indices[i + 2]].position;
+			points.push_back((a + b + c) / 3.0f);
+			//edge midpoints are not sampled by generate_lods, they check the bound holds between its samples
+			points.push_back((a + b) * 0.5f);
+			points.push_back((b + c) * 0.5f);
+			points.push_back((c + a) * 0.5f);
+		}
+
+		const uint32_t baseTriangles = base.indexCount / 3;
+		std::cout << "LODs of the " << test.name << ": " << mesh._lods.size() << " levels in " << lodTime << " ms" << std::endl;
+		std::cout << "  level  triangles     target      error   measured" << std::endl;
+		for (size_t l = 1; l < mesh._lods.size(); l++) {
+			const uint32_t triangles = mesh._lods[l].indexCount / 3;
+			const uint32_t target = static_cast<uint32_t>(baseTriangles * DEFAULT_LOD_RATIOS[l - 1]);
+			const float measured = vkutil::measure_lod_error(mesh, l, points);
+			const std::streamsize precision = std::cout.precision(4);
+			std::cout << "  " << std::setw(5) << l << std::setw(11) << triangles << std::setw(11) << target
+				<< std::setw(11) << mesh._lods[l].error << std::setw(11) << measured << std::endl;
+			std::cout.precision(precision);
+			if (triangles > target * (1.0f + LOD_TARGET_SLACK)) {
+				std::cerr << "LOD " << l << " of the " << test.name << " keeps " << triangles << " triangles for " << target << std::endl;
+				return false;
+			}
+			//small slack for float rounding in the distance queries
+			if (measured > mesh._lods[l].error * 1.001f + 1e-6f) {
+				std::cerr << "LOD " << l << " of the " << test.name << " deviates " << measured << " but records " << mesh._lods[l].error << std::endl;
+				return false;
+			}
+		}
+		//both simplify smoothly, a chain that stopped early means the simplifier regressed
+		if (mesh._lods.size() != DEFAULT_LOD_RATIOS.size() + 1) {
+			std::cerr << "The " << test.name << " got " << mesh._lods.size() - 1 << " of " << DEFAULT_LOD_RATIOS.size() << " levels" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
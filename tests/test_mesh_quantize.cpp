@@ -0,0 +1,56 @@
+#include "engine_tests.h"
+#include "generated_meshes.h"
+#include <iostream>
+#include <cmath>
+
+//the compact vertex format on generated meshes: a flat-ish grid and a uv sphere whose normals include the fold of the
+//octahedral encoding, (0,0,-1) and (+-1,0,0), where a sign flip of a rounding error lands on the opposite edge
+bool test_mesh_quantize()
+{
+	struct Case {
+		const char* name;
+		Mesh mesh;
+	};
+	Case cases[] = { { "grid", generate_grid_mesh(32) }, { "sphere", generate_sphere_mesh(16, 32) } };
+	//sin(pi) is not zero in float, snap the poles and the equator onto the exact fold normals
+	for (Vertex& v : cases[1].mesh._vertices) {
+		for (int c = 0; c < 3; c++) {
+			if (std::abs(v.normal[c]) < 1e-5f) {
+				v.normal[c] = 0.0f;
+			}
+			else if (std::abs(std::abs(v.normal[c]) - 1.0f) < 1e-5f) {
+				v.normal[c] = std::copysign(1.0f, v.normal[c]);
+			}
+		}
+	}
+	const glm::vec3 foldNormals[] = { { 0.0f, 0.0f, -1.0f }, { 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f } };
+	for (const glm::vec3& fold : foldNormals) {
+		bool found = false;
+		for (const Vertex& v : cases[1].mesh._vertices) {
+			found = found || v.normal == fold;
+		}
+		if (!found) {
+			std::cerr << "The sphere has no normal (" << fold.x << ", " << fold.y << ", " << fold.z << ")" << std::endl;
+			return false;
+		}
+	}
+
+	for (Case& test : cases) {
+		Mesh& mesh = test.mesh;
+		const size_t floatBytes = mesh.vertex_buffer_size();
+		mesh.quantize_vertices();
+		const QuantizationError error = mesh.measure_quantization_error();
+		std::cout << "Quantized the " << test.name << ": " << floatBytes << " -> " << mesh.vertex_buffer_size()
+			<< " bytes, max error position " << error.position << " (step " << mesh.position_step() << ") normal "
+			<< error.normal << " deg uv " << error.uv << std::endl;
+		if (mesh._vertexFormat != MeshVertexFormat::Compact || mesh.vertex_buffer_size() >= floatBytes) {
+			std::cerr << "The " << test.name << " did not switch to compact vertices" << std::endl;
+			return false;
+		}
+		if (!error.within_tolerance(mesh.position_step())) {
+			std::cerr << "Quantizing the " << test.name << " exceeds the tolerances" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,88 @@
+#include "engine_tests.h"
+#include "generated_meshes.h"
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+#include <vk_meshlet.h>
+
+//meshlets of generated meshes: validate_meshlets checks coverage, limits, spheres and cones, then the cone test of
+//Meshlet::cone is run from cameras around the mesh and every meshlet it culls must have all its triangles facing away
+bool test_meshlets()
+{
+	struct Case {
+		const char* name;
+		Mesh mesh;
+	};
+	Case cases[] = { { "grid", generate_grid_mesh(64) }, { "sphere", generate_sphere_mesh(48, 64) } };
+	//a fibonacci spiral of directions, each at a near and a far distance
+	std::vector<glm::vec3> cameras;
+	const uint32_t directionCount = 128;
+	for (uint32_t i = 0; i < directionCount; i++) {
+		const float z = 1.0f - 2.0f * (i + 0.5f) / directionCount;
+		const float phi = 2.39996323f * i;
+		const glm::vec3 direction(std::sqrt(1.0f - z * z) * std::cos(phi), std::sqrt(1.0f - z * z) * std::sin(phi), z);
+		cameras.push_back(direction * 1.5f);
+		cameras.push_back(direction * 6.0f);
+	}
+
+	for (Case& test : cases) {
+		Mesh& mesh = test.mesh;
+		const float buildTime = vkutil::build_meshlets(mesh);
+		if (!vkutil::validate_meshlets(mesh)) {
+			std::cerr << "Meshlets of the " << test.name << " failed validation" << std::endl;
+			return false;
+		}
+		uint32_t triangleCount = 0;
+		for (const Meshlet& meshlet : mesh._meshlets) {
+			if (meshlet.vertexCount == 0 || meshlet.vertexCount > MESHLET_MAX_VERTICES
+				|| meshlet.triangleCount == 0 || meshlet.triangleCount > MESHLET_MAX_TRIANGLES) {
+				std::cerr << "A meshlet of the " << test.name << " has " << meshlet.vertexCount << " vertices and "
+					<< meshlet.triangleCount << " triangles" << std::endl;
+				return false;
+			}
+			triangleCount += meshlet.triangleCount;
+		}
+		if (triangleCount != mesh.base_lod().indexCount / 3) {
+			std::cerr << "Meshlets of the " << test.name << " hold " << triangleCount << " triangles" << std::endl;
+			return false;
+		}
+
+		uint64_t tests = 0;
+		uint64_t culled = 0;
+		for (const glm::vec3& camera : cameras) {
+			for (const Meshlet& meshlet : mesh._meshlets) {
+				const glm::vec3 center(meshlet.sphere);
+				const glm::vec3 axis(meshlet.cone);
+				const glm::vec3 view = center - camera;
+				tests++;
+				if (glm::dot(view, axis) < meshlet.cone.w * glm::length(view) + meshlet.sphere.w) {
+					continue;
+				}
+				culled++;
+				const uint32_t* vertices = &mesh._meshletVertices[meshlet.vertexOffset];
+				const uint8_t* triangles = &mesh._meshletTriangles[meshlet.triangleOffset];
+				for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+					const glm::vec3& a = mesh._vertices[vertices[triangles[t * 3 + 0]]].position;
+					const glm::vec3& b = mesh._vertices[vertices[triangles[t * 3 + 1]]].position;
+					const glm::vec3& c = mesh._vertices[vertices[triangles[t * 3 + 2]]].position;
+					const glm::vec3 n = glm::cross(b - a, c - a);
+					//a culled triangle that faces the camera would be a visible hole
+					if (glm::dot(n, a - camera) < -1e-6f * glm::length(n) * glm::length(a - camera)) {
+						std::cerr << "A meshlet of the " << test.name << " is culled from (" << camera.x << ", "
+							<< camera.y << ", " << camera.z << ") with triangle " << t << " facing the camera" << std::endl;
+						return false;
+					}
+				}
+			}
+		}
+		std::cout << "Meshlets of the " << test.name << ": " << mesh._meshlets.size() << " clusters for " << triangleCount
+			<< " triangles in " << buildTime << " ms, cone culled " << culled << " of " << tests << " tests" << std::endl;
+		//a sphere seen from outside hides about half its meshlets, a cone test that never culls checks nothing
+		if (culled == 0) {
+			std::cerr << "Cones of the " << test.name << " never cull" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
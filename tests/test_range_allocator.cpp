@@ -0,0 +1,110 @@
+#include "engine_tests.h"
+#include <iostream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cmath>
+
+#include <range_allocator.h>
+#include <vk_mesh.h>
+
+//allocate and free thousands of mesh sized ranges in random order like streaming would, check after every
+//batch that live and free ranges tile the pool exactly and print how fragmented it gets
+bool test_range_allocator()
+{
+	const uint64_t capacity = 256ull * 1024 * 1024;
+	const int steps = 200000;
+	//vertex strides (CompactVertex, Vertex) and index sizes the engine uses
+	const uint64_t alignments[] = { 16, 44, 2, 4 };
+	RangeAllocator allocator(capacity);
+	std::mt19937 rng(1234);
+	//sizes log uniform between 1 KB and 1 MB
+	std::uniform_real_distribution<float> logSize(10.0f, 20.0f);
+	std::uniform_real_distribution<float> coin(0.0f, 1.0f);
+	std::vector<RangeAllocation> live;
+	size_t allocations = 0, frees = 0, failures = 0;
+	float worstFragmentation = 0.0f;
+	float operationTime = 0.0f;
+
+	auto check_tiling = [&]() {
+		std::vector<RangeAllocation> ranges;
+		for (const RangeAllocation& allocation : live) {
+			if (allocation.size > 0) {
+				ranges.push_back(allocation);
+			}
+		}
+		for (const auto& range : allocator.free_ranges()) {
+			ranges.push_back(RangeAllocation{ range.first, range.second });
+		}
+		std::sort(ranges.begin(), ranges.end(), [](const RangeAllocation& a, const RangeAllocation& b) { return a.offset < b.offset; });
+		uint64_t end = 0;
+		for (const RangeAllocation& range : ranges) {
+			if (range.offset != end) {
+				std::cerr << "Pool ranges " << (range.offset < end ? "overlap" : "leave a gap") << " at " << range.offset << std::endl;
+				return false;
+			}
+			end = range.offset + range.size;
+		}
+		if (end != capacity) {
+			std::cerr << "Pool ranges end at " << end << " instead of " << capacity << std::endl;
+			return false;
+		}
+		return allocator.validate();
+	};
+
+	for (int step = 0; step < steps; step++) {
+		//lean towards allocating while under 3/4 full so the pool fills up and then churns
+		const RangeAllocatorStats stats = allocator.stats();
+		const float allocateChance = stats.usedBytes < capacity * 3 / 4 ? 0.6f : 0.4f;
+		auto start = std::chrono::high_resolution_clock::now();
+		if (live.empty() || coin(rng) < allocateChance) {
+			const uint64_t size = static_cast<uint64_t>(std::exp2(logSize(rng)));
+			const uint64_t alignment = alignments[rng() % 4];
+			RangeAllocation allocation;
+			if (allocator.allocate(size / alignment * alignment + alignment, alignment, allocation)) {
+				operationTime += elapsed_ms(start);
+				if (allocation.offset % alignment != 0) {
+					std::cerr << "Pool range at " << allocation.offset << " is not aligned to " << alignment << std::endl;
+					return false;
+				}
+				live.push_back(allocation);
+				allocations++;
+			}
+			else {
+				operationTime += elapsed_ms(start);
+				failures++;
+			}
+		}
+		else {
+			const size_t victim = rng() % live.size();
+			allocator.free(live[victim]);
+			operationTime += elapsed_ms(start);
+			live[victim] = live.back();
+			live.pop_back();
+			frees++;
+		}
+		worstFragmentation = std::max(worstFragmentation, allocator.stats().fragmentation());
+		if (step % 1000 == 999 && !check_tiling()) {
+			return false;
+		}
+	}
+
+	const RangeAllocatorStats stats = allocator.stats();
+	std::cout << "Geometry pool stress: " << allocations << " allocations, " << frees << " frees, " << failures
+		<< " failed, " << operationTime * 1e6f / (allocations + frees + failures) << " ns per operation" << std::endl;
+	std::cout << "  " << stats.allocationCount << " live ranges using " << stats.usedBytes / (1024.0 * 1024.0) << " of "
+		<< capacity / (1024.0 * 1024.0) << " MB, " << stats.freeRangeCount << " free ranges, largest "
+		<< stats.largestFreeRange / (1024.0 * 1024.0) << " MB, fragmentation " << stats.fragmentation()
+		<< " (worst " << worstFragmentation << ")" << std::endl;
+
+	//everything freed has to merge back into a single range
+	for (const RangeAllocation& allocation : live) {
+		allocator.free(allocation);
+	}
+	live.clear();
+	if (!check_tiling() || allocator.stats().freeRangeCount != 1) {
+		std::cerr << "Pool did not merge back into one free range after freeing everything" << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,224 @@
+#include "engine_tests.h"
+#include <iostream>
+#include <vector>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <cmath>
+
+#include <resource_pool.h>
+#include <vk_renderObjects.h>
+
+//generational handles of the render object sets: checks that removed elements and reused slots never resolve through old
+//handles, that removing a mesh or material leaves no object drawing it and that sorting keeps the bounds with their objects,
+//then times a pass over 100000 objects reading their mesh and material through the pools against the objects of before,
+//raw pointers into unordered_maps keyed by name
+bool test_resource_pool()
+{
+	//removing and reusing a slot
+	ResourcePool<uint32_t> pool;
+	const Handle<uint32_t> first = pool.add(1);
+	pool.remove(first);
+	const Handle<uint32_t> reused = pool.add(2);
+	if (pool.get(first) || pool.remove(first) || reused.index() != first.index() || reused == first
+		|| !pool.get(reused) || *pool.get(reused) != 2 || pool.get(Handle<uint32_t>{}) || pool.size() != 1) {
+		std::cerr << "Resource pool: a removed handle still resolves after its slot was reused" << std::endl;
+		return false;
+	}
+	//generations wrap past 0, a slot never hands out the null handle
+	for (uint32_t i = 0; i < Handle<uint32_t>::GENERATION_MASK + 2; i++) {
+		pool.remove(pool.add(i));
+	}
+	//random churn, every handle ever removed has to stay stale
+	std::mt19937 rng(42);
+	std::vector<Handle<uint32_t>> live;
+	std::vector<uint32_t> liveValues;
+	std::vector<Handle<uint32_t>> removed;
+	uint32_t nullHandles = 0;
+	for (uint32_t step = 0; step < 200000; step++) {
+		if (live.empty() || rng() % 5 < 3) {
+			live.push_back(pool.add(step));
+			liveValues.push_back(step);
+			nullHandles += live.back().is_null();
+		}
+		else {
+			const size_t i = rng() % live.size();
+			pool.remove(live[i]);
+			removed.push_back(live[i]);
+			live[i] = live.back();
+			liveValues[i] = liveValues.back();
+			live.pop_back();
+			liveValues.pop_back();
+		}
+	}
+	uint32_t stale = 0;
+	for (Handle<uint32_t> handle : removed) {
+		stale += pool.get(handle) == nullptr;
+	}
+	uint32_t resolved = 0;
+	for (size_t i = 0; i < live.size(); i++) {
+		const uint32_t* value = pool.get(live[i]);
+		resolved += value && *value == liveValues[i];
+	}
+	if (nullHandles != 0 || stale != removed.size() || resolved != live.size() || pool.size() != live.size() + 1) {
+		std::cerr << "Resource pool churn: " << removed.size() - stale << " of " << removed.size() << " removed handles resolve, "
+			<< live.size() - resolved << " of " << live.size() << " live ones do not, " << nullHandles << " null handles" << std::endl;
+		return false;
+	}
+
+	//the scene: meshes and materials shared by many objects, visited in no particular order
+	const uint32_t meshCount = 1000;
+	const uint32_t materialCount = 64;
+	const uint32_t objectCount = 100000;
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	RenderObjectsSets sets;
+	std::unordered_map<std::string, Mesh> mapMeshes;
+	std::unordered_map<std::string, Material> mapMaterials;
+	for (uint32_t m = 0; m < materialCount; m++) {
+		const std::string name = "material" + std::to_string(m);
+		const MaterialHandle handle = sets.create_material(reinterpret_cast<VkPipeline>(uintptr_t(m) + 1), VK_NULL_HANDLE, name);
+		mapMaterials[name] = sets._materials[handle];
+	}
+	for (uint32_t m = 0; m < meshCount; m++) {
+		Mesh mesh;
+		mesh._bounds.sphere = glm::vec4(unit(rng), unit(rng), unit(rng), unit(rng));
+		mapMeshes["mesh" + std::to_string(m)] = mesh;
+		sets.add_mesh("mesh" + std::to_string(m), std::move(mesh));
+	}
+	//RenderObject as it was, 8 byte pointers and the table pointer
+	struct MapRenderObject {
+		Mesh* mesh;
+		Material* material;
+		Material** submeshMaterials;
+		glm::mat4 transformMatrix;
+		Bounds worldBounds;
+	};
+	std::vector<MapRenderObject> mapObjects(objectCount);
+	for (uint32_t i = 0; i < objectCount; i++) {
+		const std::string meshName = "mesh" + std::to_string(rng() % meshCount);
+		const std::string materialName = "material" + std::to_string(rng() % materialCount);
+		const glm::mat4 transform = glm::translate(glm::vec3(unit(rng), unit(rng), unit(rng)));
+		RenderObject object;
+		object.mesh = sets.get_mesh(meshName);
+		object.material = sets.get_material(materialName);
+		const uint32_t index = sets.add_renderable(object, transform);
+		mapObjects[i] = { &mapMeshes[meshName], &mapMaterials[materialName], nullptr, transform, sets._renderableBounds[index] };
+	}
+
+	//what draw_objects reads per object, the mesh bounds and buffers and the material's pipeline
+	const int passes = 20;
+	double mapSum = 0.0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int pass = 0; pass < passes; pass++) {
+		for (const MapRenderObject& object : mapObjects) {
+			mapSum += object.mesh->_bounds.sphere.w * object.transformMatrix[3].x + object.mesh->_firstIndex
+				+ float(reinterpret_cast<uintptr_t>(object.material->pipeline));
+		}
+	}
+	const float mapTime = elapsed_ms(start) / passes;
+	//the draw loop's lookups, unchecked in release builds
+	double poolSum = 0.0;
+	start = std::chrono::high_resolution_clock::now();
+	for (int pass = 0; pass < passes; pass++) {
+		for (const RenderObject& object : sets._renderables) {
+			const Mesh& mesh = sets._meshes[object.mesh];
+			poolSum += mesh._bounds.sphere.w * object.transformMatrix[3].x + mesh._firstIndex
+				+ float(reinterpret_cast<uintptr_t>(sets._materials[object.material].pipeline));
+		}
+	}
+	const float poolTime = elapsed_ms(start) / passes;
+	if (std::abs(mapSum - poolSum) > 1e-6 * std::abs(mapSum)) {
+		std::cerr << "Handle traversal read other meshes or materials than the pointers" << std::endl;
+		return false;
+	}
+
+	//objects drawing a material through their submesh table
+	Mesh tabled;
+	tabled._materials.resize(2);
+	tabled._materials[0].name = "a";
+	tabled._materials[1].name = "b";
+	const uint32_t table = sets.create_mesh_materials("tabled", tabled, VK_NULL_HANDLE, VK_NULL_HANDLE);
+	RenderObject tabledObject;
+	tabledObject.mesh = sets.add_mesh("tabled", std::move(tabled));
+	tabledObject.material = sets.get_material("material0");
+	tabledObject.submeshMaterials = table;
+	for (uint32_t i = 0; i < 10; i++) {
+		sets.add_renderable(tabledObject, glm::mat4(1.0f));
+	}
+
+	//unloading: the objects drawing what is removed leave the draw list, everything left resolves
+	auto count_drawing = [&sets](auto draws) {
+		uint32_t count = 0;
+		for (const RenderObject& object : sets._renderables) {
+			count += draws(object);
+		}
+		return count;
+	};
+	auto all_live = [&sets]() {
+		for (const RenderObject& object : sets._renderables) {
+			if (!sets._meshes.contains(object.mesh) || !sets._materials.contains(object.material)) {
+				return false;
+			}
+		}
+		return sets._renderables.size() == sets._renderableBounds.size();
+	};
+	const MeshHandle unloaded = sets.get_mesh("mesh0");
+	const MaterialHandle unloadedMaterial = sets.get_material("material1");
+	const size_t objectsBefore = sets._renderables.size();
+	const uint32_t meshObjects = count_drawing([unloaded](const RenderObject& object) { return object.mesh == unloaded; });
+	sets.remove_mesh("mesh0");
+	const uint32_t materialObjects = count_drawing([unloadedMaterial](const RenderObject& object) { return object.material == unloadedMaterial; });
+	sets.remove_material("material1");
+	sets.remove_material("tabled/b");
+	sets.add_mesh("mesh_after", Mesh{});
+	const size_t removedObjects = objectsBefore - sets._renderables.size();
+	if (removedObjects != meshObjects + materialObjects + 10 || !all_live() || sets._meshes.get(unloaded)
+		|| sets._materials.get(unloadedMaterial) || sets.get_mesh("mesh_after").index() != unloaded.index()) {
+		std::cerr << "Removing: " << removedObjects << " objects left the draw list, " << meshObjects << " drew the mesh, "
+			<< materialObjects << " the material and 10 the submesh material" << std::endl;
+		return false;
+	}
+
+	//a mesh loaded under two names stays while either is left, its objects with it
+	const MeshHandle shared = sets.get_mesh("mesh2");
+	sets.alias_mesh("mesh2_alias", shared);
+	const uint32_t sharedObjects = count_drawing([shared](const RenderObject& object) { return object.mesh == shared; });
+	sets.remove_mesh("mesh2");
+	const bool aliasKept = sets._meshes.contains(shared) && sets.mesh_name_count(shared) == 1
+		&& count_drawing([shared](const RenderObject& object) { return object.mesh == shared; }) == sharedObjects;
+	sets.remove_mesh("mesh2_alias");
+	if (!aliasKept || sets._meshes.contains(shared) || !all_live()) {
+		std::cerr << "Shared mesh: " << (aliasKept ? "kept after" : "removed before") << " its last name" << std::endl;
+		return false;
+	}
+
+	//sorting by pipeline and texture set groups the objects of a material, bounds stay with their objects
+	size_t pipelineRuns = 0;
+	for (size_t i = 0; i < sets._renderables.size(); i++) {
+		pipelineRuns += i == 0 || sets._materials[sets._renderables[i].material].pipeline
+			!= sets._materials[sets._renderables[i - 1].material].pipeline;
+	}
+	sets.sort_renderables();
+	bool sorted = sets._renderables.size() == sets._renderableBounds.size();
+	size_t sortedRuns = 0;
+	for (size_t i = 0; i < sets._renderables.size() && sorted; i++) {
+		const RenderObject& object = sets._renderables[i];
+		const Bounds bounds = vkutil::transform_bounds(sets._meshes[object.mesh]._bounds, object.transformMatrix);
+		sorted = bounds.sphere == sets._renderableBounds[i].sphere && (i == 0
+			|| sets._materials[sets._renderables[i - 1].material].pipeline <= sets._materials[object.material].pipeline);
+		sortedRuns += i == 0 || sets._materials[sets._renderables[i - 1].material].pipeline != sets._materials[object.material].pipeline;
+	}
+	if (!sorted || sortedRuns > materialCount) {
+		std::cerr << "Sorting renderables: " << (sorted ? "in order" : "out of order or bounds moved apart") << ", "
+			<< sortedRuns << " pipeline runs for " << materialCount << " materials" << std::endl;
+		return false;
+	}
+
+	std::cout << "Resource handles: " << removed.size() << " removed handles stale, " << live.size() << " live resolve, "
+		<< removedObjects << " objects of removed meshes and materials left the draw list, sorting cut "
+		<< pipelineRuns << " pipeline runs to " << sortedRuns << std::endl;
+	std::cout << "  " << objectCount << " objects over " << meshCount << " meshes and " << materialCount << " materials: "
+		<< sizeof(MapRenderObject) << " byte objects of map pointers " << mapTime << " ms, " << sizeof(RenderObject)
+		<< " byte objects of pool handles " << poolTime << " ms per pass" << std::endl;
+	return true;
+}
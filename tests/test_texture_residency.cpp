@@ -0,0 +1,151 @@
+#include "engine_tests.h"
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <deque>
+#include <random>
+#include <algorithm>
+#include <cmath>
+
+#include <texture_residency.h>
+#include <asset_loader.h>
+#include <frame_allocator.h>
+#include <memory_stats.h>
+#include <vk_bounds.h>
+#include <mip_generator.h>
+
+//texture streaming along a scripted camera path: a grid of BC7 textured objects, the residency policy fed
+//with their footprints every frame, moves landing a few frames after they are planned like async loads,
+//and a budget that halves half way through; prints resident bytes over time and checks the budget holds,
+//and that residency settles once the camera stops, without touching the heap in builds that count allocations
+bool test_texture_residency()
+{
+	const int gridSize = 8;
+	const float spacing = 12.0f;
+	const float radius = 4.0f;
+	//stand in for frustum culling, objects further away are not drawn
+	const float viewDistance = 40.0f;
+	const float pixelsPerUnit = 800.0f / (2.0f * std::tan(glm::radians(45.0f) * 0.5f));
+	const int latency = 3;
+	const uint32_t maxStreamIns = 4;
+	const uint64_t budgets[2] = { 96ull * 1024 * 1024, 48ull * 1024 * 1024 };
+	const int flyFrames = 300;
+	const int holdFrames = 150;
+	const int budgetDropFrame = flyFrames * 3 / 2;
+	const glm::vec3 waypoints[] = { { -10.0f, -10.0f, 6.0f }, { 94.0f, 94.0f, 6.0f }, { 0.0f, 94.0f, 6.0f }, { 42.0f, 42.0f, 6.0f } };
+	const int totalFrames = flyFrames * 3 + holdFrames;
+
+	TextureResidency residency;
+	std::vector<glm::vec4> spheres;
+	std::vector<glm::uvec2> sizes;
+	uint64_t fullBytes = 0;
+	for (int y = 0; y < gridSize; y++) {
+		for (int x = 0; x < gridSize; x++) {
+			const uint32_t size = 1024u << ((x + y) % 3);
+			std::vector<uint64_t> levels;
+			for (uint32_t i = 0; i < vkutil::mip_level_count(size, size); i++) {
+				levels.push_back(assets::texture_level_size(assets::TextureFormat::BC7_SRGB, std::max(1u, size >> i), std::max(1u, size >> i)));
+			}
+			const uint32_t id = residency.add_texture(size, size, levels);
+			fullBytes += residency.bytes_from(id, 0);
+			spheres.push_back(glm::vec4(x * spacing, y * spacing, 0.0f, radius));
+			sizes.push_back(glm::uvec2(size));
+		}
+	}
+
+	struct Move {
+		int landFrame;
+		ResidencyRequest request;
+	};
+	std::deque<Move> inFlight;
+	std::vector<ResidencyRequest> streamIns, evictions;
+	//one arena like the engine's frames, a single one is enough since nothing planned outlives the frame
+	FrameAllocator scratch(64 * 1024);
+	//plan keeps room for a move of every texture, reserved here it has nothing to grow
+	streamIns.reserve(residency.texture_count());
+	evictions.reserve(residency.texture_count());
+	uint64_t planHeapAllocations = 0, heldHeapAllocations = 0;
+	uint64_t peakResident = 0;
+	uint64_t holdStreamIns = 0, holdEvictions = 0;
+	const double mb = 1.0 / (1024.0 * 1024.0);
+	std::cout << "Texture streaming: " << spheres.size() << " BC7 textures, " << fullBytes * mb << " MB with every level resident, "
+		<< latency << " frame load latency" << std::endl;
+	std::cout << "  frame   drawn  resident MB  committed MB  budget MB  below desired  in flight  stream ins  evictions" << std::endl;
+	for (int frame = 0; frame < totalFrames; frame++) {
+		const uint64_t heapAllocations = vkutil::heap_allocation_count();
+		scratch.reset();
+		//moves planned latency frames ago land first, like finished loads at the start of a frame
+		while (!inFlight.empty() && inFlight.front().landFrame <= frame) {
+			residency.complete(inFlight.front().request.texture, inFlight.front().request.targetMip);
+			inFlight.pop_front();
+		}
+
+		const int segment = std::min(frame / flyFrames, 2);
+		const float t = std::min(1.0f, float(frame - segment * flyFrames) / flyFrames);
+		const glm::vec3 eye = glm::mix(waypoints[segment], waypoints[segment + 1], t);
+		int drawn = 0;
+		for (uint32_t i = 0; i < spheres.size(); i++) {
+			if (glm::length(glm::vec3(spheres[i]) - eye) > viewDistance) {
+				continue;
+			}
+			const float pixels = vkutil::sphere_screen_pixels(spheres[i], eye, pixelsPerUnit);
+			residency.request(i, vkutil::footprint_mip(sizes[i].x, sizes[i].y, residency.level_count(i), pixels));
+			drawn++;
+		}
+
+		const uint64_t budget = frame < budgetDropFrame ? budgets[0] : budgets[1];
+		const uint64_t planStart = vkutil::heap_allocation_count();
+		residency.plan(budget, maxStreamIns, streamIns, evictions, scratch);
+		planHeapAllocations += vkutil::heap_allocation_count() - planStart;
+		for (const ResidencyRequest& request : evictions) {
+			inFlight.push_back({ frame + latency, request });
+		}
+		for (const ResidencyRequest& request : streamIns) {
+			inFlight.push_back({ frame + latency, request });
+		}
+		if (frame >= totalFrames - 60) {
+			heldHeapAllocations += vkutil::heap_allocation_count() - heapAllocations;
+		}
+
+		const ResidencyStats& stats = residency.stats();
+		peakResident = std::max(peakResident, stats.residentBytes);
+		if (frame % 50 == 0 || frame == totalFrames - 1) {
+			std::cout << "  " << std::setw(5) << frame << std::setw(8) << drawn << std::setw(13) << stats.residentBytes * mb
+				<< std::setw(14) << stats.committedBytes * mb << std::setw(11) << budget * mb << std::setw(15) << stats.texturesBelowDesired
+				<< std::setw(11) << stats.inFlight << std::setw(12) << stats.streamIns << std::setw(11) << stats.evictions << std::endl;
+		}
+		//right after the budget drops the evictions it causes are still loading
+		if (stats.residentBytes > budget && !(frame >= budgetDropFrame && frame <= budgetDropFrame + latency)) {
+			std::cerr << "Resident textures exceed the budget at frame " << frame << ": " << stats.residentBytes << " > " << budget << std::endl;
+			return false;
+		}
+		if (frame == totalFrames - 60) {
+			holdStreamIns = stats.streamIns;
+			holdEvictions = stats.evictions;
+		}
+	}
+	for (uint32_t i = 0; i < residency.texture_count(); i++) {
+		if (residency.resident_mip(i) > residency.tail_mip(i)) {
+			std::cerr << "Texture " << i << " lost its tail levels" << std::endl;
+			return false;
+		}
+	}
+	const ResidencyStats& stats = residency.stats();
+	std::cout << "  peak resident " << peakResident * mb << " MB, " << stats.streamIns << " stream ins, " << stats.evictions << " evictions, "
+		<< "frame arena high water " << scratch.stats().highWater << " bytes" << std::endl;
+	//planning never allocates, and neither does a whole frame once the camera stopped and the moves landed
+	if (vkutil::heap_allocations_counted()) {
+		std::cout << "  " << planHeapAllocations << " heap allocations planning " << totalFrames << " frames, "
+			<< heldHeapAllocations << " over the last 60 frames" << std::endl;
+		if (planHeapAllocations != 0 || heldHeapAllocations != 0) {
+			std::cerr << "Frames allocate on the heap" << std::endl;
+			return false;
+		}
+	}
+	//a still camera must not keep swapping levels in and out
+	if (stats.streamIns != holdStreamIns || stats.evictions != holdEvictions || stats.inFlight != 0) {
+		std::cerr << "Residency keeps changing with the camera standing still" << std::endl;
+		return false;
+	}
+	return true;
+}